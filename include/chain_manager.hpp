@@ -2,6 +2,7 @@
 
 #include "config.hpp"
 #include "command_executor.hpp"
+#include "ruleset_snapshot.hpp"
 #include <string>
 #include <vector>
 #include <set>
@@ -26,6 +27,17 @@ public:
      */
     explicit ChainManager(CommandExecutor& executor, bool debug_mode = false);
 
+    /**
+     * @brief Answer chain lookups from a ruleset snapshot
+     * 
+     * While a snapshot is set, chainExists() and listChains() read it instead
+     * of listing the filter table, and successful create, flush and delete
+     * operations are mirrored into it.
+     * 
+     * @param snapshot Snapshot owned by the caller, or nullptr to list the kernel again
+     */
+    void setSnapshot(RulesetSnapshot* snapshot) { snapshot_ = snapshot; }
+
     /**
      * @brief Create a custom iptables chain
      * 
@@ -125,6 +137,7 @@ private:
     bool debug_mode_;
     std::string last_error_;
     std::set<std::string> managed_chains_;  // Chains created by this manager
+    RulesetSnapshot* snapshot_ = nullptr;   // Live ruleset model, not owned
 
     /**
      * @brief Build dependency graph for chains
@@ -0,0 +1,141 @@
+/**
+ * @file change_monitor.hpp
+ * @brief Waiting for changes to the kernel's iptables tables
+ * @author iptables-compose-cpp Development Team
+ * @date 2024
+ *
+ * This file contains the ChangeMonitor class used by --watch and
+ * --daemon. With the nf_tables variant of iptables, the kernel announces
+ * every ruleset change on the NFNLGRP_NFTABLES netlink group, and the
+ * monitor sleeps until one arrives. The legacy tables send no
+ * notifications; there the monitor compares StateJournal fingerprints, one
+ * getsockopt() per table, without starting a process or listing any rules.
+ * Configuration files can be watched as well, through inotify.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace iptables {
+
+/**
+ * @class ChangeMonitor
+ * @brief Blocks until some tables or files change
+ *
+ * Changes usually come in bursts, e.g. Docker creating a container's
+ * rules one by one or an editor saving a file in several steps, so a
+ * change is only reported once everything has been quiet for kSettleTime.
+ * Waiting stops when CommandExecutor::cancelAll() is called, e.g. from a
+ * SIGTERM handler.
+ */
+class ChangeMonitor {
+public:
+    /// How often fingerprints are compared when there are no notifications
+    static constexpr std::chrono::milliseconds kPollInterval{2000};
+
+    /// Quiet time that ends a burst of changes
+    static constexpr std::chrono::milliseconds kSettleTime{250};
+
+    /// Longest burst waited out before a change is reported anyway
+    static constexpr std::chrono::milliseconds kMaxSettleTime{3000};
+
+    /**
+     * @brief Start monitoring
+     * @param tables Tables whose fingerprints are compared when polling
+     */
+    explicit ChangeMonitor(std::vector<std::string> tables);
+
+    /**
+     * @brief Leave the netlink group and stop watching files
+     */
+    ~ChangeMonitor();
+
+    ChangeMonitor(const ChangeMonitor&) = delete;
+    ChangeMonitor& operator=(const ChangeMonitor&) = delete;
+
+    /**
+     * @brief Check whether changes are announced by the kernel
+     * @return true for netlink notifications, false for fingerprint polling
+     */
+    bool eventDriven() const { return socket_ >= 0; }
+
+    /**
+     * @brief Also report changes to some files
+     * @param files Files to watch, replacing any watched before
+     * @return true if every file's directory could be watched
+     *
+     * Writing, creating, deleting or renaming over a file counts as a
+     * change; touching it does not. A file that is a directory also
+     * reports such changes to every file inside it.
+     */
+    bool watchFiles(const std::vector<std::filesystem::path>& files);
+
+    /**
+     * @brief Check whether a watched file changed during the last waitForChange()
+     */
+    bool filesChanged() const { return files_changed_; }
+
+    /**
+     * @brief Check whether the tables changed during the last waitForChange()
+     */
+    bool tablesChanged() const { return tables_changed_; }
+
+    /**
+     * @brief Also wake up when a descriptor becomes readable
+     * @param descriptor E.g. ControlServer::descriptor(); -1 to stop
+     *
+     * Readiness ends the wait at once, without waiting for quiet.
+     */
+    void watchRequests(int descriptor) { requests_ = descriptor; }
+
+    /**
+     * @brief Check whether the watchRequests() descriptor ended the last waitForChange()
+     */
+    bool requestsPending() const { return requests_pending_; }
+
+    /**
+     * @brief Replace the tables whose fingerprints are compared
+     * @param tables Table names
+     */
+    void watchTables(std::vector<std::string> tables);
+
+    /**
+     * @brief Wait for the next burst of changes to end
+     * @return true once the tables or a watched file changed or requests
+     *         are pending, false if waiting was cancelled
+     *
+     * Without notifications and without fingerprints, every kPollInterval
+     * counts as a change, so the caller falls back to checking on a timer.
+     */
+    bool waitForChange();
+
+    /**
+     * @brief Forget the changes made so far, e.g. by the caller's own repair
+     */
+    void rearm();
+
+private:
+    bool collect(std::chrono::milliseconds timeout, bool settling);
+    bool drainTables() const;
+    bool drainFiles() const;
+
+    std::vector<std::string> tables_;
+    int socket_ = -1;
+    std::optional<uint64_t> fingerprint_;
+    int inotify_ = -1;
+    std::map<int, std::set<std::string>> watched_;  ///< Watched directory -> file names in it; "" for any
+    bool files_changed_ = false;
+    bool tables_changed_ = false;
+    int requests_ = -1;
+    bool requests_pending_ = false;
+};
+
+} // namespace iptables
@@ -40,6 +40,24 @@ public:
         bool show_license = false;  ///< Display license information
         bool help = false;          ///< Display help information
         bool debug = false;         ///< Bypass system validation for testing
+        std::string backend = "iptables";         ///< Apply backend: "iptables", "restore", "libiptc" or "stream"
+        std::optional<std::string> emit_restore;  ///< Write iptables-restore payload here ("-" for stdout)
+        bool plan = false;          ///< Print the changes that applying would make, without applying
+        std::optional<unsigned> timeout;  ///< Seconds the whole run may take; unlimited if unset
+        unsigned command_timeout = 30;    ///< Seconds a single command may take; 0 for unlimited
+        std::optional<std::filesystem::path> simulate;  ///< Run against an in-memory netfilter kept in this file
+        unsigned simulate_latency_ms = 0;               ///< Simulated latency of every iptables program call
+        std::optional<std::filesystem::path> metrics_file;  ///< Write run metrics here (.json or Prometheus text)
+        bool section_chains = false;  ///< Compile each section into chains of its own
+        std::optional<std::filesystem::path> state_file;  ///< State journal; StateJournal::kDefaultPath if unset
+        bool reload = false;          ///< Switch to the configuration make-before-break, see IptablesManager::reloadConfig()
+        bool from_cache = false;      ///< Boot from the cached payload, see IptablesManager::loadFromCache()
+        std::optional<std::filesystem::path> cache_file;  ///< Ruleset cache; RulesetCache::kDefaultPath if unset
+        bool check = false;           ///< Report drift of the managed rules, see IptablesManager::checkConfig()
+        bool watch = false;           ///< Repair drift whenever the tables change, see IptablesManager::watchConfig()
+        bool daemon = false;          ///< Follow edits of the configuration as well, see IptablesManager::runDaemon()
+        std::optional<std::string> control;  ///< Send this request to a running daemon and print the response
+        std::optional<std::filesystem::path> socket;  ///< Control socket; ControlServer::kDefaultPath if unset
     };
     
     /**
@@ -82,6 +100,16 @@ private:
      * config file and remove_rules simultaneously).
      */
     static void validateOptions(const Options& options);
+    
+    /**
+     * @brief Parse a non-negative number option argument
+     * @param option Option name used in the error message
+     * @param value Argument text
+     * @param maximum Largest accepted value
+     * @return Parsed number
+     * @throws std::invalid_argument if value is not a number or out of range
+     */
+    static unsigned parseNumber(const std::string& option, const std::string& value, unsigned maximum);
 };
 
 } // namespace iptables 
\ No newline at end of file
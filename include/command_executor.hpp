@@ -12,12 +12,44 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <optional>
 
 namespace iptables {
 
+/**
+ * @struct ExecutionLimits
+ * @brief When a running child must be given up on
+ *
+ * A default-constructed value imposes no limit. Once the deadline has
+ * passed or the cancellation flag is set, the child's process group is
+ * killed with SIGKILL and the result is marked as timed out.
+ */
+struct ExecutionLimits {
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point deadline = Clock::time_point::max();  ///< Latest time the child may still run
+    const std::atomic<bool>* cancelled = nullptr;            ///< Set from another thread or a signal handler
+
+    /**
+     * @brief Check whether the child must be stopped now
+     */
+    bool expired() const {
+        return (cancelled && cancelled->load()) || Clock::now() >= deadline;
+    }
+
+    /**
+     * @brief Check whether any limit is set at all
+     */
+    bool bounded() const {
+        return cancelled != nullptr || deadline != Clock::time_point::max();
+    }
+};
+
 /**
  * @struct CommandResult
  * @brief Structure representing the result of a command execution
@@ -32,6 +64,7 @@ struct CommandResult {
     std::string stdout_output;     ///< Standard output from the command
     std::string stderr_output;     ///< Standard error output from the command
     std::string command;           ///< The actual command that was executed
+    bool timed_out = false;        ///< Killed because its deadline passed or it was cancelled
     
     /**
      * @brief Check if the command executed successfully
@@ -85,6 +118,54 @@ struct CommandResult {
     }
 };
 
+/**
+ * @class CommandRunner
+ * @brief Replaceable program runner behind CommandExecutor
+ * 
+ * By default CommandExecutor spawns real processes. Installing a runner
+ * with CommandExecutor::setRunner() routes every command, including the
+ * streamed restore sessions, to it instead, e.g. to simulate iptables in
+ * memory.
+ */
+class CommandRunner {
+public:
+    virtual ~CommandRunner() = default;
+    
+    /**
+     * @brief Run one program to completion
+     * @param argv Program name followed by its arguments
+     * @param input Data for the program's stdin
+     * @param limits Deadline and cancellation flag for the program
+     * @return Result as a spawned process would report it
+     * 
+     * May be called from several threads at once.
+     */
+    virtual CommandResult run(const std::vector<std::string>& argv, const std::string& input,
+                              const ExecutionLimits& limits) = 0;
+    
+    /**
+     * @brief Fingerprint tables without listing them, see StateJournal::fingerprint()
+     * @param tables Table names
+     * @return Hash of the tables' rules, chains and policies, or std::nullopt
+     *         if the runner cannot provide one
+     */
+    virtual std::optional<uint64_t> rulesetFingerprint(const std::vector<std::string>& tables) {
+        (void)tables;
+        return std::nullopt;
+    }
+    
+    /**
+     * @brief Check tables for rules without listing them, see StateJournal::isEmpty()
+     * @param tables Table names
+     * @return true if none of the tables holds a rule or user-defined chain,
+     *         or std::nullopt if the runner cannot tell
+     */
+    virtual std::optional<bool> rulesetEmpty(const std::vector<std::string>& tables) {
+        (void)tables;
+        return std::nullopt;
+    }
+};
+
 /**
  * @enum LogLevel
  * @brief Logging levels for command execution
@@ -115,7 +196,7 @@ enum class LogLevel {
  * - Configurable logging levels for debugging and monitoring
  * - Specialized methods for common iptables operations
  * - Robust error handling and output capture
- * - Shell argument escaping for security
+ * - Direct program execution without a shell (posix_spawn)
  * - Command validation and availability checking
  * 
  * All methods are static, making the class a utility interface that can be
@@ -131,8 +212,8 @@ public:
      * 
      * Executes a command specified as a vector of arguments. The first element
      * should be the command name, and subsequent elements are arguments.
-     * This is the preferred method for command execution as it handles
-     * argument escaping automatically.
+     * This is the preferred method for command execution: the program is
+     * spawned directly, so arguments are passed verbatim without quoting.
      */
     static CommandResult execute(const std::vector<std::string>& args);
     
@@ -143,7 +224,7 @@ public:
      * @throws std::invalid_argument if command string is empty
      * 
      * Executes a command specified as a single string. The string is passed
-     * directly to the shell, so shell features like pipes and redirection
+     * to /bin/sh -c, so shell features like pipes and redirection
      * are available but manual escaping may be required.
      */
     static CommandResult execute(const std::string& command);
@@ -171,6 +252,8 @@ public:
      * 
      * Convenience method for iptables commands that automatically prepends
      * the 'iptables' command. Arguments should not include the command itself.
+     * Like every command that changes the ruleset, it runs with --wait and
+     * is retried while another process holds the xtables lock.
      */
     static CommandResult executeIptables(const std::vector<std::string>& args);
     
@@ -233,6 +316,27 @@ public:
     static CommandResult flushChain(const std::string& table = "filter",
                                   const std::string& chain = "");
     
+    /**
+     * @brief Dump the complete live ruleset
+     * @return CommandResult whose stdout holds the iptables-save -c output
+     * 
+     * Reads every table, chain, policy and rule, including packet and
+     * byte counters, with a single iptables-save invocation.
+     */
+    static CommandResult saveRuleset();
+    
+    /**
+     * @brief Feed a payload to iptables-restore
+     * @param payload Complete iptables-restore input (one or more *table ... COMMIT blocks)
+     * @param options Additional iptables-restore options (e.g. "--counters", "--noflush")
+     * @return CommandResult with restore status
+     * 
+     * The payload is streamed to iptables-restore over stdin. Each table
+     * in the payload is committed atomically by the kernel.
+     */
+    static CommandResult executeRestore(const std::string& payload,
+                                        const std::vector<std::string>& options = {});
+    
     /**
      * @brief Enable or disable logging
      * @param level Logging level to set
@@ -259,18 +363,91 @@ public:
      */
     static bool isIptablesAvailable();
     
+    /**
+     * @brief Limit how long a single command may run
+     * @param timeout Maximum runtime; zero removes the limit
+     * 
+     * A command that runs longer is killed together with its process
+     * group. The default is kDefaultCommandTimeout.
+     */
+    static void setCommandTimeout(std::chrono::milliseconds timeout);
+    
+    /**
+     * @brief Set a deadline for all remaining commands
+     * @param deadline Point in time after which no command may still run
+     * 
+     * Used to bound a complete apply: commands started later get whatever
+     * time is left, and commands that would start after the deadline fail
+     * immediately.
+     */
+    static void setDeadline(ExecutionLimits::Clock::time_point deadline);
+    
+    /**
+     * @brief Kill every running command and fail all later ones
+     * 
+     * Only sets an atomic flag, so it may be called from a signal handler.
+     * Running children are killed within ExecutionLimits' polling interval.
+     */
+    static void cancelAll();
+    
+    /**
+     * @brief Check whether cancelAll() was called
+     */
+    static bool isCancelled();
+    
+    /**
+     * @brief Limits for a command starting now
+     * @return The earlier of the command timeout and the global deadline,
+     *         together with the global cancellation flag
+     */
+    static ExecutionLimits currentLimits();
+    
+    /**
+     * @brief Route all commands to a runner instead of spawning processes
+     * @param runner Runner owned by the caller, or nullptr to spawn processes again
+     */
+    static void setRunner(CommandRunner* runner);
+    
+    /**
+     * @brief Runner installed with setRunner()
+     * @return Runner, or nullptr if commands spawn real processes
+     */
+    static CommandRunner* runner();
+    
+    /// Per-command timeout used until setCommandTimeout() is called
+    static constexpr std::chrono::seconds kDefaultCommandTimeout{30};
+    
+    /**
+     * @brief iptables-restore option that waits for the xtables lock
+     * @return "--wait=<seconds>" using XtablesLock::kWaitSeconds
+     */
+    static std::string restoreWaitOption();
+    
 private:
     /**
-     * @brief Internal method to execute command with full control
-     * @param command Command string to execute
-     * @param capture_output Whether to capture stdout/stderr
+     * @brief Execute a command that takes the xtables lock
+     * @param args Program name followed by its arguments, including --wait
+     * @param input Data written to the program's stdin
+     * @return CommandResult of the last attempt
+     * 
+     * Waits until the lock is free, runs the command, and re-runs it with
+     * jittered exponential backoff while it exits with code 4 (lock held).
+     * Time blocked on the lock and time spent working are added to the
+     * XtablesLock statistics.
+     */
+    static CommandResult executeLocked(const std::vector<std::string>& args, const std::string& input = "");
+    
+    /**
+     * @brief Internal method to execute a program with full control
+     * @param args Program name followed by its arguments
+     * @param input Data written to the program's stdin
      * @return CommandResult with execution details
      * 
-     * Core execution method used by all public methods. Handles process
-     * creation, output capture, error handling, and result structure
-     * population. Uses popen() for command execution.
+     * Core execution method used by all public methods. Spawns the program
+     * through ProcessRunner without a shell, captures stdout and stderr
+     * separately, and logs the outcome.
      */
-    static CommandResult executeInternal(const std::string& command, bool capture_output = true);
+    static CommandResult executeInternal(const std::vector<std::string>& args, const std::string& input = "");
     
     /**
      * @brief Log a message at the specified level
@@ -288,8 +465,8 @@ private:
      * @return Properly escaped command string
      * 
      * Converts a vector of command arguments into a single command string
-     * with proper shell escaping. Used internally to prepare commands
-     * for execution.
+     * with proper shell escaping. Used for log output and error messages;
+     * commands are never executed through this string.
      */
     static std::string argsToCommand(const std::vector<std::string>& args);
     
@@ -315,6 +492,10 @@ private:
     static std::string logLevelToString(LogLevel level);
     
     static LogLevel current_log_level_; ///< Current global logging level
+    static std::chrono::milliseconds command_timeout_;          ///< Zero for no per-command limit
+    static ExecutionLimits::Clock::time_point deadline_;        ///< Global deadline, max() if unset
+    static std::atomic<bool> cancelled_;                        ///< Set by cancelAll()
+    static CommandRunner* runner_;                              ///< Replaces ProcessRunner when set
 };
 
 } // namespace iptables 
\ No newline at end of file
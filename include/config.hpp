@@ -21,6 +21,7 @@
 #pragma once
 
 #include "rule.hpp"
+#include "match_values.hpp"
 #include <string>
 #include <vector>
 #include <map>
@@ -69,14 +70,14 @@ enum class Policy {
  */
 struct PortConfig {
     std::optional<uint16_t> port;  ///< Single port number (mutually exclusive with range)
-    std::optional<std::vector<std::string>> range;  ///< Port ranges like ["1000-2000", "3000-4000"]
+    std::optional<std::vector<PortRange>> range;  ///< Port ranges like ["1000-2000", "3000-4000"]
     Protocol protocol = Protocol::Tcp;  ///< Protocol type (TCP or UDP)
     Direction direction = Direction::Input;  ///< Traffic direction (INPUT or OUTPUT)
-    std::optional<std::vector<std::string>> subnet;  ///< Source/destination subnet restrictions
+    std::optional<std::vector<Subnet>> subnet;  ///< Source/destination subnet restrictions
     std::optional<uint16_t> forward;  ///< Port forwarding target port
     bool allow = true;  ///< Whether to ACCEPT (true) or DROP (false) traffic
     std::optional<InterfaceConfig> interface;  ///< Network interface configuration
-    std::optional<std::string> mac_source;  ///< MAC address source filter
+    std::optional<MacAddress> mac_source;  ///< MAC address source filter
     std::optional<std::string> chain;  ///< Direct chain target (mutually exclusive with allow/forward)
 
     /**
@@ -99,17 +100,6 @@ struct PortConfig {
      * including which fields are invalid and why.
      */
     std::string getErrorMessage() const;
-
-private:
-    /**
-     * @brief Validate a port range string format
-     * @param range_str Port range in format "start-end"
-     * @return true if range format is valid
-     * 
-     * Validates that the range string follows the correct format
-     * and that start <= end within valid port number bounds.
-     */
-    bool isValidPortRange(const std::string& range_str) const;
 };
 
 /**
@@ -126,9 +116,9 @@ private:
  * Used for Layer 2 filtering and device-specific access control.
  */
 struct MacConfig {
-    std::string mac_source;  ///< Source MAC address in XX:XX:XX:XX:XX:XX format
+    MacAddress mac_source;  ///< Source MAC address in XX:XX:XX:XX:XX:XX format
     Direction direction = Direction::Input;  ///< Traffic direction (INPUT or OUTPUT)
-    std::optional<std::vector<std::string>> subnet;  ///< Source/destination subnet restrictions
+    std::optional<std::vector<Subnet>> subnet;  ///< Source/destination subnet restrictions
     bool allow = true;  ///< Whether to ACCEPT (true) or DROP (false) traffic
     std::optional<InterfaceConfig> interface;  ///< Network interface configuration
     std::optional<std::string> chain;  ///< Direct chain target (mutually exclusive with allow)
@@ -254,6 +244,36 @@ struct ChainConfig {
     std::string getErrorMessage() const;
 };
 
+/**
+ * @struct TemplateVariable
+ * @brief A variable of a section template
+ *
+ * Scalars hold their value as the only element of values. Under for_each
+ * a scalar names a list variable of vars instead.
+ */
+struct TemplateVariable {
+    std::string name;  ///< Name used as ${name}
+    std::vector<std::string> values;  ///< Value, or values of a list
+    bool list = false;  ///< Whether the YAML value was a sequence
+};
+
+/**
+ * @struct TemplateConfig
+ * @brief Variables and for_each lists that make a section a template
+ *
+ * A template section stands for one instance per combination of its
+ * for_each values, the first for_each variable varying slowest, like
+ * nested loops in the order written. Every instance is the section's
+ * rules with ${name} replaced in their string values: interface and
+ * chain names, subnets, port ranges and MAC addresses. A list variable
+ * written as a whole element of a subnet or range list adds all of its
+ * values there.
+ */
+struct TemplateConfig {
+    std::vector<TemplateVariable> vars;  ///< Variables shared by every instance
+    std::vector<TemplateVariable> for_each;  ///< Variables taking each value in turn
+};
+
 /**
  * @struct SectionConfig
  * @brief Configuration for a named section of iptables rules
@@ -264,6 +284,10 @@ struct ChainConfig {
  * 
  * The order of rules within each vector is preserved from the YAML
  * configuration to maintain rule precedence in iptables.
+ * 
+ * A section with vars or for_each is kept as written. Its instances are
+ * built one at a time by instance(), by the compiler and by validation,
+ * so the expanded configuration never exists as a whole.
  */
 struct SectionConfig {
     std::optional<std::vector<PortConfig>> ports;  ///< Port-based rules
@@ -272,10 +296,13 @@ struct SectionConfig {
     std::optional<InterfaceConfig> interface_config;  ///< Interface configuration for chain calls
     std::optional<Action> action;  ///< Action field for general catch-all rules (e.g., dropall section)
     std::optional<ChainConfig> chain_config;  ///< Chain configuration for chain definition sections
+    std::optional<TemplateConfig> template_config;  ///< Variables and for_each lists of a template section
 
     /**
      * @brief Validate the section configuration
      * @return true if all contained rules and configurations are valid
+     *
+     * Template sections are valid if every instance is.
      */
     bool isValid() const;
     
@@ -284,6 +311,35 @@ struct SectionConfig {
      * @return Human-readable error description or empty string if valid
      */
     std::string getErrorMessage() const;
+
+    /**
+     * @brief Get the number of instances the section stands for
+     * @return Product of the for_each list sizes; 1 for plain sections
+     */
+    size_t instanceCount() const;
+
+    /**
+     * @brief Build one instance of a template section
+     * @param index Instance number, below instanceCount()
+     * @return The section with variables replaced and no template_config;
+     *         a plain section is returned unchanged
+     * @throws std::invalid_argument on an undefined variable, a list
+     *         variable used inside a string, or a for_each naming no list
+     */
+    SectionConfig instance(size_t index) const;
+
+    /**
+     * @brief Get the name rules of an instance are compiled under
+     * @param section Name of the section
+     * @param index Instance number
+     * @return "section[value,...]" with the instance's for_each values, or
+     *         section itself when there is no for_each
+     *
+     * Each instance is a section of its own for rule tags and digests, so
+     * adding a value to a for_each list leaves the other instances' rules
+     * untouched.
+     */
+    std::string instanceName(const std::string& section, size_t index) const;
 };
 
 /**
@@ -440,6 +496,80 @@ struct convert<iptables::Action> {
     static bool decode(const Node& node, iptables::Action& action);
 };
 
+/**
+ * @brief YAML conversion for Subnet
+ * 
+ * Parses the scalar into a network address and prefix length. Text that
+ * is not an IPv4 network still decodes, with Subnet::valid set to false.
+ */
+template<>
+struct convert<iptables::Subnet> {
+    /**
+     * @brief Encode Subnet to YAML node
+     * @param subnet Subnet to encode
+     * @return YAML node containing the text as written
+     */
+    static Node encode(const iptables::Subnet& subnet);
+    
+    /**
+     * @brief Decode YAML node to Subnet
+     * @param node YAML node containing the subnet
+     * @param subnet Output subnet
+     * @return true if the node is a scalar
+     */
+    static bool decode(const Node& node, iptables::Subnet& subnet);
+};
+
+/**
+ * @brief YAML conversion for PortRange
+ * 
+ * Parses the scalar into its first and last port. Malformed ranges still
+ * decode, with PortRange::valid set to false, and are reported by
+ * PortConfig::getErrorMessage().
+ */
+template<>
+struct convert<iptables::PortRange> {
+    /**
+     * @brief Encode PortRange to YAML node
+     * @param range Port range to encode
+     * @return YAML node containing the text as written
+     */
+    static Node encode(const iptables::PortRange& range);
+    
+    /**
+     * @brief Decode YAML node to PortRange
+     * @param node YAML node containing the port range
+     * @param range Output port range
+     * @return true if the node is a scalar
+     */
+    static bool decode(const Node& node, iptables::PortRange& range);
+};
+
+/**
+ * @brief YAML conversion for MacAddress
+ * 
+ * Parses the scalar into a 48-bit address. Malformed addresses still
+ * decode, with MacAddress::valid set to false, and are reported by
+ * MacConfig::getErrorMessage().
+ */
+template<>
+struct convert<iptables::MacAddress> {
+    /**
+     * @brief Encode MacAddress to YAML node
+     * @param mac MAC address to encode
+     * @return YAML node containing the text as written
+     */
+    static Node encode(const iptables::MacAddress& mac);
+    
+    /**
+     * @brief Decode YAML node to MacAddress
+     * @param node YAML node containing the MAC address
+     * @param mac Output MAC address
+     * @return true if the node is a scalar
+     */
+    static bool decode(const Node& node, iptables::MacAddress& mac);
+};
+
 /**
  * @brief YAML conversion for InterfaceConfig struct
  * 
@@ -608,7 +738,8 @@ struct convert<iptables::FilterConfig> {
  * @brief YAML conversion for SectionConfig struct
  * 
  * Handles complex section configuration serialization including
- * all rule types and nested configurations.
+ * all rule types and nested configurations. The vars and for_each maps
+ * are decoded into template_config; instances are not built here.
  */
 template<>
 struct convert<iptables::SectionConfig> {
@@ -0,0 +1,108 @@
+/**
+ * @file config_loader.hpp
+ * @brief Loading a configuration together with its conf.d fragments
+ * @author iptables-compose-cpp Development Team
+ * @date 2024
+ *
+ * This file contains the ConfigLoader class. Besides the main file, a
+ * configuration may be split into fragments kept in a directory next to
+ * it, named after the file with a ".d" suffix instead of its extension:
+ * /etc/network/iptables-compose.yaml reads its fragments from
+ * /etc/network/iptables-compose.d/. Several teams can then each own a
+ * fragment without editing one shared file.
+ *
+ * Fragments are parsed concurrently and merged into one Config in a fixed
+ * order. A loader keeps what it parsed, so a daemon re-reads only the
+ * fragments that changed since its last load.
+ */
+
+#pragma once
+
+#include "config.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace iptables {
+
+/**
+ * @class ConfigLoader
+ * @brief Parses the main file and its fragments and merges them
+ *
+ * The main file comes first, followed by the fragments in byte order of
+ * their file names, so "10-base.yaml" precedes "50-web.yaml" and
+ * "99-dropall.yaml". Only regular files ending in ".yaml" or ".yml" and
+ * not starting with a dot are fragments. Each file is parsed and
+ * validated on its own, exactly like a main file, and its sections,
+ * chains and filter MAC rules are appended in that order.
+ *
+ * A section name, a chain definition section or a custom chain name that
+ * appears in two files is a conflict, as is a filter policy set to
+ * different values in two files; both fail the load naming the two files.
+ * Within one file nothing changes: repeated keys behave as they always
+ * have.
+ */
+class ConfigLoader {
+public:
+    /**
+     * @brief Get the fragment directory of a configuration file
+     * @param config_path Main configuration file
+     * @return The file's path with ".d" in place of its extension
+     */
+    static std::filesystem::path fragmentDirectory(const std::filesystem::path& config_path);
+
+    /**
+     * @brief List the files a configuration is read from
+     * @param config_path Main configuration file
+     * @return The main file followed by its fragments, in merge order
+     */
+    static std::vector<std::filesystem::path> files(const std::filesystem::path& config_path);
+
+    /**
+     * @brief Parse, validate and merge a configuration
+     * @param config_path Main configuration file
+     * @return Merged configuration
+     * @throws std::runtime_error if a file does not parse or validate, naming
+     *         the fragment, or if two files conflict
+     *
+     * With keepParsed(), files whose size, modification time and inode
+     * match the previous load are not read again.
+     */
+    Config load(const std::filesystem::path& config_path);
+
+    /**
+     * @brief Keep parsed files for the next load()
+     * @param keep true for a long-running process that loads repeatedly
+     *
+     * A single load() does not need them, and moves them into the result
+     * instead of copying.
+     */
+    void keepParsed(bool keep) { keep_parsed_ = keep; }
+
+    /**
+     * @brief Number of fragments merged by the last load(), not counting the main file
+     */
+    size_t fragmentCount() const { return fragments_; }
+
+    /**
+     * @brief Number of files the last load() had to parse
+     */
+    size_t parsedCount() const { return parsed_; }
+
+private:
+    struct Entry {
+        int64_t modified = 0;            ///< Modification time in nanoseconds
+        uintmax_t size = 0;              ///< File size in bytes
+        uint64_t inode = 0;              ///< Inode, which changes when a file is replaced by rename()
+        std::shared_ptr<Config> config;  ///< Parsed and validated contents
+    };
+
+    std::map<std::filesystem::path, Entry> cache_;  ///< Files of the last load, by path
+    bool keep_parsed_ = false;
+    size_t fragments_ = 0;
+    size_t parsed_ = 0;
+};
+
+} // namespace iptables
@@ -24,7 +24,8 @@ namespace iptables {
  * The ConfigParser class provides static methods for loading YAML configuration
  * files and strings into Config objects, and saving Config objects back to YAML.
  * It handles all YAML parsing, validation, and serialization operations using
- * the yaml-cpp library with custom template specializations.
+ * the yaml-cpp library. Loading decodes yaml-cpp's parser events directly
+ * through ConfigReader; saving uses the custom template specializations.
  */
 class ConfigParser {
 public:
@@ -36,8 +37,9 @@ public:
      * @throws YAML::Exception if YAML parsing fails
      * @throws std::filesystem::filesystem_error if file access fails
      * 
-     * Loads a YAML configuration file from disk, parses it using yaml-cpp,
-     * validates the structure and content, and returns a Config object.
+     * Loads a YAML configuration file from disk, decodes it in one pass
+     * over yaml-cpp's parser events, validates the structure and content,
+     * and returns a Config object.
      * The file must exist and be readable by the current user.
      */
     static Config loadFromFile(const std::string& filename);
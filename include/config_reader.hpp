@@ -0,0 +1,56 @@
+/**
+ * @file config_reader.hpp
+ * @brief Streaming YAML reader building Config from parser events
+ * @author iptables-compose-cpp Development Team
+ * @date 2024
+ *
+ * This file contains the ConfigReader class used by ConfigParser. Loading
+ * a document with YAML::Load builds a node for every scalar, sequence and
+ * map before the YAML::convert specializations copy it into Config, so
+ * large generated configurations pay for the file twice in time and
+ * memory. ConfigReader instead receives yaml-cpp's parser events and
+ * decodes them into Config as they arrive, keeping only the open maps and
+ * sequences and, for aliases, the anchored nodes.
+ */
+
+#pragma once
+
+#include "config.hpp"
+#include <istream>
+#include <string>
+
+namespace iptables {
+
+/**
+ * @class ConfigReader
+ * @brief Decodes a YAML document into Config in one pass
+ *
+ * The result is the one YAML::convert<Config>::decode gives for the same
+ * document, and so are the errors: keys are looked up with the same rules
+ * (the first of repeated keys wins, unknown keys are ignored), scalars are
+ * converted with the same functions, and when a document has several
+ * faults the one reported is the one the node-based decoder runs into
+ * first. Syntax errors take precedence over conversion errors, as they
+ * did when the whole document was parsed before converting.
+ */
+class ConfigReader {
+public:
+    /**
+     * @brief Decode the first document of a stream
+     * @param input YAML text
+     * @return Decoded configuration, not yet validated
+     * @throws YAML::Exception on syntax and conversion errors
+     */
+    static Config read(std::istream& input);
+
+    /**
+     * @brief Decode the first document of a file
+     * @param filename Path to the YAML file
+     * @return Decoded configuration, not yet validated
+     * @throws YAML::BadFile if the file cannot be opened
+     * @throws YAML::Exception on syntax and conversion errors
+     */
+    static Config readFile(const std::string& filename);
+};
+
+} // namespace iptables
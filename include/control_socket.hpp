@@ -0,0 +1,141 @@
+/**
+ * @file control_socket.hpp
+ * @brief Unix domain socket control API of the daemon
+ * @author iptables-compose-cpp Development Team
+ * @date 2024
+ *
+ * This file contains the ControlServer and ControlClient classes. A daemon
+ * started with --daemon listens on a Unix domain socket, so orchestration
+ * can apply configuration, change single sections and query state without
+ * starting a process for every call. Each connection carries one request
+ * and one response. Both are frames: a 4-byte big-endian length followed
+ * by that many bytes. A request frame holds a line with the command and
+ * its arguments, separated by spaces, followed by an optional body; a
+ * response frame holds "ok" or "error" on the first line followed by the
+ * response text.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace iptables {
+
+/**
+ * @struct ControlRequest
+ * @brief One request received on the control socket
+ */
+struct ControlRequest {
+    std::string command;                 ///< First word of the request line, e.g. "status"
+    std::vector<std::string> arguments;  ///< Remaining words of the request line
+    std::string body;                    ///< Everything after the request line, e.g. YAML
+};
+
+/**
+ * @struct ControlResponse
+ * @brief Answer to a ControlRequest
+ */
+struct ControlResponse {
+    bool success = true;  ///< Sent as "ok" or "error"
+    std::string body;     ///< Response text
+};
+
+/**
+ * @class ControlServer
+ * @brief Listening end of the control socket
+ *
+ * The server never blocks the caller's event loop: descriptor() becomes
+ * readable when clients connect, and serve() then answers every pending
+ * connection in turn. Requests are therefore handled one at a time, in
+ * the order they arrive, by the thread that runs the loop. The socket is
+ * only accessible to root.
+ */
+class ControlServer {
+public:
+    /// Socket used unless --socket chooses another
+    static constexpr const char* kDefaultPath = "/run/iptables-compose.sock";
+
+    /// Largest frame accepted in either direction
+    static constexpr uint32_t kMaxFrame = 16u << 20;
+
+    /// Time a client has to send its whole request, and to take the whole response
+    static constexpr std::chrono::milliseconds kClientTimeout{1000};
+
+    /// Handles one request
+    using Handler = std::function<ControlResponse(const ControlRequest&)>;
+
+    /**
+     * @brief Prepare a server
+     * @param path Socket path; nothing is created before listen()
+     */
+    explicit ControlServer(std::filesystem::path path);
+
+    /**
+     * @brief Close the socket and remove its path
+     */
+    ~ControlServer();
+
+    ControlServer(const ControlServer&) = delete;
+    ControlServer& operator=(const ControlServer&) = delete;
+
+    /**
+     * @brief Create the socket and start listening
+     * @return true if listening; false if the path is in use by a running
+     *         server or cannot be created
+     *
+     * A stale socket left behind by a server that died is replaced.
+     */
+    bool listen();
+
+    /**
+     * @brief Descriptor that becomes readable when clients connect
+     */
+    int descriptor() const { return socket_; }
+
+    /**
+     * @brief Answer every connection waiting to be accepted
+     * @param handler Called once per request
+     * @return Number of requests answered
+     *
+     * A client that does not send its complete request within
+     * kClientTimeout, or does not read the complete response within
+     * kClientTimeout, is dropped. A request frame larger than kMaxFrame
+     * is dropped unanswered.
+     */
+    size_t serve(const Handler& handler);
+
+private:
+    std::filesystem::path path_;
+    int socket_ = -1;
+};
+
+/**
+ * @class ControlClient
+ * @brief Sends requests to a running daemon
+ */
+class ControlClient {
+public:
+    /**
+     * @brief Send one request and wait for its response
+     * @param path Socket path
+     * @param request Request to send
+     * @return Response, or std::nullopt if the daemon cannot be reached;
+     *         the reason is written to stderr
+     */
+    static std::optional<ControlResponse> send(const std::filesystem::path& path, const ControlRequest& request);
+
+    /**
+     * @brief Split a request line such as "remove-section web"
+     * @param line Command followed by its arguments
+     * @param body Request body
+     */
+    static ControlRequest parse(const std::string& line, std::string body = {});
+};
+
+} // namespace iptables
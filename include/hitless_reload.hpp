@@ -0,0 +1,103 @@
+/**
+ * @file hitless_reload.hpp
+ * @brief Make-before-break reloads through generation chains
+ * @author iptables-compose-cpp Development Team
+ * @date 2024
+ *
+ * This file contains the HitlessReload class. A reload builds the complete
+ * new ruleset in chains nothing jumps to yet, switches each table over to
+ * them in one iptables-restore transaction, and only then removes the
+ * chains of the previous generation. Packets see either the old or the new
+ * ruleset of a table, never an empty or half-written one, so established
+ * connections survive a reload on a busy host.
+ */
+
+#pragma once
+
+#include "ruleset_compiler.hpp"
+#include "ruleset_snapshot.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace iptables {
+
+/**
+ * @struct TableReload
+ * @brief iptables-restore --noflush payloads reloading one table
+ */
+struct TableReload {
+    std::string table;    ///< Table name
+    std::string build;    ///< Creates and fills the new generation's chains
+    std::string swap;     ///< Points the built-in chains at the new chains and sets policies
+    std::string retire;   ///< Flushes and deletes the chains the new generation replaces
+    std::string abandon;  ///< Flushes and deletes the new chains if the swap never happens
+};
+
+/**
+ * @struct ReloadPlan
+ * @brief Everything a reload writes, in the order it is written
+ */
+struct ReloadPlan {
+    std::string generation;           ///< Generation being built, "a" or "b"
+    std::vector<TableReload> tables;  ///< Per-table payloads in iptables-save order
+    size_t chains_built = 0;          ///< Chains of the new generation
+    size_t rules_built = 0;           ///< Rules in those chains
+    size_t jumps = 0;                 ///< Rules written to built-in chains by the swap
+    size_t rules_deleted = 0;         ///< Managed rules the swap removes from built-in chains
+    size_t policies = 0;              ///< Policies the swap changes
+    size_t chains_retired = 0;        ///< Chains removed after the swap
+};
+
+/**
+ * @class HitlessReload
+ * @brief Plans and applies make-before-break reloads
+ *
+ * The ruleset is compiled with RulesetCompiler::useSectionChains() and a
+ * generation, so two complete rulesets can coexist. Each table then goes
+ * through three iptables-restore --noflush transactions:
+ * - build: the new chains are created and filled while unreferenced;
+ * - swap: managed rules in the built-in chains are replaced in place
+ *   (-R) by jumps to the new chains, surplus ones deleted and missing
+ *   ones inserted, together with the policy changes;
+ * - retire: chains of the previous generation, of the plain section chain
+ *   layout and the configuration's old custom chains are flushed and
+ *   deleted.
+ *
+ * Foreign rules and chains are never touched. All methods are static,
+ * following RestoreBackend.
+ */
+class HitlessReload {
+public:
+    /**
+     * @brief Pick the generation that is not serving traffic
+     * @param live Snapshot of the live ruleset
+     * @return "b" if built-in chains jump to generation "a" chains, otherwise "a"
+     */
+    static std::string nextGeneration(const RulesetSnapshot& live);
+
+    /**
+     * @brief Render the payloads of a reload
+     * @param ruleset Ruleset compiled with useSectionChains() and the generation to build
+     * @param live Snapshot of the live ruleset
+     * @return Payloads and counts; generation is left empty
+     *
+     * The configuration's custom chains, which the generation renames,
+     * are taken from the section chains without a parent.
+     */
+    static ReloadPlan plan(const CompiledRuleset& ruleset, const RulesetSnapshot& live);
+
+    /**
+     * @brief Build, swap and retire table by table
+     * @param plan Plan from plan()
+     * @return true if every table switched to the new generation
+     *
+     * If a build or swap fails, the chains built for tables that were not
+     * switched are removed again and those tables keep serving the old
+     * ruleset. A failed retire only leaves unreferenced chains behind and
+     * is reported as a warning.
+     */
+    static bool apply(const ReloadPlan& plan);
+};
+
+} // namespace iptables
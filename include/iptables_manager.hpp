@@ -12,16 +12,29 @@
 
 #pragma once
 
-#include "rule_manager.hpp"
 #include "chain_manager.hpp"
 #include "command_executor.hpp"
 #include "config.hpp"
+#include "config_loader.hpp"
+#include "ruleset_compiler.hpp"
+#include "restore_session.hpp"
+#include "ruleset_snapshot.hpp"
+#include "reconciler.hpp"
+#include "xtables_lock.hpp"
+#include "state_journal.hpp"
+#include "control_socket.hpp"
+#include <map>
+#include <memory>
+#include <optional>
 #include <string>
+#include <ostream>
 #include <filesystem>
 #include <yaml-cpp/yaml.h>
 
 namespace iptables {
 
+class ChangeMonitor;
+
 /**
  * @class IptablesManager
  * @brief Main orchestration class for comprehensive iptables management
@@ -40,12 +53,23 @@ namespace iptables {
  * - Providing cleanup and reset functionality
  * - Orchestrating rule removal and firewall restoration
  * 
- * The class integrates with RuleManager for individual rule operations,
- * ChainManager for custom chain handling, and CommandExecutor for
+ * The class compiles configurations with RulesetCompiler and integrates
+ * with ChainManager for custom chain handling and CommandExecutor for
  * low-level iptables command execution.
  */
 class IptablesManager {
 public:
+    /**
+     * @enum Backend
+     * @brief Mechanism used to push rules into the kernel
+     */
+    enum class Backend {
+        Iptables,  ///< One iptables invocation per rule, policy and chain
+        Restore,   ///< Whole configuration committed by a single iptables-restore
+        Libiptc,   ///< Tables modified in memory through libiptc, one commit per table
+        Stream     ///< Per-rule replacement streamed to one long-lived iptables-restore --noflush
+    };
+
     /**
      * @brief Construct a new IptablesManager instance
      * 
@@ -59,10 +83,47 @@ public:
      * @brief Destructor
      * 
      * Cleans up resources. Does not automatically remove iptables
-     * rules - use removeAllRules() explicitly if needed.
+     * rules - use removeYamlRules() explicitly if needed.
      */
     ~IptablesManager() = default;
 
+    /**
+     * @brief Select the apply backend
+     * @param backend Backend used by loadConfig() and resetRules()
+     * 
+     * With a transactional backend (Restore or Libiptc), resetRules() only
+     * marks the reset as pending and the following loadConfig() drops the
+     * existing rules in the same transaction that installs the new ones.
+     */
+    void setBackend(Backend backend) { backend_ = backend; }
+
+    /**
+     * @brief Get the selected apply backend
+     * @return Current backend
+     */
+    Backend getBackend() const { return backend_; }
+
+    /**
+     * @brief Check whether the selected backend commits whole tables at once
+     * @return true for Backend::Restore and Backend::Libiptc
+     */
+    bool isTransactional() const { return backend_ == Backend::Restore || backend_ == Backend::Libiptc; }
+
+    /**
+     * @brief Compile each section into chains of its own
+     * @param enabled Use RulesetCompiler::useSectionChains() for loadConfig(), planConfig() and emitRestore()
+     *
+     * Switching the layout on or off between applies is safe: the next
+     * apply moves the rules and removes what the other layout left behind.
+     */
+    void setSectionChains(bool enabled) { section_chains_ = enabled; }
+    
+    /**
+     * @brief Choose where runDaemon() listens for control requests
+     * @param path Unix domain socket path
+     */
+    void setControlSocket(const std::filesystem::path& path) { control_socket_ = path; }
+
     // Configuration management
     
     /**
@@ -75,10 +136,107 @@ public:
      * Loads, parses, and validates a complete iptables configuration from
      * a YAML file. This includes all sections, rules, chains, and policies.
      * The configuration is validated for consistency and correctness before
-     * being accepted. Does not apply rules - use applyRules() separately.
+     * it is compiled and applied.
      */
     bool loadConfig(const std::filesystem::path& config_path);
     
+    /**
+     * @brief Boot from the cached restore payload of a configuration
+     * @param config_path Path to the YAML configuration file
+     * @return true if the configuration is in place, from the cache or compiled
+     * 
+     * If RulesetCache holds a payload for this configuration file, tool
+     * version and layout, and the tables it replaces hold no rules yet, it
+     * is restored in one iptables-restore without parsing the file.
+     * Otherwise the configuration is loaded as by loadConfig() and its
+     * payload is cached for the next boot.
+     */
+    bool loadFromCache(const std::filesystem::path& config_path);
+    
+    /**
+     * @brief Compile a configuration into an iptables-restore payload
+     * @param config_path Path to the YAML configuration file
+     * @param destination Output file path, or "-" for standard output
+     * @return true if the payload was compiled and written
+     * 
+     * Does not read or modify the kernel ruleset and therefore needs no
+     * privileges. The payload describes complete tables: every table it
+     * contains is replaced when it is fed to iptables-restore. All
+     * diagnostics are written to stderr.
+     */
+    bool emitRestore(const std::filesystem::path& config_path, const std::string& destination);
+    
+    /**
+     * @brief Print the changes loadConfig() would make without making them
+     * @param config_path Path to the YAML configuration file
+     * @return true if the configuration compiled and the live ruleset could be read
+     * 
+     * Reads the live ruleset once and prints the reconcile plan, one
+     * operation per line followed by a summary, to stdout. Diagnostics go
+     * to stderr. Nothing is written to the kernel.
+     */
+    bool planConfig(const std::filesystem::path& config_path);
+    
+    /**
+     * @brief Replace the applied configuration without a gap in filtering
+     * @param config_path Path to the YAML configuration file
+     * @return true if every table switched to the new configuration
+     * 
+     * Builds the new ruleset in a fresh generation of chains, switches
+     * each table to it in one iptables-restore transaction and removes the
+     * previous generation afterwards; see HitlessReload. Works the same
+     * whatever ruleset layout or backend the previous apply used.
+     */
+    bool reloadConfig(const std::filesystem::path& config_path);
+    
+    /**
+     * @brief Check whether the managed rules in the kernel match a configuration
+     * @param config_path Path to the YAML configuration file
+     * @param record Journal a listing that shows no drift, so the next run need not list again
+     * @return true if they match, false on drift, std::nullopt if the
+     *         configuration or the live ruleset could not be read
+     * 
+     * Compares the managed rules of every chain, the configuration's own
+     * chains and the filter policies with one listing of the live ruleset,
+     * or none while the state journal still matches the kernel, and prints
+     * each chain that drifted. Foreign rules elsewhere are not drift.
+     * Nothing is written to the kernel, and the state journal only if
+     * record is set.
+     */
+    std::optional<bool> checkConfig(const std::filesystem::path& config_path, bool record);
+    
+    /**
+     * @brief Keep the kernel in line with a configuration until cancelled
+     * @param config_path Path to the YAML configuration file
+     * @return true if watching ended by cancellation, false if the
+     *         configuration could not be loaded
+     * 
+     * Repairs drift once, then waits on a ChangeMonitor and repairs again
+     * after every burst of changes to the tables. A repair only writes the
+     * chains that drifted, as a reconcile plan does. Failed repairs are
+     * reported and retried at the next change.
+     */
+    bool watchConfig(const std::filesystem::path& config_path);
+    
+    /**
+     * @brief Keep a configuration applied, following edits and repairing drift
+     * @param config_path Path to the YAML configuration file
+     * @return true if the daemon ended by cancellation, false if the
+     *         configuration could not be loaded at start
+     * 
+     * Applies the configuration, then keeps the compiled ruleset and the
+     * last recorded live ruleset in memory and waits on a ChangeMonitor
+     * watching both the tables and the configuration file. After a burst
+     * of edits the file is only parsed again if its contents changed, and
+     * the new ruleset is applied incrementally; a file that no longer
+     * parses leaves the previous ruleset in force. Changes to the tables
+     * are repaired as by watchConfig().
+     * 
+     * Control requests on the socket set with setControlSocket() are
+     * answered between passes, one at a time; see handleRequest().
+     */
+    bool runDaemon(const std::filesystem::path& config_path);
+    
     /**
      * @brief Reset all iptables rules to default state
      * @return true if reset was successful
@@ -97,191 +255,254 @@ public:
      * Selectively removes only the rules and chains that were created
      * from the loaded YAML configuration, leaving other iptables rules
      * intact. This is useful for updating configurations without
-     * affecting unrelated firewall rules.
+     * affecting unrelated firewall rules. Every table is torn down by a
+     * single iptables-restore transaction built from one listing of the
+     * ruleset, see Reconciler::teardown().
      */
     bool removeYamlRules();
 
-    // Rule management
+private:
+    CommandExecutor command_executor_;  ///< Executes low-level iptables commands
+    ChainManager chain_manager_;    ///< Manages custom chain operations
+    
+    Backend backend_ = Backend::Iptables;  ///< Selected apply backend
+    bool pending_reset_ = false;           ///< Reset requested for the next restore transaction
+    bool section_chains_ = false;          ///< Compile each section into its own chains
+    
+    std::optional<RulesetSnapshot> snapshot_;  ///< Live ruleset, read once and updated as operations apply
+    bool snapshot_recalled_ = false;           ///< snapshot_ came from the state journal and has no counters
+    bool snapshot_resident_ = false;           ///< snapshot_ was recalled from resident_ rather than the state file
+    JournalIndex journal_index_;               ///< Tags and section digests of the compiled configuration
+    std::unique_ptr<RestoreSession> session_;  ///< Open restore session while applying in stream mode
     
     /**
-     * @brief Apply all rules from the loaded configuration
-     * @return true if all rules were applied successfully
-     * @throws std::runtime_error if no configuration is loaded
-     * 
-     * Processes the loaded configuration and applies all rules, chains,
-     * and policies to iptables in the correct order. This includes:
-     * - Creating custom chains with proper dependencies
-     * - Processing filter policies for built-in chains
-     * - Applying port, MAC, and interface rules
-     * - Setting up chain cross-references and jumps
-     * 
-     * If any rule fails to apply, the process stops and returns false.
+     * @struct ResidentState
+     * @brief The journaled ruleset, kept in memory between the applies of a daemon
      */
-    bool applyRules();
+    struct ResidentState {
+        RulesetSnapshot snapshot;                  ///< Ruleset as recorded
+        uint64_t fingerprint = 0;                  ///< StateJournal::fingerprint() when it was recorded
+        std::map<std::string, uint64_t> sections;  ///< Section digests recorded with it, see JournalIndex
+    };
+    std::filesystem::path control_socket_ = ControlServer::kDefaultPath;  ///< Where runDaemon() listens
+    bool keep_resident_ = false;             ///< Keep resident_ after recording, see runDaemon()
+    ConfigLoader config_loader_;             ///< Reads the configuration and its fragments
+    std::optional<ResidentState> resident_;  ///< Used instead of StateJournal::recall() while the fingerprint matches
     
     /**
-     * @brief Remove all iptables rules and chains
-     * @return true if removal was successful
-     * 
-     * Removes all rules from all chains, deletes all custom chains,
-     * and resets built-in chain policies to ACCEPT. This is a complete
-     * firewall cleanup that removes both YAML-managed and external rules.
+     * @brief Read the live ruleset into snapshot_ and share it with the chain manager
+     * @param use_journal Take the ruleset from the state journal if the kernel still matches it
+     * @return true if the ruleset was recalled or iptables-save succeeded
      */
-    bool removeAllRules();
-
-    // Policy management
+    bool captureSnapshot(bool use_journal = false);
     
     /**
-     * @brief Set default policy for a built-in chain
-     * @param direction Chain direction (INPUT or OUTPUT)
-     * @param action Policy action (ACCEPT, DROP, or REJECT)
-     * @return true if policy was set successfully
-     * @throws std::invalid_argument if direction or action is invalid
-     * 
-     * Sets the default policy for INPUT or OUTPUT chains in the filter
-     * table. The policy determines what happens to packets that don't
-     * match any rules in the chain. FORWARD chain policies should be
-     * managed through the configuration file.
+     * @brief Record the ruleset a successful run left behind in the state journal
+     * @param mirrored snapshot_ reflects every change the run made; otherwise the ruleset is read again
      */
-    bool setPolicy(Direction direction, Action action);
+    void recordState(bool mirrored);
     
     /**
-     * @brief Reset all built-in chain policies to ACCEPT
-     * @return true if policies were reset successfully
-     * 
-     * Sets the default policy for INPUT, OUTPUT, and FORWARD chains
-     * to ACCEPT, providing a permissive default state. This is typically
-     * done before rule removal to prevent lockouts.
+     * @brief Discard snapshot_ after changes that were not mirrored into it
      */
-    bool resetPolicies();
-
-private:
-    RuleManager rule_manager_;      ///< Manages individual iptables rules
-    CommandExecutor command_executor_;  ///< Executes low-level iptables commands
-    ChainManager chain_manager_;    ///< Manages custom chain operations
+    void dropSnapshot();
+    
+    /**
+     * @brief Apply a plan operation the kernel accepted to snapshot_
+     * @param op Operation that ran successfully
+     */
+    void mirrorOperation(const PlanOperation& op);
+    
+    /**
+     * @brief Sync the restore session and report failed batches
+     * @param out Stream for progress messages
+     * @param err Stream for failed batches
+     * @return true if every batch was committed
+     */
+    bool finishStream(std::ostream& out, std::ostream& err);
     
-    // Section name to actual chain name mapping for resolving references
-    std::map<std::string, std::string> section_to_chain_map_;
+    /**
+     * @brief Print the xtables lock wait and work time of the last operation
+     * @param before Lock statistics read before the operation started
+     * @param out Stream receiving the statistics
+     *
+     * The process-wide totals keep growing for the run's metrics; only the
+     * difference is printed.
+     */
+    void reportLockStatistics(const LockStatistics& before, std::ostream& out) const;
+    
+    /**
+     * @brief Print rule order validation warnings for a configuration
+     * @param config Parsed configuration
+     * @param out Stream receiving the report
+     */
+    void reportValidationWarnings(const Config& config, std::ostream& out);
+    
+    /**
+     * @brief Validate chain references and compile a configuration
+     * @param config Parsed configuration
+     * @param ruleset Receives the compiled rules
+     * @param err Stream for errors
+     * @param generation Compile into generation chains of this name, see RulesetCompiler::useSectionChains()
+     * @return true if the configuration compiled
+     */
+    bool compileConfig(const Config& config, CompiledRuleset& ruleset, std::ostream& err,
+                       const std::string& generation = "");
+
+    /**
+     * @brief Parse a configuration file and its fragments, timed as the "load" phase
+     * @param config_path YAML configuration file
+     * @param out Stream for the fragment summary
+     * @throws std::runtime_error if a file cannot be parsed or two files conflict
+     */
+    Config loadConfigFile(const std::filesystem::path& config_path, std::ostream& out);
+
+    /**
+     * @brief Diff a compiled configuration against snapshot_, timed as the "plan" phase
+     * @param ruleset Compiled configuration
+     * @param out Stream for the summary of changed sections
+     *
+     * When snapshot_ was recalled from the state journal, sections whose
+     * digest matches the journal are settled and compared by tag only.
+     */
+    ReconcilePlan planChanges(const CompiledRuleset& ruleset, std::ostream& out) const;
 
-    // Configuration processing
+    /**
+     * @brief Add the changes of an applied plan to the run metrics
+     * @param plan Plan that was applied
+     */
+    static void recordPlanOperations(const ReconcilePlan& plan);
+
+    /**
+     * @brief Apply a compiled configuration with the selected backend
+     * @param ruleset Compiled configuration
+     * @param out Stream for progress messages
+     * @param err Stream for failures
+     * @return true if the kernel now holds the configuration
+     */
+    bool applyRuleset(const CompiledRuleset& ruleset, std::ostream& out, std::ostream& err);
     
     /**
-     * @brief Process filter configuration section
-     * @param filter Filter configuration containing policies and MAC rules
-     * @return true if filter configuration was processed successfully
-     * 
-     * Processes the filter section of the configuration, setting default
-     * policies for built-in chains and applying global MAC filtering rules.
+     * @brief Apply a compiled configuration with the selected transactional backend
+     * @param ruleset Compiled configuration
+     * @param out Stream for progress messages
+     * @param err Stream for failures
+     * @return true if the backend committed every table, or nothing needed to change
      */
-    bool processFilterConfig(const FilterConfig& filter);
+    bool applyTransactional(const CompiledRuleset& ruleset, std::ostream& out, std::ostream& err);
     
     /**
-     * @brief Process a single port configuration rule
-     * @param port Port configuration to process
-     * @param section_name Name of the section containing this rule
-     * @return true if port rule was processed successfully
+     * @brief Execute a reconcile plan with one iptables call per operation
+     * @param plan Operations to run
+     * @param out Stream for progress messages
+     * @param err Stream for failed operations
+     * @return true if every operation succeeded
      * 
-     * Converts a PortConfig into appropriate iptables rules, handling
-     * single ports, port ranges, forwarding, and multiport configurations.
+     * After a failed operation the remaining operations of the same chain
+     * are skipped, since their positions assume it succeeded.
      */
-    bool processPortConfig(const PortConfig& port, const std::string& section_name);
+    bool executePlan(const ReconcilePlan& plan, std::ostream& out, std::ostream& err);
     
     /**
-     * @brief Process a single MAC configuration rule
-     * @param mac MAC configuration to process
-     * @param section_name Name of the section containing this rule
-     * @return true if MAC rule was processed successfully
-     * 
-     * Converts a MacConfig into appropriate iptables rules for MAC
-     * address filtering with support for interfaces and subnets.
+     * @brief Execute a reconcile plan through a restore session, one batch per chain
+     * @param plan Operations to run
+     * @param out Stream for progress messages
+     * @param err Stream for failed batches
+     * @return true if every batch was committed
      */
-    bool processMacConfig(const MacConfig& mac, const std::string& section_name);
+    bool streamPlan(const ReconcilePlan& plan, std::ostream& out, std::ostream& err);
     
     /**
-     * @brief Process a single interface configuration rule
-     * @param interface Interface configuration to process
-     * @param section_name Name of the section containing this rule
-     * @return true if interface rule was processed successfully
+     * @brief Bring the managed rules back in line if they drifted
+     * @param ruleset Compiled configuration
+     * @return true if nothing drifted or every repair succeeded
      * 
-     * Converts an InterfaceRuleConfig into appropriate iptables rules
-     * for interface-based traffic control.
+     * Silent when nothing drifted; otherwise prints the drifted chains and
+     * applies the plan through a restore session unless the backend is
+     * plain iptables.
      */
-    bool processInterfaceConfig(const InterfaceRuleConfig& interface, const std::string& section_name);
+    bool repairDrift(const CompiledRuleset& ruleset);
     
     /**
-     * @brief Process an action configuration (catch-all rules)
-     * @param action Action to apply for unmatched traffic
-     * @param section_name Name of the section containing this action
-     * @return true if action rule was processed successfully
-     * 
-     * Creates catch-all rules that apply the specified action to traffic
-     * that doesn't match more specific rules in the section.
+     * @brief Parse and compile a configuration file
+     * @param config_path Path to the YAML configuration file
+     * @param ruleset Receives the compiled configuration
+     * @param out Stream for progress and rule order warnings
+     * @return true if the file parsed and compiled; errors go to stderr
      */
-    bool processActionConfig(const Action& action, const std::string& section_name);
+    bool compileFile(const std::filesystem::path& config_path, CompiledRuleset& ruleset, std::ostream& out);
     
     /**
-     * @brief Process interface configuration for chain calls
-     * @param interface Interface configuration specifying chain targets
-     * @param section_name Name of the section containing this configuration
-     * @return true if interface chain call was processed successfully
-     * 
-     * Creates rules that jump to custom chains based on interface
-     * specifications, enabling modular firewall organization.
+     * @brief Print a reconcile plan one operation per line, followed by a summary
+     * @param plan Plan to print
+     * @param out Stream for the plan
      */
-    bool processInterfaceChainCall(const InterfaceConfig& interface, const std::string& section_name);
+    static void printPlan(const ReconcilePlan& plan, std::ostream& out);
     
-    // Chain configuration processing methods
+    /**
+     * @struct DaemonState
+     * @brief What runDaemon() keeps in memory between passes
+     */
+    struct DaemonState {
+        std::filesystem::path config_path;  ///< Configuration file followed
+        std::optional<uint64_t> contents;   ///< RulesetCache::key() of the file last parsed
+        Config config;                      ///< Configuration in force, including control requests
+        CompiledRuleset ruleset;            ///< config, compiled
+        ChangeMonitor* monitor = nullptr;   ///< Monitor of the running daemon
+        size_t applies = 0;                 ///< Applies so far
+        bool last_apply_ok = false;         ///< Whether the last apply succeeded
+    };
     
     /**
-     * @brief Create a custom iptables chain
-     * @param chain_name Name of the chain to create
-     * @return true if chain was created successfully
-     * 
-     * Creates a new custom chain in the filter table. Checks for
-     * existing chains to avoid conflicts and validates chain names.
+     * @brief Parse the configuration file into the daemon's state
+     * @param state Daemon state; unchanged if the file does not parse or compile
+     * @param out Stream for progress and rule order warnings
+     * @param err Stream for errors
+     * @return true if the file was parsed and compiled
      */
-    bool createChain(const std::string& chain_name);
+    bool reloadDaemonConfig(DaemonState& state, std::ostream& out, std::ostream& err);
     
     /**
-     * @brief Process a complete chain configuration
-     * @param chain_name Name of the chain being configured
-     * @param chain_config Configuration containing multiple chain rules
-     * @return true if chain configuration was processed successfully
-     * 
-     * Processes a ChainConfig containing multiple chain definitions,
-     * creating chains and applying their associated rule sets.
+     * @brief Compile and apply an edited configuration in the daemon
+     * @param state Daemon state; unchanged if the configuration does not compile
+     * @param config Edited configuration
+     * @param out Stream for progress messages
+     * @param err Stream for errors
+     * @return true if it compiled and applied
      */
-    bool processChainConfig(const std::string& chain_name, const ChainConfig& chain_config);
+    bool applyDaemonConfig(DaemonState& state, Config config, std::ostream& out, std::ostream& err);
     
     /**
-     * @brief Process a single chain rule configuration
-     * @param chain_name Name of the target chain
-     * @param chain_rule Configuration for a single chain
-     * @return true if chain rule was processed successfully
+     * @brief Answer one control request
+     * @param request Request from ControlServer
+     * @param state Daemon state
+     * @return Response carrying what the request printed
      * 
-     * Processes a ChainRuleConfig, creating the chain and applying
-     * its default action and associated rule groups.
+     * Commands: "status", "plan", "query [SECTION...]", "apply-config",
+     * "apply-section" with sections in YAML as the body, and
+     * "remove-section SECTION...". Sections changed over the socket stay in
+     * force until the configuration file changes or apply-config reads it
+     * again. New sections are appended after the existing ones. The
+     * request's output is written to a stream of its own, so messages other
+     * threads or diagnostics print meanwhile stay out of the response.
      */
-    bool processChainRuleConfig(const std::string& chain_name, const ChainRuleConfig& chain_rule);
+    ControlResponse handleRequest(const ControlRequest& request, DaemonState& state);
     
     /**
-     * @brief Process rules within a custom chain
-     * @param chain_name Name of the chain containing the rules
-     * @param rules Map of section names to rule configurations
-     * @return true if all chain rules were processed successfully
-     * 
-     * Processes all rule sections within a custom chain, maintaining
-     * proper rule ordering and section organization.
+     * @brief Print one line per chain a plan would change
+     * @param plan Plan computed against the live ruleset
+     * @param out Stream for the report
+     * @return Number of chains listed
      */
-    bool processChainRules(const std::string& chain_name, const std::vector<std::pair<std::string, SectionConfig>>& rules);
-
+    static size_t reportDrift(const ReconcilePlan& plan, std::ostream& out);
+    
     // Configuration parsing (legacy methods)
     
     /**
      * @brief Parse filter configuration from YAML node (legacy)
      * @param node YAML node containing filter configuration
      * @return true if parsing was successful
-     * @deprecated Use processFilterConfig with Config structures instead
+     * @deprecated Use ConfigParser and RulesetCompiler instead
      * 
      * Legacy method for parsing filter configuration directly from
      * YAML nodes. Maintained for backwards compatibility.
@@ -293,7 +514,7 @@ private:
      * @param node YAML node containing port configuration
      * @param section_name Name of the containing section
      * @return true if parsing was successful
-     * @deprecated Use processPortConfig with PortConfig structures instead
+     * @deprecated Use ConfigParser and RulesetCompiler instead
      * 
      * Legacy method for parsing port configuration directly from
      * YAML nodes. Maintained for backwards compatibility.
@@ -305,7 +526,7 @@ private:
      * @param node YAML node containing MAC configuration
      * @param section_name Name of the containing section
      * @return true if parsing was successful
-     * @deprecated Use processMacConfig with MacConfig structures instead
+     * @deprecated Use ConfigParser and RulesetCompiler instead
      * 
      * Legacy method for parsing MAC configuration directly from
      * YAML nodes. Maintained for backwards compatibility.
@@ -357,16 +578,6 @@ private:
      * simple string values and complex interface specifications.
      */
     InterfaceConfig parseInterface(const YAML::Node& node);
-    
-    /**
-     * @brief Resolve chain name from section name to actual chain name
-     * @param name Section name or chain name to resolve
-     * @return Actual chain name for iptables rules
-     * 
-     * Resolves section names to actual chain names using the internal mapping.
-     * If the name is not found in the mapping, it's assumed to be an actual chain name.
-     */
-    std::string resolveChainName(const std::string& name);
 };
 
 } // namespace iptables 
\ No newline at end of file
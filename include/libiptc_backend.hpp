@@ -0,0 +1,57 @@
+/**
+ * @file libiptc_backend.hpp
+ * @brief Native ruleset application through libiptc
+ * @author iptables-compose-cpp Development Team
+ * @date 2024
+ *
+ * This file contains the LibiptcBackend class which applies a CompiledRuleset
+ * without spawning any process. Each table blob is read from the kernel once,
+ * modified in memory and committed once. The backend is only functional when
+ * the project is built with libiptc support (HAVE_LIBIPTC); otherwise every
+ * call reports that the backend is unavailable.
+ */
+
+#pragma once
+
+#include "ruleset_compiler.hpp"
+#include <ostream>
+
+namespace iptables {
+
+/**
+ * @class LibiptcBackend
+ * @brief Applies compiled rulesets with libiptc, one commit per table
+ *
+ * Offers the same entry point as RestoreBackend so IptablesManager can
+ * select either one. Rule specifications are translated directly into
+ * ipt_entry structures using the kernel's match and target layouts; the
+ * supported vocabulary is exactly what RulesetCompiler emits (interfaces,
+ * sources, tcp/udp, multiport, mac, comment, and the standard, REJECT
+ * and REDIRECT targets).
+ *
+ * All methods are static, following CommandExecutor.
+ */
+class LibiptcBackend {
+public:
+    /**
+     * @brief Check whether the binary was built with libiptc support
+     * @return true if apply() can reach the kernel
+     */
+    static bool isAvailable();
+
+    /**
+     * @brief Apply a compiled ruleset with one libiptc commit per table
+     * @param ruleset Compiled configuration
+     * @param reset Drop all existing rules and custom chains in filter, nat and mangle
+     * @param out Stream for progress messages
+     * @param err Stream for errors
+     * @return true if every modified table was committed
+     *
+     * Without reset, previously applied YAML rules are deleted, custom
+     * chains defined by the configuration are flushed, and foreign rules,
+     * chains and counters are left untouched.
+     */
+    static bool apply(const CompiledRuleset& ruleset, bool reset, std::ostream& out, std::ostream& err);
+};
+
+} // namespace iptables
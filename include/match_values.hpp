@@ -0,0 +1,105 @@
+/**
+ * @file match_values.hpp
+ * @brief Typed subnet, port range and MAC address match values
+ * @author iptables-compose-cpp Development Team
+ * @date 2024
+ *
+ * This file contains the value types the configuration decoders produce
+ * for addresses and ranges. Each is parsed once, when its YAML scalar is
+ * decoded, into integers that validation, overlap analysis and rule
+ * compilation compare directly. The text as written is kept next to the
+ * parsed value: it is what error messages quote, and it is the spelling
+ * rules are emitted and tagged with, so existing rule tags stay valid.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace iptables {
+
+/**
+ * @struct Subnet
+ * @brief IPv4 network in CIDR notation, e.g. "10.1.0.0/24"
+ *
+ * A bare address stands for a /32 network. Text that is not an IPv4
+ * network (a hostname, an IPv6 address) is kept with valid set to false;
+ * such subnets are passed on to iptables unchanged but never contain, and
+ * are never contained in, another subnet.
+ */
+struct Subnet {
+    uint32_t network = 0;  ///< Network address in host byte order, host bits cleared
+    uint8_t prefix = 32;   ///< Prefix length, 0-32
+    bool valid = false;    ///< Whether text parsed as an IPv4 network
+    std::string text;      ///< Subnet as written in the configuration
+
+    /**
+     * @brief Parse a subnet
+     * @param text CIDR network or bare address
+     * @return Parsed subnet; valid is false if text is not an IPv4 network
+     */
+    static Subnet parse(std::string_view text);
+
+    /**
+     * @brief Check whether this network contains another one
+     * @param other Potentially contained network
+     * @return true if both are valid and every address of other lies in this network
+     */
+    bool contains(const Subnet& other) const;
+};
+
+/**
+ * @struct PortRange
+ * @brief Port range in the form "start-end", e.g. "1000-2000"
+ *
+ * A range is valid when both ends are ports between 1 and 65535 and the
+ * start is below the end.
+ */
+struct PortRange {
+    uint16_t first = 0;  ///< First port of the range
+    uint16_t last = 0;   ///< Last port of the range
+    bool valid = false;  ///< Whether text parsed as a valid range
+    std::string text;    ///< Range as written in the configuration
+
+    /**
+     * @brief Parse a port range
+     * @param text Range in the form "start-end"
+     * @return Parsed range; valid is false if text is not a valid range
+     */
+    static PortRange parse(std::string_view text);
+
+    /**
+     * @brief Render the range for the multiport match
+     * @return Range in the form "start:end"
+     */
+    std::string toMultiport() const;
+};
+
+/**
+ * @struct MacAddress
+ * @brief 48-bit MAC address in the form XX:XX:XX:XX:XX:XX or XX-XX-XX-XX-XX-XX
+ */
+struct MacAddress {
+    uint64_t value = 0;  ///< Address in the low 48 bits
+    bool valid = false;  ///< Whether text parsed as a MAC address
+    std::string text;    ///< Address as written in the configuration
+
+    /**
+     * @brief Parse a MAC address
+     * @param text Six hexadecimal octets separated by ':' or '-'
+     * @return Parsed address; valid is false if text is not a MAC address
+     */
+    static MacAddress parse(std::string_view text);
+
+    /**
+     * @brief Compare two addresses, ignoring case and separators when both are valid
+     */
+    bool operator==(const MacAddress& other) const {
+        return valid && other.valid ? value == other.value : text == other.text;
+    }
+    bool operator!=(const MacAddress& other) const { return !(*this == other); }
+};
+
+} // namespace iptables
@@ -0,0 +1,150 @@
+/**
+ * @file metrics.hpp
+ * @brief Per-run timing and cost metrics with JSON and Prometheus export
+ * @author iptables-compose-cpp Development Team
+ * @date 2024
+ *
+ * This file contains the Metrics class. A run records how long each phase
+ * took (loading, validation, compilation, planning, removal scans and
+ * execution) and what it cost the system: processes spawned, iptables
+ * invocations per table, bytes read from ruleset listings and time spent
+ * waiting for the xtables lock. At the end of the run the numbers can be
+ * written to a file for node exporter's textfile collector or any other
+ * scraper, so slow or expensive applies can be alerted on.
+ */
+
+#pragma once
+
+#include "command_executor.hpp"
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace iptables {
+
+/**
+ * @struct PhaseMetrics
+ * @brief Accumulated time of one phase
+ */
+struct PhaseMetrics {
+    uint64_t runs = 0;     ///< Times the phase was entered
+    double seconds = 0.0;  ///< Time spent in the phase, summed over all workers
+};
+
+/**
+ * @struct RunMetrics
+ * @brief Everything recorded during one run
+ */
+struct RunMetrics {
+    std::map<std::string, PhaseMetrics> phases;  ///< Phase timings, by phase name
+    uint64_t processes = 0;                      ///< Programs started
+    std::map<std::string, uint64_t> programs;    ///< Programs started, by program name
+    std::map<std::string, uint64_t> tables;      ///< iptables invocations, by table
+    uint64_t failures = 0;                       ///< Commands that did not succeed
+    uint64_t timeouts = 0;                       ///< Commands killed by a deadline or cancellation
+    double command_seconds = 0.0;                ///< Time spent in commands, summed over all workers
+    uint64_t bytes_written = 0;                  ///< Bytes written to command input
+    uint64_t bytes_read = 0;                     ///< Bytes read from command output
+    uint64_t listing_bytes = 0;                  ///< Part of bytes_read that came from ruleset listings
+    std::map<std::string, uint64_t> operations;  ///< Ruleset changes, by kind
+};
+
+/**
+ * @class Metrics
+ * @brief Process-wide, thread-safe collection of run metrics
+ *
+ * All methods are static. Commands are recorded by CommandExecutor and
+ * RestoreSession; phases are timed with PhaseTimer where the work happens.
+ * xtables lock figures are taken from XtablesLock when the metrics are
+ * rendered.
+ */
+class Metrics {
+public:
+    /**
+     * @class PhaseTimer
+     * @brief Adds the time between construction and destruction to a phase
+     */
+    class PhaseTimer {
+    public:
+        explicit PhaseTimer(std::string phase);
+        ~PhaseTimer() { stop(); }
+
+        /**
+         * @brief Record the phase now instead of at destruction
+         */
+        void stop();
+
+        PhaseTimer(const PhaseTimer&) = delete;
+        PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+    private:
+        std::string phase_;
+        std::chrono::steady_clock::time_point start_;
+        bool running_ = true;
+    };
+
+    /**
+     * @brief Add time to a phase
+     * @param phase Phase name, e.g. "load" or "apply"
+     * @param seconds Time spent
+     */
+    static void recordPhase(const std::string& phase, double seconds);
+
+    /**
+     * @brief Account for one finished command
+     * @param args Argument vector the command was started with
+     * @param input Data written to the command's standard input
+     * @param result What the command returned
+     * @param seconds Time the command took
+     * @param spawned false if no process was started, e.g. when the deadline had already passed
+     *
+     * iptables calls count towards the table given with -t, iptables-restore
+     * calls towards every table in their input.
+     */
+    static void recordCommand(const std::vector<std::string>& args, const std::string& input,
+                              const CommandResult& result, double seconds, bool spawned = true);
+
+    /**
+     * @brief Count ruleset changes
+     * @param kind Kind of change, e.g. "insert" or "delete"
+     * @param count Number of changes
+     */
+    static void recordOperations(const std::string& kind, uint64_t count);
+
+    /**
+     * @brief Copy of everything recorded so far
+     */
+    static RunMetrics snapshot();
+
+    /**
+     * @brief Render the metrics as a JSON object
+     * @param success Whether the run succeeded
+     */
+    static std::string toJson(bool success);
+
+    /**
+     * @brief Render the metrics in the Prometheus text exposition format
+     * @param success Whether the run succeeded
+     */
+    static std::string toPrometheus(bool success);
+
+    /**
+     * @brief Write the metrics to a file
+     * @param path Destination; ".json" selects JSON, anything else the Prometheus format
+     * @param success Whether the run succeeded
+     * @return true if the file was written
+     *
+     * The file is written next to its destination and renamed into place,
+     * so a scraper never reads a partially written file.
+     */
+    static bool writeFile(const std::filesystem::path& path, bool success);
+
+private:
+    /// Seconds since the metrics were first used, i.e. since the run started
+    static double elapsedSeconds();
+};
+
+} // namespace iptables
@@ -0,0 +1,116 @@
+/**
+ * @file process_runner.hpp
+ * @brief Shell-less process execution with separated output capture
+ * @author iptables-compose-cpp Development Team
+ * @date 2024
+ *
+ * This file contains the ProcessRunner class which starts programs directly
+ * from an argument vector with posix_spawn. No shell is involved, so
+ * arguments never need quoting, and stdout and stderr are captured on
+ * separate pipes. Every child leads its own process group, so a child that
+ * overruns its deadline is killed together with anything it started.
+ */
+
+#pragma once
+
+#include "command_executor.hpp"
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+namespace iptables {
+
+/**
+ * @struct SpawnedProcess
+ * @brief Handle to a child process started by ProcessRunner::spawn()
+ *
+ * File descriptors are the parent's ends of the child's standard streams;
+ * a value of -1 means the stream was not redirected. The descriptors are
+ * owned by the caller until passed to ProcessRunner::wait() or closed.
+ */
+struct SpawnedProcess {
+    pid_t pid = -1;      ///< Child process ID, -1 if spawning failed
+    int stdin_fd = -1;   ///< Write end of the child's stdin
+    int stdout_fd = -1;  ///< Read end of the child's stdout
+    int stderr_fd = -1;  ///< Read end of the child's stderr
+    int error = 0;       ///< errno from posix_spawn when pid is -1
+};
+
+/**
+ * @class ProcessRunner
+ * @brief Runs programs with posix_spawn and captures their output
+ *
+ * All methods are static. The program is resolved through PATH like
+ * execvp(). Exit status is reported as the process exit code, or as
+ * 128 + signal number when the child was killed by a signal.
+ */
+class ProcessRunner {
+public:
+    /**
+     * @brief Run a program to completion
+     * @param argv Program name followed by its arguments
+     * @param input Data written to the child's stdin (stdin is closed afterwards)
+     * @param limits Deadline and cancellation flag for the child
+     * @return CommandResult with exit code and separately captured stdout and stderr
+     *
+     * The child's output is read with poll() and large reads into buffers
+     * reserved up front, while the input is written, so neither side can
+     * block the other on a full pipe.
+     */
+    static CommandResult run(const std::vector<std::string>& argv, const std::string& input = "",
+                             const ExecutionLimits& limits = {});
+
+    /**
+     * @brief Start a program with all three standard streams connected to pipes
+     * @param argv Program name followed by its arguments
+     * @return Handle to the child; pid is -1 and error is set on failure
+     *
+     * All pipe descriptors are close-on-exec, so later children never
+     * inherit them. The child is placed in a new process group whose ID
+     * equals its pid.
+     */
+    static SpawnedProcess spawn(const std::vector<std::string>& argv);
+
+    /**
+     * @brief Feed input to a spawned child, collect its output and reap it
+     * @param process Child started by spawn(); all descriptors are closed and pid reset
+     * @param input Data written to the child's stdin before it is closed
+     * @param limits Deadline and cancellation flag for the child
+     * @return CommandResult with exit code and separately captured stdout and stderr
+     *
+     * Output that the child produced before this call is still in the pipes
+     * and is included in the result. When the limits expire first, the
+     * child's process group is killed and timed_out is set in the result.
+     */
+    static CommandResult communicate(SpawnedProcess& process, const std::string& input = "",
+                                     const ExecutionLimits& limits = {});
+
+    /**
+     * @brief Write a buffer completely to a pipe
+     * @param fd Pipe write end
+     * @param data Bytes to write
+     * @param limits Give up once these expire while the pipe is full
+     * @return false if the reader has gone away, the limits expired or another write error occurred
+     *
+     * SIGPIPE is suppressed for the duration of the write, so a reader that
+     * exits early is reported as a failed write instead of killing the caller.
+     */
+    static bool writeAll(int fd, const std::string& data, const ExecutionLimits& limits = {});
+
+    /**
+     * @brief Wait for a child and translate its status
+     * @param pid Child process ID
+     * @return Exit code, 128 + signal if the child was killed, or -1 on error
+     */
+    static int wait(pid_t pid);
+
+    /**
+     * @brief Kill a child started by spawn() together with its process group
+     * @param pid Child process ID
+     *
+     * The child is not reaped; wait() still has to be called.
+     */
+    static void kill(pid_t pid);
+};
+
+} // namespace iptables
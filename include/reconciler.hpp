@@ -0,0 +1,214 @@
+/**
+ * @file reconciler.hpp
+ * @brief Minimal change plans between a compiled configuration and the live ruleset
+ * @author iptables-compose-cpp Development Team
+ * @date 2024
+ *
+ * This file contains the Reconciler class which compares the rules a
+ * configuration asks for with the rules already in the kernel and derives
+ * the smallest list of chain creations, rule deletions, rule insertions and
+ * policy changes that turns one into the other. Rules that are already in
+ * place are left alone, so re-applying an unchanged configuration performs
+ * no kernel writes at all.
+ */
+
+#pragma once
+
+#include "ruleset_compiler.hpp"
+#include "ruleset_snapshot.hpp"
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace iptables {
+
+/**
+ * @struct PlanOperation
+ * @brief One kernel change in a reconcile plan
+ *
+ * Rule positions are 1-based and valid at the moment the operation runs,
+ * i.e. after every earlier operation of the plan has been applied.
+ */
+struct PlanOperation {
+    /**
+     * @enum Kind
+     * @brief Type of change
+     */
+    enum class Kind {
+        CreateChain,  ///< Create a user-defined chain
+        DeleteRule,   ///< Delete the rule at a position
+        InsertRule,   ///< Insert a rule at a position
+        AppendRule,   ///< Append a rule at the end of the chain
+        SetPolicy,    ///< Change a built-in chain policy
+        FlushChain,   ///< Remove every rule of a chain
+        DeleteChain   ///< Delete an empty user-defined chain
+    };
+
+    Kind kind = Kind::AppendRule;
+    std::string table = "filter";  ///< Table the operation applies to
+    std::string chain;             ///< Chain the operation applies to
+    uint32_t position = 0;         ///< Rule position for DeleteRule and InsertRule
+    CompiledRule rule;             ///< Rule to add for InsertRule and AppendRule
+    std::string text;              ///< Deleted rule for DeleteRule, new policy for SetPolicy,
+                                   ///< number of flushed rules for FlushChain
+
+    /**
+     * @brief Build the iptables arguments that perform the operation
+     * @return Argument vector suitable for CommandExecutor::executeIptables()
+     */
+    std::vector<std::string> toIptablesArgs() const;
+
+    /**
+     * @brief Render the operation as an iptables-restore --noflush line
+     * @return Line such as "-I INPUT 3 -p tcp ..." or "-D INPUT 4"
+     */
+    std::string toRestoreLine() const;
+
+    /**
+     * @brief Human readable description used by --plan
+     * @return One line describing the change, prefixed with +, - or ~
+     */
+    std::string describe() const;
+};
+
+/**
+ * @struct ReconcilePlan
+ * @brief Ordered operations that bring the live ruleset in line with a configuration
+ *
+ * Operations are grouped by chain: chain creations come first, then the
+ * deletions and insertions of each chain in turn, then the flush and
+ * deletion of section chains that are no longer configured (their jumps
+ * are gone by then), and policy changes last, so rules are in place before
+ * a restrictive policy takes effect.
+ */
+struct ReconcilePlan {
+    std::vector<PlanOperation> operations;  ///< Changes in execution order
+    size_t unchanged = 0;                   ///< Desired rules already present in the right order
+
+    /**
+     * @brief Check whether the live ruleset already matches
+     */
+    bool empty() const { return operations.empty(); }
+
+    /**
+     * @brief Count the operations of one kind
+     */
+    size_t count(PlanOperation::Kind kind) const;
+};
+
+/**
+ * @class Reconciler
+ * @brief Computes minimal change plans
+ *
+ * For every chain the configuration touches or that still holds managed
+ * rules, the managed rules in the kernel are compared with the desired
+ * rules as a longest common subsequence of canonical rule forms. Rules in
+ * the subsequence stay where they are, other managed rules are deleted,
+ * and missing desired rules are inserted next to their desired neighbours.
+ * Foreign rules are never touched, except in the configuration's own
+ * chains, which are owned completely as in the restore backend. A
+ * generated section chain the configuration no longer has is flushed and
+ * deleted as a whole instead of rule by rule.
+ *
+ * All methods are static, following RulesetCompiler.
+ */
+class Reconciler {
+public:
+    /**
+     * @brief Compute the operations that turn the live ruleset into the desired one
+     * @param desired Compiled configuration
+     * @param live Snapshot of the live ruleset
+     * @param settled_sections Sections whose rules are known to be in place
+     *        unchanged, e.g. because their digest matches the state journal
+     *        and the kernel still matches the journal
+     * @return Plan; empty if nothing needs to change
+     *
+     * Rules of settled sections are compared by their ownership tags
+     * instead of canonical forms, so the cost of planning follows the
+     * size of the change rather than the size of the ruleset.
+     */
+    static ReconcilePlan plan(const CompiledRuleset& desired, const RulesetSnapshot& live,
+                              const std::set<std::string>& settled_sections = {});
+
+    /**
+     * @brief Compute the operations that remove every managed rule and chain
+     * @param live Snapshot of the live ruleset
+     * @return Plan grouped by table, in the order of live.tables()
+     *
+     * Covers every table in the snapshot. Section chains, and filter chains
+     * holding managed rules and nothing else, are flushed and deleted as a whole
+     * unless a rule that stays still jumps to them. Managed rules anywhere
+     * else are deleted bottom-up, so every position stays valid when the
+     * operations of a table run in one transaction. The built-in filter
+     * chains get their ACCEPT policy back.
+     */
+    static ReconcilePlan teardown(const RulesetSnapshot& live);
+
+    /**
+     * @brief Canonical form of a rule specification for comparison
+     * @param spec Rule specification tokens without "-A CHAIN"
+     * @return Normalised text in which equivalent rules compare equal
+     *
+     * Mirrors how iptables-save prints rules: address, interface and
+     * protocol options come first in a fixed order, networks lose their
+     * host bits and host addresses get a /32 prefix, 0.0.0.0/0 matches are
+     * dropped, MAC addresses are upper case with colons and implicit target
+     * defaults are spelled out.
+     */
+    static std::string canonicalRule(const std::vector<std::string>& spec);
+
+    /**
+     * @brief Canonical form of a compiled rule
+     * @param rule Row of a RuleTable
+     * @return The same text canonicalRule() gives for a copy of the tokens,
+     *         with protocol, sources and MAC address taken from the row's
+     *         typed columns instead of parsed from its tokens
+     */
+    static std::string canonicalRule(const RuleView& rule);
+
+    /**
+     * @brief Split an iptables-save rule specification into tokens
+     * @param spec Rule text in iptables-save quoting
+     * @return Tokens with quotes removed
+     */
+    static std::vector<std::string> tokenize(const std::string& spec);
+
+    /**
+     * @brief Target a rule jumps or goes to
+     * @param spec Rule specification tokens, e.g. from tokenize()
+     * @return Value of -j, --jump, -g or --goto; empty if the rule has none
+     */
+    static std::string jumpTarget(const std::vector<std::string>& spec);
+
+    /**
+     * @brief Target a rule jumps or goes to
+     * @param spec Rule text in iptables-save quoting
+     * @return The same as jumpTarget() for the rule's tokens
+     */
+    static std::string jumpTarget(const std::string& spec);
+
+    /**
+     * @brief Check whether iptables-compose manages a live rule
+     * @param rule Rule from a snapshot
+     * @return true if its comment carries the "YAML:" ownership prefix
+     */
+    static bool isManaged(const SnapshotRule& rule);
+
+    /**
+     * @brief Split rules with several sources into one rule per source
+     * @param rule Compiled rule
+     * @param expanded Table receiving the rules as the kernel stores them
+     * @return Number of rules appended; 0 if the rule has at most one
+     *         source and is stored as it is
+     *
+     * The split follows the rule's typed sources; compiled rules match no
+     * destination, so "-d" lists never need splitting.
+     *
+     * iptables expands "-s a,b" into one rule per address, so that is what
+     * the live ruleset is compared against.
+     */
+    static size_t expandSources(const RuleView& rule, RuleTable& expanded);
+};
+
+} // namespace iptables
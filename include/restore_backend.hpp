@@ -0,0 +1,78 @@
+/**
+ * @file restore_backend.hpp
+ * @brief Transactional ruleset application through iptables-restore
+ * @author iptables-compose-cpp Development Team
+ * @date 2024
+ *
+ * This file contains the RestoreBackend class which renders a CompiledRuleset
+ * into iptables-restore payloads. Instead of forking one iptables process per
+ * rule, the whole configuration is committed with a single iptables-restore
+ * invocation, and every table is replaced atomically by the kernel.
+ */
+
+#pragma once
+
+#include "ruleset_compiler.hpp"
+#include "ruleset_snapshot.hpp"
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace iptables {
+
+/**
+ * @class RestoreBackend
+ * @brief Renders and applies iptables-restore payloads
+ *
+ * Two payload forms are produced:
+ * - A standalone payload containing only what the configuration describes,
+ *   suitable for --emit-restore and for loading on a clean system.
+ * - A merged payload built on top of the live ruleset (iptables-save -c),
+ *   in which previously applied YAML rules are replaced while foreign rules,
+ *   chains, policies and counters are carried over unchanged.
+ *
+ * All methods are static, following CommandExecutor.
+ */
+class RestoreBackend {
+public:
+    /**
+     * @brief Render the standalone payload for a compiled ruleset
+     * @param ruleset Compiled configuration
+     * @return iptables-restore payload with one *table ... COMMIT block per table
+     *
+     * Built-in chains without a configured policy are declared with "-",
+     * which tells iptables-restore to keep their current policy.
+     */
+    static std::string renderPayload(const CompiledRuleset& ruleset);
+
+    /**
+     * @brief Render a payload that replaces managed rules in a live ruleset
+     * @param ruleset Compiled configuration
+     * @param live Snapshot of the live ruleset, read with iptables-save -c
+     * @param reset Drop every rule and custom chain instead of only managed ones
+     * @return iptables-restore payload suitable for --counters
+     */
+    static std::string mergeWithLive(const CompiledRuleset& ruleset, const RulesetSnapshot& live, bool reset);
+
+    /**
+     * @brief Apply a compiled ruleset in a single iptables-restore transaction
+     * @param ruleset Compiled configuration
+     * @param live Snapshot of the live ruleset, read with iptables-save -c
+     * @param reset Drop all existing rules in filter, nat and mangle as part of the transaction
+     * @param out Stream for progress messages
+     * @param err Stream for errors
+     * @return true if the restore committed
+     */
+    static bool apply(const CompiledRuleset& ruleset, const RulesetSnapshot& live, bool reset,
+                      std::ostream& out, std::ostream& err);
+
+    /**
+     * @brief Write the standalone payload to a file
+     * @param ruleset Compiled configuration
+     * @param destination Output file path, or "-" for standard output
+     * @return true if the payload was written completely
+     */
+    static bool writePayload(const CompiledRuleset& ruleset, const std::string& destination);
+};
+
+} // namespace iptables
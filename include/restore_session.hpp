@@ -0,0 +1,141 @@
+/**
+ * @file restore_session.hpp
+ * @brief Streaming incremental updates through a long-lived iptables-restore
+ * @author iptables-compose-cpp Development Team
+ * @date 2024
+ *
+ * This file contains the RestoreSession class which keeps a single
+ * "iptables-restore --noflush" child open on a pipe and streams small,
+ * independently committed batches to it. Many rule operations then cost one
+ * process instead of one process each, while a bad rule still only fails
+ * the batch that contains it.
+ */
+
+#pragma once
+
+#include "process_runner.hpp"
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace iptables {
+
+/**
+ * @struct RestoreBatch
+ * @brief A group of operations committed together in one table
+ *
+ * Lines use iptables-restore syntax without the surrounding "*table" and
+ * "COMMIT" lines, for example "-D INPUT -p tcp ..." or "-A INPUT ...".
+ */
+struct RestoreBatch {
+    std::string table = "filter";    ///< Table the batch operates on
+    std::vector<std::string> lines;  ///< Operations in iptables-restore syntax
+    std::string description;         ///< Human readable label used in reports
+};
+
+/**
+ * @struct BatchResult
+ * @brief Outcome of one submitted batch
+ */
+struct BatchResult {
+    size_t id = 0;            ///< Identifier returned by RestoreSession::submit()
+    std::string description;  ///< Copied from the submitted batch
+    bool success = false;     ///< Whether the batch was committed
+    std::string error;        ///< iptables-restore diagnostics for failed batches
+};
+
+/**
+ * @class RestoreSession
+ * @brief Long-lived iptables-restore --noflush coprocess
+ *
+ * Batches are written to the child as soon as they are submitted, each
+ * wrapped in its own "*table ... COMMIT" block, so the child commits them
+ * one after another while the caller keeps producing work. iptables-restore
+ * reports nothing on success and exits on the first failing line, naming
+ * its line number. sync() therefore closes the input, maps the reported
+ * line back to the batch that contained it, marks earlier batches as
+ * committed, and replays later batches into a fresh child until every
+ * batch is resolved. A failing batch never commits, because its COMMIT
+ * line is never reached.
+ *
+ * Since a commit produces no output, there is no per-batch feedback
+ * before sync(): a failure is only known once the input is closed, and
+ * batches submitted after a failing one are queued as usual and replayed
+ * then. Callers must therefore not make a batch depend on an earlier
+ * batch having committed.
+ */
+class RestoreSession {
+public:
+    /**
+     * @brief Create a session
+     * @param program Restore binary, e.g. "iptables-restore" or "iptables-nft-restore"
+     *
+     * No process is started until the first batch is submitted.
+     */
+    explicit RestoreSession(std::string program = "iptables-restore");
+
+    /**
+     * @brief Resolve outstanding batches and stop the child
+     *
+     * Results of batches that were never synced are discarded.
+     */
+    ~RestoreSession();
+
+    RestoreSession(const RestoreSession&) = delete;
+    RestoreSession& operator=(const RestoreSession&) = delete;
+
+    /**
+     * @brief Queue a batch and stream it to the child
+     * @param batch Operations to commit together
+     * @return Identifier reported back in the matching BatchResult
+     *
+     * Never reports a failure itself; whether the batch committed is only
+     * known after sync().
+     */
+    size_t submit(RestoreBatch batch);
+
+    /**
+     * @brief Wait for every submitted batch and report its outcome
+     * @return One result per batch submitted since the previous sync(), in submission order
+     *
+     * The child exits as part of the sync; the next submit() starts a new one.
+     */
+    std::vector<BatchResult> sync();
+
+    /**
+     * @brief Number of batches submitted but not yet synced
+     */
+    size_t pendingCount() const { return pending_.size(); }
+
+    /**
+     * @brief Number of restore processes started by this session
+     */
+    size_t spawnCount() const { return spawn_count_; }
+
+private:
+    struct PendingBatch {
+        size_t id;
+        RestoreBatch batch;
+        size_t first_line = 0;  ///< Line number of "*table" in the current child's input
+        size_t last_line = 0;   ///< Line number of "COMMIT" in the current child's input
+        bool written = false;   ///< Whether the batch was streamed to the current child
+    };
+
+    bool ensureChild();
+    void writeBatch(PendingBatch& pending);
+    std::vector<std::string> childArgs() const;
+    CommandResult finishChild();
+    void stopChild();
+
+    std::string program_;
+    SpawnedProcess child_;
+    std::string child_input_;   ///< Everything written to the current child, for a runner and the metrics
+    std::chrono::steady_clock::time_point child_started_;
+    bool child_alive_ = false;
+    size_t lines_written_ = 0;
+    size_t next_id_ = 1;
+    size_t spawn_count_ = 0;
+    std::vector<PendingBatch> pending_;
+};
+
+} // namespace iptables
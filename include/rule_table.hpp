@@ -0,0 +1,465 @@
+/**
+ * @file rule_table.hpp
+ * @brief Compiled rules and their columnar, interned storage
+ * @author iptables-compose-cpp Development Team
+ * @date 2024
+ *
+ * This file contains the compiled rule representation every backend and
+ * analysis consumes. CompiledRule is a self-contained value, used while a
+ * rule is built and wherever a single rule travels on its own. A complete
+ * ruleset keeps its rules in a RuleTable instead: one column per field,
+ * with every table, chain, section, interface and spec token stored once
+ * in a StringPool and referenced by a 32-bit id. A rule then costs a
+ * handful of integers rather than a dozen heap strings, and walking 100k
+ * rules to diff or emit them reads contiguous arrays instead of chasing
+ * pointers.
+ *
+ * Next to the tokens, each row carries its matches as numbers: protocol,
+ * source networks, destination ports, MAC address, redirect port and the
+ * interned target. They come from the Subnet, PortRange and MacAddress
+ * values the configuration was decoded into, so consumers that need
+ * numbers, such as the libiptc backend and the reconciler, never parse
+ * the tokens back.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace iptables {
+
+/**
+ * @struct AddressMatch
+ * @brief IPv4 network matched by -s
+ */
+struct AddressMatch {
+    /// Prefix of a source that is not an IPv4 network, e.g. a hostname iptables resolves itself
+    static constexpr uint8_t kUnresolved = 0xff;
+
+    uint32_t network = 0;  ///< Network address in host byte order, host bits cleared
+    uint8_t prefix = 32;   ///< Prefix length 0-32, or kUnresolved
+
+    /**
+     * @brief Render the network as iptables-save prints it
+     * @return "a.b.c.d/prefix"
+     */
+    std::string toCidr() const;
+};
+
+/**
+ * @struct PortMatch
+ * @brief Destination port, or port range, matched by --dport or --dports
+ */
+struct PortMatch {
+    uint16_t first = 0;  ///< First port
+    uint16_t last = 0;   ///< Last port; equal to first for a single port
+};
+
+/**
+ * @brief Render a MAC address as iptables-save prints it
+ * @param mac Address in the low 48 bits
+ * @return Upper case octets separated by colons
+ */
+std::string formatMac(uint64_t mac);
+
+/**
+ * @class ColumnSpan
+ * @brief Read-only view of the entries one RuleTable row has in a list column
+ *
+ * Valid until rows are appended to the table.
+ */
+template <typename T>
+class ColumnSpan {
+public:
+    ColumnSpan(const T* begin, const T* end) : begin_(begin), end_(end) {}
+
+    size_t size() const { return static_cast<size_t>(end_ - begin_); }
+    bool empty() const { return begin_ == end_; }
+    const T& operator[](size_t i) const { return begin_[i]; }
+    const T* begin() const { return begin_; }
+    const T* end() const { return end_; }
+
+private:
+    const T* begin_;
+    const T* end_;
+};
+
+/**
+ * @struct CompiledRule
+ * @brief A single iptables rule ready for application
+ *
+ * Holds the table, chain and rule specification (everything that follows
+ * "-A <chain>") together with the ownership tag that identifies the rule
+ * for later replacement or removal. The tag is the rule's comment in the
+ * kernel; the readable signature it stands for stays in user space, see
+ * RulesetCompiler::ruleTag().
+ */
+struct CompiledRule {
+    std::string table = "filter";   ///< Target table (filter, nat)
+    std::string chain;              ///< Target chain (built-in or custom)
+    std::vector<std::string> spec;  ///< Rule specification without table/chain
+    std::string comment;            ///< Ownership tag carried by the rule as its comment
+    std::string description;        ///< Readable signature, e.g. "YAML:web:port:80:i:any:o:any:..."
+    std::string section;            ///< Configuration section the rule originates from
+
+    // The matches of spec as numbers, set by the compiler along with the tokens
+    uint8_t protocol = 0;               ///< IP protocol number of -p, e.g. IPPROTO_TCP; 0 for any
+    std::vector<AddressMatch> sources;  ///< Networks of -s, one per listed subnet
+    std::vector<PortMatch> ports;       ///< Port of --dport, or the ranges of --dports
+    bool multiport = false;             ///< Whether ports are matched with the multiport match
+    std::optional<uint64_t> mac;        ///< Address of --mac-source in the low 48 bits
+    uint16_t to_port = 0;               ///< Port of REDIRECT --to-port; 0 for none
+    std::string target;                 ///< Value of -j: a verdict, a chain or an extension
+
+    /**
+     * @brief Build the iptables arguments that append this rule
+     * @return Argument vector suitable for CommandExecutor::executeIptables()
+     */
+    std::vector<std::string> toAppendArgs() const;
+
+    /**
+     * @brief Render the rule as an iptables-restore line
+     * @param position Insert at this 1-based position instead of appending
+     * @return Line in the form "-A <chain> <spec>" (or "-I <chain> <position> <spec>")
+     *         with shell-style quoting
+     */
+    std::string toRestoreLine(uint32_t position = 0) const;
+
+    /**
+     * @brief Render the rule as an iptables-restore line replacing a rule in place
+     * @param position 1-based position of the rule to replace
+     * @return Line in the form "-R <chain> <position> <spec>"
+     */
+    std::string toReplaceLine(uint32_t position) const;
+};
+
+/**
+ * @class StringPool
+ * @brief Append-only store of strings addressed by 32-bit ids
+ *
+ * intern() hands out one id per distinct string. add() stores a string
+ * without looking for an equal one, for values such as ownership tags
+ * that are unique anyway and would only grow the index. Strings never
+ * move once stored, so references returned by operator[] stay valid for
+ * the lifetime of the pool. The index is an open-addressing table of ids
+ * and hashes, so a lookup touches one contiguous slot array rather than a
+ * chain of heap nodes.
+ */
+class StringPool {
+public:
+
+    /**
+     * @brief Get the id of a string, storing it on first use
+     * @param text String to look up
+     * @return Id shared by every equal interned string
+     */
+    uint32_t intern(std::string_view text);
+
+    /**
+     * @brief Store a string under a fresh id
+     * @param text String to store
+     * @return New id
+     */
+    uint32_t add(std::string text);
+
+    /**
+     * @brief Get a stored string
+     * @param id Id returned by intern() or add()
+     */
+    const std::string& operator[](uint32_t id) const { return strings_[id]; }
+
+    /**
+     * @brief Get the number of stored strings
+     */
+    size_t size() const { return strings_.size(); }
+
+private:
+    struct Slot {
+        uint32_t id = 0;    ///< Id + 1 of the string; 0 for a free slot
+        uint32_t hash = 0;  ///< Low bits of the string's hash
+    };
+
+    void grow();
+
+    std::deque<std::string> strings_;
+    std::vector<Slot> slots_;  ///< Size is a power of two, at most half in use
+    size_t interned_ = 0;
+};
+
+class RuleTable;
+
+/**
+ * @class TokenSpan
+ * @brief The specification tokens of one RuleTable row
+ *
+ * Behaves like a read-only std::vector<std::string>: it has a size, can
+ * be indexed and iterated, and yields references to pooled strings.
+ */
+class TokenSpan {
+public:
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::string;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const std::string*;
+        using reference = const std::string&;
+
+        const_iterator(const RuleTable* rules, size_t index) : rules_(rules), index_(index) {}
+        reference operator*() const;
+        pointer operator->() const { return &**this; }
+        const_iterator& operator++() { ++index_; return *this; }
+        const_iterator operator++(int) { const_iterator old = *this; ++index_; return old; }
+        bool operator==(const const_iterator& other) const { return index_ == other.index_; }
+        bool operator!=(const const_iterator& other) const { return index_ != other.index_; }
+
+    private:
+        const RuleTable* rules_;
+        size_t index_;
+    };
+
+    TokenSpan(const RuleTable* rules, size_t begin, size_t end) : rules_(rules), begin_(begin), end_(end) {}
+
+    size_t size() const { return end_ - begin_; }
+    bool empty() const { return begin_ == end_; }
+    const std::string& operator[](size_t i) const;
+    const_iterator begin() const { return {rules_, begin_}; }
+    const_iterator end() const { return {rules_, end_}; }
+
+    /**
+     * @brief Get the pool id of a token, equal for equal tokens
+     */
+    uint32_t id(size_t i) const;
+
+    /**
+     * @brief Copy the tokens out of the table
+     */
+    std::vector<std::string> toVector() const { return {begin(), end()}; }
+
+private:
+    const RuleTable* rules_;
+    size_t begin_;
+    size_t end_;
+};
+
+/**
+ * @class RuleView
+ * @brief One row of a RuleTable, with the accessors of a CompiledRule
+ *
+ * A view is two words and is passed by value. It stays valid while its
+ * table exists; appending rows does not invalidate it.
+ */
+class RuleView {
+public:
+    RuleView(const RuleTable& rules, size_t row) : rules_(&rules), row_(row) {}
+
+    const std::string& table() const;
+    const std::string& chain() const;
+    const std::string& section() const;
+    const std::string& comment() const;
+    const std::string& description() const;
+    TokenSpan spec() const;
+
+    uint8_t protocol() const;
+    ColumnSpan<AddressMatch> sources() const;
+    ColumnSpan<PortMatch> ports() const;
+    bool multiport() const;
+    std::optional<uint64_t> mac() const;
+    uint16_t toPort() const;
+    const std::string& target() const;
+
+    /**
+     * @brief Get the pool id of the target, equal for equal targets
+     */
+    uint32_t targetId() const;
+
+    /// @copydoc CompiledRule::toAppendArgs()
+    std::vector<std::string> toAppendArgs() const;
+
+    /// @copydoc CompiledRule::toRestoreLine()
+    std::string toRestoreLine(uint32_t position = 0) const;
+
+    /// @copydoc CompiledRule::toReplaceLine()
+    std::string toReplaceLine(uint32_t position) const;
+
+    /**
+     * @brief Copy the row into a self-contained rule
+     */
+    CompiledRule toCompiledRule() const;
+
+    /**
+     * @brief Get the table the view reads from
+     */
+    const RuleTable& rules() const { return *rules_; }
+
+    /**
+     * @brief Get the row number within its table
+     */
+    size_t row() const { return row_; }
+
+private:
+    const RuleTable* rules_;
+    size_t row_;
+};
+
+/**
+ * @class RuleTable
+ * @brief Ordered rules stored as interned columns
+ *
+ * Each row is a rule: its table, chain, section, comment, description and
+ * target ids, a range of spec token ids, and its typed matches. Rows are
+ * appended from CompiledRule values or from rows of any other table, and
+ * read back through RuleView.
+ */
+class RuleTable {
+public:
+    class const_iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = RuleView;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = RuleView;
+
+        const_iterator(const RuleTable* rules, size_t row) : rules_(rules), row_(row) {}
+        RuleView operator*() const { return RuleView(*rules_, row_); }
+        const_iterator& operator++() { ++row_; return *this; }
+        bool operator==(const const_iterator& other) const { return row_ == other.row_; }
+        bool operator!=(const const_iterator& other) const { return row_ != other.row_; }
+
+    private:
+        const RuleTable* rules_;
+        size_t row_;
+    };
+
+    size_t size() const { return chain_.size(); }
+    bool empty() const { return chain_.empty(); }
+    size_t tokenCount() const { return tokens_.size(); }
+    RuleView operator[](size_t row) const { return RuleView(*this, row); }
+    const_iterator begin() const { return {this, 0}; }
+    const_iterator end() const { return {this, size()}; }
+
+    /**
+     * @brief Reserve room for rows and their spec tokens
+     * @param rows Expected number of rows
+     * @param tokens Expected number of spec tokens over all rows
+     */
+    void reserve(size_t rows, size_t tokens);
+
+    /**
+     * @brief Append a rule
+     * @param rule Rule to store; its unique strings are moved into the pool
+     */
+    void append(CompiledRule rule);
+
+    /**
+     * @brief Append a copy of a row, possibly of another table
+     * @param rule Row to copy
+     */
+    void append(const RuleView& rule);
+
+    /**
+     * @brief Move a row to another chain
+     * @param row Row number
+     * @param chain New chain name
+     */
+    void setChain(size_t row, std::string_view chain);
+
+    /**
+     * @brief Point a row's -j at another target
+     * @param row Row number
+     * @param target New target, in the spec and the target column
+     */
+    void setTarget(size_t row, std::string_view target);
+
+    /**
+     * @brief Check whether any row targets a table
+     * @param table Table name
+     */
+    bool hasTable(std::string_view table) const;
+
+    /**
+     * @brief Get the pool holding every string of the table
+     */
+    const StringPool& strings() const { return strings_; }
+
+private:
+    friend class RuleView;
+    friend class TokenSpan;
+    friend class TokenSpan::const_iterator;
+
+    StringPool strings_;
+    std::vector<uint32_t> table_;
+    std::vector<uint32_t> chain_;
+    std::vector<uint32_t> section_;
+    std::vector<uint32_t> comment_;
+    std::vector<uint32_t> description_;
+    std::vector<uint32_t> spec_begin_ = {0};  ///< Row -> first token; one more entry ends the last row
+    std::vector<uint32_t> tokens_;
+
+    std::vector<uint8_t> protocol_;
+    std::vector<uint8_t> multiport_;
+    std::vector<uint64_t> mac_;                  ///< kNoMac for rules without --mac-source
+    std::vector<uint16_t> to_port_;
+    std::vector<uint32_t> target_;
+    std::vector<uint32_t> source_begin_ = {0};  ///< Row -> first entry of sources_, as spec_begin_
+    std::vector<AddressMatch> sources_;
+    std::vector<uint32_t> port_begin_ = {0};    ///< Row -> first entry of ports_, as spec_begin_
+    std::vector<PortMatch> ports_;
+
+    static constexpr uint64_t kNoMac = ~uint64_t{0};
+
+    void appendMatches(const RuleView& rule);
+};
+
+inline const std::string& TokenSpan::const_iterator::operator*() const {
+    return rules_->strings_[rules_->tokens_[index_]];
+}
+
+inline const std::string& TokenSpan::operator[](size_t i) const {
+    return rules_->strings_[rules_->tokens_[begin_ + i]];
+}
+
+inline uint32_t TokenSpan::id(size_t i) const {
+    return rules_->tokens_[begin_ + i];
+}
+
+inline const std::string& RuleView::table() const { return rules_->strings_[rules_->table_[row_]]; }
+inline const std::string& RuleView::chain() const { return rules_->strings_[rules_->chain_[row_]]; }
+inline const std::string& RuleView::section() const { return rules_->strings_[rules_->section_[row_]]; }
+inline const std::string& RuleView::comment() const { return rules_->strings_[rules_->comment_[row_]]; }
+inline const std::string& RuleView::description() const { return rules_->strings_[rules_->description_[row_]]; }
+
+inline TokenSpan RuleView::spec() const {
+    return TokenSpan(rules_, rules_->spec_begin_[row_], rules_->spec_begin_[row_ + 1]);
+}
+
+inline uint8_t RuleView::protocol() const { return rules_->protocol_[row_]; }
+inline bool RuleView::multiport() const { return rules_->multiport_[row_] != 0; }
+inline uint16_t RuleView::toPort() const { return rules_->to_port_[row_]; }
+inline const std::string& RuleView::target() const { return rules_->strings_[rules_->target_[row_]]; }
+inline uint32_t RuleView::targetId() const { return rules_->target_[row_]; }
+
+inline std::optional<uint64_t> RuleView::mac() const {
+    uint64_t mac = rules_->mac_[row_];
+    return mac == RuleTable::kNoMac ? std::nullopt : std::optional<uint64_t>(mac);
+}
+
+inline ColumnSpan<AddressMatch> RuleView::sources() const {
+    const AddressMatch* data = rules_->sources_.data();
+    return {data + rules_->source_begin_[row_], data + rules_->source_begin_[row_ + 1]};
+}
+
+inline ColumnSpan<PortMatch> RuleView::ports() const {
+    const PortMatch* data = rules_->ports_.data();
+    return {data + rules_->port_begin_[row_], data + rules_->port_begin_[row_ + 1]};
+}
+
+} // namespace iptables
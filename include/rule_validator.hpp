@@ -36,13 +36,13 @@ namespace iptables {
  * appear before less selective rules to ensure proper packet matching.
  */
 struct RuleSelectivity {
-    std::optional<std::vector<std::string>> subnets;  ///< Network subnets (more specific = more selective)
+    std::optional<std::vector<Subnet>> subnets;       ///< Network subnets (more specific = more selective)
     std::optional<int> port;                          ///< Specific single port (more selective than ranges)
-    std::optional<std::vector<std::string>> port_ranges; ///< Port ranges using multiport extension
+    std::optional<std::vector<PortRange>> port_ranges; ///< Port ranges using multiport extension
     Protocol protocol;                                ///< Network protocol (TCP/UDP specificity)
     std::optional<std::string> input_interface;       ///< Input interface specification
     std::optional<std::string> output_interface;      ///< Output interface specification
-    std::optional<std::string> mac_source;            ///< MAC address source filter
+    std::optional<MacAddress> mac_source;             ///< MAC address source filter
     bool allow;                                       ///< Rule action (ACCEPT vs DROP/REJECT)
     std::optional<std::string> target_chain;         ///< Custom chain target instead of direct action
     
@@ -189,15 +189,17 @@ public:
     
     /**
      * @brief Check if one subnet contains another subnet
-     * @param subnet_a The potentially containing subnet (CIDR notation)
-     * @param subnet_b The potentially contained subnet (CIDR notation)
+     * @param subnet_a The potentially containing subnet
+     * @param subnet_b The potentially contained subnet
      * @return true if subnet_a completely contains subnet_b
      * 
-     * Performs CIDR analysis to determine if subnet A completely
-     * contains subnet B (A is less specific than B). Used for
-     * detecting subnet-based rule conflicts and overlaps.
+     * Compares the network addresses and prefix lengths decoded with the
+     * configuration to determine if subnet A completely contains subnet B
+     * (A is less specific than B). Subnets that did not parse as IPv4
+     * networks contain nothing. Used for detecting subnet-based rule
+     * conflicts and overlaps.
      */
-    static bool subnetContains(const std::string& subnet_a, const std::string& subnet_b);
+    static bool subnetContains(const Subnet& subnet_a, const Subnet& subnet_b);
     
     /**
      * @brief Extract rule selectivity information from configuration
@@ -260,17 +262,6 @@ private:
      */
     static bool hasCycleInGraph(const std::map<std::string, std::set<std::string>>& graph);
     
-    /**
-     * @brief Parse CIDR notation into network address and prefix length
-     * @param cidr CIDR string (e.g., "192.168.1.0/24")
-     * @return Pair of network address (as uint32_t) and prefix length
-     * @throws std::invalid_argument if CIDR format is invalid
-     * 
-     * Parses CIDR notation strings into binary network addresses and
-     * prefix lengths for mathematical subnet containment analysis.
-     */
-    static std::pair<uint32_t, int> parseCIDR(const std::string& cidr);
-    
     /**
      * @brief Check if one interface specification is more specific than another
      * @param specific The potentially more specific interface specification
@@ -0,0 +1,86 @@
+/**
+ * @file ruleset_cache.hpp
+ * @brief Compiled ruleset cache for the boot fast path
+ * @author iptables-compose-cpp Development Team
+ * @date 2024
+ *
+ * This file contains the RulesetCache class. The iptables-restore payload a
+ * configuration compiles to is stored under a key derived from the
+ * configuration file, the tool version and the chain layout. At boot,
+ * --from-cache checks the key and restores the stored payload in one
+ * iptables-restore, skipping the YAML parse, validation, compilation and
+ * the listing of the live ruleset.
+ */
+
+#pragma once
+
+#include "ruleset_compiler.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace iptables {
+
+/**
+ * @struct CachedRuleset
+ * @brief A stored payload and the tables it replaces
+ */
+struct CachedRuleset {
+    std::vector<std::string> tables;  ///< Tables the payload declares
+    std::string payload;              ///< Standalone iptables-restore payload
+};
+
+/**
+ * @class RulesetCache
+ * @brief Stores and loads compiled restore payloads
+ *
+ * The cache file starts with "key <16 hex digits>" and "tables <t1,t2>"
+ * lines, followed by the payload RestoreBackend::renderPayload() renders.
+ * It is replaced atomically. All methods are static, following
+ * StateJournal.
+ */
+class RulesetCache {
+public:
+    /// Cache file used unless setPath() chooses another
+    static constexpr const char* kDefaultPath = "/var/cache/iptables-compose/ruleset";
+
+    /**
+     * @brief Choose the cache file
+     * @param path Cache file; its directory is created when it is written
+     */
+    static void setPath(const std::filesystem::path& path);
+
+    /**
+     * @brief The cache file in use
+     */
+    static const std::filesystem::path& path();
+
+    /**
+     * @brief Cache key of a configuration
+     * @param config_path Configuration file
+     * @param section_chains Whether sections are compiled into chains of their own
+     * @return 64-bit FNV-1a hash of the contents of the file and its
+     *         fragments, the fragment names, the tool version and the
+     *         layout, or std::nullopt if a file cannot be read
+     */
+    static std::optional<uint64_t> key(const std::filesystem::path& config_path, bool section_chains);
+
+    /**
+     * @brief Load the stored payload if it was compiled for a key
+     * @param key Key from key()
+     * @return Stored payload, or std::nullopt if there is none or its key differs
+     */
+    static std::optional<CachedRuleset> load(uint64_t key);
+
+    /**
+     * @brief Store the payload of a compiled ruleset
+     * @param key Key from key()
+     * @param ruleset Compiled configuration
+     * @return true if the cache file was written
+     */
+    static bool store(uint64_t key, const CompiledRuleset& ruleset);
+};
+
+} // namespace iptables
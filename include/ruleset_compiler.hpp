@@ -0,0 +1,281 @@
+/**
+ * @file ruleset_compiler.hpp
+ * @brief Compilation of configuration structures into iptables rule specifications
+ * @author iptables-compose-cpp Development Team
+ * @date 2024
+ *
+ * This file contains the RulesetCompiler class which translates a parsed Config
+ * into a flat, ordered set of iptables rule specifications. The compiled form is
+ * shared by every apply backend: the per-command executor path appends each rule
+ * individually, while the restore backend renders the complete set into a single
+ * iptables-restore payload.
+ */
+
+#pragma once
+
+#include "config.hpp"
+#include "rule_table.hpp"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace iptables {
+
+/**
+ * @struct SectionChain
+ * @brief Generated chain holding one section's rules of one built-in chain
+ */
+struct SectionChain {
+    std::string table = "filter";  ///< Table of the built-in chain
+    std::string name;              ///< Generated name, see RulesetCompiler::sectionChainName()
+    std::string parent;            ///< Built-in chain holding the single jump into it; empty for custom chains
+    std::string section;           ///< Configuration section, or custom chain, the rules come from
+};
+
+/**
+ * @struct CompiledRuleset
+ * @brief Complete compiled form of a configuration
+ *
+ * Rules are stored in application order. Custom chains are listed in the
+ * order they are defined in the configuration and always live in the
+ * filter table. Policies apply to the built-in filter chains. Section
+ * chains are only present after RulesetCompiler::useSectionChains().
+ */
+struct CompiledRuleset {
+    std::map<std::string, Policy> policies;     ///< Built-in filter chain -> policy
+    std::vector<std::string> chains;            ///< Custom filter chains to create
+    std::vector<SectionChain> section_chains;   ///< Generated per-section chains to create
+    RuleTable rules;                            ///< Rules in application order
+
+    /**
+     * @brief Get the set of tables referenced by this ruleset
+     * @return Table names in canonical order; always includes "filter"
+     */
+    std::vector<std::string> tables() const;
+
+    /**
+     * @brief Check whether a chain belongs to the configuration completely
+     * @param table Table of the chain
+     * @param chain Chain name
+     * @return true for custom chains and section chains of this ruleset
+     *
+     * Owned chains hold nothing but configured rules, so every other rule
+     * found in them is removed.
+     */
+    bool ownsChain(const std::string& table, const std::string& chain) const;
+};
+
+/**
+ * @class RulesetCompiler
+ * @brief Translates configuration structures into compiled iptables rules
+ *
+ * All methods are static. The per-rule methods throw std::invalid_argument
+ * when a configuration cannot be expressed as an iptables rule (for example
+ * port forwarding combined with port ranges), mirroring the checks the
+ * apply path has always performed.
+ */
+class RulesetCompiler {
+public:
+    /**
+     * @brief Compile a complete configuration
+     * @param config Parsed and validated configuration
+     * @return Compiled ruleset in the same order the per-command path applies it
+     * @throws std::invalid_argument if any rule cannot be compiled
+     */
+    static CompiledRuleset compile(const Config& config);
+
+    /**
+     * @brief Build the section name to chain name mapping
+     * @param config Configuration containing chain definitions
+     * @return Map from defining section name to the actual chain name
+     */
+    static std::map<std::string, std::string> buildSectionChainMap(const Config& config);
+
+    /**
+     * @brief Resolve a chain reference that may be a section name
+     * @param section_to_chain Mapping produced by buildSectionChainMap()
+     * @param name Section or chain name
+     * @return Actual chain name
+     */
+    static std::string resolveChainName(const std::map<std::string, std::string>& section_to_chain,
+                                        const std::string& name);
+
+    /**
+     * @brief Compile a port rule from a custom section
+     * @param port Port configuration
+     * @param section_name Name of the containing section
+     * @return Compiled rule (filter table, or nat PREROUTING for forwards)
+     * @throws std::invalid_argument if neither port nor range is set or a range is forwarded
+     */
+    static CompiledRule compilePortRule(const PortConfig& port, const std::string& section_name);
+
+    /**
+     * @brief Compile a MAC rule from a custom section or the filter section
+     * @param mac MAC configuration
+     * @param section_name Name of the containing section
+     * @return Compiled rule for the INPUT chain
+     * @throws std::invalid_argument if the direction is not INPUT
+     */
+    static CompiledRule compileMacRule(const MacConfig& mac, const std::string& section_name);
+
+    /**
+     * @brief Compile an interface rule
+     * @param interface Interface rule configuration
+     * @param section_name Name of the containing section
+     * @return Compiled rule
+     */
+    static CompiledRule compileInterfaceRule(const InterfaceRuleConfig& interface, const std::string& section_name);
+
+    /**
+     * @brief Compile a catch-all action rule
+     * @param action Action applied to unmatched INPUT traffic
+     * @param section_name Name of the containing section
+     * @return Compiled rule for the INPUT chain
+     */
+    static CompiledRule compileActionRule(const Action& action, const std::string& section_name);
+
+    /**
+     * @brief Compile an interface-based jump into a custom chain
+     * @param interface Interface configuration carrying the chain reference
+     * @param section_name Name of the containing section
+     * @param target_chain Already resolved target chain name
+     * @return Compiled rule
+     * @throws std::invalid_argument if the interface does not reference a chain
+     */
+    static CompiledRule compileInterfaceChainCall(const InterfaceConfig& interface,
+                                                  const std::string& section_name,
+                                                  const std::string& target_chain);
+
+    /**
+     * @brief Compile the rule groups of a custom chain
+     * @param chain_name Name of the custom chain
+     * @param rules Named rule groups in YAML order
+     * @param section_to_chain Mapping used to resolve chain call targets
+     * @return Compiled rules in YAML order
+     */
+    static std::vector<CompiledRule> compileChainRules(
+        const std::string& chain_name,
+        const std::vector<std::pair<std::string, SectionConfig>>& rules,
+        const std::map<std::string, std::string>& section_to_chain);
+
+    /**
+     * @brief Get the built-in chains of a table
+     * @param table Table name
+     * @return Built-in chain names in iptables-save order
+     */
+    static const std::vector<std::string>& builtinChains(const std::string& table);
+
+    /**
+     * @brief Check whether a chain is a built-in chain of any table
+     * @param chain Chain name
+     * @return true for INPUT, OUTPUT, FORWARD, PREROUTING and POSTROUTING
+     */
+    static bool isBuiltinChain(const std::string& chain);
+
+    /// Name prefix reserved for generated section chains
+    static constexpr const char* kSectionChainPrefix = "YAML-";
+
+    /// Longest chain name iptables accepts
+    static constexpr size_t kMaxChainNameLength = 28;
+
+    /// Comment prefix shared by every rule the configuration owns
+    static constexpr const char* kRuleTagPrefix = "YAML:";
+
+    /// Length of an ownership tag: prefix, 8 hex digits, ':' and 16 hex digits
+    static constexpr size_t kRuleTagLength = 30;
+
+    /**
+     * @brief Ownership tag of a compiled rule
+     * @param rule Rule with its table, chain, spec and section filled in
+     * @return "YAML:<section id>:<rule hash>", always kRuleTagLength characters
+     *
+     * The section id is a 32-bit hash of the section name and the rule
+     * hash a 64-bit FNV-1a hash of the table, chain and spec with the
+     * comment left out, so the tag is stable for as long as the rule is
+     * and does not grow with subnet or port lists. It stays well below
+     * the 256-byte comment limit of the kernel, is compared as a whole
+     * instead of searched for, and keeps the "YAML:" prefix that marks a
+     * rule as managed.
+     */
+    static std::string ruleTag(const CompiledRule& rule);
+
+    /**
+     * @brief Section id carried in the tags of a section's rules
+     * @param section Section name, or custom chain name for a chain's rules
+     * @return 8 hex digits
+     */
+    static std::string sectionId(const std::string& section);
+
+    /**
+     * @brief Content hash of every section of a compiled ruleset
+     * @param ruleset Compiled ruleset
+     * @return Section -> 64-bit hash of its rules' tags in order
+     *
+     * A digest changes whenever a rule of the section is added, removed,
+     * reordered or changed, including a jump whose target chain was
+     * renamed, and stays the same under any change to other sections.
+     */
+    static std::map<std::string, uint64_t> sectionDigests(const CompiledRuleset& ruleset);
+
+    /**
+     * @brief Move every section's rules into chains of their own
+     * @param ruleset Compiled ruleset; rewritten in place
+     * @throws std::invalid_argument if a custom chain uses the reserved prefix
+     *
+     * The rules a section adds to a built-in chain move to a generated
+     * chain, and the built-in chain gets a single jump to it in their
+     * place. Evaluation order is unchanged: a section's rules were already
+     * contiguous, and traffic they do not decide returns to the rule after
+     * the jump. Removing a section then takes a jump deletion plus a flush
+     * and delete of its chain, however many rules it has.
+     *
+     * With a generation, every generated name gets ".<generation>" appended
+     * and the custom chains move into generated chains as well, named
+     * "YAML-<chain>.<generation>" with jumps to them rewritten. Two
+     * generations of the whole ruleset can then exist side by side, which
+     * is what a hitless reload builds on.
+     */
+    static void useSectionChains(CompiledRuleset& ruleset, const std::string& generation = "");
+
+    /**
+     * @brief Name of the chain holding a section's rules of a built-in chain
+     * @param section Section name
+     * @param parent Built-in chain, e.g. "INPUT"
+     * @param generation Optional generation, appended as ".<generation>"
+     * @return "YAML-<section>-<in|out|fwd|pre|post>"; sections that are too
+     *         long or contain characters iptables rejects are shortened and
+     *         suffixed with a hash of the full name
+     */
+    static std::string sectionChainName(const std::string& section, const std::string& parent,
+                                        const std::string& generation = "");
+
+    /**
+     * @brief Check whether a chain name is a generated section chain
+     * @param chain Chain name
+     * @return true if the name starts with kSectionChainPrefix
+     */
+    static bool isSectionChain(const std::string& chain);
+};
+
+/**
+ * @brief Convert a Policy value to its iptables target name
+ */
+std::string policyToString(Policy policy);
+
+/**
+ * @brief Convert an Action value to its iptables target name
+ */
+std::string actionToString(Action action);
+
+/**
+ * @brief Build the "i:<in>:o:<out>" fragment used in YAML comments
+ */
+std::string getInterfaceComment(const std::optional<InterfaceConfig>& interface);
+
+/**
+ * @brief Convert a Direction value to its built-in chain name
+ */
+std::string directionToChain(Direction direction);
+
+} // namespace iptables
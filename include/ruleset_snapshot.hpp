@@ -0,0 +1,225 @@
+/**
+ * @file ruleset_snapshot.hpp
+ * @brief In-memory model of the live ruleset parsed from iptables-save
+ * @author iptables-compose-cpp Development Team
+ * @date 2024
+ *
+ * This file contains the RulesetSnapshot class which holds every table,
+ * chain and rule of the running ruleset as reported by a single
+ * "iptables-save -c" call. Lookups that used to list a chain with
+ * "iptables -L" before every rule operation are answered from memory,
+ * and the model is updated locally as operations are applied so it stays
+ * in sync without being re-read.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace iptables {
+
+/**
+ * @struct SnapshotRule
+ * @brief One rule as written by iptables-save
+ */
+struct SnapshotRule {
+    std::string counters;  ///< "[packets:bytes]" prefix, empty if the dump had none
+    std::string spec;      ///< Rule text after "-A CHAIN ", in iptables-save quoting
+    std::string comment;   ///< Unquoted --comment value, empty if the rule has none
+
+    /**
+     * @brief Render the rule as an iptables-save line
+     * @param chain Chain holding the rule
+     * @param with_counters Prefix the line with the saved counters
+     * @return "[p:b] -A CHAIN spec" or "-A CHAIN spec"
+     */
+    std::string toLine(const std::string& chain, bool with_counters) const;
+};
+
+/**
+ * @struct SnapshotChain
+ * @brief One chain of a table with its rules in kernel order
+ */
+struct SnapshotChain {
+    std::string name{};                 ///< Chain name
+    std::string policy = "-";           ///< Built-in policy, "-" for user-defined chains
+    std::string counters = "[0:0]";     ///< Chain counters from the declaration line
+    std::vector<SnapshotRule> rules{};  ///< Rules in evaluation order
+
+    /**
+     * @brief Check whether the chain is user-defined
+     * @return true if the chain has no policy
+     */
+    bool isUserDefined() const { return policy == "-"; }
+};
+
+/**
+ * @class RulesetSnapshot
+ * @brief Table/chain/rule model of the live ruleset
+ *
+ * Rules are additionally indexed by their comment, which is how
+ * iptables-compose identifies the rules it manages, so finding the copies
+ * of a managed rule costs one hash lookup instead of an iptables process.
+ * Rule positions are 1-based, matching "iptables -D CHAIN N".
+ *
+ * The mutators only change the model; callers apply the matching kernel
+ * operation first and mirror it here once it succeeded.
+ */
+class RulesetSnapshot {
+public:
+    /**
+     * @brief Parse iptables-save output, with or without -c counters
+     * @param dump Complete iptables-save output
+     * @return Snapshot holding every table in the dump
+     */
+    static RulesetSnapshot parse(const std::string& dump);
+
+    /**
+     * @brief Read the live ruleset with a single iptables-save -c call
+     * @return Snapshot, or std::nullopt if iptables-save failed (reported on stderr)
+     */
+    static std::optional<RulesetSnapshot> capture();
+
+    /**
+     * @brief Extract the --comment value of a rule, unquoting it if needed
+     * @param spec Rule text in iptables-save quoting
+     * @return Comment text, empty if the rule has no comment
+     */
+    static std::string extractComment(const std::string& spec);
+
+    // Queries
+
+    /**
+     * @brief Tables present in the snapshot, in dump order
+     */
+    const std::vector<std::string>& tables() const { return table_order_; }
+
+    /**
+     * @brief Check whether a table was present in the dump
+     */
+    bool hasTable(const std::string& table) const;
+
+    /**
+     * @brief Check whether a chain exists in a table
+     */
+    bool hasChain(const std::string& table, const std::string& chain) const;
+
+    /**
+     * @brief Look up a chain
+     * @return Chain, or nullptr if it does not exist
+     */
+    const SnapshotChain* chain(const std::string& table, const std::string& chain) const;
+
+    /**
+     * @brief Chains of a table in declaration order
+     * @param table Table name
+     * @param user_defined_only Skip built-in chains
+     * @return Chain names; empty if the table does not exist
+     */
+    std::vector<std::string> chainNames(const std::string& table, bool user_defined_only = false) const;
+
+    /**
+     * @brief Positions of the rules carrying exactly the given comment
+     * @param table Table name
+     * @param chain Chain name
+     * @param comment Comment to match
+     * @return 1-based rule positions in ascending order
+     */
+    std::vector<uint32_t> findRules(const std::string& table, const std::string& chain,
+                                    const std::string& comment) const;
+
+    /**
+     * @brief Positions of the rules whose comment starts with a prefix
+     * @param table Table name
+     * @param chain Chain name
+     * @param prefix Comment prefix, e.g. "YAML:"
+     * @return 1-based rule positions in ascending order
+     */
+    std::vector<uint32_t> findRulesWithPrefix(const std::string& table, const std::string& chain,
+                                              const std::string& prefix) const;
+
+    /**
+     * @brief Render the snapshot in iptables-save format
+     * @param with_counters Include chain and rule counters, like iptables-save -c
+     * @return One "*table ... COMMIT" block per table, in dump order
+     */
+    std::string dump(bool with_counters) const;
+
+    // Local updates mirroring successful kernel operations
+
+    /**
+     * @brief Record a new empty user-defined chain
+     * @return false if the chain already exists
+     */
+    bool createChain(const std::string& table, const std::string& chain);
+
+    /**
+     * @brief Forget a chain and its rules
+     * @return false if the chain does not exist
+     */
+    bool deleteChain(const std::string& table, const std::string& chain);
+
+    /**
+     * @brief Remove every rule of a chain
+     * @return false if the chain does not exist
+     */
+    bool flushChain(const std::string& table, const std::string& chain);
+
+    /**
+     * @brief Record a chain policy change
+     * @return false if the chain does not exist or is user-defined
+     */
+    bool setPolicy(const std::string& table, const std::string& chain, const std::string& policy);
+
+    /**
+     * @brief Record an appended rule
+     * @param table Table name
+     * @param rule_line Rule in iptables-restore syntax, "-A CHAIN ..."
+     * @return false if the line is malformed or the chain does not exist
+     */
+    bool appendRule(const std::string& table, const std::string& rule_line);
+
+    /**
+     * @brief Record a rule inserted at a position
+     * @param table Table name
+     * @param chain Chain name
+     * @param position 1-based position the rule takes; rules from there on move down
+     * @param spec Rule text after "-I CHAIN N", in iptables-save quoting
+     * @return false if the chain does not exist or the position is past the end
+     */
+    bool insertRule(const std::string& table, const std::string& chain, uint32_t position,
+                    const std::string& spec);
+
+    /**
+     * @brief Record a rule deletion by position
+     * @param table Table name
+     * @param chain Chain name
+     * @param position 1-based rule position
+     * @return false if no such rule exists
+     */
+    bool deleteRule(const std::string& table, const std::string& chain, uint32_t position);
+
+private:
+    struct Table {
+        std::vector<SnapshotChain> chains;                 ///< Chains in declaration order
+        std::unordered_map<std::string, size_t> by_name;   ///< Chain name -> index in chains
+        /// Chain name -> comment -> 0-based rule positions, kept ascending
+        std::unordered_map<std::string, std::unordered_map<std::string, std::vector<size_t>>> by_comment;
+    };
+
+    SnapshotChain* findChain(const std::string& table, const std::string& chain);
+    const SnapshotChain* findChain(const std::string& table, const std::string& chain) const;
+    Table& ensureTable(const std::string& table);
+    void reindexChain(Table& table, const SnapshotChain& chain);
+    bool addRule(Table& table, const std::string& counters, const std::string& line);
+
+    std::vector<std::string> table_order_;
+    std::map<std::string, Table> tables_;
+};
+
+} // namespace iptables
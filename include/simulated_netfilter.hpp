@@ -0,0 +1,125 @@
+/**
+ * @file simulated_netfilter.hpp
+ * @brief In-memory stand-in for iptables, iptables-save and iptables-restore
+ * @author iptables-compose-cpp Development Team
+ * @date 2024
+ *
+ * This file contains the SimulatedNetfilter class, a CommandRunner that
+ * answers the iptables programs from an in-memory ruleset instead of the
+ * kernel. With it installed, the complete apply, plan and removal flows run
+ * without root privileges or a real netfilter, which makes process counts,
+ * operation counts and scaling behaviour measurable on any machine.
+ */
+
+#pragma once
+
+#include "command_executor.hpp"
+#include "ruleset_snapshot.hpp"
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace iptables {
+
+/**
+ * @struct SimulationStatistics
+ * @brief What a simulated run cost
+ */
+struct SimulationStatistics {
+    uint64_t processes = 0;                     ///< Programs "started"
+    std::map<std::string, uint64_t> programs;   ///< Programs started, by name
+    uint64_t operations = 0;                    ///< Chain and rule changes applied
+    uint64_t failures = 0;                      ///< Programs that exited non-zero
+    double latency_seconds = 0.0;               ///< Simulated process latency, summed over all calls
+
+    /**
+     * @brief One line summary of the statistics
+     */
+    std::string summary() const;
+};
+
+/**
+ * @class SimulatedNetfilter
+ * @brief CommandRunner that simulates iptables in memory
+ *
+ * Supported are the operations iptables-compose uses: iptables with -A,
+ * -I, -R, -D (by position or specification), -C, -N, -X, -F, -P, -L, -S,
+ * -Z and --version; iptables-save with -c and -t; and iptables-restore with
+ * --noflush, --counters and --test, committing each table atomically and
+ * reporting "line N failed" like the real program. Rules are kept in the
+ * form they were given, with comma-separated -s/-d addresses expanded to
+ * one rule each as iptables does. Jump targets must be built-in targets or
+ * existing chains, and chains can only be deleted while empty and
+ * unreferenced. Fingerprints for the state journal are hashed from the
+ * in-memory ruleset.
+ *
+ * Calls are serialised like the xtables lock serialises real iptables
+ * processes. The configurable per-call latency models process start-up and
+ * is spent outside that lock, so concurrent callers overlap as they would
+ * on a real host.
+ */
+class SimulatedNetfilter : public CommandRunner {
+public:
+    /**
+     * @brief Start from the given ruleset
+     * @param initial Ruleset the simulation starts with
+     */
+    explicit SimulatedNetfilter(RulesetSnapshot initial = defaultRuleset());
+
+    /**
+     * @brief Empty filter, nat and mangle tables with ACCEPT policies
+     */
+    static RulesetSnapshot defaultRuleset();
+
+    /**
+     * @brief Set the latency every simulated program call takes
+     * @param latency Time each call sleeps before it is handled
+     */
+    void setLatency(std::chrono::microseconds latency) { latency_ = latency; }
+
+    /**
+     * @brief Copy of the current simulated ruleset
+     */
+    RulesetSnapshot ruleset() const;
+
+    /**
+     * @brief Statistics accumulated since construction
+     */
+    SimulationStatistics statistics() const;
+
+    CommandResult run(const std::vector<std::string>& argv, const std::string& input,
+                      const ExecutionLimits& limits) override;
+
+    std::optional<uint64_t> rulesetFingerprint(const std::vector<std::string>& tables) override;
+
+    std::optional<bool> rulesetEmpty(const std::vector<std::string>& tables) override;
+
+private:
+    CommandResult runIptables(const std::vector<std::string>& args);
+    CommandResult runSave(const std::vector<std::string>& args) const;
+    CommandResult runRestore(const std::vector<std::string>& args, const std::string& input);
+
+    /**
+     * @brief Apply one iptables command to a ruleset
+     * @param state Ruleset to change
+     * @param table Table the command applies to
+     * @param args Command tokens starting with the command option, e.g. {"-A", "INPUT", ...}
+     * @param output Receives listings for -L and -S
+     * @param operations Incremented for every chain or rule change
+     * @return Error message; empty on success
+     */
+    static std::string apply(RulesetSnapshot& state, const std::string& table,
+                             const std::vector<std::string>& args, std::string& output,
+                             uint64_t& operations);
+
+    mutable std::mutex mutex_;      ///< Serialises calls like the xtables lock
+    RulesetSnapshot state_;         ///< Simulated kernel ruleset
+    SimulationStatistics statistics_;
+    std::chrono::microseconds latency_{0};
+};
+
+} // namespace iptables
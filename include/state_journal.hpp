@@ -0,0 +1,131 @@
+/**
+ * @file state_journal.hpp
+ * @brief Persistent record of the ruleset the last run left behind
+ * @author iptables-compose-cpp Development Team
+ * @date 2024
+ *
+ * This file contains the StateJournal class. After every successful run
+ * the resulting ruleset is written to a state file together with a
+ * fingerprint of the kernel tables. The next run compares the fingerprint,
+ * which is read with one getsockopt() per table instead of an
+ * iptables-save, and when nothing changed in between it works from the
+ * recorded ruleset: removal and re-apply then never list the kernel. Any
+ * outside modification changes the fingerprint, and the run falls back to
+ * reading the live ruleset.
+ */
+
+#pragma once
+
+#include "ruleset_snapshot.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace iptables {
+
+/**
+ * @struct JournalIndex
+ * @brief Metadata recorded next to the ruleset
+ */
+struct JournalIndex {
+    std::map<std::string, std::string> descriptions;  ///< Ownership tag -> readable signature
+    std::map<std::string, uint64_t> sections;         ///< Section -> RulesetCompiler::sectionDigests() value
+};
+
+/**
+ * @class StateJournal
+ * @brief Records and recalls the applied ruleset
+ *
+ * The state file holds the fingerprint followed by the ruleset in
+ * iptables-save format without counters. It is replaced atomically.
+ * Between the two sits a JournalIndex: "# tag <tag> <signature>" lines
+ * map the ownership tags the rules carry as comments back to the readable
+ * signatures they stand for, and "# section <digest> <name>" lines hold
+ * each section's content hash. iptables-save parsers skip them as
+ * comments.
+ * Fingerprints come from the legacy iptables socket options, which read
+ * the kernel's rule blobs directly; counters are left out so traffic does
+ * not change them. With the nf_tables variant of iptables, whose rules
+ * those options do not see, no fingerprint is available and every run
+ * reads the live ruleset as before. An installed CommandRunner answers
+ * fingerprints itself, so simulated runs use the journal too.
+ *
+ * All methods are static, following CommandExecutor.
+ */
+class StateJournal {
+public:
+    /// State file used unless setPath() chooses another
+    static constexpr const char* kDefaultPath = "/var/lib/iptables-compose/state";
+
+    /**
+     * @brief Choose the state file
+     * @param path State file; its directory is created when it is written
+     */
+    static void setPath(const std::filesystem::path& path);
+
+    /**
+     * @brief The state file in use
+     */
+    static const std::filesystem::path& path();
+
+    /**
+     * @brief Fingerprint the rules, chains and policies of some tables
+     * @param tables Table names
+     * @return Hash of the tables' contents, or std::nullopt if it cannot be read
+     */
+    static std::optional<uint64_t> fingerprint(const std::vector<std::string>& tables);
+
+    /**
+     * @brief Check that tables hold nothing but their built-in chains
+     * @param tables Table names; tables the kernel has not loaded count as empty
+     * @return true if there is no rule and no user-defined chain, or
+     *         std::nullopt if the tables cannot be read
+     *
+     * Reads only the entry count of each table, with the same socket
+     * options as fingerprint(). Where those are unavailable, e.g. with
+     * iptables-nft, one iptables-save listing is read instead.
+     */
+    static std::optional<bool> isEmpty(const std::vector<std::string>& tables);
+
+    /**
+     * @brief Ruleset recorded by the last run, if the kernel still matches it
+     * @return Recorded ruleset without counters, or std::nullopt if there is
+     *         none or the tables changed since it was recorded
+     */
+    static std::optional<RulesetSnapshot> recall();
+
+    /**
+     * @brief Record the ruleset a run left behind
+     * @param snapshot Ruleset now in the kernel
+     * @param index Tags and section digests of the configuration now applied
+     * @param before Fingerprint read before the snapshot was listed, if it was
+     * @return true if it was recorded, or nothing could be fingerprinted
+     *
+     * Without a fingerprint there is nothing to check a record against, so
+     * an existing state file is removed instead. So is it when the tables
+     * no longer match before: another tool changed them while they were
+     * being listed, and the snapshot may hold neither state.
+     */
+    static bool record(const RulesetSnapshot& snapshot, const JournalIndex& index = {},
+                       std::optional<uint64_t> before = std::nullopt);
+
+    /**
+     * @brief Index recorded with the last ruleset
+     * @return Recorded index; empty if there is no state file
+     *
+     * Unlike recall(), this does not check the fingerprint: a signature
+     * describes a tag whether or not the kernel changed since. Section
+     * digests only describe the kernel if recall() succeeds.
+     */
+    static JournalIndex index();
+
+    /**
+     * @brief Remove the state file, e.g. after a run that failed part way
+     */
+    static void discard();
+};
+
+} // namespace iptables
@@ -0,0 +1,97 @@
+/**
+ * @file xtables_lock.hpp
+ * @brief xtables lock contention probing and accounting
+ * @author iptables-compose-cpp Development Team
+ * @date 2024
+ *
+ * This file contains the XtablesLock class. iptables serialises every
+ * ruleset change through an flock() on /run/xtables.lock, which other
+ * firewall managers such as Docker or kube-proxy take as well. XtablesLock
+ * measures how long commands wait for that lock, separately from the time
+ * they spend working, so lock contention on busy hosts becomes visible.
+ */
+
+#pragma once
+
+#include "command_executor.hpp"
+#include <cstdint>
+#include <string>
+
+namespace iptables {
+
+/**
+ * @struct LockStatistics
+ * @brief Accumulated lock wait and work time of iptables commands
+ */
+struct LockStatistics {
+    uint64_t commands = 0;      ///< Commands run under the lock
+    uint64_t contended = 0;     ///< Commands that had to wait for the lock
+    uint64_t retries = 0;       ///< Commands re-run after exit code 4
+    double wait_seconds = 0.0;  ///< Time blocked on the lock, including retry backoff
+    double work_seconds = 0.0;  ///< Time spent running commands, summed over all workers
+
+    /**
+     * @brief One line summary, e.g. for the end of an apply
+     */
+    std::string summary() const;
+
+    /**
+     * @brief What was added to the totals after an earlier reading
+     * @param earlier Statistics read before
+     */
+    LockStatistics since(const LockStatistics& earlier) const;
+};
+
+/**
+ * @class XtablesLock
+ * @brief Probes the xtables lock and accumulates wait and work time
+ *
+ * All methods are static and thread-safe; the statistics are shared by
+ * every thread of the process.
+ */
+class XtablesLock {
+public:
+    /// Seconds passed to iptables --wait before it gives up with exit code 4
+    static constexpr int kWaitSeconds = 10;
+
+    /// Exit code iptables uses when the lock could not be obtained
+    static constexpr int kLockExitCode = 4;
+
+    /**
+     * @brief Wait until the lock is free, without keeping it
+     * @param limits Stop waiting once these expire
+     * @return Seconds spent waiting; 0 if the lock was free or does not exist
+     *
+     * The lock is probed with a shared flock(), which never delays other
+     * probes but waits for an exclusive holder. It is released immediately,
+     * so the command that follows still takes the lock itself with --wait.
+     * XTABLES_LOCKFILE overrides the lock path, as it does for iptables.
+     */
+    static double waitUntilFree(const ExecutionLimits& limits = {});
+
+    /**
+     * @brief Add one command to the statistics
+     * @param wait_seconds Time blocked on the lock
+     * @param work_seconds Time spent running the command
+     * @param retries Number of times the command was re-run
+     */
+    static void record(double wait_seconds, double work_seconds, uint64_t retries);
+
+    /**
+     * @brief Current totals
+     */
+    static LockStatistics statistics();
+
+    /**
+     * @brief Clear the totals
+     */
+    static void reset();
+
+    /**
+     * @brief Path of the lock file
+     * @return XTABLES_LOCKFILE if set, otherwise /run/xtables.lock
+     */
+    static std::string lockPath();
+};
+
+} // namespace iptables
@@ -35,6 +35,9 @@ bool ChainManager::createChain(const std::string& chain_name) {
         return false;
     }
     
+    if (snapshot_) {
+        snapshot_->createChain("filter", chain_name);
+    }
     managed_chains_.insert(chain_name);
     return true;
 }
@@ -67,6 +70,9 @@ bool ChainManager::deleteChain(const std::string& chain_name) {
         return false;
     }
     
+    if (snapshot_) {
+        snapshot_->deleteChain("filter", chain_name);
+    }
     managed_chains_.erase(chain_name);
     return true;
 }
@@ -86,6 +92,9 @@ bool ChainManager::flushChain(const std::string& chain_name) {
         return false;
     }
     
+    if (snapshot_) {
+        snapshot_->flushChain("filter", chain_name);
+    }
     return true;
 }
 
@@ -96,6 +105,11 @@ bool ChainManager::chainExists(const std::string& chain_name) {
         return false;
     }
     
+    if (snapshot_) {
+        const SnapshotChain* chain = snapshot_->chain("filter", chain_name);
+        return chain != nullptr && chain->isUserDefined();
+    }
+    
     // Use iptables -L to check if chain exists
     CommandResult result = executor_.executeIptables({"-t", "filter", "-L", "-n"});
     
@@ -135,6 +149,10 @@ std::vector<std::string> ChainManager::listChains() {
         return std::vector<std::string>(managed_chains_.begin(), managed_chains_.end());
     }
     
+    if (snapshot_) {
+        return snapshot_->chainNames("filter", true);
+    }
+    
     CommandResult result = executor_.executeIptables({"-t", "filter", "-L", "-n"});
     
     if (!result.isSuccess()) {
@@ -423,6 +441,14 @@ std::vector<std::string> ChainManager::topologicalSort(const std::map<std::strin
 
 void ChainManager::extractChainReferences(const SectionConfig& section_config, 
                                          std::set<std::string>& references) {
+    // A template section references whatever its instances do
+    if (section_config.template_config) {
+        for (size_t i = 0, count = section_config.instanceCount(); i < count; ++i) {
+            extractChainReferences(section_config.instance(i), references);
+        }
+        return;
+    }
+
     // Check interface_config for chain references
     if (section_config.interface_config && section_config.interface_config->hasChain()) {
         references.insert(*section_config.interface_config->chain);
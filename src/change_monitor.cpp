@@ -0,0 +1,208 @@
+#include "change_monitor.hpp"
+#include "command_executor.hpp"
+#include "state_journal.hpp"
+#include <cerrno>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/netlink.h>
+#include <linux/netfilter/nfnetlink.h>
+
+namespace iptables {
+
+ChangeMonitor::ChangeMonitor(std::vector<std::string> tables)
+    : tables_(std::move(tables)) {
+    // Where fingerprints work the tables are legacy ones, which never notify
+    fingerprint_ = StateJournal::fingerprint(tables_);
+    if (fingerprint_ || CommandExecutor::runner()) {
+        return;
+    }
+
+    socket_ = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_NETFILTER);
+    if (socket_ < 0) {
+        return;
+    }
+    sockaddr_nl address{};
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = 1u << (NFNLGRP_NFTABLES - 1);
+    if (bind(socket_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(socket_);
+        socket_ = -1;
+    }
+}
+
+ChangeMonitor::~ChangeMonitor() {
+    if (socket_ >= 0) {
+        close(socket_);
+    }
+    if (inotify_ >= 0) {
+        close(inotify_);
+    }
+}
+
+bool ChangeMonitor::watchFiles(const std::vector<std::filesystem::path>& files) {
+    if (inotify_ < 0) {
+        inotify_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_ < 0) {
+            return false;
+        }
+    }
+    for (const auto& [descriptor, names] : watched_) {
+        inotify_rm_watch(inotify_, descriptor);
+    }
+    watched_.clear();
+
+    // Directories are watched rather than the files, so that editors and
+    // configuration management replacing a file by rename() are noticed too
+    bool complete = true;
+    for (const auto& file : files) {
+        std::filesystem::path absolute = std::filesystem::absolute(file);
+        int descriptor = inotify_add_watch(inotify_, absolute.parent_path().c_str(),
+                                           IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE);
+        if (descriptor < 0) {
+            complete = false;
+            continue;
+        }
+        watched_[descriptor].insert(absolute.filename().string());
+        
+        // A directory, such as a fragment directory, reports changes to any file in it
+        std::error_code error;
+        if (std::filesystem::is_directory(absolute, error)) {
+            descriptor = inotify_add_watch(inotify_, absolute.c_str(),
+                                           IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE);
+            if (descriptor < 0) {
+                complete = false;
+                continue;
+            }
+            watched_[descriptor].insert("");
+        }
+    }
+    return complete;
+}
+
+// Discard pending notifications; their content does not matter, only that they came
+bool ChangeMonitor::drainTables() const {
+    char buffer[8192];
+    bool received = false;
+    for (;;) {
+        ssize_t length = recv(socket_, buffer, sizeof(buffer), 0);
+        if (length > 0) {
+            received = true;
+        } else if (length < 0 && errno == EINTR) {
+            continue;
+        } else {
+            // ENOBUFS means notifications were dropped, which is a change as well
+            return received || (length < 0 && errno == ENOBUFS);
+        }
+    }
+}
+
+// Read pending inotify events and tell whether one names a watched file
+bool ChangeMonitor::drainFiles() const {
+    alignas(inotify_event) char buffer[8192];
+    bool relevant = false;
+    for (;;) {
+        ssize_t length = read(inotify_, buffer, sizeof(buffer));
+        if (length < 0 && errno == EINTR) {
+            continue;
+        }
+        if (length <= 0) {
+            return relevant;
+        }
+        for (ssize_t offset = 0; offset < length;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            if (event->mask & IN_Q_OVERFLOW) {
+                relevant = true;
+                continue;
+            }
+            auto found = watched_.find(event->wd);
+            if (found != watched_.end() && event->len > 0 &&
+                (found->second.count("") || found->second.count(event->name))) {
+                relevant = true;
+            }
+        }
+    }
+}
+
+// Wait up to a timeout for notifications and note what changed
+bool ChangeMonitor::collect(std::chrono::milliseconds timeout, bool settling) {
+    pollfd watched[3];
+    nfds_t count = 0;
+    if (socket_ >= 0) {
+        watched[count++] = {socket_, POLLIN, 0};
+    }
+    if (inotify_ >= 0) {
+        watched[count++] = {inotify_, POLLIN, 0};
+    }
+    if (requests_ >= 0) {
+        watched[count++] = {requests_, POLLIN, 0};
+    }
+    // Signals interrupt poll(), so cancellation is noticed at once
+    int ready = poll(watched, count, static_cast<int>(timeout.count()));
+
+    bool changed = false;
+    for (nfds_t i = 0; ready > 0 && i < count; ++i) {
+        if (!(watched[i].revents & POLLIN)) {
+            continue;
+        }
+        if (watched[i].fd == socket_ && drainTables()) {
+            tables_changed_ = changed = true;
+        } else if (watched[i].fd == inotify_ && drainFiles()) {
+            files_changed_ = changed = true;
+        } else if (watched[i].fd == requests_) {
+            requests_pending_ = changed = true;
+        }
+    }
+    if (socket_ < 0) {
+        if (fingerprint_) {
+            std::optional<uint64_t> current = StateJournal::fingerprint(tables_);
+            if (current != fingerprint_) {
+                fingerprint_ = current;
+                tables_changed_ = changed = true;
+            }
+        } else if (ready == 0 && !settling) {
+            // Nothing tells when the tables change, so every interval counts as a change
+            tables_changed_ = changed = true;
+        }
+    }
+    return changed;
+}
+
+bool ChangeMonitor::waitForChange() {
+    using Clock = std::chrono::steady_clock;
+    files_changed_ = false;
+    tables_changed_ = false;
+    requests_pending_ = false;
+
+    // A bounded wait closes the gap between the cancellation check and poll()
+    std::chrono::milliseconds interval = socket_ >= 0 ? std::chrono::milliseconds(1000) : kPollInterval;
+    do {
+        if (CommandExecutor::isCancelled()) {
+            return false;
+        }
+    } while (!collect(interval, false));
+
+    // Requests are answered at once; they are not part of a burst
+    Clock::time_point limit = Clock::now() + kMaxSettleTime;
+    while (!requests_pending_ && Clock::now() < limit && !CommandExecutor::isCancelled() &&
+           collect(kSettleTime, true)) {
+    }
+    return !CommandExecutor::isCancelled();
+}
+
+void ChangeMonitor::watchTables(std::vector<std::string> tables) {
+    tables_ = std::move(tables);
+    rearm();
+}
+
+void ChangeMonitor::rearm() {
+    if (socket_ >= 0) {
+        drainTables();
+    } else {
+        fingerprint_ = StateJournal::fingerprint(tables_);
+    }
+}
+
+} // namespace iptables
@@ -1,4 +1,7 @@
 #include "cli_parser.hpp"
+#include "state_journal.hpp"
+#include "ruleset_cache.hpp"
+#include "control_socket.hpp"
 #include <iostream>
 #include <fstream>
 #include <stdexcept>
@@ -19,6 +22,24 @@ CLIParser::Options CLIParser::parse(int argc, char* argv[]) {
         {"license",      no_argument,       0, 'l'},  // Display license information
         {"help",         no_argument,       0, 'h'},  // Show usage help
         {"debug",        no_argument,       0, 'd'},  // Debug mode for testing without root
+        {"backend",      required_argument, 0, 'b'},  // Apply backend (iptables, restore, libiptc or stream)
+        {"emit-restore", required_argument, 0, 'e'},  // Write iptables-restore payload instead of applying
+        {"plan",         no_argument,       0, 'p'},  // Show the changes applying would make
+        {"timeout",      required_argument, 0, 't'},  // Deadline for the whole run in seconds
+        {"command-timeout", required_argument, 0, 'T'},  // Deadline for each command in seconds
+        {"simulate",     required_argument, 0, 'S'},  // Simulate netfilter in memory, state kept in a file
+        {"simulate-latency", required_argument, 0, 'L'},  // Latency of each simulated program call in ms
+        {"metrics-file", required_argument, 0, 'M'},  // Write run metrics for monitoring
+        {"section-chains", no_argument,     0, 'c'},  // One generated chain per section
+        {"reload",       no_argument,       0, 'R'},  // Hitless make-before-break reload
+        {"state-file",   required_argument, 0, 'J'},  // Journal of the applied ruleset
+        {"from-cache",   no_argument,       0, 'C'},  // Boot from the cached compiled ruleset
+        {"cache-file",   required_argument, 0, 'K'},  // Cached compiled ruleset
+        {"check",        no_argument,       0, 'k'},  // Exit non-zero if the managed rules drifted
+        {"watch",        no_argument,       0, 'w'},  // Repair drift whenever the tables change
+        {"daemon",       no_argument,       0, 'D'},  // Follow configuration edits and repair drift
+        {"control",      required_argument, 0, 'x'},  // Send a request to a running daemon
+        {"socket",       required_argument, 0, 's'},  // Control socket of the daemon
         {0, 0, 0, 0}  // Terminator entry required by getopt_long
     };
     
@@ -26,9 +47,9 @@ CLIParser::Options CLIParser::parse(int argc, char* argv[]) {
     int c;                 // Current option character returned by getopt_long
     
     // Parse options using getopt_long for robust argument handling
-    // The option string "rmlhd" specifies valid short options (all take no arguments)
+    // The option string "rmlhdb:e:pt:T:S:L:M:cRJ:CK:kwDx:s:" specifies valid short options (b, e, t, T, S, L, M, J, K, x and s take an argument)
     // getopt_long handles option bundling (-rh), long options (--reset), and error detection
-    while ((c = getopt_long(argc, argv, "rmlhd", long_options, &option_index)) != -1) {
+    while ((c = getopt_long(argc, argv, "rmlhdb:e:pt:T:S:L:M:cRJ:CK:kwDx:s:", long_options, &option_index)) != -1) {
         switch (c) {
             case 'r':
                 // Reset flag clears all iptables rules before applying new configuration
@@ -55,6 +76,90 @@ CLIParser::Options CLIParser::parse(int argc, char* argv[]) {
                 // Allows configuration parsing and validation without root privileges
                 options.debug = true;
                 break;
+            case 'b':
+                // Backend selects how rules reach the kernel: one iptables call per rule,
+                // a single iptables-restore transaction, in-process libiptc commits, or
+                // per-rule batches streamed to one long-lived iptables-restore --noflush
+                options.backend = optarg;
+                if (options.backend != "iptables" && options.backend != "restore" &&
+                    options.backend != "libiptc" && options.backend != "stream") {
+                    throw std::invalid_argument("Unknown backend: " + options.backend);
+                }
+                break;
+            case 'e':
+                // Emit restore compiles the configuration into an iptables-restore payload
+                // without touching the kernel, so it requires no special privileges
+                options.emit_restore = std::string(optarg);
+                break;
+            case 'p':
+                // Plan compares the configuration with the live ruleset and prints
+                // the minimal changes without executing any of them
+                options.plan = true;
+                break;
+            case 't':
+                // Timeout bounds the whole run, e.g. below systemd's TimeoutStartSec;
+                // commands still running when it expires are killed
+                options.timeout = parseNumber("--timeout", optarg, 86400);
+                break;
+            case 'T':
+                // Command timeout bounds each iptables invocation, so one hung
+                // command cannot stall everything behind it
+                options.command_timeout = parseNumber("--command-timeout", optarg, 86400);
+                break;
+            case 'S':
+                // Simulate runs every iptables program against an in-memory ruleset that is
+                // loaded from and saved back to the given iptables-save file, without root
+                options.simulate = std::filesystem::path(optarg);
+                break;
+            case 'L':
+                // Simulated latency makes process counts show up as wall-clock time
+                options.simulate_latency_ms = parseNumber("--simulate-latency", optarg, 60000);
+                break;
+            case 'M':
+                // Metrics file receives phase timings, process counts and lock wait time
+                // at the end of the run; ".json" selects JSON, anything else Prometheus text
+                options.metrics_file = std::filesystem::path(optarg);
+                break;
+            case 'c':
+                // Section chains give every section its own chain behind a single jump,
+                // so replacing or removing a section never scans the built-in chains
+                options.section_chains = true;
+                break;
+            case 'R':
+                // A reload builds the new ruleset beside the old one and switches
+                // each table over atomically, so filtering never has a gap
+                options.reload = true;
+                break;
+            case 'J':
+                // The journal lets the next run skip listing the kernel when nothing changed
+                options.state_file = std::filesystem::path(optarg);
+                break;
+            case 'C':
+                // At boot the cached payload goes in with one iptables-restore, unparsed
+                options.from_cache = true;
+                break;
+            case 'K':
+                options.cache_file = std::filesystem::path(optarg);
+                break;
+            case 'k':
+                // Read-only, for monitoring: the exit code tells whether anything drifted
+                options.check = true;
+                break;
+            case 'w':
+                // Stays running and repairs the managed rules whenever another tool changes the tables
+                options.watch = true;
+                break;
+            case 'D':
+                // Keeps the compiled configuration and the live ruleset in memory between applies
+                options.daemon = true;
+                break;
+            case 'x':
+                // A request to a running daemon costs no system probes and no listing
+                options.control = std::string(optarg);
+                break;
+            case 's':
+                options.socket = std::filesystem::path(optarg);
+                break;
             case '?':
                 // getopt_long returns '?' for unrecognized options
                 // Error message is already printed by getopt_long to stderr
@@ -107,13 +212,100 @@ void CLIParser::validateOptions(const Options& options) {
         throw std::invalid_argument("--reset requires a config file");
     }
     
+    // Emitting a payload compiles a configuration and never modifies iptables
+    if (options.emit_restore && !options.config_file.has_value()) {
+        throw std::invalid_argument("--emit-restore requires a config file");
+    }
+    if (options.emit_restore && (options.reset || options.remove_rules)) {
+        throw std::invalid_argument("--emit-restore conflicts with --reset and --remove-rules");
+    }
+    
+    // A plan describes applying a configuration on top of the live ruleset
+    if (options.plan && !options.config_file.has_value()) {
+        throw std::invalid_argument("--plan requires a config file");
+    }
+    if (options.plan && (options.reset || options.remove_rules || options.emit_restore)) {
+        throw std::invalid_argument("--plan conflicts with --reset, --remove-rules and --emit-restore");
+    }
+    
+    // The layout only affects how a configuration is compiled
+    if (options.section_chains && !options.config_file.has_value()) {
+        throw std::invalid_argument("--section-chains requires a config file");
+    }
+    
+    // A reload replaces what is applied with a configuration, in its own way
+    if (options.reload && !options.config_file.has_value()) {
+        throw std::invalid_argument("--reload requires a config file");
+    }
+    if (options.reload && (options.reset || options.remove_rules || options.emit_restore || options.plan)) {
+        throw std::invalid_argument("--reload conflicts with --reset, --remove-rules, --emit-restore and --plan");
+    }
+    
+    // The cache holds what a configuration compiles to and is only used to apply it
+    if (options.from_cache && !options.config_file.has_value()) {
+        throw std::invalid_argument("--from-cache requires a config file");
+    }
+    if (options.from_cache && (options.reset || options.remove_rules || options.emit_restore || options.plan ||
+                               options.reload)) {
+        throw std::invalid_argument("--from-cache conflicts with --reset, --remove-rules, --emit-restore, --plan and --reload");
+    }
+    
+    // Checking, watching and the daemon compare the kernel with a configuration and do nothing else
+    bool follows = options.check || options.watch || options.daemon;
+    if (follows && !options.config_file.has_value()) {
+        throw std::invalid_argument("--check, --watch and --daemon require a config file");
+    }
+    if (follows && (options.reset || options.remove_rules || options.emit_restore || options.plan ||
+                    options.reload || options.from_cache)) {
+        throw std::invalid_argument("--check, --watch and --daemon conflict with --reset, --remove-rules, "
+                                    "--emit-restore, --plan, --reload and --from-cache");
+    }
+    if (options.check + options.watch + options.daemon > 1) {
+        throw std::invalid_argument("--check, --watch and --daemon conflict with each other");
+    }
+    if ((options.watch || options.daemon) && options.timeout) {
+        throw std::invalid_argument("--watch and --daemon run until stopped and conflict with --timeout");
+    }
+    
+    // A control request is all a client run does
+    if (options.control && (options.config_file || options.reset || options.remove_rules || options.emit_restore ||
+                            options.plan || options.reload || options.from_cache || follows)) {
+        throw std::invalid_argument("--control takes no config file and conflicts with every other mode");
+    }
+    if (options.socket && !options.daemon && !options.control) {
+        throw std::invalid_argument("--socket requires --daemon or --control");
+    }
+    
+    // Latency only exists inside the simulation
+    if (options.simulate_latency_ms > 0 && !options.simulate) {
+        throw std::invalid_argument("--simulate-latency requires --simulate");
+    }
+    if (options.simulate && options.backend == "libiptc") {
+        throw std::invalid_argument("--simulate does not support the libiptc backend");
+    }
+    
     // Ensure at least one action is specified
     // Help request is handled separately and doesn't require other options
-    if (!options.config_file.has_value() && !options.remove_rules && !options.show_license && !options.help) {
+    if (!options.config_file.has_value() && !options.remove_rules && !options.show_license && !options.help &&
+        !options.control) {
         throw std::invalid_argument("No action specified");
     }
 }
 
+unsigned CLIParser::parseNumber(const std::string& option, const std::string& value, unsigned maximum) {
+    size_t end = 0;
+    unsigned long number = 0;
+    try {
+        number = std::stoul(value, &end);
+    } catch (const std::exception&) {
+        end = 0;
+    }
+    if (end == 0 || end != value.size() || value[0] == '-' || number > maximum) {
+        throw std::invalid_argument(option + " expects a number from 0 to " + std::to_string(maximum) + ": " + value);
+    }
+    return static_cast<unsigned>(number);
+}
+
 void CLIParser::printUsage(const std::string& program_name) {
     // Display comprehensive usage information including all options and examples
     // Format follows standard Unix command line tool conventions
@@ -127,11 +319,52 @@ void CLIParser::printUsage(const std::string& program_name) {
     std::cout << "  -m, --remove-rules Remove rules with YAML comments\n";
     std::cout << "  -l, --license      Print license information\n";
     std::cout << "  -h, --help         Show this help message\n";
-    std::cout << "  -d, --debug        Debug mode (bypass system validation)\n\n";
+    std::cout << "  -d, --debug        Debug mode (bypass system validation)\n";
+    std::cout << "  -b, --backend B    Apply backend: iptables (default), restore, libiptc or stream\n";
+    std::cout << "  -e, --emit-restore FILE\n";
+    std::cout << "                     Write iptables-restore payload to FILE ('-' for stdout)\n";
+    std::cout << "  -p, --plan         Show the changes applying CONFIG_FILE would make\n";
+    std::cout << "  -c, --section-chains\n";
+    std::cout << "                     Put each section's rules in a chain of its own\n";
+    std::cout << "  -R, --reload       Switch to CONFIG_FILE without a gap in filtering\n";
+    std::cout << "  -t, --timeout SEC  Give up after SEC seconds, killing running commands\n";
+    std::cout << "  -T, --command-timeout SEC\n";
+    std::cout << "                     Kill a single command after SEC seconds (default 30, 0 = never)\n";
+    std::cout << "  -S, --simulate FILE\n";
+    std::cout << "                     Run against an in-memory netfilter stored in FILE (no root needed)\n";
+    std::cout << "  -L, --simulate-latency MS\n";
+    std::cout << "                     Delay every simulated iptables call by MS milliseconds\n";
+    std::cout << "  -M, --metrics-file FILE\n";
+    std::cout << "                     Write run metrics to FILE (.json, otherwise Prometheus text)\n";
+    std::cout << "  -J, --state-file FILE\n";
+    std::cout << "                     Journal the applied ruleset in FILE (default " << StateJournal::kDefaultPath << ")\n";
+    std::cout << "  -C, --from-cache   Restore the cached ruleset of CONFIG_FILE into empty tables, e.g. at boot\n";
+    std::cout << "  -k, --check        Exit with status 2 if the managed rules differ from CONFIG_FILE;\n";
+    std::cout << "                     writes nothing, unless --state-file is given: then a check\n";
+    std::cout << "                     without drift journals the listing for the next run\n";
+    std::cout << "  -w, --watch        Stay running and repair drift whenever the tables change\n";
+    std::cout << "  -D, --daemon       Like --watch, and reapply CONFIG_FILE whenever it is edited\n";
+    std::cout << "  -x, --control REQUEST\n";
+    std::cout << "                     Send REQUEST to a running daemon: status, plan, query [SECTION...],\n";
+    std::cout << "                     apply-config, apply-section (sections read from stdin) or\n";
+    std::cout << "                     remove-section SECTION...\n";
+    std::cout << "  -s, --socket FILE  Control socket of the daemon (default " << ControlServer::kDefaultPath << ")\n";
+    std::cout << "  -K, --cache-file FILE\n";
+    std::cout << "                     Cache compiled rulesets in FILE (default " << RulesetCache::kDefaultPath << ")\n\n";
     std::cout << "Examples:\n";
     // Provide practical examples showing common usage patterns
     std::cout << "  " << program_name << " config.yaml              Apply configuration\n";
     std::cout << "  " << program_name << " --reset config.yaml      Reset rules then apply config\n";
+    std::cout << "  " << program_name << " --backend restore config.yaml  Apply in one transaction\n";
+    std::cout << "  " << program_name << " --emit-restore - config.yaml   Print restore payload\n";
+    std::cout << "  " << program_name << " --plan config.yaml       Preview changes\n";
+    std::cout << "  " << program_name << " --reload config.yaml     Hitless reload\n";
+    std::cout << "  " << program_name << " --from-cache config.yaml Apply at boot\n";
+    std::cout << "  " << program_name << " --check config.yaml      Detect drift\n";
+    std::cout << "  " << program_name << " --control status         Ask a running daemon\n";
+    std::cout << "  " << program_name << " --timeout 25 config.yaml Apply within 25 seconds\n";
+    std::cout << "  " << program_name << " --simulate state.rules config.yaml  Apply without a kernel\n";
+    std::cout << "  " << program_name << " --metrics-file run.prom config.yaml  Apply and export metrics\n";
     std::cout << "  " << program_name << " --remove-rules           Remove all YAML rules\n";
     std::cout << "  " << program_name << " --license                Show license information\n";
 }
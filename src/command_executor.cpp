@@ -1,16 +1,45 @@
 #include "command_executor.hpp"
+#include "metrics.hpp"
+#include "process_runner.hpp"
+#include "xtables_lock.hpp"
+#include <algorithm>
 #include <iostream>
 #include <sstream>
-#include <cstdlib>
-#include <array>
-#include <memory>
 #include <chrono>
 #include <iomanip>
+#include <mutex>
+#include <random>
+#include <thread>
 
 namespace iptables {
 
-// Initialize static member
+// Initialize static members
 LogLevel CommandExecutor::current_log_level_ = LogLevel::Info;
+std::chrono::milliseconds CommandExecutor::command_timeout_ = CommandExecutor::kDefaultCommandTimeout;
+ExecutionLimits::Clock::time_point CommandExecutor::deadline_ = ExecutionLimits::Clock::time_point::max();
+std::atomic<bool> CommandExecutor::cancelled_{false};
+CommandRunner* CommandExecutor::runner_ = nullptr;
+
+namespace {
+
+// Serialises log lines written by concurrent table workers
+std::mutex g_log_mutex;
+
+// Attempts made when iptables reports that the xtables lock is held
+constexpr int kLockAttempts = 5;
+
+// Backoff before the first retry; doubles on every further attempt
+constexpr double kLockBackoffSeconds = 0.1;
+
+// Jittered exponential backoff, so workers that lost the lock together
+// do not all come back at the same moment
+double lockBackoff(int attempt) {
+    thread_local std::mt19937 generator{std::random_device{}()};
+    std::uniform_real_distribution<double> jitter(0.5, 1.5);
+    return kLockBackoffSeconds * static_cast<double>(1 << attempt) * jitter(generator);
+}
+
+} // namespace
 
 CommandResult CommandExecutor::execute(const std::vector<std::string>& args) {
     if (args.empty()) {
@@ -22,94 +51,54 @@ CommandResult CommandExecutor::execute(const std::vector<std::string>& args) {
         return result;
     }
     
-    std::string command = argsToCommand(args);
-    return executeInternal(command);
+    return executeInternal(args);
 }
 
 CommandResult CommandExecutor::execute(const std::string& command) {
-    // Log the command execution at INFO level for audit trails and debugging
-    // This provides visibility into all iptables operations performed by the application
-    log(LogLevel::Info, "Executing command: " + command);
-    
-    try {
-        // Use popen() to execute the command and capture both stdout and stderr
-        // The "2>&1" redirection combines stderr into stdout for unified output capture
-        // This ensures we capture all command output regardless of which stream it uses
-        std::unique_ptr<FILE, decltype(&pclose)> pipe(popen((command + " 2>&1").c_str(), "r"), pclose);
-        
-        if (!pipe) {
-            // popen() failed - typically due to resource exhaustion or invalid command
-            // This is a system-level failure rather than a command execution failure
-            std::string error = "Failed to execute command: " + command;
-            log(LogLevel::Error, error);
-            
-            CommandResult result;
-            result.success = false;
-            result.exit_code = 1;
-            result.stderr_output = error;
-            result.command = command;
-            return result;
-        }
-        
-        // Read command output in chunks using a fixed-size buffer
-        // This approach handles arbitrary output sizes while controlling memory usage
-        // The buffer size balances memory efficiency with read operation overhead
-        std::array<char, 4096> buffer;
-        std::string output;
-        
-        // Read all available output from the command
-        // fgets() returns nullptr when EOF is reached or an error occurs
-        while (fgets(buffer.data(), buffer.size(), pipe.get()) != nullptr) {
-            output += buffer.data();
-        }
-        
-        // Close the pipe and retrieve the command exit status
-        // pclose() returns the exit status of the executed command
-        // This status indicates whether the command succeeded or failed
-        int exitStatus = pclose(pipe.release());
-        
-        // Extract the actual exit code from the pclose() return value
-        // pclose() returns a status value that needs to be processed with WEXITSTATUS
-        // On Unix systems, the exit status is encoded in the high byte
-        int exitCode = WEXITSTATUS(exitStatus);
-        
-        // Log the command completion with exit status for debugging and auditing
-        // Include timing information and output length for performance analysis
-        std::string resultLog = "Command completed with exit code " + std::to_string(exitCode);
-        if (!output.empty()) {
-            resultLog += " (output: " + std::to_string(output.length()) + " bytes)";
-        }
-        log(exitCode == 0 ? LogLevel::Debug : LogLevel::Error, resultLog);
-        
-        // Return structured result with exit code and captured output
-        // The caller can use CommandResult methods to check success and extract information
-        CommandResult result;
-        result.success = (exitCode == 0);
-        result.exit_code = exitCode;
-        result.stdout_output = output;
-        result.stderr_output = "";
-        result.command = command;
-        return result;
-        
-    } catch (const std::exception& e) {
-        // Handle any unexpected exceptions during command execution
-        // This provides a consistent error handling interface for system failures
-        std::string error = "Exception during command execution: " + std::string(e.what());
-        log(LogLevel::Error, error);
-        
-        CommandResult result;
-        result.success = false;
-        result.exit_code = -1;
-        result.stderr_output = error;
-        result.command = command;
-        return result;
+    // Shell command lines are the only case that still needs /bin/sh; argument
+    // vectors should be passed to execute(const std::vector<std::string>&) instead
+    return executeInternal({"/bin/sh", "-c", command});
+}
+
+void CommandExecutor::setCommandTimeout(std::chrono::milliseconds timeout) {
+    command_timeout_ = timeout;
+}
+
+void CommandExecutor::setDeadline(ExecutionLimits::Clock::time_point deadline) {
+    deadline_ = deadline;
+}
+
+void CommandExecutor::cancelAll() {
+    cancelled_.store(true);
+}
+
+bool CommandExecutor::isCancelled() {
+    return cancelled_.load();
+}
+
+void CommandExecutor::setRunner(CommandRunner* runner) {
+    runner_ = runner;
+}
+
+CommandRunner* CommandExecutor::runner() {
+    return runner_;
+}
+
+ExecutionLimits CommandExecutor::currentLimits() {
+    ExecutionLimits limits;
+    limits.cancelled = &cancelled_;
+    limits.deadline = deadline_;
+    if (command_timeout_.count() > 0) {
+        limits.deadline = std::min(limits.deadline, ExecutionLimits::Clock::now() + command_timeout_);
     }
+    return limits;
 }
 
 CommandResult CommandExecutor::executeIptables(const std::string& table, 
                                               const std::string& chain,
                                               const std::vector<std::string>& args) {
-    std::vector<std::string> full_args = {"iptables", "-t", table};
+    std::vector<std::string> full_args = {"iptables", "-w", std::to_string(XtablesLock::kWaitSeconds),
+                                          "-t", table};
     
     if (!chain.empty()) {
         // Add chain specification if provided
@@ -144,13 +133,13 @@ CommandResult CommandExecutor::executeIptables(const std::string& table,
         full_args.insert(full_args.end(), args.begin(), args.end());
     }
     
-    return execute(full_args);
+    return executeLocked(full_args);
 }
 
 CommandResult CommandExecutor::executeIptables(const std::vector<std::string>& args) {
-    std::vector<std::string> full_args = {"iptables"};
+    std::vector<std::string> full_args = {"iptables", "-w", std::to_string(XtablesLock::kWaitSeconds)};
     full_args.insert(full_args.end(), args.begin(), args.end());
-    return execute(full_args);
+    return executeLocked(full_args);
 }
 
 CommandResult CommandExecutor::listRules(const std::string& table, const std::string& chain) {
@@ -201,6 +190,25 @@ CommandResult CommandExecutor::flushChain(const std::string& table, const std::s
     return executeIptables(args);
 }
 
+CommandResult CommandExecutor::saveRuleset() {
+    return execute(std::vector<std::string>{"iptables-save", "-c"});
+}
+
+CommandResult CommandExecutor::executeRestore(const std::string& payload,
+                                              const std::vector<std::string>& options) {
+    std::vector<std::string> args = {"iptables-restore", restoreWaitOption()};
+    args.insert(args.end(), options.begin(), options.end());
+    
+    // The payload is streamed over stdin, so it never touches the filesystem
+    log(LogLevel::Debug, "Restore payload: " + std::to_string(payload.size()) + " bytes");
+    return executeLocked(args, payload);
+}
+
+std::string CommandExecutor::restoreWaitOption() {
+    // iptables-restore only accepts the wait time attached to the option
+    return "--wait=" + std::to_string(XtablesLock::kWaitSeconds);
+}
+
 void CommandExecutor::setLogLevel(LogLevel level) {
     // Update the global logging level for all CommandExecutor operations
     // This allows dynamic control of logging verbosity based on user preferences or debugging needs
@@ -219,80 +227,71 @@ LogLevel CommandExecutor::getLogLevel() {
 }
 
 bool CommandExecutor::isIptablesAvailable() {
-    // Check if iptables command is available in the system PATH
+    // Check if iptables command can be started from the system PATH
     // This is a basic availability check that doesn't verify permissions
-    CommandResult result = execute("which iptables");
+    CommandResult result = execute(std::vector<std::string>{"iptables", "--version"});
     return result.isSuccess();
 }
 
-CommandResult CommandExecutor::executeInternal(const std::string& command, bool capture_output) {
+CommandResult CommandExecutor::executeLocked(const std::vector<std::string>& args, const std::string& input) {
+    double wait_seconds = 0.0;
+    double work_seconds = 0.0;
+    uint64_t retries = 0;
     CommandResult result;
-    result.command = command;
-    
-    log(LogLevel::Debug, "Executing command: " + command);
-    
-    if (!capture_output) {
-        // Simple execution without output capture
-        int exit_code = std::system(command.c_str());
-        result.exit_code = WEXITSTATUS(exit_code);
-        result.success = (result.exit_code == 0);
-        
-        log(LogLevel::Debug, "Command completed with exit code: " + std::to_string(result.exit_code));
-        return result;
-    }
-    
-    // Execute command with output capture
-    std::string stdout_cmd = command + " 2>/tmp/cmd_stderr_$$ && echo \"__EXIT_CODE_0__\" || echo \"__EXIT_CODE_$?__\"";
-    
-    std::array<char, 128> buffer;
-    std::string stdout_result;
-    
-    std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(stdout_cmd.c_str(), "r"), pclose);
-    if (!pipe) {
-        result.success = false;
-        result.exit_code = -1;
-        result.stderr_output = "Failed to execute command";
-        log(LogLevel::Error, "Failed to create pipe for command: " + command);
-        return result;
-    }
-    
-    // Read stdout
-    while (fgets(buffer.data(), buffer.size(), pipe.get()) != nullptr) {
-        stdout_result += buffer.data();
-    }
-    
-    // Extract exit code from stdout
-    if (stdout_result.find("__EXIT_CODE_0__") != std::string::npos) {
-        result.exit_code = 0;
-        stdout_result = stdout_result.substr(0, stdout_result.find("__EXIT_CODE_0__"));
-    } else if (stdout_result.find("__EXIT_CODE_") != std::string::npos) {
-        size_t pos = stdout_result.find("__EXIT_CODE_") + 12;
-        size_t end_pos = stdout_result.find("__", pos);
-        if (end_pos != std::string::npos) {
-            std::string exit_code_str = stdout_result.substr(pos, end_pos - pos);
-            try {
-                result.exit_code = std::stoi(exit_code_str);
-            } catch (...) {
-                result.exit_code = -1;
-            }
+
+    for (int attempt = 0;; ++attempt) {
+        wait_seconds += XtablesLock::waitUntilFree(currentLimits());
+
+        auto start = std::chrono::steady_clock::now();
+        result = executeInternal(args, input);
+        work_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (result.exit_code != XtablesLock::kLockExitCode || attempt + 1 >= kLockAttempts) {
+            break;
         }
-        stdout_result = stdout_result.substr(0, stdout_result.find("__EXIT_CODE_"));
+
+        // Exit code 4 means --wait expired while another process held the lock;
+        // a retry that could not finish before the deadline is not worth starting
+        double backoff = lockBackoff(attempt);
+        ExecutionLimits limits = currentLimits();
+        if (limits.expired() ||
+            ExecutionLimits::Clock::now() + std::chrono::duration<double>(backoff) >= deadline_) {
+            break;
+        }
+        log(LogLevel::Warning, "xtables lock busy, retrying in " +
+                               std::to_string(static_cast<int>(backoff * 1000)) + " ms");
+        std::this_thread::sleep_for(std::chrono::duration<double>(backoff));
+        wait_seconds += backoff;
+        ++retries;
     }
+
+    XtablesLock::record(wait_seconds, work_seconds, retries);
+    return result;
+}
+
+CommandResult CommandExecutor::executeInternal(const std::vector<std::string>& args, const std::string& input) {
+    std::string command = argsToCommand(args);
     
-    result.stdout_output = stdout_result;
-    
-    // Read stderr from temporary file
-    std::string stderr_cmd = "cat /tmp/cmd_stderr_$$ 2>/dev/null && rm -f /tmp/cmd_stderr_$$";
-    std::unique_ptr<FILE, decltype(&pclose)> stderr_pipe(popen(stderr_cmd.c_str(), "r"), pclose);
-    if (stderr_pipe) {
-        std::string stderr_result;
-        while (fgets(buffer.data(), buffer.size(), stderr_pipe.get()) != nullptr) {
-            stderr_result += buffer.data();
-        }
-        result.stderr_output = stderr_result;
+    ExecutionLimits limits = currentLimits();
+    if (limits.expired()) {
+        CommandResult result;
+        result.command = command;
+        result.timed_out = true;
+        result.stderr_output = isCancelled() ? "Cancelled before start" : "Deadline passed before start";
+        log(LogLevel::Error, "Not starting " + command + ": " + result.stderr_output);
+        Metrics::recordCommand(args, input, result, 0.0, false);
+        return result;
     }
+    log(LogLevel::Debug, "Executing command: " + command);
     
-    result.success = (result.exit_code == 0);
+    // The program is spawned directly from the argument vector; the quoted
+    // command string is kept only for logs and error messages
+    auto start = std::chrono::steady_clock::now();
+    CommandResult result = runner_ ? runner_->run(args, input, limits)
+                                   : ProcessRunner::run(args, input, limits);
+    result.command = command;
+    Metrics::recordCommand(args, input, result,
+                           std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
     
     // Remove trailing newlines
     if (!result.stdout_output.empty() && result.stdout_output.back() == '\n') {
@@ -355,6 +354,7 @@ void CommandExecutor::log(LogLevel level, const std::string& message) {
             return; // Don't log anything
     }
     
+    std::lock_guard<std::mutex> lock(g_log_mutex);
     *output_stream << "[" << timestamp.str() << "] [" << level_str << "] CommandExecutor: " 
                    << message << std::endl;
 }
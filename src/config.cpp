@@ -1,11 +1,157 @@
 #include "config.hpp"
-#include "chain_rule.hpp"
-#include <regex>
 #include <sstream>
 #include <algorithm>
+#include <stdexcept>
 
 namespace iptables {
 
+namespace {
+
+// Values of the variables in one instance of a template section
+class Bindings {
+public:
+    Bindings(const TemplateConfig& config, size_t index) : config_(config) {
+        for (const auto& variable : config.vars) {
+            if (variable.name.empty()) {
+                throw std::invalid_argument("Template variables need a name");
+            }
+        }
+        // The last for_each variable varies fastest, as the innermost of nested loops
+        current_.resize(config.for_each.size());
+        for (size_t i = config.for_each.size(); i-- > 0;) {
+            const auto& values = loopValues(config, config.for_each[i]);
+            if (find(config.vars, config.for_each[i].name)) {
+                throw std::invalid_argument("Variable '" + config.for_each[i].name +
+                                            "' is defined in both vars and for_each");
+            }
+            if (!values.empty()) {
+                current_[i] = &values[index % values.size()];
+                index /= values.size();
+            }
+        }
+    }
+
+    // Values a for_each variable takes: its own list, or the list variable it names
+    static const std::vector<std::string>& loopValues(const TemplateConfig& config, const TemplateVariable& loop) {
+        if (loop.list) {
+            return loop.values;
+        }
+        const TemplateVariable* named = find(config.vars, loop.values.front());
+        if (!named || !named->list) {
+            throw std::invalid_argument("for_each '" + loop.name + "' must be a list or name a list variable, not '" +
+                                        loop.values.front() + "'");
+        }
+        return named->values;
+    }
+
+    // Value of ${name} inside a string
+    const std::string& scalar(const std::string& name) const {
+        for (size_t i = 0; i < config_.for_each.size(); ++i) {
+            if (config_.for_each[i].name == name) {
+                return *current_[i];
+            }
+        }
+        const TemplateVariable* variable = find(config_.vars, name);
+        if (!variable) {
+            throw std::invalid_argument("Undefined variable '" + name + "'");
+        }
+        if (variable->list) {
+            throw std::invalid_argument("List variable '" + name +
+                                        "' can only be used as a whole element of a subnet or range list");
+        }
+        return variable->values.front();
+    }
+
+    // Values of a list variable when text is nothing but a reference to one
+    const std::vector<std::string>* list(const std::string& text) const {
+        if (text.size() < 4 || text.compare(0, 2, "${") != 0 || text.back() != '}') {
+            return nullptr;
+        }
+        const TemplateVariable* variable = find(config_.vars, text.substr(2, text.size() - 3));
+        return variable && variable->list ? &variable->values : nullptr;
+    }
+
+    // Text with every ${name} replaced
+    std::string substitute(const std::string& text) const {
+        size_t start = text.find("${");
+        if (start == std::string::npos) {
+            return text;
+        }
+        std::string result;
+        size_t position = 0;
+        for (; start != std::string::npos; start = text.find("${", position)) {
+            size_t end = text.find('}', start);
+            if (end == std::string::npos) {
+                throw std::invalid_argument("Unterminated variable reference in '" + text + "'");
+            }
+            result.append(text, position, start - position);
+            result += scalar(text.substr(start + 2, end - start - 2));
+            position = end + 1;
+        }
+        result.append(text, position, std::string::npos);
+        return result;
+    }
+
+    void expand(std::optional<std::string>& text) const {
+        if (text) {
+            *text = substitute(*text);
+        }
+    }
+
+    void expand(std::optional<InterfaceConfig>& interface) const {
+        if (interface) {
+            expand(interface->input);
+            expand(interface->output);
+            expand(interface->chain);
+        }
+    }
+
+    // Subnets, ranges and MAC addresses are parsed again once their text is complete
+    template <typename T>
+    void expand(T& value) const {
+        if (value.text.find("${") != std::string::npos) {
+            value = T::parse(substitute(value.text));
+        }
+    }
+
+    template <typename T>
+    void expand(std::optional<std::vector<T>>& values) const {
+        if (!values || std::none_of(values->begin(), values->end(), [](const T& value) {
+                return value.text.find("${") != std::string::npos;
+            })) {
+            return;
+        }
+        std::vector<T> expanded;
+        expanded.reserve(values->size());
+        for (const T& value : *values) {
+            if (const std::vector<std::string>* items = list(value.text)) {
+                for (const std::string& item : *items) {
+                    expanded.push_back(T::parse(item));
+                }
+            } else {
+                expanded.push_back(value);
+                expand(expanded.back());
+            }
+        }
+        *values = std::move(expanded);
+    }
+
+private:
+    static const TemplateVariable* find(const std::vector<TemplateVariable>& variables, const std::string& name) {
+        for (const auto& variable : variables) {
+            if (variable.name == name) {
+                return &variable;
+            }
+        }
+        return nullptr;
+    }
+
+    const TemplateConfig& config_;
+    std::vector<const std::string*> current_;  // value of each for_each variable
+};
+
+} // namespace
+
 // PortConfig implementation
 bool PortConfig::isValid() const {
     // Exactly one of port or range must be specified
@@ -33,8 +179,8 @@ bool PortConfig::isValid() const {
     
     // Validate port ranges
     if (range.has_value()) {
-        for (const auto& range_str : *range) {
-            if (!isValidPortRange(range_str)) {
+        for (const auto& port_range : *range) {
+            if (!port_range.valid) {
                 return false;
             }
         }
@@ -68,9 +214,9 @@ std::string PortConfig::getErrorMessage() const {
         return "Port must be between 1-65535";
     }
     if (range.has_value()) {
-        for (const auto& range_str : *range) {
-            if (!isValidPortRange(range_str)) {
-                return "Invalid port range format: " + range_str + " (expected format: 'start-end', e.g., '1000-2000')";
+        for (const auto& port_range : *range) {
+            if (!port_range.valid) {
+                return "Invalid port range format: " + port_range.text + " (expected format: 'start-end', e.g., '1000-2000')";
             }
         }
     }
@@ -80,33 +226,9 @@ std::string PortConfig::getErrorMessage() const {
     return "";
 }
 
-// Helper function to validate port range format
-bool PortConfig::isValidPortRange(const std::string& range_str) const {
-    size_t dash_pos = range_str.find('-');
-    if (dash_pos == std::string::npos) {
-        return false;
-    }
-    
-    try {
-        uint16_t start = std::stoul(range_str.substr(0, dash_pos));
-        uint16_t end = std::stoul(range_str.substr(dash_pos + 1));
-        
-        if (start < 1 || start > 65535 || end < 1 || end > 65535) {
-            return false;
-        }
-        if (start >= end) {
-            return false;
-        }
-        
-        return true;
-    } catch (const std::exception&) {
-        return false;
-    }
-}
-
 // MacConfig implementation
 bool MacConfig::isValid() const {
-    if (mac_source.empty()) return false;
+    if (mac_source.text.empty()) return false;
     
     // ✨ NEW: Validate chain vs. action mutual exclusivity
     // If chain is specified, it's mutually exclusive with allow=false
@@ -114,12 +236,11 @@ bool MacConfig::isValid() const {
         return false; // Cannot have both chain target and allow=false (drop/reject action)
     }
     
-    std::regex mac_regex("^([0-9A-Fa-f]{2}[:-]){5}([0-9A-Fa-f]{2})$");
-    return std::regex_match(mac_source, mac_regex);
+    return mac_source.valid;
 }
 
 std::string MacConfig::getErrorMessage() const {
-    if (mac_source.empty()) {
+    if (mac_source.text.empty()) {
         return "MAC source cannot be empty";
     }
     
@@ -224,6 +345,9 @@ std::string FilterConfig::getErrorMessage() const {
 
 // SectionConfig implementation
 bool SectionConfig::isValid() const {
+    if (template_config) {
+        return getErrorMessage().empty();
+    }
     if (ports) {
         for (const auto& port : *ports) {
             if (!port.isValid()) {
@@ -260,6 +384,21 @@ bool SectionConfig::isValid() const {
 }
 
 std::string SectionConfig::getErrorMessage() const {
+    if (template_config) {
+        // Every instance is checked, one at a time, as the compiler will build it
+        try {
+            size_t count = instanceCount();
+            for (size_t i = 0; i < count; ++i) {
+                std::string error = instance(i).getErrorMessage();
+                if (!error.empty()) {
+                    return "Instance " + instanceName("", i) + ": " + error;
+                }
+            }
+        } catch (const std::invalid_argument& e) {
+            return e.what();
+        }
+        return "";
+    }
     if (ports) {
         for (const auto& port : *ports) {
             std::string error = port.getErrorMessage();
@@ -298,6 +437,64 @@ std::string SectionConfig::getErrorMessage() const {
     return "";
 }
 
+size_t SectionConfig::instanceCount() const {
+    size_t count = 1;
+    if (template_config) {
+        for (const auto& loop : template_config->for_each) {
+            count *= Bindings::loopValues(*template_config, loop).size();
+        }
+    }
+    return count;
+}
+
+SectionConfig SectionConfig::instance(size_t index) const {
+    if (!template_config) {
+        return *this;
+    }
+    Bindings bindings(*template_config, index);
+    SectionConfig result = *this;
+    result.template_config.reset();
+    if (result.ports) {
+        for (auto& port : *result.ports) {
+            bindings.expand(port.range);
+            bindings.expand(port.subnet);
+            bindings.expand(port.interface);
+            if (port.mac_source) {
+                bindings.expand(*port.mac_source);
+            }
+            bindings.expand(port.chain);
+        }
+    }
+    if (result.mac) {
+        for (auto& mac : *result.mac) {
+            bindings.expand(mac.mac_source);
+            bindings.expand(mac.subnet);
+            bindings.expand(mac.interface);
+            bindings.expand(mac.chain);
+        }
+    }
+    if (result.interface) {
+        for (auto& interface : *result.interface) {
+            bindings.expand(interface.input);
+            bindings.expand(interface.output);
+        }
+    }
+    bindings.expand(result.interface_config);
+    return result;
+}
+
+std::string SectionConfig::instanceName(const std::string& section, size_t index) const {
+    if (!template_config || template_config->for_each.empty()) {
+        return section;
+    }
+    Bindings bindings(*template_config, index);
+    std::string name = section + "[";
+    for (size_t i = 0; i < template_config->for_each.size(); ++i) {
+        name += (i > 0 ? "," : "") + bindings.scalar(template_config->for_each[i].name);
+    }
+    return name + "]";
+}
+
 // Config implementation
 bool Config::isValid() const {
     if (filter && !filter->isValid()) {
@@ -472,6 +669,43 @@ bool convert<Action>::decode(const Node& node, Action& action) {
     return false;
 }
 
+// Subnet conversion
+YAML::Node convert<Subnet>::encode(const Subnet& subnet) {
+    return Node(subnet.text);
+}
+
+bool convert<Subnet>::decode(const Node& node, Subnet& subnet) {
+    // A null reads as the string "null", as for any other string field
+    if (!node.IsScalar() && !node.IsNull()) return false;
+    
+    subnet = Subnet::parse(node.as<std::string>());
+    return true;
+}
+
+// PortRange conversion
+YAML::Node convert<PortRange>::encode(const PortRange& range) {
+    return Node(range.text);
+}
+
+bool convert<PortRange>::decode(const Node& node, PortRange& range) {
+    if (!node.IsScalar() && !node.IsNull()) return false;
+    
+    range = PortRange::parse(node.as<std::string>());
+    return true;
+}
+
+// MacAddress conversion
+YAML::Node convert<MacAddress>::encode(const MacAddress& mac) {
+    return Node(mac.text);
+}
+
+bool convert<MacAddress>::decode(const Node& node, MacAddress& mac) {
+    if (!node.IsScalar() && !node.IsNull()) return false;
+    
+    mac = MacAddress::parse(node.as<std::string>());
+    return true;
+}
+
 // InterfaceConfig conversion
 YAML::Node convert<InterfaceConfig>::encode(const InterfaceConfig& interface) {
     Node node;
@@ -559,7 +793,7 @@ bool convert<PortConfig>::decode(const Node& node, PortConfig& config) {
         config.port = node["port"].as<uint16_t>();
     }
     if (has_range) {
-        config.range = node["range"].as<std::vector<std::string>>();
+        config.range = node["range"].as<std::vector<PortRange>>();
     }
     
     if (node["protocol"]) {
@@ -569,7 +803,7 @@ bool convert<PortConfig>::decode(const Node& node, PortConfig& config) {
         config.direction = node["direction"].as<Direction>();
     }
     if (node["subnet"]) {
-        config.subnet = node["subnet"].as<std::vector<std::string>>();
+        config.subnet = node["subnet"].as<std::vector<Subnet>>();
     }
     if (node["forward"]) {
         config.forward = node["forward"].as<uint16_t>();
@@ -583,7 +817,7 @@ bool convert<PortConfig>::decode(const Node& node, PortConfig& config) {
         config.interface = node["interface"].as<InterfaceConfig>();
     }
     if (node["mac-source"]) {
-        config.mac_source = node["mac-source"].as<std::string>();
+        config.mac_source = node["mac-source"].as<MacAddress>();
     }
     if (node["chain"]) {
         config.chain = node["chain"].as<std::string>();
@@ -620,13 +854,13 @@ bool convert<MacConfig>::decode(const Node& node, MacConfig& config) {
     if (!node.IsMap()) return false;
     
     if (!node["mac-source"]) return false;
-    config.mac_source = node["mac-source"].as<std::string>();
+    config.mac_source = node["mac-source"].as<MacAddress>();
     
     if (node["direction"]) {
         config.direction = node["direction"].as<Direction>();
     }
     if (node["subnet"]) {
-        config.subnet = node["subnet"].as<std::vector<std::string>>();
+        config.subnet = node["subnet"].as<std::vector<Subnet>>();
     }
     if (node["allow"]) {
         config.allow = node["allow"].as<bool>();
@@ -819,6 +1053,18 @@ YAML::Node convert<SectionConfig>::encode(const SectionConfig& config) {
     if (config.chain_config) {
         node["chain"] = *config.chain_config;
     }
+    if (config.template_config) {
+        for (const auto& [key, variables] : {std::make_pair("vars", &config.template_config->vars),
+                                             std::make_pair("for_each", &config.template_config->for_each)}) {
+            for (const auto& variable : *variables) {
+                if (variable.list) {
+                    node[key][variable.name] = variable.values;
+                } else {
+                    node[key][variable.name] = variable.values.front();
+                }
+            }
+        }
+    }
     
     return node;
 }
@@ -851,6 +1097,28 @@ bool convert<SectionConfig>::decode(const Node& node, SectionConfig& config) {
     if (node["chain"]) {
         config.chain_config = node["chain"].as<ChainConfig>();
     }
+    // Template variables: each a scalar or a list of scalars, in YAML order
+    for (const char* key : {"vars", "for_each"}) {
+        if (!node[key]) {
+            continue;
+        }
+        if (!node[key].IsMap()) {
+            return false;
+        }
+        TemplateConfig& template_config = config.template_config ? *config.template_config : config.template_config.emplace();
+        auto& variables = std::string(key) == "vars" ? template_config.vars : template_config.for_each;
+        for (const auto& item : node[key]) {
+            TemplateVariable variable;
+            variable.name = item.first.as<std::string>();
+            variable.list = item.second.IsSequence();
+            if (variable.list) {
+                variable.values = item.second.as<std::vector<std::string>>();
+            } else {
+                variable.values = {item.second.as<std::string>()};
+            }
+            variables.push_back(std::move(variable));
+        }
+    }
     
     return true;
 }
@@ -903,39 +1171,4 @@ bool convert<Config>::decode(const Node& node, Config& config) {
     return true;
 }
 
-// ✨ NEW: ChainRule YAML conversion support
-template <>
-struct convert<iptables::ChainRule> {
-    static Node encode(const iptables::ChainRule& rule) {
-        Node node;
-        
-        // Basic rule information
-        node["direction"] = rule.getDirection();
-        node["target_chain"] = rule.getTargetChain();
-        node["section"] = rule.getSectionName();
-        
-        // Interface configuration
-        if (rule.getInterface().hasInterface() || rule.getInterface().hasChain()) {
-            node["interface"] = rule.getInterface();
-        }
-        
-        // Subnet configuration
-        if (!rule.getSubnets().empty()) {
-            node["subnets"] = rule.getSubnets();
-        }
-        
-        return node;
-    }
-    
-    static bool decode(const Node& node, iptables::ChainRule& rule) {
-        // ChainRule is typically created through rule processing, not directly from YAML
-        // This decode method is provided for completeness but may not be used in practice
-        if (!node.IsMap()) return false;
-        
-        // Basic validation - we would need to reconstruct the rule
-        // For now, return false as ChainRule objects are created programmatically
-        return false;
-    }
-};
-
 } // namespace YAML 
\ No newline at end of file
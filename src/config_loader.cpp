@@ -0,0 +1,203 @@
+#include "config_loader.hpp"
+#include "config_parser.hpp"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <thread>
+
+namespace iptables {
+
+namespace {
+
+// Which file each merged name came from
+struct Owners {
+    std::map<std::string, std::filesystem::path> sections;
+    std::map<std::string, std::filesystem::path> chains;
+    std::map<std::string, std::filesystem::path> policies;
+};
+
+// Record the file a name comes from; a name another file already claimed is a conflict
+void claim(std::map<std::string, std::filesystem::path>& owners, const std::string& what, const std::string& name,
+           const std::filesystem::path& file) {
+    auto [found, inserted] = owners.emplace(name, file);
+    if (!inserted && found->second != file) {
+        throw std::runtime_error(what + " '" + name + "' is defined in both " + found->second.string() + " and " +
+                                 file.string());
+    }
+}
+
+void mergePolicy(std::optional<Policy>& into, const std::optional<Policy>& policy, const std::string& chain,
+                 Owners& owners, const std::filesystem::path& file) {
+    if (!policy) {
+        return;
+    }
+    if (into && *into != *policy) {
+        throw std::runtime_error("Policy of " + chain + " is set differently in " + owners.policies[chain].string() +
+                                 " and " + file.string());
+    }
+    into = policy;
+    owners.policies.emplace(chain, file);
+}
+
+void merge(Config& into, Config part, Owners& owners, const std::filesystem::path& file) {
+    if (part.filter) {
+        FilterConfig& filter = into.filter ? *into.filter : into.filter.emplace();
+        mergePolicy(filter.input, part.filter->input, "INPUT", owners, file);
+        mergePolicy(filter.output, part.filter->output, "OUTPUT", owners, file);
+        mergePolicy(filter.forward, part.filter->forward, "FORWARD", owners, file);
+        if (part.filter->mac) {
+            auto& mac = filter.mac ? *filter.mac : filter.mac.emplace();
+            mac.insert(mac.end(), std::make_move_iterator(part.filter->mac->begin()),
+                       std::make_move_iterator(part.filter->mac->end()));
+        }
+    }
+    for (auto& [name, section] : part.custom_sections) {
+        claim(owners.sections, "Section", name, file);
+        into.custom_sections.emplace_back(std::move(name), std::move(section));
+    }
+    for (auto& [name, chain_config] : part.chain_definitions) {
+        claim(owners.sections, "Section", name, file);
+        for (const auto& chain_rule : chain_config.chain) {
+            claim(owners.chains, "Chain", chain_rule.name, file);
+        }
+        into.chain_definitions.emplace(name, std::move(chain_config));
+    }
+}
+
+// Modification time in nanoseconds, size and inode of a file
+struct FileStatus {
+    int64_t modified;
+    uintmax_t size;
+    uint64_t inode;
+};
+
+std::optional<FileStatus> statFile(const std::filesystem::path& file) {
+    struct stat status;
+    if (stat(file.c_str(), &status) != 0) {
+        return std::nullopt;
+    }
+    return FileStatus{static_cast<int64_t>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec,
+                      static_cast<uintmax_t>(status.st_size), static_cast<uint64_t>(status.st_ino)};
+}
+
+} // namespace
+
+std::filesystem::path ConfigLoader::fragmentDirectory(const std::filesystem::path& config_path) {
+    std::filesystem::path directory = config_path;
+    return directory.replace_extension(".d");
+}
+
+std::vector<std::filesystem::path> ConfigLoader::files(const std::filesystem::path& config_path) {
+    std::vector<std::filesystem::path> result = {config_path};
+
+    std::error_code error;
+    std::filesystem::directory_iterator it(fragmentDirectory(config_path), error);
+    std::vector<std::filesystem::path> fragments;
+    for (; !error && it != std::filesystem::directory_iterator(); it.increment(error)) {
+        const std::filesystem::path& path = it->path();
+        std::string name = path.filename().string();
+        std::string extension = path.extension().string();
+        if (name.empty() || name[0] == '.' || (extension != ".yaml" && extension != ".yml") ||
+            !it->is_regular_file(error)) {
+            continue;
+        }
+        fragments.push_back(path);
+    }
+    std::sort(fragments.begin(), fragments.end(),
+              [](const auto& a, const auto& b) { return a.filename().string() < b.filename().string(); });
+    result.insert(result.end(), fragments.begin(), fragments.end());
+    return result;
+}
+
+Config ConfigLoader::load(const std::filesystem::path& config_path) {
+    std::vector<std::filesystem::path> paths = files(config_path);
+    std::vector<Entry> entries(paths.size());
+    std::vector<size_t> stale;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        std::optional<FileStatus> current = statFile(paths[i]);
+        auto cached = cache_.find(paths[i]);
+        if (current && cached != cache_.end() && cached->second.modified == current->modified &&
+            cached->second.size == current->size && cached->second.inode == current->inode) {
+            entries[i] = cached->second;
+            continue;
+        }
+        // A file that cannot be stat()ed is parsed anyway and reports its own error
+        if (current) {
+            entries[i].modified = current->modified;
+            entries[i].size = current->size;
+            entries[i].inode = current->inode;
+        }
+        stale.push_back(i);
+    }
+
+    // Parse the changed files, several at a time when there are several
+    std::vector<std::exception_ptr> errors(paths.size());
+    std::atomic<size_t> next{0};
+    auto parse = [&]() {
+        for (size_t k = next++; k < stale.size(); k = next++) {
+            size_t i = stale[k];
+            try {
+                entries[i].config = std::make_shared<Config>(ConfigParser::loadFromFile(paths[i].string()));
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        }
+    };
+    size_t workers = std::min<size_t>(stale.size(), std::max(1u, std::thread::hardware_concurrency()));
+    if (workers <= 1) {
+        parse();
+    } else {
+        std::vector<std::thread> threads;
+        threads.reserve(workers);
+        for (size_t w = 0; w < workers; ++w) {
+            threads.emplace_back(parse);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    parsed_ = stale.size();
+    fragments_ = paths.size() - 1;
+
+    // The first failing file in merge order is reported, however the parses were scheduled
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (!errors[i]) {
+            continue;
+        }
+        if (i == 0) {
+            std::rethrow_exception(errors[i]);
+        }
+        try {
+            std::rethrow_exception(errors[i]);
+        } catch (const std::exception& e) {
+            throw std::runtime_error(paths[i].string() + ": " + e.what());
+        }
+    }
+
+    cache_.clear();
+    if (keep_parsed_) {
+        for (size_t i = 0; i < paths.size(); ++i) {
+            cache_.emplace(paths[i], entries[i]);
+        }
+    }
+
+    // Parsed files nobody else holds are moved rather than copied
+    auto take = [&](size_t i) {
+        return entries[i].config.use_count() == 1 ? std::move(*entries[i].config)
+                                                  : Config(*entries[i].config);
+    };
+    if (paths.size() == 1) {
+        return take(0);
+    }
+    Config merged;
+    Owners owners;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        merge(merged, take(i), owners, paths[i]);
+    }
+    return merged;
+}
+
+} // namespace iptables
@@ -1,21 +1,18 @@
 #include "config_parser.hpp"
+#include "config_reader.hpp"
 #include <yaml-cpp/yaml.h>
 #include <fstream>
+#include <sstream>
 #include <stdexcept>
 
 namespace iptables {
 
 Config ConfigParser::loadFromFile(const std::string& filename) {
     try {
-        // Load YAML file using yaml-cpp library
-        // YAML::LoadFile throws YAML::Exception for file access errors or invalid YAML syntax
-        // This handles UTF-8 encoding and supports all YAML 1.2 features
-        YAML::Node yamlNode = YAML::LoadFile(filename);
-        
-        // Convert YAML node to Config object using custom template specializations
-        // The as<Config>() call triggers the YAML::convert<Config>::decode() method
-        // which recursively parses all nested configuration structures
-        Config config = yamlNode.as<Config>();
+        // Decode the file straight from yaml-cpp's parser events
+        // ConfigReader builds the same Config as YAML::LoadFile(...).as<Config>() without
+        // building a node tree first, and throws YAML::Exception with the same messages
+        Config config = ConfigReader::readFile(filename);
         
         // Validate the parsed configuration for logical consistency
         // This checks field constraints, mutual exclusivity, and cross-references
@@ -41,13 +38,10 @@ Config ConfigParser::loadFromFile(const std::string& filename) {
 Config ConfigParser::loadFromString(const std::string& yaml_content) {
     try {
         // Parse YAML content from string rather than file
-        // YAML::Load supports the same syntax as LoadFile but operates on in-memory content
+        // The same streaming decoder as for files ensures consistent behavior
         // This is useful for testing, dynamic configuration generation, or embedded YAML
-        YAML::Node yamlNode = YAML::Load(yaml_content);
-        
-        // Convert YAML node to Config object using the same mechanism as file loading
-        // This ensures consistent behavior between file and string-based configuration
-        Config config = yamlNode.as<Config>();
+        std::istringstream input(yaml_content);
+        Config config = ConfigReader::read(input);
         
         // Apply the same validation logic as file-based loading
         // Configuration validation is independent of the YAML source (file vs string)
@@ -0,0 +1,761 @@
+#include "config_reader.hpp"
+#include <yaml-cpp/eventhandler.h>
+#include <yaml-cpp/parser.h>
+#include <algorithm>
+#include <cctype>
+#include <exception>
+#include <fstream>
+#include <optional>
+#include <vector>
+
+namespace iptables {
+
+namespace {
+
+using YAML::Mark;
+
+// What a node is decoded into
+enum class Target : uint8_t {
+    Skip,
+    Config,
+    Filter,
+    Section,
+    SectionInterface,  // a section's interface key: an InterfaceConfig map or InterfaceRuleConfig list
+    Port,
+    Mac,
+    InterfaceRule,
+    Interface,
+    ChainRule,
+    Chain,
+    Rules,
+    Ports,
+    Macs,
+    InterfaceRules,
+    ChainRules,
+    Subnets,
+    PortRanges,
+    Strings,
+    Variables,         // vars or for_each: a map from names to scalars or lists
+    Variable,
+    String,
+    Subnet,
+    PortRange,
+    MacAddress,
+    Number,
+    Bool,
+    Policy,
+    Direction,
+    Protocol,
+    Action
+};
+
+// Where the next node goes. The rank is the position of the node in the
+// order YAML::convert<Config>::decode converts nodes, which decides the
+// error reported when a document has several.
+struct Slot {
+    Target target = Target::Skip;
+    void* into = nullptr;
+    uint32_t rank = 0;
+};
+
+// An open map or sequence
+struct Frame {
+    Target target = Target::Skip;
+    void* into = nullptr;
+    Mark mark;
+    uint32_t rank = 0;
+    bool map = false;
+    bool collapse = false;  // errors below are reported as the enclosing section's
+    bool at_key = true;
+    Slot value{};           // slot of the value following the last key
+    uint32_t seen = 0;      // fields set so far, by rank; the first of repeated keys wins
+    uint32_t items = 0;     // entries or elements so far
+};
+
+// Field names of the struct-like maps, in the order their decode functions
+// convert them; an empty name stands for a check made before any field
+const std::vector<std::string>& fields(Target target) {
+    static const std::vector<std::string> none;
+    static const std::vector<std::string> filter = {"input", "output", "forward", "mac"};
+    static const std::vector<std::string> section = {"ports", "mac", "interface", "action", "chain", "vars", "for_each"};
+    static const std::vector<std::string> port = {"",          "port",  "range",     "protocol",   "direction", "subnet",
+                                                  "forward",   "allow", "interface", "mac-source", "chain"};
+    static const std::vector<std::string> mac = {"", "mac-source", "direction", "subnet", "allow", "interface", "chain"};
+    static const std::vector<std::string> interface_rule = {"input", "output", "direction", "allow"};
+    static const std::vector<std::string> interface = {"input", "output", "chain"};
+    static const std::vector<std::string> chain_rule = {"", "name", "action", "rules"};
+    static const std::vector<std::string> chain = {"chain"};
+    switch (target) {
+        case Target::Filter: return filter;
+        case Target::Section: return section;
+        case Target::Port: return port;
+        case Target::Mac: return mac;
+        case Target::InterfaceRule: return interface_rule;
+        case Target::Interface: return interface;
+        case Target::ChainRule: return chain_rule;
+        case Target::Chain: return chain;
+        default: return none;
+    }
+}
+
+// Bit of a field in Frame::seen
+constexpr uint32_t bit(uint32_t rank) {
+    return 1u << rank;
+}
+
+bool toNumber(const std::string& text, uint16_t& value) {
+    // Plain decimal ports are by far the most common; anything else, such
+    // as octal or hexadecimal, goes through yaml-cpp's own conversion
+    if (!text.empty() && text.size() <= 5 && text[0] != '0' &&
+        std::all_of(text.begin(), text.end(), [](unsigned char c) { return std::isdigit(c); })) {
+        unsigned long number = std::stoul(text);
+        if (number > 65535) {
+            return false;
+        }
+        value = static_cast<uint16_t>(number);
+        return true;
+    }
+    return YAML::convert<uint16_t>::decode(YAML::Node(text), value);
+}
+
+bool toBool(const std::string& text, bool& value) {
+    if (text == "true" || text == "false") {
+        value = text == "true";
+        return true;
+    }
+    return YAML::convert<bool>::decode(YAML::Node(text), value);
+}
+
+std::string lower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+    return text;
+}
+
+// Decodes events into a Config
+class Reader : public YAML::EventHandler {
+public:
+    Config take() {
+        if (failure_) {
+            std::rethrow_exception(failure_);
+        }
+        return std::move(config_);
+    }
+
+    void OnDocumentStart(const Mark&) override {}
+    void OnDocumentEnd() override {}
+
+    void OnNull(const Mark& mark, YAML::anchor_t anchor) override {
+        if (!recording_.empty() || anchor != YAML::NullAnchor) {
+            Event event{Event::Null, mark, 0, {}};
+            record(event);
+            if (anchor != YAML::NullAnchor) {
+                anchored(anchor) = {event};
+            }
+        }
+        scalar(mark, nullptr);
+    }
+
+    void OnAlias(const Mark& mark, YAML::anchor_t anchor) override {
+        record(Event{Event::Alias, mark, anchor, {}});
+        replay(mark, anchor);
+    }
+
+    void OnScalar(const Mark& mark, const std::string&, YAML::anchor_t anchor, const std::string& value) override {
+        if (!recording_.empty() || anchor != YAML::NullAnchor) {
+            Event event{Event::Scalar, mark, 0, value};
+            record(event);
+            if (anchor != YAML::NullAnchor) {
+                anchored(anchor) = {std::move(event)};
+            }
+        }
+        scalar(mark, &value);
+    }
+
+    void OnSequenceStart(const Mark& mark, const std::string&, YAML::anchor_t anchor,
+                         YAML::EmitterStyle::value) override {
+        start(Event{Event::SequenceStart, mark, 0, {}}, anchor);
+        open(mark, false);
+    }
+
+    void OnSequenceEnd() override {
+        record(Event{Event::End, {}, 0, {}});
+        close();
+    }
+
+    void OnMapStart(const Mark& mark, const std::string&, YAML::anchor_t anchor, YAML::EmitterStyle::value) override {
+        start(Event{Event::MapStart, mark, 0, {}}, anchor);
+        open(mark, true);
+    }
+
+    void OnMapEnd() override {
+        record(Event{Event::End, {}, 0, {}});
+        close();
+    }
+
+private:
+    // Anchored nodes are kept as events and decoded again wherever an alias names them
+    struct Event {
+        enum Kind : uint8_t { Null, Scalar, Alias, SequenceStart, MapStart, End } kind;
+        Mark mark;
+        YAML::anchor_t alias;
+        std::string value;
+    };
+
+    struct Recording {
+        YAML::anchor_t anchor;
+        size_t depth;
+    };
+
+    std::vector<Event>& anchored(YAML::anchor_t anchor) {
+        if (anchors_.size() <= anchor) {
+            anchors_.resize(anchor + 1);
+        }
+        return anchors_[anchor];
+    }
+
+    void record(const Event& event) {
+        for (auto it = recording_.begin(); it != recording_.end();) {
+            anchors_[it->anchor].push_back(event);
+            if (event.kind == Event::SequenceStart || event.kind == Event::MapStart) {
+                ++it->depth;
+            } else if (event.kind == Event::End) {
+                --it->depth;
+            }
+            it = it->depth == 0 ? recording_.erase(it) : it + 1;
+        }
+    }
+
+    void start(const Event& event, YAML::anchor_t anchor) {
+        record(event);
+        if (anchor != YAML::NullAnchor) {
+            anchored(anchor) = {event};
+            recording_.push_back({anchor, 1});
+        }
+    }
+
+    void replay(const Mark& mark, YAML::anchor_t anchor) {
+        bool complete = std::none_of(recording_.begin(), recording_.end(),
+                                     [&](const Recording& open) { return open.anchor == anchor; });
+        if (!complete) {
+            // An alias inside the node it names is fine where it is ignored.
+            // Elsewhere, the node is still open; where a scalar is expected it
+            // fails like any collection, and where a collection is expected it
+            // is rejected rather than decoded without end.
+            if (frames_.back().map && frames_.back().at_key) {
+                key(mark, nullptr);
+                return;
+            }
+            Slot slot = next();
+            if (slot.target == Target::SectionInterface) {
+                badConversion(frames_.back().mark, slot.rank);
+            } else if (slot.target != Target::Skip) {
+                badConversion(anchors_[anchor].front().mark, slot.rank);
+            }
+            return;
+        }
+        for (const Event& event : anchors_[anchor]) {
+            switch (event.kind) {
+                case Event::Null: scalar(event.mark, nullptr); break;
+                case Event::Scalar: scalar(event.mark, &event.value); break;
+                case Event::Alias: replay(event.mark, event.alias); break;
+                case Event::SequenceStart: open(event.mark, false); break;
+                case Event::MapStart: open(event.mark, true); break;
+                case Event::End: close(); break;
+            }
+        }
+    }
+
+    // Remember an error unless one the node-based decoder meets earlier is known
+    void fail(std::exception_ptr error, std::vector<uint32_t> rank) {
+        // A section's interface is decoded inside try blocks whose failure
+        // makes the whole section fail, so errors below it name the section
+        for (size_t i = 1; i < frames_.size(); ++i) {
+            if (frames_[i].collapse) {
+                error = std::make_exception_ptr(YAML::BadConversion(frames_[i - 1].mark));
+                rank.resize(i + 1);
+                break;
+            }
+        }
+        if (!failure_ || rank < failure_rank_) {
+            failure_ = std::move(error);
+            failure_rank_ = std::move(rank);
+        }
+    }
+
+    // Rank of the open frames, optionally followed by one more position
+    std::vector<uint32_t> rank(std::optional<uint32_t> position = std::nullopt) const {
+        std::vector<uint32_t> result;
+        result.reserve(frames_.size() + 1);
+        for (const Frame& frame : frames_) {
+            result.push_back(frame.rank);
+        }
+        if (position) {
+            result.push_back(*position);
+        }
+        return result;
+    }
+
+    void badConversion(const Mark& mark, std::optional<uint32_t> position) {
+        fail(std::make_exception_ptr(YAML::BadConversion(mark)), rank(position));
+    }
+
+    // Slot of the next node inside the innermost frame, which is not waiting for a key
+    Slot next() {
+        if (frames_.empty()) {
+            return {Target::Config, &config_, 0};
+        }
+        Frame& frame = frames_.back();
+        if (frame.map) {
+            frame.at_key = true;
+            return frame.value;
+        }
+        uint32_t index = frame.items++;
+        switch (frame.target) {
+            case Target::Ports:
+                return {Target::Port, &static_cast<std::vector<PortConfig>*>(frame.into)->emplace_back(), index};
+            case Target::Macs:
+                return {Target::Mac, &static_cast<std::vector<MacConfig>*>(frame.into)->emplace_back(), index};
+            case Target::InterfaceRules:
+                return {Target::InterfaceRule,
+                        &static_cast<std::vector<InterfaceRuleConfig>*>(frame.into)->emplace_back(), index};
+            case Target::ChainRules:
+                return {Target::ChainRule, &static_cast<std::vector<ChainRuleConfig>*>(frame.into)->emplace_back(),
+                        index};
+            case Target::Subnets:
+                return {Target::Subnet, &static_cast<std::vector<Subnet>*>(frame.into)->emplace_back(), index};
+            case Target::PortRanges:
+                return {Target::PortRange, &static_cast<std::vector<PortRange>*>(frame.into)->emplace_back(), index};
+            case Target::Strings:
+                return {Target::String, &static_cast<std::vector<std::string>*>(frame.into)->emplace_back(), index};
+            case Target::Rules:
+                // Iterating a sequence as a map yields entries without keys
+                if (index == 0) {
+                    fail(std::make_exception_ptr(YAML::InvalidNode("")), rank(0));
+                }
+                return {};
+            default:
+                return {};
+        }
+    }
+
+    // Slot of a field of a struct-like map
+    Slot bind(Frame& frame, uint32_t field) {
+        frame.seen |= bit(field);
+        switch (frame.target) {
+            case Target::Filter: {
+                auto* filter = static_cast<FilterConfig*>(frame.into);
+                switch (field) {
+                    case 0: return {Target::Policy, &filter->input.emplace(), field};
+                    case 1: return {Target::Policy, &filter->output.emplace(), field};
+                    case 2: return {Target::Policy, &filter->forward.emplace(), field};
+                    default: return {Target::Macs, &filter->mac, field};
+                }
+            }
+            case Target::Section: {
+                auto* section = static_cast<SectionConfig*>(frame.into);
+                switch (field) {
+                    case 0: return {Target::Ports, &section->ports, field};
+                    case 1: return {Target::Macs, &section->mac, field};
+                    case 2: return {Target::SectionInterface, section, field};
+                    case 3: return {Target::Action, &section->action.emplace(), field};
+                    case 4: return {Target::Chain, &section->chain_config.emplace(), field};
+                    default: {
+                        TemplateConfig& template_config =
+                            section->template_config ? *section->template_config : section->template_config.emplace();
+                        return {Target::Variables, field == 5 ? &template_config.vars : &template_config.for_each, field};
+                    }
+                }
+            }
+            case Target::Port: {
+                auto* port = static_cast<PortConfig*>(frame.into);
+                switch (field) {
+                    case 1: return {Target::Number, &port->port.emplace(), field};
+                    case 2: return {Target::PortRanges, &port->range, field};
+                    case 3: return {Target::Protocol, &port->protocol, field};
+                    case 4: return {Target::Direction, &port->direction, field};
+                    case 5: return {Target::Subnets, &port->subnet, field};
+                    case 6: return {Target::Number, &port->forward.emplace(), field};
+                    case 7: return {Target::Bool, &port->allow, field};
+                    case 8: return {Target::Interface, &port->interface.emplace(), field};
+                    case 9: return {Target::MacAddress, &port->mac_source.emplace(), field};
+                    default: return {Target::String, &port->chain.emplace(), field};
+                }
+            }
+            case Target::Mac: {
+                auto* mac = static_cast<MacConfig*>(frame.into);
+                switch (field) {
+                    case 1: return {Target::MacAddress, &mac->mac_source, field};
+                    case 2: return {Target::Direction, &mac->direction, field};
+                    case 3: return {Target::Subnets, &mac->subnet, field};
+                    case 4: return {Target::Bool, &mac->allow, field};
+                    case 5: return {Target::Interface, &mac->interface.emplace(), field};
+                    default: return {Target::String, &mac->chain.emplace(), field};
+                }
+            }
+            case Target::InterfaceRule: {
+                auto* rule = static_cast<InterfaceRuleConfig*>(frame.into);
+                switch (field) {
+                    case 0: return {Target::String, &rule->input.emplace(), field};
+                    case 1: return {Target::String, &rule->output.emplace(), field};
+                    case 2: return {Target::Direction, &rule->direction, field};
+                    default: return {Target::Bool, &rule->allow, field};
+                }
+            }
+            case Target::Interface: {
+                auto* interface = static_cast<InterfaceConfig*>(frame.into);
+                switch (field) {
+                    case 0: return {Target::String, &interface->input.emplace(), field};
+                    case 1: return {Target::String, &interface->output.emplace(), field};
+                    default: return {Target::String, &interface->chain.emplace(), field};
+                }
+            }
+            case Target::ChainRule: {
+                auto* rule = static_cast<ChainRuleConfig*>(frame.into);
+                switch (field) {
+                    case 1: return {Target::String, &rule->name, field};
+                    case 2: return {Target::Action, &rule->action, field};
+                    default: return {Target::Rules, &rule->rules, field};
+                }
+            }
+            case Target::Chain:
+                return {Target::ChainRules, &static_cast<ChainConfig*>(frame.into)->chain, field};
+            default:
+                return {};
+        }
+    }
+
+    // A key inside the innermost frame; nullptr stands for a key that is not a scalar
+    void key(const Mark& mark, const std::string* name) {
+        Frame& frame = frames_.back();
+        frame.at_key = false;
+        frame.value = {};
+        uint32_t entry = frame.items++;
+
+        if (frame.target == Target::Config || frame.target == Target::Rules || frame.target == Target::Variables) {
+            // These maps are iterated, and every key is converted to a string
+            uint32_t base = frame.target == Target::Config ? 1 : 0;
+            if (!name) {
+                badConversion(mark, base + 2 * entry);
+                return;
+            }
+            if (frame.target == Target::Variables) {
+                auto* variables = static_cast<std::vector<TemplateVariable>*>(frame.into);
+                variables->push_back({*name, {}, false});
+                frame.value = {Target::Variable, &variables->back(), 2 * entry + 1};
+            } else if (frame.target == Target::Rules) {
+                auto* rules = static_cast<std::vector<std::pair<std::string, SectionConfig>>*>(frame.into);
+                frame.value = {Target::Section, &rules->emplace_back(*name, SectionConfig{}).second, 2 * entry + 1};
+            } else if (*name != "filter") {
+                frame.value = {Target::Section, &config_.custom_sections.emplace_back(*name, SectionConfig{}).second,
+                               2 + 2 * entry};
+            } else if (!(frame.seen & bit(0))) {
+                frame.seen |= bit(0);
+                frame.value = {Target::Filter, &config_.filter.emplace(), 0};
+            }
+            return;
+        }
+
+        // Struct-like maps look their fields up by name
+        const std::vector<std::string>& names = fields(frame.target);
+        if (!name || names.empty()) {
+            return;
+        }
+        auto found = std::find(names.begin(), names.end(), *name);
+        if (found == names.end() || found->empty()) {
+            return;
+        }
+        uint32_t field = static_cast<uint32_t>(found - names.begin());
+        if (!(frame.seen & bit(field))) {
+            frame.value = bind(frame, field);
+        }
+    }
+
+    // A scalar, or with nullptr a null
+    void scalar(const Mark& mark, const std::string* value) {
+        if (!frames_.empty() && frames_.back().map && frames_.back().at_key) {
+            // yaml-cpp converts a null key to the string "null" but never matches it with a field name
+            static const std::string null_key = "null";
+            Target target = frames_.back().target;
+            bool iterated = target == Target::Config || target == Target::Rules || target == Target::Variables;
+            key(mark, value ? value : (iterated ? &null_key : nullptr));
+            return;
+        }
+
+        Slot slot = next();
+        bool converted = true;
+        switch (slot.target) {
+            case Target::Skip:
+            case Target::Rules:
+                break;
+            case Target::SectionInterface:
+            case Target::Variables:
+                // Decoding the section fails as a whole
+                badConversion(frames_.back().mark, slot.rank);
+                break;
+            case Target::Variable:
+                static_cast<TemplateVariable*>(slot.into)->values = {value ? *value : "null"};
+                break;
+            case Target::String:
+                *static_cast<std::string*>(slot.into) = value ? *value : "null";
+                break;
+            // Addresses and ranges are parsed here, once; malformed ones are kept for validation to report
+            case Target::Subnet:
+                *static_cast<Subnet*>(slot.into) = Subnet::parse(value ? *value : "null");
+                break;
+            case Target::PortRange:
+                *static_cast<PortRange*>(slot.into) = PortRange::parse(value ? *value : "null");
+                break;
+            case Target::MacAddress:
+                *static_cast<MacAddress*>(slot.into) = MacAddress::parse(value ? *value : "null");
+                break;
+            case Target::Number:
+                converted = value && toNumber(*value, *static_cast<uint16_t*>(slot.into));
+                break;
+            case Target::Bool:
+                converted = value && toBool(*value, *static_cast<bool*>(slot.into));
+                break;
+            case Target::Policy:
+                converted = value && toPolicy(*value, *static_cast<Policy*>(slot.into));
+                break;
+            case Target::Direction:
+                converted = value && toDirection(*value, *static_cast<Direction*>(slot.into));
+                break;
+            case Target::Protocol:
+                converted = value && toProtocol(lower(*value), *static_cast<Protocol*>(slot.into));
+                break;
+            case Target::Action:
+                converted = value && toAction(lower(*value), *static_cast<Action*>(slot.into));
+                break;
+            default:
+                // Maps and sequences expected
+                converted = false;
+                break;
+        }
+        if (!converted) {
+            badConversion(mark, slot.rank);
+        }
+    }
+
+    void open(const Mark& mark, bool map) {
+        if (!frames_.empty() && frames_.back().map && frames_.back().at_key) {
+            key(mark, nullptr);
+            frames_.push_back({Target::Skip, nullptr, mark, 0, map});
+            return;
+        }
+
+        Slot slot = next();
+        Frame frame{Target::Skip, nullptr, mark, slot.rank, map};
+        switch (slot.target) {
+            case Target::Config:
+            case Target::Filter:
+            case Target::Section:
+            case Target::Port:
+            case Target::Mac:
+            case Target::InterfaceRule:
+            case Target::Interface:
+            case Target::ChainRule:
+                if (map) {
+                    frame.target = slot.target;
+                    frame.into = slot.into;
+                } else {
+                    badConversion(mark, slot.rank);
+                }
+                break;
+            case Target::Rules:
+                frame.target = Target::Rules;
+                frame.into = slot.into;
+                break;
+            case Target::Variables:
+                if (map) {
+                    frame.target = Target::Variables;
+                    frame.into = slot.into;
+                } else {
+                    badConversion(frames_.back().mark, slot.rank);
+                }
+                break;
+            case Target::Variable:
+                if (!map) {
+                    auto* variable = static_cast<TemplateVariable*>(slot.into);
+                    variable->list = true;
+                    frame.target = Target::Strings;
+                    frame.into = &variable->values;
+                } else {
+                    badConversion(mark, slot.rank);
+                }
+                break;
+            case Target::Chain:
+                // A list of chains, or a map holding the list under "chain"
+                frame.target = map ? Target::Chain : Target::ChainRules;
+                frame.into = map ? slot.into : &static_cast<ChainConfig*>(slot.into)->chain;
+                break;
+            case Target::ChainRules:
+                if (!map) {
+                    frame.target = Target::ChainRules;
+                    frame.into = slot.into;
+                } else {
+                    badConversion(mark, slot.rank);
+                }
+                break;
+            case Target::Ports:
+                frame.into = list<PortConfig>(slot, map, mark);
+                frame.target = frame.into ? slot.target : Target::Skip;
+                break;
+            case Target::Macs:
+                frame.into = list<MacConfig>(slot, map, mark);
+                frame.target = frame.into ? slot.target : Target::Skip;
+                break;
+            case Target::Subnets:
+                frame.into = list<Subnet>(slot, map, mark);
+                frame.target = frame.into ? slot.target : Target::Skip;
+                break;
+            case Target::PortRanges:
+                frame.into = list<PortRange>(slot, map, mark);
+                frame.target = frame.into ? slot.target : Target::Skip;
+                break;
+            case Target::SectionInterface: {
+                auto* section = static_cast<SectionConfig*>(slot.into);
+                frame.collapse = true;
+                if (map) {
+                    frame.target = Target::Interface;
+                    frame.into = &section->interface_config.emplace();
+                } else {
+                    frame.target = Target::InterfaceRules;
+                    frame.into = &section->interface.emplace();
+                }
+                break;
+            }
+            case Target::Skip:
+                break;
+            default:
+                // Scalars expected
+                badConversion(mark, slot.rank);
+                break;
+        }
+        frames_.push_back(frame);
+    }
+
+    template <typename T>
+    std::vector<T>* list(const Slot& slot, bool map, const Mark& mark) {
+        if (map) {
+            badConversion(mark, slot.rank);
+            return nullptr;
+        }
+        return &static_cast<std::optional<std::vector<T>>*>(slot.into)->emplace();
+    }
+
+    void close() {
+        const Frame& frame = frames_.back();
+        uint32_t seen = frame.seen;
+        switch (frame.target) {
+            case Target::Port:
+                // Either a port or a range, checked before any field is converted
+                if (!(seen & bit(1)) == !(seen & bit(2))) {
+                    badConversion(frame.mark, 0);
+                }
+                break;
+            case Target::Mac:
+            case Target::ChainRule:
+                if (!(seen & bit(1))) {
+                    badConversion(frame.mark, 0);
+                }
+                break;
+            case Target::Chain:
+                if (!(seen & bit(0))) {
+                    badConversion(frame.mark, std::nullopt);
+                }
+                break;
+            default:
+                break;
+        }
+        bool section = frame.target == Target::Section;
+        frames_.pop_back();
+
+        // Sections defining chains are kept apart from the sections applied in order
+        if (section && frames_.size() == 1 && frames_.back().target == Target::Config) {
+            auto& [name, config] = config_.custom_sections.back();
+            if (config.chain_config) {
+                config_.chain_definitions[name] = *config.chain_config;
+                config_.custom_sections.pop_back();
+            }
+        }
+    }
+
+    static bool toPolicy(const std::string& value, Policy& policy) {
+        if (value == "accept") {
+            policy = Policy::Accept;
+        } else if (value == "drop") {
+            policy = Policy::Drop;
+        } else if (value == "reject") {
+            policy = Policy::Reject;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    static bool toDirection(const std::string& value, Direction& direction) {
+        if (value == "input") {
+            direction = Direction::Input;
+        } else if (value == "output") {
+            direction = Direction::Output;
+        } else if (value == "forward") {
+            direction = Direction::Forward;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    static bool toProtocol(const std::string& value, Protocol& protocol) {
+        if (value == "tcp") {
+            protocol = Protocol::Tcp;
+        } else if (value == "udp") {
+            protocol = Protocol::Udp;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    static bool toAction(const std::string& value, Action& action) {
+        if (value == "accept" || value == "allow") {
+            action = Action::Accept;
+        } else if (value == "drop" || value == "deny") {
+            action = Action::Drop;
+        } else if (value == "reject") {
+            action = Action::Reject;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    Config config_;
+    std::vector<Frame> frames_;
+    std::vector<std::vector<Event>> anchors_;
+    std::vector<Recording> recording_;
+    std::exception_ptr failure_;
+    std::vector<uint32_t> failure_rank_;
+};
+
+} // namespace
+
+Config ConfigReader::read(std::istream& input) {
+    YAML::Parser parser(input);
+    Reader reader;
+    if (!parser.HandleNextDocument(reader)) {
+        // An empty stream loads as a null node, which is not a map
+        throw YAML::BadConversion(Mark::null_mark());
+    }
+    return reader.take();
+}
+
+Config ConfigReader::readFile(const std::string& filename) {
+    std::ifstream input(filename);
+    if (!input) {
+        throw YAML::BadFile(filename);
+    }
+    return read(input);
+}
+
+} // namespace iptables
@@ -0,0 +1,258 @@
+#include "control_socket.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace iptables {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// No deadline: the client waits for as long as the daemon takes
+constexpr Clock::time_point kNoDeadline = Clock::time_point::max();
+
+// Wait until fd is ready for events or the deadline passes
+bool waitReady(int fd, short events, Clock::time_point deadline) {
+    if (deadline == kNoDeadline) {
+        return true;
+    }
+    for (;;) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+        if (left <= 0) {
+            return false;
+        }
+        pollfd descriptor{fd, events, 0};
+        int ready = poll(&descriptor, 1, static_cast<int>(left));
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        return ready > 0;
+    }
+}
+
+bool socketAddress(const std::filesystem::path& path, sockaddr_un& address) {
+    address = sockaddr_un{};
+    address.sun_family = AF_UNIX;
+    const std::string& text = path.native();
+    if (text.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::memcpy(address.sun_path, text.c_str(), text.size() + 1);
+    return true;
+}
+
+// The deadline covers the whole write, however slowly the peer reads
+bool writeAll(int fd, const char* data, size_t size, Clock::time_point deadline) {
+    int flags = MSG_NOSIGNAL | (deadline == kNoDeadline ? 0 : MSG_DONTWAIT);
+    while (size > 0) {
+        if (!waitReady(fd, POLLOUT, deadline)) {
+            return false;
+        }
+        // MSG_NOSIGNAL: a client that hung up must not take the daemon down with SIGPIPE
+        ssize_t written = ::send(fd, data, size, flags);
+        if (written < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// The deadline covers the whole read, however slowly the peer writes
+bool readAll(int fd, char* data, size_t size, Clock::time_point deadline) {
+    int flags = deadline == kNoDeadline ? 0 : MSG_DONTWAIT;
+    while (size > 0) {
+        if (!waitReady(fd, POLLIN, deadline)) {
+            return false;
+        }
+        ssize_t received = recv(fd, data, size, flags);
+        if (received < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        data += received;
+        size -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+bool writeFrame(int fd, const std::string& payload, Clock::time_point deadline = kNoDeadline) {
+    // The peer would drop it unread
+    if (payload.size() > ControlServer::kMaxFrame) {
+        return false;
+    }
+    uint32_t size = static_cast<uint32_t>(payload.size());
+    unsigned char header[4] = {static_cast<unsigned char>(size >> 24), static_cast<unsigned char>(size >> 16),
+                               static_cast<unsigned char>(size >> 8), static_cast<unsigned char>(size)};
+    return writeAll(fd, reinterpret_cast<const char*>(header), sizeof(header), deadline) &&
+           writeAll(fd, payload.data(), payload.size(), deadline);
+}
+
+std::optional<std::string> readFrame(int fd, Clock::time_point deadline = kNoDeadline) {
+    unsigned char header[4];
+    if (!readAll(fd, reinterpret_cast<char*>(header), sizeof(header), deadline)) {
+        return std::nullopt;
+    }
+    uint32_t size = (uint32_t(header[0]) << 24) | (uint32_t(header[1]) << 16) | (uint32_t(header[2]) << 8) |
+                    uint32_t(header[3]);
+    if (size > ControlServer::kMaxFrame) {
+        return std::nullopt;
+    }
+    std::string payload(size, '\0');
+    if (!readAll(fd, payload.data(), size, deadline)) {
+        return std::nullopt;
+    }
+    return payload;
+}
+
+// Split a payload at its first line
+std::pair<std::string, std::string> firstLine(const std::string& payload) {
+    size_t end = payload.find('\n');
+    if (end == std::string::npos) {
+        return {payload, {}};
+    }
+    return {payload.substr(0, end), payload.substr(end + 1)};
+}
+
+} // namespace
+
+ControlServer::ControlServer(std::filesystem::path path)
+    : path_(std::move(path)) {
+}
+
+ControlServer::~ControlServer() {
+    if (socket_ >= 0) {
+        close(socket_);
+        std::error_code error;
+        std::filesystem::remove(path_, error);
+    }
+}
+
+bool ControlServer::listen() {
+    sockaddr_un address;
+    if (!socketAddress(path_, address)) {
+        std::cerr << "Control socket path too long: " << path_.string() << std::endl;
+        return false;
+    }
+
+    // A path that still accepts connections belongs to a running daemon
+    std::error_code error;
+    if (std::filesystem::is_socket(path_, error)) {
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool alive = probe >= 0 && connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        if (probe >= 0) {
+            close(probe);
+        }
+        if (alive) {
+            std::cerr << "Control socket " << path_.string() << " is in use by another daemon" << std::endl;
+            return false;
+        }
+        std::filesystem::remove(path_, error);
+    }
+    if (path_.has_parent_path()) {
+        std::filesystem::create_directories(path_.parent_path(), error);
+    }
+
+    socket_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (socket_ < 0) {
+        std::cerr << "Failed to create control socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    // Requests change the firewall, so only root may connect
+    mode_t previous = umask(077);
+    bool bound = bind(socket_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+    umask(previous);
+    if (!bound || ::listen(socket_, 16) != 0) {
+        std::cerr << "Failed to listen on " << path_.string() << ": " << std::strerror(errno) << std::endl;
+        close(socket_);
+        socket_ = -1;
+        return false;
+    }
+    return true;
+}
+
+size_t ControlServer::serve(const Handler& handler) {
+    size_t served = 0;
+    for (;;) {
+        int client = accept4(socket_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return served;
+        }
+        // Deadlines per frame, not per call, so a client trickling bytes cannot hold the loop
+        std::optional<std::string> payload = readFrame(client, Clock::now() + kClientTimeout);
+        if (payload) {
+            auto [line, body] = firstLine(*payload);
+            ControlResponse response = handler(ControlClient::parse(line, std::move(body)));
+            writeFrame(client, (response.success ? "ok\n" : "error\n") + response.body,
+                       Clock::now() + kClientTimeout);
+            ++served;
+        }
+        close(client);
+    }
+}
+
+std::optional<ControlResponse> ControlClient::send(const std::filesystem::path& path, const ControlRequest& request) {
+    sockaddr_un address;
+    if (!socketAddress(path, address)) {
+        std::cerr << "Control socket path too long: " << path.string() << std::endl;
+        return std::nullopt;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::cerr << "Cannot reach the daemon at " << path.string() << ": " << std::strerror(errno) << std::endl;
+        if (fd >= 0) {
+            close(fd);
+        }
+        return std::nullopt;
+    }
+
+    std::string line = request.command;
+    for (const auto& argument : request.arguments) {
+        line += " " + argument;
+    }
+    std::optional<std::string> payload;
+    if (writeFrame(fd, line + "\n" + request.body)) {
+        payload = readFrame(fd);
+    }
+    close(fd);
+    if (!payload) {
+        std::cerr << "The daemon at " << path.string() << " closed the connection" << std::endl;
+        return std::nullopt;
+    }
+
+    auto [status, body] = firstLine(*payload);
+    ControlResponse response;
+    response.success = status == "ok";
+    response.body = std::move(body);
+    return response;
+}
+
+ControlRequest ControlClient::parse(const std::string& line, std::string body) {
+    ControlRequest request;
+    std::istringstream words(line);
+    words >> request.command;
+    std::string argument;
+    while (words >> argument) {
+        request.arguments.push_back(argument);
+    }
+    request.body = std::move(body);
+    return request;
+}
+
+} // namespace iptables
@@ -0,0 +1,246 @@
+#include "hitless_reload.hpp"
+#include "command_executor.hpp"
+#include "metrics.hpp"
+#include "reconciler.hpp"
+#include <algorithm>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+namespace iptables {
+
+namespace {
+
+// Tables in the order iptables-restore payloads are written
+const std::vector<std::string> kTableOrder = {"filter", "nat", "mangle", "raw"};
+
+// "-F" every chain, then "-X" every chain: chains may still jump to each other until all are empty
+void removeChains(std::ostringstream& out, const std::vector<std::string>& chains) {
+    for (const auto& chain : chains) {
+        out << "-F " << chain << "\n";
+    }
+    for (const auto& chain : chains) {
+        out << "-X " << chain << "\n";
+    }
+}
+
+std::string wrap(const std::string& table, const std::ostringstream& body) {
+    std::string lines = body.str();
+    return lines.empty() ? "" : "*" + table + "\n" + lines + "COMMIT\n";
+}
+
+// Run one --noflush transaction; an empty payload has nothing to do
+bool commit(const std::string& stage, const std::string& table, const std::string& payload) {
+    if (payload.empty()) {
+        return true;
+    }
+    auto result = CommandExecutor::executeRestore(payload, {"--noflush"});
+    if (!result.isSuccess()) {
+        std::cerr << "Reload " << stage << " of table " << table << " failed: " << result.getErrorMessage()
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+std::string HitlessReload::nextGeneration(const RulesetSnapshot& live) {
+    for (const auto& table : live.tables()) {
+        for (const auto& chain : RulesetCompiler::builtinChains(table)) {
+            const SnapshotChain* found = live.chain(table, chain);
+            if (found == nullptr) {
+                continue;
+            }
+            for (const auto& rule : found->rules) {
+                std::string target = Reconciler::isManaged(rule) ? Reconciler::jumpTarget(rule.spec) : "";
+                if (RulesetCompiler::isSectionChain(target) && target.size() > 2 &&
+                    target.compare(target.size() - 2, 2, ".a") == 0) {
+                    return "b";
+                }
+            }
+        }
+    }
+    return "a";
+}
+
+ReloadPlan HitlessReload::plan(const CompiledRuleset& ruleset, const RulesetSnapshot& live) {
+    ReloadPlan plan;
+    std::vector<std::string> wanted_tables = ruleset.tables();
+    std::set<std::string> replaced_chains;  // Custom chains under their configured names
+    for (const auto& chain : ruleset.section_chains) {
+        if (chain.parent.empty()) {
+            replaced_chains.insert(chain.section);
+        }
+    }
+
+    for (const auto& table : kTableOrder) {
+        bool wanted = std::find(wanted_tables.begin(), wanted_tables.end(), table) != wanted_tables.end();
+        if (!wanted && !live.hasTable(table)) {
+            continue;
+        }
+        TableReload reload;
+        reload.table = table;
+
+        // Build: new chains are declared, which creates them or empties leftovers of an aborted reload
+        std::ostringstream build, abandon;
+        std::vector<std::string> built;
+        for (const auto& chain : ruleset.section_chains) {
+            if (chain.table == table) {
+                build << ":" << chain.name << " - [0:0]\n";
+                built.push_back(chain.name);
+            }
+        }
+        for (const auto& rule : ruleset.rules) {
+            if (rule.table() == table && !RulesetCompiler::isBuiltinChain(rule.chain())) {
+                build << rule.toRestoreLine() << "\n";
+                plan.rules_built++;
+            }
+        }
+        removeChains(abandon, built);
+        plan.chains_built += built.size();
+
+        // Swap: managed rules of each built-in chain become the new jumps, in place
+        std::ostringstream swap;
+        for (const auto& chain : RulesetCompiler::builtinChains(table)) {
+            std::vector<RuleView> jumps;
+            for (const auto& rule : ruleset.rules) {
+                if (rule.table() == table && rule.chain() == chain) {
+                    jumps.push_back(rule);
+                }
+            }
+            std::vector<uint32_t> managed = live.findRulesWithPrefix(table, chain, "YAML:");
+
+            size_t replaced = std::min(jumps.size(), managed.size());
+            for (size_t i = 0; i < replaced; ++i) {
+                swap << jumps[i].toReplaceLine(managed[i]) << "\n";
+            }
+            // Bottom-up, so the positions still to be deleted stay valid
+            for (size_t i = managed.size(); i > replaced; --i) {
+                swap << "-D " << chain << " " << managed[i - 1] << "\n";
+            }
+            uint32_t position = replaced > 0 ? managed[replaced - 1] : 0;
+            for (size_t i = replaced; i < jumps.size(); ++i) {
+                swap << jumps[i].toRestoreLine(position > 0 ? ++position : 0) << "\n";
+            }
+            plan.jumps += jumps.size();
+            plan.rules_deleted += managed.size() - replaced;
+        }
+        if (table == "filter") {
+            for (const auto& [chain, policy] : ruleset.policies) {
+                const SnapshotChain* current = live.chain(table, chain);
+                std::string target = policyToString(policy);
+                if (current == nullptr || current->policy != target) {
+                    swap << "-P " << chain << " " << target << "\n";
+                    plan.policies++;
+                }
+            }
+        }
+
+        // Retire: everything the new generation replaces, unless foreign rules still jump to it
+        std::vector<std::string> retired;
+        for (const auto& chain : live.chainNames(table, true)) {
+            bool section = RulesetCompiler::isSectionChain(chain) && !ruleset.ownsChain(table, chain);
+            bool replaced_chain = table == "filter" && replaced_chains.count(chain) > 0;
+            if (section || replaced_chain) {
+                retired.push_back(chain);
+            }
+        }
+        // A kept chain keeps the chains it jumps to as well, so repeat until nothing changes
+        std::set<std::string> retiring(retired.begin(), retired.end());
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (const auto& chain : live.chainNames(table)) {
+                if (retiring.count(chain)) {
+                    continue;
+                }
+                bool builtin = !live.chain(table, chain)->isUserDefined();
+                for (const auto& rule : live.chain(table, chain)->rules) {
+                    // Managed rules of built-in chains are gone after the swap
+                    std::string target = builtin && Reconciler::isManaged(rule) ? "" : Reconciler::jumpTarget(rule.spec);
+                    if (retiring.erase(target) > 0) {
+                        std::cerr << "Warning: keeping chain " << table << "." << target
+                                  << " after reload, other rules still jump to it" << std::endl;
+                        changed = true;
+                    }
+                }
+            }
+        }
+        retired.erase(std::remove_if(retired.begin(), retired.end(), [&](const std::string& chain) {
+            return retiring.count(chain) == 0;
+        }), retired.end());
+        std::ostringstream retire;
+        removeChains(retire, retired);
+        plan.chains_retired += retired.size();
+
+        reload.build = wrap(table, build);
+        reload.swap = wrap(table, swap);
+        reload.retire = wrap(table, retire);
+        reload.abandon = wrap(table, abandon);
+        if (!reload.build.empty() || !reload.swap.empty() || !reload.retire.empty()) {
+            plan.tables.push_back(std::move(reload));
+        }
+    }
+    return plan;
+}
+
+bool HitlessReload::apply(const ReloadPlan& plan) {
+    // Make: nothing jumps to the new chains yet, so building them cannot affect traffic
+    size_t built = 0;
+    {
+        Metrics::PhaseTimer timer("build");
+        for (; built < plan.tables.size(); ++built) {
+            const TableReload& reload = plan.tables[built];
+            if (!commit("build", reload.table, reload.build)) {
+                break;
+            }
+        }
+    }
+
+    // Switch each table atomically; a table that fails keeps its old ruleset
+    size_t swapped = 0;
+    if (built == plan.tables.size()) {
+        Metrics::PhaseTimer timer("swap");
+        for (; swapped < plan.tables.size(); ++swapped) {
+            const TableReload& reload = plan.tables[swapped];
+            if (!commit("swap", reload.table, reload.swap)) {
+                break;
+            }
+        }
+    }
+
+    Metrics::PhaseTimer timer("retire");
+    for (size_t i = swapped; i < built; ++i) {
+        const TableReload& reload = plan.tables[i];
+        if (!commit("cleanup", reload.table, reload.abandon)) {
+            std::cerr << "Warning: unused chains of generation " << plan.generation << " remain in table "
+                      << reload.table << std::endl;
+        }
+    }
+
+    // Break: the old chains of every switched table are unreferenced now
+    for (size_t i = 0; i < swapped; ++i) {
+        const TableReload& reload = plan.tables[i];
+        if (!commit("retire", reload.table, reload.retire)) {
+            std::cerr << "Warning: unused chains of the previous ruleset remain in table " << reload.table
+                      << std::endl;
+        }
+    }
+    if (swapped < plan.tables.size()) {
+        if (swapped > 0) {
+            std::cerr << "Warning: " << swapped << " of " << plan.tables.size()
+                      << " table(s) switched to the new ruleset before the reload failed" << std::endl;
+        }
+        return false;
+    }
+
+    Metrics::recordOperations("create_chain", plan.chains_built);
+    Metrics::recordOperations("append", plan.rules_built);
+    Metrics::recordOperations("jump", plan.jumps);
+    Metrics::recordOperations("delete", plan.rules_deleted);
+    Metrics::recordOperations("set_policy", plan.policies);
+    Metrics::recordOperations("delete_chain", plan.chains_retired);
+    return true;
+}
+
+} // namespace iptables
@@ -3,9 +3,24 @@
 #include "system_utils.hpp"
 #include "command_executor.hpp"
 #include "rule_validator.hpp"
+#include "ruleset_compiler.hpp"
+#include "restore_backend.hpp"
+#include "libiptc_backend.hpp"
+#include "restore_session.hpp"
+#include "reconciler.hpp"
+#include "table_scheduler.hpp"
+#include "xtables_lock.hpp"
+#include "metrics.hpp"
+#include "hitless_reload.hpp"
+#include "state_journal.hpp"
+#include "ruleset_cache.hpp"
+#include "change_monitor.hpp"
+#include "control_socket.hpp"
 #include <iostream>
 #include <sstream>
 #include <algorithm>
+#include <map>
+#include <set>
 
 namespace iptables {
 
@@ -14,87 +29,67 @@ IptablesManager::IptablesManager()
     : chain_manager_(command_executor_) {
 }
 
-// Helper function to convert Policy enum to string
-std::string policyToString(Policy policy) {
-    switch (policy) {
-        case Policy::Accept: return "ACCEPT";
-        case Policy::Drop: return "DROP";
-        case Policy::Reject: return "REJECT";
-        default: return "ACCEPT";
+// Read the live ruleset once; later lookups are answered from the snapshot
+bool IptablesManager::captureSnapshot(bool use_journal) {
+    Metrics::PhaseTimer timer("snapshot");
+    snapshot_.reset();
+    // A resident copy of the journal saves reading and parsing the state file
+    snapshot_resident_ = use_journal && resident_ &&
+                         StateJournal::fingerprint(resident_->snapshot.tables()) == resident_->fingerprint;
+    if (snapshot_resident_) {
+        snapshot_ = resident_->snapshot;
+    } else if (use_journal) {
+        snapshot_ = StateJournal::recall();
     }
-}
-
-std::string actionToString(Action action) {
-    switch (action) {
-        case Action::Accept: return "ACCEPT";
-        case Action::Drop: return "DROP";
-        case Action::Reject: return "REJECT";
-        default: return "ACCEPT";
+    snapshot_recalled_ = snapshot_.has_value();
+    if (!snapshot_recalled_) {
+        snapshot_ = RulesetSnapshot::capture();
     }
+    chain_manager_.setSnapshot(snapshot_ ? &*snapshot_ : nullptr);
+    return snapshot_.has_value();
 }
 
-// Helper function to generate interface comment
-std::string getInterfaceComment(const std::optional<InterfaceConfig>& interface) {
-    if (interface.has_value()) {
-        std::string in_iface = interface->input.value_or("any");
-        std::string out_iface = interface->output.value_or("any");
-        return "i:" + in_iface + ":o:" + out_iface;
+// Journal the ruleset after a successful run so the next one need not list it
+void IptablesManager::recordState(bool mirrored) {
+    Metrics::PhaseTimer timer("journal");
+    std::optional<RulesetSnapshot> state;
+    std::optional<uint64_t> before;
+    if (mirrored) {
+        state = snapshot_;
+    } else {
+        // The fingerprint is read before listing and again when recording, so
+        // a change another tool makes in between is never journalled as the
+        // kernel's state. The tables to fingerprint are only known for sure
+        // once listed; if the guess was wrong, list once more.
+        std::vector<std::string> tables = snapshot_ ? snapshot_->tables() : std::vector<std::string>{"filter", "nat"};
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            before = StateJournal::fingerprint(tables);
+            state = RulesetSnapshot::capture();
+            if (!state || !before || state->tables() == tables) {
+                break;
+            }
+            tables = state->tables();
+            before.reset();
+        }
     }
-    return "i:any:o:any";
-}
-
-// Helper function to get rule line numbers by comment signature
-std::vector<uint32_t> getRuleLineNumbers(const std::string& table, const std::string& chain, const std::string& comment) {
-    std::vector<uint32_t> line_numbers;
-    
-    // Execute iptables -L with line numbers
-    std::vector<std::string> cmd_args = {"-t", table, "-L", chain, "--line-numbers"};
-    auto result = CommandExecutor::executeIptables(cmd_args);
-    
-    if (!result.isSuccess()) {
-        // Chain might not exist, return empty list
-        return line_numbers;
+    resident_.reset();
+    if (!state || (!mirrored && !before)) {
+        StateJournal::discard();
+        return;
     }
-    
-    // Parse output to find matching rules
-    std::istringstream iss(result.stdout_output);
-    std::string line;
-    while (std::getline(iss, line)) {
-        if (line.find(comment) != std::string::npos) {
-            // Extract line number (first token)
-            std::istringstream line_stream(line);
-            std::string line_num_str;
-            if (line_stream >> line_num_str) {
-                try {
-                    uint32_t line_num = std::stoul(line_num_str);
-                    line_numbers.push_back(line_num);
-                } catch (const std::exception&) {
-                    // Not a number, skip
-                }
-            }
+    StateJournal::record(*state, journal_index_, before);
+    if (keep_resident_) {
+        std::optional<uint64_t> fingerprint = StateJournal::fingerprint(state->tables());
+        if (fingerprint && (!before || *fingerprint == *before)) {
+            resident_ = ResidentState{std::move(*state), *fingerprint, journal_index_.sections};
         }
     }
-    
-    return line_numbers;
 }
 
-// Helper function to remove rules by signature
-bool removeRulesBySignature(const std::string& table, const std::string& chain, const std::string& comment) {
-    auto line_numbers = getRuleLineNumbers(table, chain, comment);
-    
-    // Sort in descending order to delete from bottom to top
-    std::sort(line_numbers.begin(), line_numbers.end(), std::greater<uint32_t>());
-    
-    bool success = true;
-    for (uint32_t line_num : line_numbers) {
-        auto result = CommandExecutor::removeRuleByLineNumber(table, chain, line_num);
-        if (!result.isSuccess()) {
-            std::cerr << "Failed to remove rule at line " << line_num << ": " << result.getErrorMessage() << std::endl;
-            success = false;
-        }
-    }
-    
-    return success;
+// Forget the snapshot after operations that are not mirrored into it
+void IptablesManager::dropSnapshot() {
+    chain_manager_.setSnapshot(nullptr);
+    snapshot_.reset();
 }
 
 bool IptablesManager::loadConfig(const std::filesystem::path& config_path) {
@@ -102,132 +97,19 @@ bool IptablesManager::loadConfig(const std::filesystem::path& config_path) {
         std::cout << "Loading configuration from: " << config_path << std::endl;
         
         // Use ConfigParser to load the configuration
-        Config config = ConfigParser::loadFromFile(config_path.string());
+        Config config = loadConfigFile(config_path, std::cout);
         
         std::cout << "Configuration loaded successfully" << std::endl;
         
         // Validate rule order before applying configuration
-        std::cout << "Validating rule order..." << std::endl;
-        auto warnings = RuleValidator::validateRuleOrder(config);
-        
-        if (!warnings.empty()) {
-            std::cout << "Found " << warnings.size() << " potential rule ordering issue(s):" << std::endl;
-            for (const auto& warning : warnings) {
-                switch (warning.type) {
-                    case ValidationWarning::Type::UnreachableRule:
-                        std::cout << "  WARNING (Unreachable Rule): " << warning.message << std::endl;
-                        break;
-                    case ValidationWarning::Type::RedundantRule:
-                        std::cout << "  WARNING (Redundant Rule): " << warning.message << std::endl;
-                        break;
-                    case ValidationWarning::Type::SubnetOverlap:
-                        std::cout << "  WARNING (Subnet Overlap): " << warning.message << std::endl;
-                        break;
-                }
-            }
-            std::cout << "These warnings indicate potential misconfigurations where rules may not work as expected." << std::endl;
-            std::cout << "Consider reordering rules to place more specific conditions before general ones." << std::endl;
-            std::cout << std::endl;
-        } else {
-            std::cout << "Rule order validation passed - no issues detected." << std::endl;
-        }
-        
-        // Process filter section if present
-        if (config.filter) {
-            std::cout << "Processing filter section" << std::endl;
-            if (!processFilterConfig(*config.filter)) {
-                std::cerr << "Failed to process filter configuration" << std::endl;
-                return false;
-            }
-        }
+        reportValidationWarnings(config, std::cout);
         
-        // Process chain configurations (create custom chains)
-        std::cout << "Processing chain configurations..." << std::endl;
-        if (!chain_manager_.processChainConfigurations(config)) {
-            std::cerr << "Failed to process chain configurations: " << chain_manager_.getLastError() << std::endl;
+        CompiledRuleset ruleset;
+        if (!compileConfig(config, ruleset, std::cerr)) {
             return false;
         }
-        std::cout << "Chain configurations processed successfully" << std::endl;
-        
-        // Build section name to chain name mapping for resolving references
-        section_to_chain_map_.clear();
-        for (const auto& [section_name, chain_config] : config.chain_definitions) {
-            for (const auto& chain_rule : chain_config.chain) {
-                section_to_chain_map_[section_name] = chain_rule.name;
-                break; // Use the first (and typically only) chain in the section
-            }
-        }
         
-        // ✨ NEW: Process chain rules (populate chains with rules) - Phase 6.3.4
-        std::cout << "Processing chain rules..." << std::endl;
-        for (const auto& [yaml_object_name, chain_config] : config.chain_definitions) {
-            // Process each chain rule in the configuration
-            for (const auto& chain_rule : chain_config.chain) {
-                std::cout << "Processing chain configuration: " << yaml_object_name << std::endl;
-                
-                // Use the actual chain name from the ChainRuleConfig.name field
-                if (!processChainRuleConfig(chain_rule.name, chain_rule)) {
-                    std::cerr << "Failed to process chain rules for: " << chain_rule.name << std::endl;
-                    return false;
-                }
-            }
-        }
-        std::cout << "Chain rules processed successfully" << std::endl;
-        
-        // Process custom sections in the order they appear in YAML
-        std::cout << "Custom sections: " << config.custom_sections.size() << std::endl;
-        for (const auto& [section_name, section] : config.custom_sections) {
-            std::cout << "Processing section: " << section_name << std::endl;
-            
-            // Process port rules in order
-            if (section.ports) {
-                for (const auto& port : *section.ports) {
-                    if (!processPortConfig(port, section_name)) {
-                        std::cerr << "Failed to process port configuration in section " << section_name << std::endl;
-                        return false;
-                    }
-                }
-            }
-            
-            // Process MAC rules in order
-            if (section.mac) {
-                for (const auto& mac : *section.mac) {
-                    if (!processMacConfig(mac, section_name)) {
-                        std::cerr << "Failed to process MAC configuration in section " << section_name << std::endl;
-                        return false;
-                    }
-                }
-            }
-            
-            // Process interface rules in order
-            if (section.interface) {
-                for (const auto& interface : *section.interface) {
-                    if (!processInterfaceConfig(interface, section_name)) {
-                        std::cerr << "Failed to process interface configuration in section " << section_name << std::endl;
-                        return false;
-                    }
-                }
-            }
-            
-            // ✨ NEW: Process interface-based chain calls
-            if (section.interface_config) {
-                if (!processInterfaceChainCall(*section.interface_config, section_name)) {
-                    std::cerr << "Failed to process interface chain call in section " << section_name << std::endl;
-                    return false;
-                }
-            }
-            
-            // Process general action rules (catch-all rules)
-            if (section.action) {
-                if (!processActionConfig(*section.action, section_name)) {
-                    std::cerr << "Failed to process action configuration in section " << section_name << std::endl;
-                    return false;
-                }
-            }
-        }
-        
-        std::cout << "Configuration processing completed" << std::endl;
-        return true;
+        return applyRuleset(ruleset, std::cout, std::cerr);
         
     } catch (const std::exception& e) {
         std::cerr << "Error loading configuration: " << e.what() << std::endl;
@@ -235,582 +117,860 @@ bool IptablesManager::loadConfig(const std::filesystem::path& config_path) {
     }
 }
 
-bool IptablesManager::processFilterConfig(const FilterConfig& filter) {
-    std::cout << "Processing filter configuration" << std::endl;
-    
-    bool success = true;
-    
-    // Set default policies if specified
-    if (filter.input) {
-        std::cout << "Setting INPUT policy to: " << policyToString(*filter.input) << std::endl;
-        
-        // Generate comment for this policy rule
-        std::string comment = "YAML:filter:input:" + getInterfaceComment(std::nullopt);
-        
-        // Remove existing rules with this signature (policies don't have rules to remove, but we clean up any custom rules)
-        removeRulesBySignature("filter", "INPUT", comment);
-        
-        // Set the policy using CommandExecutor
-        auto result = CommandExecutor::setChainPolicy("filter", "INPUT", policyToString(*filter.input));
-        if (!result.isSuccess()) {
-            std::cerr << "Failed to set INPUT policy: " << result.getErrorMessage() << std::endl;
-            success = false;
+bool IptablesManager::loadFromCache(const std::filesystem::path& config_path) {
+    Metrics::PhaseTimer cache_timer("cache");
+    std::optional<uint64_t> key = RulesetCache::key(config_path, section_chains_);
+    std::optional<CachedRuleset> cached = key ? RulesetCache::load(*key) : std::nullopt;
+    
+    // The payload replaces whole tables, so it is only restored where
+    // there is nothing it could wipe out
+    std::string reason;
+    if (!key) {
+        reason = "configuration file cannot be read";
+    } else if (!cached) {
+        reason = "no cached ruleset for this configuration";
+    } else {
+        std::optional<bool> empty = StateJournal::isEmpty(cached->tables);
+        if (!empty) {
+            reason = "tables cannot be inspected";
+        } else if (!*empty) {
+            reason = "tables already hold rules";
         }
     }
     
-    if (filter.output) {
-        std::cout << "Setting OUTPUT policy to: " << policyToString(*filter.output) << std::endl;
-        
-        std::string comment = "YAML:filter:output:" + getInterfaceComment(std::nullopt);
-        removeRulesBySignature("filter", "OUTPUT", comment);
-        
-        auto result = CommandExecutor::setChainPolicy("filter", "OUTPUT", policyToString(*filter.output));
-        if (!result.isSuccess()) {
-            std::cerr << "Failed to set OUTPUT policy: " << result.getErrorMessage() << std::endl;
-            success = false;
+    if (reason.empty()) {
+        CommandResult result = CommandExecutor::executeRestore(cached->payload);
+        cache_timer.stop();
+        if (result.success) {
+            // Nothing recorded the tables this payload produced
+            StateJournal::discard();
+            std::cout << "Restored cached ruleset from " << RulesetCache::path().string() << std::endl;
+            return true;
         }
+        std::cerr << "Warning: restoring the cached ruleset failed: " << result.stderr_output << std::endl;
+        reason = "cached ruleset was rejected";
     }
+    cache_timer.stop();
+    std::cout << "Compiling configuration: " << reason << std::endl;
     
-    if (filter.forward) {
-        std::cout << "Setting FORWARD policy to: " << policyToString(*filter.forward) << std::endl;
-        
-        std::string comment = "YAML:filter:forward:" + getInterfaceComment(std::nullopt);
-        removeRulesBySignature("filter", "FORWARD", comment);
+    try {
+        std::cout << "Loading configuration from: " << config_path << std::endl;
+        Config config = loadConfigFile(config_path, std::cout);
+        std::cout << "Configuration loaded successfully" << std::endl;
+        reportValidationWarnings(config, std::cout);
         
-        auto result = CommandExecutor::setChainPolicy("filter", "FORWARD", policyToString(*filter.forward));
-        if (!result.isSuccess()) {
-            std::cerr << "Failed to set FORWARD policy: " << result.getErrorMessage() << std::endl;
-            success = false;
+        CompiledRuleset ruleset;
+        if (!compileConfig(config, ruleset, std::cerr) || !applyRuleset(ruleset, std::cout, std::cerr)) {
+            return false;
         }
-    }
-    
-    // Process MAC rules in filter section
-    if (filter.mac) {
-        for (const auto& mac : *filter.mac) {
-            if (!processMacConfig(mac, "filter")) {
-                std::cerr << "Failed to process MAC configuration in filter section" << std::endl;
-                success = false;
-            }
+        // The key was taken before parsing, so an edit in between only costs a miss
+        if (key) {
+            RulesetCache::store(*key, ruleset);
         }
+        return true;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Error loading configuration: " << e.what() << std::endl;
+        return false;
     }
-    
-    return success;
 }
 
-bool IptablesManager::processPortConfig(const PortConfig& port, const std::string& section_name) {
-    std::cout << "Processing port configuration for section: " << section_name << std::endl;
-    
-    // Handle single port or multiport
-    std::string port_description;
-    if (port.port) {
-        std::cout << "  Single port: " << *port.port << std::endl;
-        port_description = std::to_string(*port.port);
-    } else if (port.range) {
-        std::cout << "  Port ranges: ";
-        for (const auto& range_str : *port.range) {
-            std::cout << range_str << " ";
-        }
-        std::cout << std::endl;
-        
-        // Create comma-separated list for multiport
-        std::ostringstream range_list;
-        for (size_t i = 0; i < port.range->size(); ++i) {
-            if (i > 0) range_list << ",";
-            range_list << (*port.range)[i];
-        }
-        port_description = "multiport:" + range_list.str();
-    } else {
-        std::cerr << "Invalid port configuration: neither port nor range specified" << std::endl;
-        return false;
+bool IptablesManager::applyRuleset(const CompiledRuleset& ruleset, std::ostream& out, std::ostream& err) {
+    // Transactional backends commit the whole configuration at once
+    if (isTransactional()) {
+        return applyTransactional(ruleset, out, err);
     }
     
-    std::cout << "  Direction: " << static_cast<int>(port.direction) << std::endl;
-    std::cout << "  Allow: " << (port.allow ? "true" : "false") << std::endl;
-    std::cout << "  Protocol: " << static_cast<int>(port.protocol) << std::endl;
-    
-    if (port.interface) {
-        if (port.interface->input) {
-            std::cout << "  Input interface: " << *port.interface->input << std::endl;
-        }
-        if (port.interface->output) {
-            std::cout << "  Output interface: " << *port.interface->output << std::endl;
-        }
+    // One iptables-save, or none if the state journal still matches the
+    // kernel, then only the differences are written
+    if (!captureSnapshot(true)) {
+        return false;
     }
-    
-    if (port.subnet) {
-        std::cout << "  Subnets: ";
-        for (const auto& subnet : *port.subnet) {
-            std::cout << subnet << " ";
-        }
-        std::cout << std::endl;
+    ReconcilePlan plan = planChanges(ruleset, out);
+    out << "Reconciling " << ruleset.rules.size() << " rule(s): " << plan.unchanged
+        << " already in place, " << plan.operations.size() << " change(s) needed" << std::endl;
+    
+    Metrics::PhaseTimer apply_timer("apply");
+    bool applied = (backend_ == Backend::Stream) ? streamPlan(plan, out, err) : executePlan(plan, out, err);
+    apply_timer.stop();
+    if (applied) {
+        recordPlanOperations(plan);
+        recordState(plan.empty());
+    } else {
+        StateJournal::discard();
     }
-    
-    if (port.mac_source) {
-        std::cout << "  MAC source: " << *port.mac_source << std::endl;
+    dropSnapshot();
+    if (!applied) {
+        return false;
     }
     
-    if (port.forward) {
-        std::cout << "  Forward port: " << *port.forward << std::endl;
+    out << "Configuration processing completed" << std::endl;
+    return true;
+}
+
+bool IptablesManager::planConfig(const std::filesystem::path& config_path) {
+    try {
+        // Diagnostics go to stderr so that stdout holds only the plan
+        Config config = loadConfigFile(config_path, std::cerr);
+        reportValidationWarnings(config, std::cerr);
         
-        // Port forwarding only works with single ports, not ranges
-        if (port.range) {
-            std::cerr << "Port forwarding is not supported with port ranges" << std::endl;
+        CompiledRuleset ruleset;
+        if (!compileConfig(config, ruleset, std::cerr) || !captureSnapshot(true)) {
             return false;
         }
-    }
-    
-    // Generate rule comment
-    std::string iface_comment = getInterfaceComment(port.interface);
-    std::string mac_comment = port.mac_source.value_or("any");
-    
-    if (port.forward) {
-        // Handle port forwarding in NAT table
-        std::string comment = "YAML:" + section_name + ":port:" + port_description + ":forward:" + iface_comment + ":mac:" + mac_comment;
+        ReconcilePlan plan = planChanges(ruleset, std::cerr);
+        dropSnapshot();
         
-        // Remove existing rules with this signature
-        removeRulesBySignature("nat", "PREROUTING", comment);
-        
-        // Build iptables command for port forwarding
-        std::vector<std::string> args = {"-t", "nat", "-A", "PREROUTING"};
+        printPlan(plan, std::cout);
+        return true;
         
-        // Add interface specifications if present
-        if (port.interface) {
-            if (port.interface->input) {
-                args.push_back("-i");
-                args.push_back(*port.interface->input);
-            }
-            if (port.interface->output) {
-                args.push_back("-o");
-                args.push_back(*port.interface->output);
-            }
-        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error planning configuration: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool IptablesManager::reloadConfig(const std::filesystem::path& config_path) {
+    try {
+        std::cout << "Reloading configuration from: " << config_path << std::endl;
+        Config config = loadConfigFile(config_path, std::cout);
+        reportValidationWarnings(config, std::cout);
         
-        // Add MAC source if specified
-        if (port.mac_source) {
-            args.push_back("-m");
-            args.push_back("mac");
-            args.push_back("--mac-source");
-            args.push_back(*port.mac_source);
+        // The generation not serving traffic is rebuilt and then swapped in
+        if (!captureSnapshot(true)) {
+            return false;
         }
-        
-        // Add protocol and port
-        std::string protocol_str = (port.protocol == Protocol::Tcp) ? "tcp" : "udp";
-        args.insert(args.end(), {
-            "-p", protocol_str,
-            "-m", protocol_str,
-            "--dport", std::to_string(*port.port),
-            "-m", "comment",
-            "--comment", comment,
-            "-j", "REDIRECT",
-            "--to-port", std::to_string(*port.forward)
-        });
-        
-        auto result = CommandExecutor::executeIptables(args);
-        if (!result.isSuccess()) {
-            std::cerr << "Failed to add port forwarding rule: " << result.getErrorMessage() << std::endl;
+        std::string generation = HitlessReload::nextGeneration(*snapshot_);
+        CompiledRuleset ruleset;
+        if (!compileConfig(config, ruleset, std::cerr, generation)) {
+            dropSnapshot();
             return false;
         }
+        Metrics::PhaseTimer plan_timer("plan");
+        ReloadPlan plan = HitlessReload::plan(ruleset, *snapshot_);
+        plan.generation = generation;
+        plan_timer.stop();
+        dropSnapshot();
         
-    } else {
-        // Handle regular rules in the specified chain
-        std::string comment = "YAML:" + section_name + ":port:" + port_description + ":" + iface_comment + ":mac:" + mac_comment;
-        
-        // Add subnet information to make rules unique
-        if (port.subnet && !port.subnet->empty()) {
-            comment += ":subnet:";
-            for (size_t i = 0; i < port.subnet->size(); ++i) {
-                if (i > 0) comment += ",";
-                comment += (*port.subnet)[i];
-            }
-        } else {
-            comment += ":subnet:any";
+        std::cout << "Building generation " << generation << ": " << plan.chains_built << " chain(s) with "
+                  << plan.rules_built << " rule(s)" << std::endl;
+        if (!HitlessReload::apply(plan)) {
+            StateJournal::discard();
+            std::cerr << "Reload failed" << std::endl;
+            return false;
         }
+        recordState(false);
+        std::cout << "Switched " << plan.tables.size() << " table(s) to generation " << generation << " with "
+                  << plan.jumps << " jump(s), retired " << plan.chains_retired << " chain(s)" << std::endl;
+        return true;
         
-        // Add action to make rules unique
-        comment += ":";
-        comment += (port.allow ? "ACCEPT" : "DROP");
+    } catch (const std::exception& e) {
+        std::cerr << "Error reloading configuration: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+std::optional<bool> IptablesManager::checkConfig(const std::filesystem::path& config_path, bool record) {
+    try {
+        // Rule order warnings say nothing about drift and cost more than the check itself
+        Config config = loadConfigFile(config_path, std::cout);
         
-        // ✨ NEW: Handle chain targets
-        if (port.chain) {
-            // Add chain information to comment
-            comment += ":chain:" + *port.chain;
-            
-            std::cout << "  Chain target: " << *port.chain << std::endl;
+        CompiledRuleset ruleset;
+        if (!compileConfig(config, ruleset, std::cerr) || !captureSnapshot(true)) {
+            return std::nullopt;
         }
-        
-        // Convert direction to chain name
-        std::string chain;
-        switch (port.direction) {
-            case Direction::Input:
-                chain = "INPUT";
-                break;
-            case Direction::Output:
-                chain = "OUTPUT";
-                break;
-            case Direction::Forward:
-                chain = "FORWARD";
-                break;
+        std::ostream quiet(nullptr);
+        ReconcilePlan plan = planChanges(ruleset, quiet);
+        if (plan.empty()) {
+            // The listing shows the configuration in place; journal it if asked, so the next run needs none
+            if (record && !snapshot_recalled_) {
+                recordState(true);
+            }
+            dropSnapshot();
+            std::cout << "No drift: " << plan.unchanged << " managed rule(s) in place" << std::endl;
+            return true;
         }
+        dropSnapshot();
         
-        // Remove existing rules with this signature
-        removeRulesBySignature("filter", chain, comment);
-        
-        // Build iptables command for regular rule
-        std::vector<std::string> args = {"-A", chain};
+        size_t chains = reportDrift(plan, std::cout);
+        std::cout << "Drift: " << plan.operations.size() << " change(s) needed in " << chains << " chain(s)"
+                  << std::endl;
+        return false;
         
-        // Add interface specifications if present
-        if (port.interface) {
-            if (port.interface->input) {
-                args.push_back("-i");
-                args.push_back(*port.interface->input);
-            }
-            if (port.interface->output) {
-                args.push_back("-o");
-                args.push_back(*port.interface->output);
+    } catch (const std::exception& e) {
+        std::cerr << "Error checking configuration: " << e.what() << std::endl;
+        return std::nullopt;
+    }
+}
+
+bool IptablesManager::watchConfig(const std::filesystem::path& config_path) {
+    CompiledRuleset ruleset;
+    if (!compileFile(config_path, ruleset, std::cout)) {
+        return false;
+    }
+    
+    ChangeMonitor monitor(ruleset.tables());
+    std::cout << "Watching " << ruleset.tables().size() << " table(s) for drift using "
+              << (monitor.eventDriven() ? "netfilter notifications" : "table fingerprints") << std::endl;
+    
+    // Each pass starts from a quiet monitor, so the repair's own writes are not a change
+    do {
+        try {
+            if (!repairDrift(ruleset)) {
+                std::cerr << "Repair incomplete; retrying at the next change" << std::endl;
             }
+        } catch (const std::exception& e) {
+            std::cerr << "Error repairing drift: " << e.what() << std::endl;
+            dropSnapshot();
         }
-        
-        // Add MAC source if specified
-        if (port.mac_source) {
-            args.push_back("-m");
-            args.push_back("mac");
-            args.push_back("--mac-source");
-            args.push_back(*port.mac_source);
+        monitor.rearm();
+    } while (monitor.waitForChange());
+    
+    std::cout << "Stopped watching" << std::endl;
+    return true;
+}
+
+bool IptablesManager::runDaemon(const std::filesystem::path& config_path) {
+    keep_resident_ = true;
+    config_loader_.keepParsed(true);
+    DaemonState state;
+    state.config_path = config_path;
+    state.contents = RulesetCache::key(config_path, section_chains_);
+    try {
+        std::cout << "Loading configuration from: " << config_path << std::endl;
+        state.config = loadConfigFile(config_path, std::cout);
+        reportValidationWarnings(state.config, std::cout);
+        if (!compileConfig(state.config, state.ruleset, std::cerr)) {
+            return false;
         }
-        
-        // Add subnets if specified
-        if (port.subnet && !port.subnet->empty()) {
-            args.push_back("-s");
-            std::ostringstream subnet_list;
-            for (size_t i = 0; i < port.subnet->size(); ++i) {
-                if (i > 0) subnet_list << ",";
-                subnet_list << (*port.subnet)[i];
-            }
-            args.push_back(subnet_list.str());
+    } catch (const std::exception& e) {
+        std::cerr << "Error loading configuration: " << e.what() << std::endl;
+        return false;
+    }
+    
+    ChangeMonitor monitor(state.ruleset.tables());
+    if (!monitor.watchFiles({config_path, ConfigLoader::fragmentDirectory(config_path)})) {
+        std::cerr << "Cannot watch " << config_path.string() << " for changes" << std::endl;
+        return false;
+    }
+    ControlServer server(control_socket_);
+    if (!server.listen()) {
+        return false;
+    }
+    monitor.watchRequests(server.descriptor());
+    state.monitor = &monitor;
+    std::cout << "Daemon following " << config_path.string() << " and " << state.ruleset.tables().size()
+              << " table(s) using " << (monitor.eventDriven() ? "netfilter notifications" : "table fingerprints")
+              << ", control socket " << control_socket_.string() << std::endl;
+    
+    bool reapply = true;
+    do {
+        if (monitor.requestsPending()) {
+            server.serve([this, &state](const ControlRequest& request) { return handleRequest(request, state); });
         }
-        
-        // Add protocol and port specification
-        std::string protocol_str = (port.protocol == Protocol::Tcp) ? "tcp" : "udp";
-        args.insert(args.end(), {"-p", protocol_str});
-        
-        if (port.port) {
-            // Single port
-            args.insert(args.end(), {"-m", protocol_str, "--dport", std::to_string(*port.port)});
-        } else if (port.range) {
-            // Multiple port ranges using multiport extension
-            args.insert(args.end(), {"-m", "multiport", "--dports"});
-            
-            // Build comma-separated list of port ranges
-            std::ostringstream port_list;
-            for (size_t i = 0; i < port.range->size(); ++i) {
-                if (i > 0) port_list << ",";
-                port_list << (*port.range)[i];
+        if (monitor.filesChanged()) {
+            // The fragment directory may have been created or replaced
+            monitor.watchFiles({config_path, ConfigLoader::fragmentDirectory(config_path)});
+            // Touching a file, or saving it unchanged, costs one read and no parse
+            std::optional<uint64_t> current = RulesetCache::key(config_path, section_chains_);
+            if (current != state.contents) {
+                state.contents = current;
+                reapply = reloadDaemonConfig(state, std::cout, std::cerr);
             }
-            args.push_back(port_list.str());
         }
-        
-        // ✨ NEW: Add target (action or chain)
-        args.insert(args.end(), {
-            "-m", "comment",
-            "--comment", comment,
-            "-j", port.chain ? *port.chain : (port.allow ? "ACCEPT" : "DROP")
-        });
-        
-        auto result = CommandExecutor::executeIptables(args);
-        if (!result.isSuccess()) {
-            std::cerr << "Failed to add port rule: " << result.getErrorMessage() << std::endl;
-            return false;
+        if (reapply || monitor.tablesChanged()) {
+            try {
+                bool success = reapply ? applyRuleset(state.ruleset, std::cout, std::cerr) : repairDrift(state.ruleset);
+                if (reapply) {
+                    ++state.applies;
+                    state.last_apply_ok = success;
+                }
+                reapply = false;
+                if (!success) {
+                    std::cerr << "Apply incomplete; retrying at the next change" << std::endl;
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "Error applying configuration: " << e.what() << std::endl;
+                dropSnapshot();
+            }
         }
-    }
+        monitor.rearm();
+    } while (monitor.waitForChange());
     
+    std::cout << "Daemon stopped" << std::endl;
     return true;
 }
 
-bool IptablesManager::processMacConfig(const MacConfig& mac, const std::string& section_name) {
-    std::cout << "Processing MAC configuration for section: " << section_name << std::endl;
-    std::cout << "  MAC source: " << mac.mac_source << std::endl;
-    std::cout << "  Direction: " << static_cast<int>(mac.direction) << std::endl;
-    std::cout << "  Allow: " << (mac.allow ? "true" : "false") << std::endl;
-    
-    if (mac.interface) {
-        if (mac.interface->input) {
-            std::cout << "  Input interface: " << *mac.interface->input << std::endl;
-        }
-        if (mac.interface->output) {
-            std::cout << "  Output interface: " << *mac.interface->output << std::endl;
+// Parse the configuration file again; a file that does not parse changes nothing
+bool IptablesManager::reloadDaemonConfig(DaemonState& state, std::ostream& out, std::ostream& err) {
+    try {
+        out << "Loading configuration from: " << state.config_path << std::endl;
+        Config config = loadConfigFile(state.config_path, out);
+        reportValidationWarnings(config, out);
+        CompiledRuleset ruleset;
+        if (compileConfig(config, ruleset, err)) {
+            state.config = std::move(config);
+            state.ruleset = std::move(ruleset);
+            state.monitor->watchTables(state.ruleset.tables());
+            return true;
         }
+    } catch (const std::exception& e) {
+        err << "Error loading configuration: " << e.what() << std::endl;
     }
-    
-    if (mac.subnet) {
-        std::cout << "  Subnets: ";
-        for (const auto& subnet : *mac.subnet) {
-            std::cout << subnet << " ";
+    err << "Keeping the previous configuration in force" << std::endl;
+    return false;
+}
+
+// Compile an edited configuration and apply it; the previous one stays if it does not compile
+bool IptablesManager::applyDaemonConfig(DaemonState& state, Config config, std::ostream& out, std::ostream& err) {
+    CompiledRuleset ruleset;
+    if (!compileConfig(config, ruleset, err)) {
+        return false;
+    }
+    state.config = std::move(config);
+    state.ruleset = std::move(ruleset);
+    state.monitor->watchTables(state.ruleset.tables());
+    state.last_apply_ok = applyRuleset(state.ruleset, out, err);
+    ++state.applies;
+    return state.last_apply_ok;
+}
+
+ControlResponse IptablesManager::handleRequest(const ControlRequest& request, DaemonState& state) {
+    const std::string& command = request.command;
+    bool changes = command == "apply-config" || command == "apply-section" || command == "remove-section";
+    
+    // What the request itself prints becomes the response; other output, e.g.
+    // diagnostics, still goes to the daemon's own streams
+    std::ostringstream out;
+    ControlResponse response;
+    try {
+        if (command == "status") {
+            std::optional<uint64_t> fingerprint =
+                resident_ ? StateJournal::fingerprint(resident_->snapshot.tables()) : std::nullopt;
+            out << "config " << state.config_path.string() << "\n"
+                << "sections " << state.config.custom_sections.size() << "\n"
+                << "rules " << state.ruleset.rules.size() << "\n"
+                << "applies " << state.applies << "\n"
+                << "last_apply " << (state.last_apply_ok ? "ok" : "failed") << "\n"
+                << "kernel " << (!resident_ ? "unknown" : fingerprint == resident_->fingerprint ? "unchanged" : "changed")
+                << "\n";
+        } else if (command == "plan") {
+            if (captureSnapshot(true)) {
+                printPlan(planChanges(state.ruleset, out), out);
+            } else {
+                response.success = false;
+            }
+            dropSnapshot();
+        } else if (command == "query") {
+            // Rules of all sections, or of the sections named; naming a template section selects all its instances
+            std::set<std::string> sections(request.arguments.begin(), request.arguments.end());
+            for (const auto& rule : state.ruleset.rules) {
+                std::string section = rule.section();
+                if (sections.empty() || sections.count(section) || sections.count(section.substr(0, section.find('[')))) {
+                    out << rule.table() << " " << rule.chain() << " " << rule.comment() << " "
+                        << rule.description() << "\n";
+                }
+            }
+        } else if (command == "apply-config") {
+            // The file is read even if unchanged, e.g. to drop sections set over the socket
+            state.contents = RulesetCache::key(state.config_path, section_chains_);
+            response.success = reloadDaemonConfig(state, out, out);
+            if (response.success) {
+                state.last_apply_ok = response.success = applyRuleset(state.ruleset, out, out);
+                ++state.applies;
+            }
+        } else if (command == "apply-section") {
+            // The body holds sections as they appear in the file; each replaces its namesake or is appended
+            Config sections = ConfigParser::loadFromString(request.body);
+            if (sections.custom_sections.empty()) {
+                throw std::invalid_argument("apply-section needs at least one section in the request body");
+            }
+            Config config = state.config;
+            for (auto& [name, section] : sections.custom_sections) {
+                auto found = std::find_if(config.custom_sections.begin(), config.custom_sections.end(),
+                                          [&name = name](const auto& entry) { return entry.first == name; });
+                if (found != config.custom_sections.end()) {
+                    found->second = std::move(section);
+                } else {
+                    config.custom_sections.emplace_back(name, std::move(section));
+                }
+            }
+            response.success = applyDaemonConfig(state, std::move(config), out, out);
+        } else if (command == "remove-section") {
+            if (request.arguments.empty()) {
+                throw std::invalid_argument("remove-section needs a section name");
+            }
+            Config config = state.config;
+            for (const auto& name : request.arguments) {
+                auto found = std::find_if(config.custom_sections.begin(), config.custom_sections.end(),
+                                          [&name](const auto& entry) { return entry.first == name; });
+                if (found == config.custom_sections.end()) {
+                    throw std::invalid_argument("no section named " + name);
+                }
+                config.custom_sections.erase(found);
+            }
+            response.success = applyDaemonConfig(state, std::move(config), out, out);
+        } else {
+            throw std::invalid_argument("unknown command '" + command +
+                                        "'; expected status, plan, query, apply-config, apply-section or remove-section");
         }
-        std::cout << std::endl;
+    } catch (const std::exception& e) {
+        out << "Error: " << e.what() << std::endl;
+        dropSnapshot();
+        response.success = false;
     }
     
-    // ✨ NEW: Handle chain targets
-    if (mac.chain) {
-        std::cout << "  Chain target: " << *mac.chain << std::endl;
+    response.body = out.str();
+    // Changes are logged like any other apply; reads would only flood the log
+    if (changes) {
+        std::cout << "Control request: " << command << "\n" << response.body << std::flush;
     }
-    
-    // Validate direction - only INPUT is allowed for MAC rules
-    if (mac.direction != Direction::Input) {
-        std::cerr << "MAC rules are only allowed in INPUT direction. Found direction: " << static_cast<int>(mac.direction) << std::endl;
+    return response;
+}
+
+bool IptablesManager::compileFile(const std::filesystem::path& config_path, CompiledRuleset& ruleset,
+                                  std::ostream& out) {
+    try {
+        out << "Loading configuration from: " << config_path << std::endl;
+        Config config = loadConfigFile(config_path, out);
+        reportValidationWarnings(config, out);
+        return compileConfig(config, ruleset, std::cerr);
+    } catch (const std::exception& e) {
+        std::cerr << "Error loading configuration: " << e.what() << std::endl;
         return false;
     }
+}
+
+bool IptablesManager::repairDrift(const CompiledRuleset& ruleset) {
+    if (!captureSnapshot(true)) {
+        return false;
+    }
+    std::ostream quiet(nullptr);
+    ReconcilePlan plan = planChanges(ruleset, quiet);
+    if (plan.empty()) {
+        if (!snapshot_recalled_) {
+            recordState(true);
+        }
+        dropSnapshot();
+        return true;
+    }
     
-    // Generate rule comment
-    std::string iface_comment;
-    if (mac.interface) {
-        iface_comment = "i:" + mac.interface->input.value_or("any") + ":o:any";
+    size_t chains = reportDrift(plan, std::cout);
+    Metrics::PhaseTimer apply_timer("apply");
+    bool applied = (backend_ == Backend::Iptables) ? executePlan(plan, std::cout, std::cerr)
+                                                   : streamPlan(plan, std::cout, std::cerr);
+    apply_timer.stop();
+    if (applied) {
+        recordPlanOperations(plan);
+        recordState(false);
+        std::cout << "Repaired " << plan.operations.size() << " change(s) in " << chains << " chain(s)" << std::endl;
     } else {
-        iface_comment = "i:any:o:any";
+        StateJournal::discard();
     }
-    std::string comment = "YAML:" + section_name + ":mac:" + mac.mac_source + ":" + iface_comment;
-    
-    // ✨ NEW: Add chain information to comment if present
-    if (mac.chain) {
-        comment += ":chain:" + *mac.chain;
+    dropSnapshot();
+    return applied;
+}
+
+// Summarise a plan per chain, in the order the plan first touches them
+size_t IptablesManager::reportDrift(const ReconcilePlan& plan, std::ostream& out) {
+    struct ChainDrift {
+        size_t missing = 0;
+        size_t unexpected = 0;
+        bool created = false;
+        bool stale = false;
+        std::string policy;
+    };
+    std::vector<std::pair<std::string, ChainDrift>> chains;
+    for (const auto& op : plan.operations) {
+        std::string name = op.table + " " + op.chain;
+        auto found = std::find_if(chains.begin(), chains.end(),
+                                  [&name](const auto& entry) { return entry.first == name; });
+        if (found == chains.end()) {
+            found = chains.emplace(chains.end(), name, ChainDrift{});
+        }
+        ChainDrift& drift = found->second;
+        switch (op.kind) {
+            case PlanOperation::Kind::CreateChain:
+                drift.created = true;
+                break;
+            case PlanOperation::Kind::InsertRule:
+            case PlanOperation::Kind::AppendRule:
+                ++drift.missing;
+                break;
+            case PlanOperation::Kind::DeleteRule:
+                ++drift.unexpected;
+                break;
+            case PlanOperation::Kind::SetPolicy:
+                drift.policy = op.text;
+                break;
+            case PlanOperation::Kind::FlushChain:
+            case PlanOperation::Kind::DeleteChain:
+                drift.stale = true;
+                break;
+        }
     }
     
-    // Remove existing rules with this signature
-    removeRulesBySignature("filter", "INPUT", comment);
-    
-    // Build iptables command for MAC rule
-    std::vector<std::string> args = {"-A", "INPUT"};
-    
-    // Add input interface if specified
-    if (mac.interface && mac.interface->input) {
-        args.push_back("-i");
-        args.push_back(*mac.interface->input);
+    for (const auto& [name, drift] : chains) {
+        std::vector<std::string> findings;
+        if (drift.created) {
+            findings.push_back("chain missing");
+        }
+        if (drift.stale) {
+            findings.push_back("stale chain");
+        }
+        if (drift.missing > 0) {
+            findings.push_back(std::to_string(drift.missing) + " rule(s) missing");
+        }
+        if (drift.unexpected > 0) {
+            findings.push_back(std::to_string(drift.unexpected) + " rule(s) unexpected or changed");
+        }
+        if (!drift.policy.empty()) {
+            findings.push_back("policy should be " + drift.policy);
+        }
+        out << "Drift in " << name << ":";
+        for (size_t i = 0; i < findings.size(); ++i) {
+            out << (i > 0 ? ", " : " ") << findings[i];
+        }
+        out << std::endl;
     }
-    
-    // Add MAC source
-    args.insert(args.end(), {
-        "-m", "mac",
-        "--mac-source", mac.mac_source
-    });
-    
-    // Add subnets if specified
-    if (mac.subnet && !mac.subnet->empty()) {
-        args.push_back("-s");
-        std::ostringstream subnet_list;
-        for (size_t i = 0; i < mac.subnet->size(); ++i) {
-            if (i > 0) subnet_list << ",";
-            subnet_list << (*mac.subnet)[i];
+    return chains.size();
+}
+
+// Print a plan the way --plan shows it
+void IptablesManager::printPlan(const ReconcilePlan& plan, std::ostream& out) {
+    // Tags say nothing to a reader; show the signatures they stand for where known
+    std::map<std::string, std::string> recorded = StateJournal::index().descriptions;
+    for (const auto& op : plan.operations) {
+        std::string description;
+        if (op.kind == PlanOperation::Kind::InsertRule || op.kind == PlanOperation::Kind::AppendRule) {
+            description = op.rule.description;
+        } else if (op.kind == PlanOperation::Kind::DeleteRule) {
+            auto found = recorded.find(RulesetSnapshot::extractComment(op.text));
+            description = found != recorded.end() ? found->second : "";
         }
-        args.push_back(subnet_list.str());
+        out << op.describe() << (description.empty() ? "" : "  # " + description) << std::endl;
     }
-    
-    // ✨ NEW: Add target (action or chain)
-    args.insert(args.end(), {
-        "-m", "comment",
-        "--comment", comment,
-        "-j", mac.chain ? *mac.chain : (mac.allow ? "ACCEPT" : "DROP")
-    });
-    
-    auto result = CommandExecutor::executeIptables(args);
-    if (!result.isSuccess()) {
-        std::cerr << "Failed to add MAC rule: " << result.getErrorMessage() << std::endl;
+    out << "Plan: " << plan.count(PlanOperation::Kind::InsertRule) + plan.count(PlanOperation::Kind::AppendRule)
+        << " to add, " << plan.count(PlanOperation::Kind::DeleteRule) << " to delete, "
+        << plan.count(PlanOperation::Kind::CreateChain) << " chain(s) to create, "
+        << plan.count(PlanOperation::Kind::DeleteChain) << " chain(s) to delete, "
+        << plan.count(PlanOperation::Kind::SetPolicy) << " polic(ies) to change, "
+        << plan.unchanged << " rule(s) unchanged" << std::endl;
+}
+
+bool IptablesManager::emitRestore(const std::filesystem::path& config_path, const std::string& destination) {
+    try {
+        // Diagnostics go to stderr so that "-" yields a clean payload on stdout
+        Config config = loadConfigFile(config_path, std::cerr);
+        reportValidationWarnings(config, std::cerr);
+        
+        Metrics::PhaseTimer compile_timer("sections");
+        CompiledRuleset ruleset = RulesetCompiler::compile(config);
+        if (section_chains_) {
+            RulesetCompiler::useSectionChains(ruleset);
+        }
+        compile_timer.stop();
+        if (!RestoreBackend::writePayload(ruleset, destination)) {
+            return false;
+        }
+        
+        if (destination != "-") {
+            std::cerr << "Wrote iptables-restore payload with " << ruleset.rules.size()
+                      << " rule(s) to " << destination << std::endl;
+        }
+        return true;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Error compiling configuration: " << e.what() << std::endl;
         return false;
     }
-    
-    return true;
 }
 
-bool IptablesManager::processInterfaceConfig(const InterfaceRuleConfig& interface, const std::string& section_name) {
-    std::cout << "Processing interface configuration for section: " << section_name << std::endl;
-    std::cout << "  Direction: " << static_cast<int>(interface.direction) << std::endl;
-    std::cout << "  Allow: " << (interface.allow ? "true" : "false") << std::endl;
+// Check chain references and compile a configuration into rules
+bool IptablesManager::compileConfig(const Config& config, CompiledRuleset& ruleset, std::ostream& err,
+                                    const std::string& generation) {
+    Metrics::PhaseTimer chains_timer("chains");
+    if (!chain_manager_.validateChainReferences(config)) {
+        err << "Failed to process chain configurations: " << chain_manager_.getLastError() << std::endl;
+        return false;
+    }
+    chains_timer.stop();
     
-    if (interface.input) {
-        std::cout << "  Input interface: " << *interface.input << std::endl;
+    Metrics::PhaseTimer sections_timer("sections");
+    try {
+        ruleset = RulesetCompiler::compile(config);
+        if (section_chains_ || !generation.empty()) {
+            RulesetCompiler::useSectionChains(ruleset, generation);
+        }
+    } catch (const std::invalid_argument& e) {
+        err << "Failed to compile configuration: " << e.what() << std::endl;
+        return false;
     }
-    if (interface.output) {
-        std::cout << "  Output interface: " << *interface.output << std::endl;
+    journal_index_.descriptions.clear();
+    for (const auto& rule : ruleset.rules) {
+        journal_index_.descriptions.emplace(rule.comment(), rule.description());
     }
-    
-    // Generate rule comment
-    std::string iface_comment = "i:" + interface.input.value_or("any") + ":o:" + interface.output.value_or("any");
-    std::string comment = "YAML:" + section_name + ":interface:" + iface_comment;
-    
-    // Convert direction to chain name
-    std::string chain;
-    switch (interface.direction) {
-        case Direction::Input:
-            chain = "INPUT";
-            break;
-        case Direction::Output:
-            chain = "OUTPUT";
-            break;
-        case Direction::Forward:
-            chain = "FORWARD";
-            break;
+    journal_index_.sections = RulesetCompiler::sectionDigests(ruleset);
+    return true;
+}
+
+// Parse a configuration file, timed as the load phase
+Config IptablesManager::loadConfigFile(const std::filesystem::path& config_path, std::ostream& out) {
+    Metrics::PhaseTimer timer("load");
+    Config config = config_loader_.load(config_path);
+    if (config_loader_.fragmentCount() > 0) {
+        out << "Merged " << config_loader_.fragmentCount() << " fragment(s) from "
+                  << ConfigLoader::fragmentDirectory(config_path).string() << ", "
+                  << config_loader_.parsedCount() << " file(s) parsed" << std::endl;
     }
-    
-    // Remove existing rules with this signature
-    removeRulesBySignature("filter", chain, comment);
-    
-    // Build iptables command for interface rule
-    std::vector<std::string> args = {"-A", chain};
-    
-    // Add interface specifications if present
-    if (interface.input) {
-        args.push_back("-i");
-        args.push_back(*interface.input);
+    return config;
+}
+
+// Diff a compiled configuration against snapshot_, timed as the plan phase
+ReconcilePlan IptablesManager::planChanges(const CompiledRuleset& ruleset, std::ostream& out) const {
+    Metrics::PhaseTimer timer("plan");
+    // The journal's digests only describe the kernel while the journal itself does
+    std::set<std::string> settled;
+    if (snapshot_recalled_) {
+        // A daemon keeps the digests with its resident copy; only a fresh process reads the file
+        std::map<std::string, uint64_t> read;
+        if (!snapshot_resident_) {
+            read = StateJournal::index().sections;
+        }
+        const std::map<std::string, uint64_t>& recorded = snapshot_resident_ ? resident_->sections : read;
+        size_t removed = recorded.size();
+        for (const auto& [section, digest] : journal_index_.sections) {
+            auto found = recorded.find(section);
+            if (found != recorded.end()) {
+                --removed;
+                if (found->second == digest) {
+                    settled.insert(section);
+                }
+            }
+        }
+        out << journal_index_.sections.size() - settled.size() << " of " << journal_index_.sections.size()
+            << " section(s) changed since the last run, " << removed << " removed" << std::endl;
     }
-    if (interface.output) {
-        args.push_back("-o");
-        args.push_back(*interface.output);
+    return Reconciler::plan(ruleset, *snapshot_, settled);
+}
+
+// Count the changes an applied plan made, by kind
+void IptablesManager::recordPlanOperations(const ReconcilePlan& plan) {
+    Metrics::recordOperations("create_chain", plan.count(PlanOperation::Kind::CreateChain));
+    Metrics::recordOperations("delete", plan.count(PlanOperation::Kind::DeleteRule));
+    Metrics::recordOperations("insert", plan.count(PlanOperation::Kind::InsertRule));
+    Metrics::recordOperations("append", plan.count(PlanOperation::Kind::AppendRule));
+    Metrics::recordOperations("set_policy", plan.count(PlanOperation::Kind::SetPolicy));
+    Metrics::recordOperations("flush_chain", plan.count(PlanOperation::Kind::FlushChain));
+    Metrics::recordOperations("delete_chain", plan.count(PlanOperation::Kind::DeleteChain));
+}
+
+// Apply a compiled configuration through a transactional backend
+bool IptablesManager::applyTransactional(const CompiledRuleset& ruleset, std::ostream& out, std::ostream& err) {
+    bool reset = pending_reset_;
+    pending_reset_ = false;
+    
+    bool applied = false;
+    if (backend_ == Backend::Libiptc) {
+        // libiptc already commits only the tables that changed
+        Metrics::PhaseTimer timer("apply");
+        applied = LibiptcBackend::apply(ruleset, reset, out, err);
+        timer.stop();
+        if (applied) {
+            recordState(false);
+        }
+    } else {
+        if (!captureSnapshot(!reset)) {
+            return false;
+        }
+        if (!reset && planChanges(ruleset, out).empty()) {
+            out << "Live ruleset already matches the configuration, nothing to restore" << std::endl;
+            applied = true;
+            recordState(true);
+        } else {
+            // The merged payload carries the live counters over, which a recalled snapshot lacks
+            if (snapshot_recalled_ && !captureSnapshot()) {
+                return false;
+            }
+            Metrics::PhaseTimer timer("apply");
+            applied = RestoreBackend::apply(ruleset, *snapshot_, reset, out, err);
+            timer.stop();
+            if (applied) {
+                recordState(false);
+            }
+        }
+        dropSnapshot();
     }
-    
-    // Add comment and action
-    args.insert(args.end(), {
-        "-m", "comment",
-        "--comment", comment,
-        "-j", interface.allow ? "ACCEPT" : "DROP"
-    });
-    
-    auto result = CommandExecutor::executeIptables(args);
-    if (!result.isSuccess()) {
-        std::cerr << "Failed to add interface rule: " << result.getErrorMessage() << std::endl;
+    if (!applied) {
+        StateJournal::discard();
         return false;
     }
     
+    out << "Configuration processing completed" << std::endl;
     return true;
 }
 
-bool IptablesManager::processActionConfig(const Action& action, const std::string& section_name) {
-    std::cout << "Processing action configuration for section: " << section_name << std::endl;
-    std::cout << "  Action: " << actionToString(action) << std::endl;
-    
-    // Generate rule comment for this catch-all rule
-    std::string comment = "YAML:" + section_name + ":action:" + actionToString(action) + ":i:any:o:any:mac:any";
-    
-    // Remove existing rules with this signature
-    removeRulesBySignature("filter", "INPUT", comment);
-    
-    // Build iptables command for the catch-all rule in INPUT chain
-    std::vector<std::string> args = {"-A", "INPUT"};
+// Run plan operations one iptables call at a time, one worker per table
+bool IptablesManager::executePlan(const ReconcilePlan& plan, std::ostream& out, std::ostream& err) {
+    if (plan.empty()) {
+        return true;
+    }
     
-    // Add comment
-    args.insert(args.end(), {
-        "-m", "comment",
-        "--comment", comment,
-        "-j", actionToString(action)
-    });
+    std::map<std::string, std::vector<const PlanOperation*>> by_table;
+    for (const auto& op : plan.operations) {
+        by_table[op.table].push_back(&op);
+    }
     
-    auto result = CommandExecutor::executeIptables(args);
-    if (!result.isSuccess()) {
-        std::cerr << "Failed to add action rule for section " << section_name 
-                 << ": " << result.getErrorMessage() << std::endl;
-        return false;
+    TableScheduler scheduler;
+    for (const auto& [table, operations] : by_table) {
+        scheduler.add(table, [&operations = operations](std::ostream&, std::ostream& err) {
+            bool success = true;
+            std::set<std::string> failed_chains;
+            for (const PlanOperation* op : operations) {
+                // Positions of later operations assume every earlier one in the chain succeeded
+                if (failed_chains.count(op->chain)) {
+                    continue;
+                }
+                auto result = CommandExecutor::executeIptables(op->toIptablesArgs());
+                if (!result.isSuccess()) {
+                    err << "Failed to apply " << op->describe() << ": " << result.getErrorMessage() << std::endl;
+                    err << "Skipping remaining changes to " << op->table << " " << op->chain << std::endl;
+                    failed_chains.insert(op->chain);
+                    success = false;
+                }
+            }
+            return success;
+        });
     }
     
-    std::cout << "Successfully added action rule: " << actionToString(action) << " for section " << section_name << std::endl;
-    return true;
+    LockStatistics lock_before = XtablesLock::statistics();
+    bool success = scheduler.run(out, err);
+    reportLockStatistics(lock_before, out);
+    return success;
 }
 
-// ✨ NEW: Process interface-based chain calls
-bool IptablesManager::processInterfaceChainCall(const InterfaceConfig& interface, const std::string& section_name) {
-    std::cout << "Processing interface chain call for section: " << section_name << std::endl;
-    
-    if (interface.input) {
-        std::cout << "  Input interface: " << *interface.input << std::endl;
-    }
-    if (interface.output) {
-        std::cout << "  Output interface: " << *interface.output << std::endl;
-    }
-    if (interface.chain) {
-        std::cout << "  Target chain: " << *interface.chain << std::endl;
-    } else {
-        std::cerr << "Interface configuration must specify a chain target" << std::endl;
-        return false;
+// Stream plan operations through one restore session, one batch per chain
+bool IptablesManager::streamPlan(const ReconcilePlan& plan, std::ostream& out, std::ostream& err) {
+    if (plan.empty()) {
+        return true;
     }
     
-    // Resolve the target chain name (may be a section name that needs to be resolved to actual chain name)
-    std::string target_chain_ref = *interface.chain;
-    std::string target_chain = resolveChainName(target_chain_ref);
-    
-    // Generate rule comment for interface chain call
-    std::string iface_comment = "i:" + interface.input.value_or("any") + ":o:" + interface.output.value_or("any");
-    std::string comment = "YAML:" + section_name + ":chain_call:" + target_chain + ":" + iface_comment;
+    session_ = std::make_unique<RestoreSession>();
+    RestoreBatch batch;
+    std::string batch_chain;
+    auto flush = [&]() {
+        if (!batch.lines.empty()) {
+            session_->submit(std::move(batch));
+        }
+        batch = RestoreBatch{};
+    };
     
-    // Determine which chain to add the rule to based on interface specification
-    std::string chain = "INPUT"; // Default to INPUT for interface-based chain calls
-    if (interface.output && !interface.input) {
-        chain = "OUTPUT"; // Only output interface specified
-    } else if (interface.input && interface.output) {
-        chain = "FORWARD"; // Both interfaces specified (routing)
+    // A failing batch leaves its chain untouched, so later chains still apply;
+    // failures are only known once finishStream() has sent every batch
+    for (const auto& op : plan.operations) {
+        if (op.table != batch.table || op.chain != batch_chain) {
+            flush();
+            batch.table = op.table;
+            batch.description = "changes to " + op.table + " " + op.chain;
+            batch_chain = op.chain;
+        }
+        batch.lines.push_back(op.toRestoreLine());
     }
+    flush();
     
-    // Remove existing rules with this signature
-    removeRulesBySignature("filter", chain, comment);
-    
-    // Build iptables command for interface chain call
-    std::vector<std::string> args = {"-A", chain};
+    return finishStream(out, err);
+}
+
+// Wait for every streamed batch and report failures
+bool IptablesManager::finishStream(std::ostream& out, std::ostream& err) {
+    auto results = session_->sync();
+    out << "Streamed " << results.size() << " batch(es) through "
+        << session_->spawnCount() << " iptables-restore process(es)" << std::endl;
+    session_.reset();
     
-    // Add interface specifications if present
-    if (interface.input) {
-        args.push_back("-i");
-        args.push_back(*interface.input);
-    }
-    if (interface.output) {
-        args.push_back("-o");
-        args.push_back(*interface.output);
+    bool success = true;
+    for (const auto& result : results) {
+        if (!result.success) {
+            err << "Failed to apply " << result.description << ": " << result.error << std::endl;
+            success = false;
+        }
     }
-    
-    // Add comment and target chain
-    args.insert(args.end(), {
-        "-m", "comment",
-        "--comment", comment,
-        "-j", target_chain
-    });
-    
-    auto result = CommandExecutor::executeIptables(args);
-    if (!result.isSuccess()) {
-        std::cerr << "Failed to add interface chain call rule: " << result.getErrorMessage() << std::endl;
-        return false;
+    return success;
+}
+
+// Print how long the last batch of commands waited for the xtables lock
+void IptablesManager::reportLockStatistics(const LockStatistics& before, std::ostream& out) const {
+    LockStatistics stats = XtablesLock::statistics().since(before);
+    if (stats.commands > 0) {
+        out << stats.summary() << std::endl;
     }
-    
-    std::cout << "Successfully added interface chain call to " << target_chain << " in " << chain << " chain" << std::endl;
-    return true;
 }
 
-// Helper function to resolve chain names from section names to actual chain names
-std::string IptablesManager::resolveChainName(const std::string& name) {
-    // Check if this is a section name that maps to an actual chain name
-    auto it = section_to_chain_map_.find(name);
-    if (it != section_to_chain_map_.end()) {
-        return it->second; // Return the actual chain name
+// Print rule order validation results
+void IptablesManager::reportValidationWarnings(const Config& config, std::ostream& out) {
+    out << "Validating rule order..." << std::endl;
+    Metrics::PhaseTimer timer("validate");
+    auto warnings = RuleValidator::validateRuleOrder(config);
+    timer.stop();
+    
+    if (!warnings.empty()) {
+        out << "Found " << warnings.size() << " potential rule ordering issue(s):" << std::endl;
+        for (const auto& warning : warnings) {
+            switch (warning.type) {
+                case ValidationWarning::Type::UnreachableRule:
+                    out << "  WARNING (Unreachable Rule): " << warning.message << std::endl;
+                    break;
+                case ValidationWarning::Type::RedundantRule:
+                    out << "  WARNING (Redundant Rule): " << warning.message << std::endl;
+                    break;
+                case ValidationWarning::Type::SubnetOverlap:
+                    out << "  WARNING (Subnet Overlap): " << warning.message << std::endl;
+                    break;
+            }
+        }
+        out << "These warnings indicate potential misconfigurations where rules may not work as expected." << std::endl;
+        out << "Consider reordering rules to place more specific conditions before general ones." << std::endl;
+        out << std::endl;
+    } else {
+        out << "Rule order validation passed - no issues detected." << std::endl;
     }
-    // If not found in mapping, assume it's already an actual chain name
-    return name;
 }
 
 bool IptablesManager::resetRules() {
+    // With a transactional backend the reset becomes part of the apply transaction
+    if (isTransactional()) {
+        std::cout << "Reset deferred to the apply transaction" << std::endl;
+        pending_reset_ = true;
+        return true;
+    }
+    
     std::cout << "Resetting all iptables rules" << std::endl;
     
-    // Define the reset commands (matching Rust implementation)
-    std::vector<std::vector<std::string>> commands = {
-        {"-F"},                    // Flush filter table
-        {"-X"},                    // Delete user-defined chains in filter table
-        {"-t", "nat", "-F"},       // Flush nat table
-        {"-t", "nat", "-X"},       // Delete user-defined chains in nat table
-        {"-t", "mangle", "-F"},    // Flush mangle table
-        {"-t", "mangle", "-X"}     // Delete user-defined chains in mangle table
-    };
+    // Tables are independent, so each is flushed by its own worker
+    TableScheduler scheduler;
+    for (const std::string table : {"filter", "nat", "mangle"}) {
+        scheduler.add(table, [table](std::ostream&, std::ostream& err) {
+            bool success = true;
+            // Flush first so no rule still references a chain being deleted
+            for (const char* command : {"-F", "-X"}) {
+                auto result = CommandExecutor::executeIptables({"-t", table, command});
+                if (!result.isSuccess()) {
+                    err << "Failed to execute reset command: " << result.getErrorMessage() << std::endl;
+                    success = false;
+                }
+            }
+            return success;
+        });
+    }
     
-    bool success = true;
+    Metrics::PhaseTimer timer("reset");
+    LockStatistics lock_before = XtablesLock::statistics();
+    bool success = scheduler.run(std::cout, std::cerr);
+    reportLockStatistics(lock_before, std::cout);
+    timer.stop();
     
-    for (const auto& cmd : commands) {
-        auto result = CommandExecutor::executeIptables(cmd);
-        if (!result.isSuccess()) {
-            std::cerr << "Failed to execute reset command: " << result.getErrorMessage() << std::endl;
-            success = false;
-        }
-    }
+    // The flushes are not mirrored into the snapshot; the next lookup re-reads the ruleset
+    dropSnapshot();
     
     if (success) {
         std::cout << "Successfully reset all iptables rules" << std::endl;
@@ -821,101 +981,93 @@ bool IptablesManager::resetRules() {
 
 bool IptablesManager::removeYamlRules() {
     std::cout << "Removing all rules with YAML comments" << std::endl;
+    journal_index_ = JournalIndex{};
     
-    // Define chains with their respective tables (matching Rust implementation)
-    std::vector<std::pair<std::string, std::string>> chains = {
-        {"filter", "INPUT"},
-        {"filter", "OUTPUT"},
-        {"filter", "FORWARD"},
-        {"nat", "PREROUTING"},
-        {"nat", "POSTROUTING"}
-    };
-    
-    bool success = true;
-    
-    for (const auto& [table, chain] : chains) {
-        // List rules with line numbers
-        std::vector<std::string> cmd_args = {"-t", table, "-L", chain, "--line-numbers"};
-        auto result = CommandExecutor::executeIptables(cmd_args);
-        
-        if (!result.isSuccess()) {
-            // Chain might not exist, skip
-            continue;
-        }
-        
-        // Collect line numbers of rules with YAML comments
-        std::vector<uint32_t> yaml_rule_lines;
-        std::istringstream iss(result.stdout_output);
-        std::string line;
-        
-        while (std::getline(iss, line)) {
-            if (line.find("YAML:") != std::string::npos) {
-                // Extract line number (first token)
-                std::istringstream line_stream(line);
-                std::string line_num_str;
-                if (line_stream >> line_num_str) {
-                    try {
-                        uint32_t line_num = std::stoul(line_num_str);
-                        yaml_rule_lines.push_back(line_num);
-                    } catch (const std::exception&) {
-                        // Not a number, skip
-                    }
-                }
-            }
-        }
-        
-        // Sort line numbers in descending order to delete from bottom to top
-        std::sort(yaml_rule_lines.begin(), yaml_rule_lines.end(), std::greater<uint32_t>());
-        
-        // Delete rules from highest to lowest line number
-        for (uint32_t line_num : yaml_rule_lines) {
-            auto del_result = CommandExecutor::removeRuleByLineNumber(table, chain, line_num);
-            if (!del_result.isSuccess()) {
-                std::cerr << "Failed to remove rule at line " << line_num << " in " << table << "." << chain 
-                         << ": " << del_result.getErrorMessage() << std::endl;
-                success = false;
-            }
-        }
+    // A single iptables-save covers every table and chain, and none is
+    // needed when the state journal still matches the kernel
+    if (!captureSnapshot(true)) {
+        return false;
     }
     
-    // Clean up custom chains after removing rules
-    std::cout << "Cleaning up custom chains..." << std::endl;
-    if (!chain_manager_.cleanupChains()) {
-        std::cerr << "Warning: Failed to clean up some custom chains" << std::endl;
-        success = false;
+    Metrics::PhaseTimer scan_timer("remove_scan");
+    ReconcilePlan plan = Reconciler::teardown(*snapshot_);
+    std::map<std::string, std::vector<const PlanOperation*>> by_table;
+    for (const auto& op : plan.operations) {
+        by_table[op.table].push_back(&op);
     }
-    
-    // Reset policies to ACCEPT after removing rules (matching Rust implementation)
-    auto input_policy = CommandExecutor::setChainPolicy("filter", "INPUT", "ACCEPT");
-    auto output_policy = CommandExecutor::setChainPolicy("filter", "OUTPUT", "ACCEPT");
-    auto forward_policy = CommandExecutor::setChainPolicy("filter", "FORWARD", "ACCEPT");
-    
-    if (!input_policy.isSuccess() || !output_policy.isSuccess() || !forward_policy.isSuccess()) {
-        std::cerr << "Warning: Failed to reset some policies to ACCEPT" << std::endl;
-        success = false;
+    scan_timer.stop();
+    
+    // Each table is torn down by one iptables-restore transaction, which
+    // either removes everything or leaves the table as it was; a worker
+    // per table only touches its own table in the snapshot
+    LockStatistics lock_before = XtablesLock::statistics();
+    TableScheduler scheduler;
+    for (const auto& [table, operations] : by_table) {
+        scheduler.add(table, [this, &table = table, &operations = operations](std::ostream&, std::ostream& err) {
+            Metrics::PhaseTimer timer("remove");
+            std::string payload = "*" + table + "\n";
+            for (const PlanOperation* op : operations) {
+                payload += op->toRestoreLine() + "\n";
+            }
+            payload += "COMMIT\n";
+            
+            auto result = CommandExecutor::executeRestore(payload, {"--noflush"});
+            if (!result.isSuccess()) {
+                err << "Failed to remove managed rules from table " << table << ": "
+                    << result.getErrorMessage() << std::endl;
+                return false;
+            }
+            for (const PlanOperation* op : operations) {
+                mirrorOperation(*op);
+            }
+            return true;
+        });
     }
+    bool success = scheduler.run(std::cout, std::cerr);
+    reportLockStatistics(lock_before, std::cout);
     
+    // Every change above was mirrored into the snapshot, so it is what the kernel now holds
     if (success) {
-        std::cout << "Successfully removed all rules with YAML comments and cleaned up custom chains" << std::endl;
+        recordPlanOperations(plan);
+        recordState(true);
+        std::cout << "Removed " << plan.count(PlanOperation::Kind::DeleteRule) << " rule(s) and "
+                  << plan.count(PlanOperation::Kind::DeleteChain) << " chain(s) in " << by_table.size()
+                  << " transaction(s), policies reset to ACCEPT" << std::endl;
+    } else {
+        StateJournal::discard();
     }
+    dropSnapshot();
     
     return success;
 }
 
-bool IptablesManager::applyRules() {
-    return rule_manager_.applyRules();
-}
-
-bool IptablesManager::removeAllRules() {
-    return rule_manager_.removeAllRules();
-}
-
-bool IptablesManager::setPolicy(Direction direction, Action action) {
-    return rule_manager_.setPolicy(direction, action);
-}
-
-bool IptablesManager::resetPolicies() {
-    return rule_manager_.resetPolicies();
+// Apply a plan operation that ran successfully to snapshot_
+void IptablesManager::mirrorOperation(const PlanOperation& op) {
+    switch (op.kind) {
+        case PlanOperation::Kind::CreateChain:
+            snapshot_->createChain(op.table, op.chain);
+            break;
+        case PlanOperation::Kind::DeleteRule:
+            snapshot_->deleteRule(op.table, op.chain, op.position);
+            break;
+        case PlanOperation::Kind::InsertRule:
+            // The spec is what follows "-A <chain> " of the rendered rule
+            snapshot_->insertRule(op.table, op.chain, op.position,
+                                  op.rule.toRestoreLine().substr(op.chain.size() + 4));
+            break;
+        case PlanOperation::Kind::AppendRule:
+            snapshot_->appendRule(op.table, op.rule.toRestoreLine());
+            break;
+        case PlanOperation::Kind::SetPolicy:
+            snapshot_->setPolicy(op.table, op.chain, op.text);
+            break;
+        case PlanOperation::Kind::FlushChain:
+            snapshot_->flushChain(op.table, op.chain);
+            break;
+        case PlanOperation::Kind::DeleteChain:
+            snapshot_->deleteChain(op.table, op.chain);
+            break;
+    }
 }
 
 // Helper methods
@@ -1019,273 +1171,4 @@ InterfaceConfig IptablesManager::parseInterface(const YAML::Node& node) {
     return config;
 }
 
-// ✨ NEW: Chain configuration processing methods (Phase 6.3.4)
-
-bool IptablesManager::createChain(const std::string& chain_name) {
-    std::cout << "Creating chain: " << chain_name << std::endl;
-    
-    // Check if chain already exists
-    auto check_result = CommandExecutor::executeIptables({"-L", chain_name, "-n"});
-    if (check_result.isSuccess()) {
-        std::cout << "Chain " << chain_name << " already exists, skipping creation" << std::endl;
-        return true;
-    }
-    
-    // Create the chain
-    auto result = CommandExecutor::executeIptables({"-N", chain_name});
-    if (!result.isSuccess()) {
-        std::cerr << "Failed to create chain " << chain_name << ": " << result.getErrorMessage() << std::endl;
-        return false;
-    }
-    
-    std::cout << "Successfully created chain: " << chain_name << std::endl;
-    return true;
-}
-
-bool IptablesManager::processChainConfig(const std::string& chain_name, const ChainConfig& chain_config) {
-    std::cout << "Processing chain configuration: " << chain_name << std::endl;
-    
-    // First, create the chain if it doesn't exist
-    if (!createChain(chain_name)) {
-        std::cerr << "Failed to create chain: " << chain_name << std::endl;
-        return false;
-    }
-    
-    // Find the specific chain rule that matches the chain name
-    for (const auto& chain_rule : chain_config.chain) {
-        if (chain_rule.name == chain_name) {
-            std::cout << "Processing chain rule: " << chain_rule.name << " in chain " << chain_name << std::endl;
-            
-            if (!processChainRuleConfig(chain_name, chain_rule)) {
-                std::cerr << "Failed to process chain rule: " << chain_rule.name << std::endl;
-                return false;
-            }
-            break; // Found and processed the matching chain rule
-        }
-    }
-    
-    return true;
-}
-
-bool IptablesManager::processChainRuleConfig(const std::string& chain_name, const ChainRuleConfig& chain_rule) {
-    std::cout << "Processing chain rule: " << chain_rule.name << " in chain " << chain_name << std::endl;
-    
-    // Process all rules within this chain rule configuration
-    if (!processChainRules(chain_name, chain_rule.rules)) {
-        return false;
-    }
-    
-    return true;
-}
-
-bool IptablesManager::processChainRules(const std::string& chain_name, const std::vector<std::pair<std::string, SectionConfig>>& rules) {
-    std::cout << "Processing " << rules.size() << " rule groups in chain: " << chain_name << std::endl;
-    
-    // Process each rule group within the chain in YAML order
-    for (const auto& [rule_group_name, section_config] : rules) {
-        std::cout << "Processing rule group: " << rule_group_name << " in chain " << chain_name << std::endl;
-        
-        // Process port rules in the chain
-        if (section_config.ports) {
-            for (const auto& port : *section_config.ports) {
-                // Create a modified port config that targets the chain instead of standard chains
-                PortConfig chain_port = port;
-                
-                // Generate rule comment for chain rule
-                std::string comment = "YAML:chain:" + chain_name + ":port:" + std::to_string(port.port.value_or(0));
-                if (port.range) {
-                    comment = "YAML:chain:" + chain_name + ":port:";
-                    for (size_t i = 0; i < port.range->size(); ++i) {
-                        if (i > 0) comment += ",";
-                        comment += (*port.range)[i];
-                    }
-                }
-                comment += ":" + getInterfaceComment(port.interface);
-                
-                // Add subnet information to make rules unique
-                if (port.subnet && !port.subnet->empty()) {
-                    comment += ":subnet:";
-                    for (size_t i = 0; i < port.subnet->size(); ++i) {
-                        if (i > 0) comment += ",";
-                        comment += (*port.subnet)[i];
-                    }
-                } else {
-                    comment += ":subnet:any";
-                }
-                
-                // Add action to make rules unique
-                comment += ":";
-                comment += (port.allow ? "ACCEPT" : "DROP");
-                
-                // Remove existing rules with this signature in the chain
-                removeRulesBySignature("filter", chain_name, comment);
-                
-                // Build iptables command for the chain
-                std::vector<std::string> args = {"-A", chain_name};
-                
-                // Add protocol
-                args.push_back("-p");
-                args.push_back(port.protocol == Protocol::Tcp ? "tcp" : "udp");
-                
-                // Add port specification
-                if (port.port) {
-                    // Single port
-                    args.insert(args.end(), {"-m", port.protocol == Protocol::Tcp ? "tcp" : "udp"});
-                    args.insert(args.end(), {"--dport", std::to_string(*port.port)});
-                } else if (port.range && !port.range->empty()) {
-                    // Multiple port ranges using multiport
-                    args.insert(args.end(), {"-m", "multiport"});
-                    args.push_back("--dports");
-                    
-                    std::string port_list;
-                    for (size_t i = 0; i < port.range->size(); ++i) {
-                        if (i > 0) port_list += ",";
-                        // Convert "start-end" to "start:end" for iptables multiport
-                        std::string range_str = (*port.range)[i];
-                        std::replace(range_str.begin(), range_str.end(), '-', ':');
-                        port_list += range_str;
-                    }
-                    args.push_back(port_list);
-                }
-                
-                // Add subnet filtering if specified
-                if (port.subnet && !port.subnet->empty()) {
-                    std::string subnet_list;
-                    for (size_t i = 0; i < port.subnet->size(); ++i) {
-                        if (i > 0) subnet_list += ",";
-                        subnet_list += (*port.subnet)[i];
-                    }
-                    args.insert(args.end(), {"-s", subnet_list});
-                }
-                
-                // Add interface specifications if present
-                if (port.interface) {
-                    if (port.interface->input) {
-                        args.insert(args.end(), {"-i", *port.interface->input});
-                    }
-                    if (port.interface->output) {
-                        args.insert(args.end(), {"-o", *port.interface->output});
-                    }
-                }
-                
-                // Add MAC source filtering if specified
-                if (port.mac_source) {
-                    args.insert(args.end(), {"-m", "mac", "--mac-source", *port.mac_source});
-                }
-                
-                // Add comment and action
-                args.insert(args.end(), {
-                    "-m", "comment",
-                    "--comment", comment,
-                    "-j", port.allow ? "ACCEPT" : "DROP"
-                });
-                
-                auto result = CommandExecutor::executeIptables(args);
-                if (!result.isSuccess()) {
-                    std::cerr << "Failed to add port rule to chain " << chain_name 
-                             << ": " << result.getErrorMessage() << std::endl;
-                    return false;
-                }
-                
-                std::cout << "Successfully added port rule to chain " << chain_name 
-                         << ": port " << (port.port ? std::to_string(*port.port) : "range") 
-                         << " -> " << (port.allow ? "ACCEPT" : "DROP") << std::endl;
-            }
-        }
-        
-        // Process MAC rules in the chain
-        if (section_config.mac) {
-            for (const auto& mac : *section_config.mac) {
-                // Generate rule comment for chain MAC rule
-                std::string comment = "YAML:chain:" + chain_name + ":mac:" + mac.mac_source + ":" + getInterfaceComment(mac.interface);
-                
-                // Remove existing rules with this signature in the chain
-                removeRulesBySignature("filter", chain_name, comment);
-                
-                // Build iptables command for MAC rule in chain
-                std::vector<std::string> args = {"-A", chain_name};
-                
-                // Add MAC filtering
-                args.insert(args.end(), {"-m", "mac", "--mac-source", mac.mac_source});
-                
-                // Add subnet filtering if specified
-                if (mac.subnet && !mac.subnet->empty()) {
-                    std::string subnet_list;
-                    for (size_t i = 0; i < mac.subnet->size(); ++i) {
-                        if (i > 0) subnet_list += ",";
-                        subnet_list += (*mac.subnet)[i];
-                    }
-                    args.insert(args.end(), {"-s", subnet_list});
-                }
-                
-                // Add interface specifications if present (input only for MAC rules)
-                if (mac.interface && mac.interface->input) {
-                    args.insert(args.end(), {"-i", *mac.interface->input});
-                }
-                
-                // Add comment and action
-                args.insert(args.end(), {
-                    "-m", "comment",
-                    "--comment", comment,
-                    "-j", mac.allow ? "ACCEPT" : "DROP"
-                });
-                
-                auto result = CommandExecutor::executeIptables(args);
-                if (!result.isSuccess()) {
-                    std::cerr << "Failed to add MAC rule to chain " << chain_name 
-                             << ": " << result.getErrorMessage() << std::endl;
-                    return false;
-                }
-                
-                std::cout << "Successfully added MAC rule to chain " << chain_name 
-                         << ": MAC " << mac.mac_source << " -> " << (mac.allow ? "ACCEPT" : "DROP") << std::endl;
-            }
-        }
-        
-        // Process interface chain calls within the chain
-        if (section_config.interface_config && section_config.interface_config->chain) {
-            std::string target_chain_ref = *section_config.interface_config->chain;
-            
-            // Resolve the target chain name (may be a section name that needs to be resolved to actual chain name)
-            std::string target_chain = resolveChainName(target_chain_ref);
-            
-            // Generate rule comment for chain call
-            std::string comment = "YAML:chain:" + chain_name + ":chain_call:" + target_chain + ":" + getInterfaceComment(section_config.interface_config);
-            
-            // Remove existing rules with this signature in the chain
-            removeRulesBySignature("filter", chain_name, comment);
-            
-            // Build iptables command for chain call
-            std::vector<std::string> args = {"-A", chain_name};
-            
-            // Add interface specifications if present
-            if (section_config.interface_config->input) {
-                args.insert(args.end(), {"-i", *section_config.interface_config->input});
-            }
-            if (section_config.interface_config->output) {
-                args.insert(args.end(), {"-o", *section_config.interface_config->output});
-            }
-            
-            // Jump to target chain
-            args.insert(args.end(), {
-                "-m", "comment",
-                "--comment", comment,
-                "-j", target_chain
-            });
-            
-            auto result = CommandExecutor::executeIptables(args);
-            if (!result.isSuccess()) {
-                std::cerr << "Failed to add chain call rule to chain " << chain_name 
-                         << ": " << result.getErrorMessage() << std::endl;
-                return false;
-            }
-            
-            std::cout << "Successfully added chain call to " << target_chain 
-                     << " in chain " << chain_name << std::endl;
-        }
-    }
-    
-    return true;
-}
-
 } // namespace iptables 
\ No newline at end of file
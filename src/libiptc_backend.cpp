@@ -0,0 +1,466 @@
+#include "libiptc_backend.hpp"
+
+#ifdef HAVE_LIBIPTC
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <libiptc/libiptc.h>
+#include <linux/netfilter/nf_nat.h>
+#include <linux/netfilter/xt_comment.h>
+#include <linux/netfilter/xt_mac.h>
+#include <linux/netfilter/xt_multiport.h>
+#include <linux/netfilter/xt_tcpudp.h>
+#include <linux/netfilter_ipv4/ipt_REJECT.h>
+
+namespace iptables {
+
+namespace {
+
+// Rule specification: interfaces, match order and comment decoded from the
+// tokens, values taken from the row's typed columns
+struct NativeRule {
+    std::string in_iface;
+    std::string out_iface;
+    std::vector<AddressMatch> sources;
+    uint16_t proto = 0;
+    std::vector<std::string> modules;  ///< Matches in the order they were requested
+    std::vector<PortMatch> ports;
+    bool multiport = false;
+    std::optional<uint64_t> mac;
+    std::string comment;
+    std::string target;
+    uint16_t to_port = 0;
+};
+
+void addModule(NativeRule& rule, const std::string& module) {
+    if (std::find(rule.modules.begin(), rule.modules.end(), module) == rule.modules.end()) {
+        rule.modules.push_back(module);
+    }
+}
+
+NativeRule decodeRule(const RuleView& compiled) {
+    NativeRule rule;
+    rule.proto = compiled.protocol();
+    rule.sources.assign(compiled.sources().begin(), compiled.sources().end());
+    rule.ports.assign(compiled.ports().begin(), compiled.ports().end());
+    rule.multiport = compiled.multiport();
+    rule.mac = compiled.mac();
+    rule.target = compiled.target();
+    rule.to_port = compiled.toPort();
+
+    TokenSpan spec = compiled.spec();
+    for (size_t i = 0; i < spec.size(); ++i) {
+        const std::string& option = spec[i];
+        if (i + 1 >= spec.size()) {
+            throw std::invalid_argument("Missing value for option " + option);
+        }
+        const std::string& value = spec[++i];
+
+        if (option == "-i") {
+            rule.in_iface = value;
+        } else if (option == "-o") {
+            rule.out_iface = value;
+        } else if (option == "-m") {
+            if (value != "tcp" && value != "udp" && value != "multiport" && value != "mac" && value != "comment") {
+                throw std::invalid_argument("Unsupported match: " + value);
+            }
+            addModule(rule, value);
+        } else if (option == "--dport") {
+            addModule(rule, rule.proto == IPPROTO_UDP ? "udp" : "tcp");
+        } else if (option == "--comment") {
+            rule.comment = value;
+        } else if (option == "-p") {
+            if (rule.proto != IPPROTO_TCP && rule.proto != IPPROTO_UDP) {
+                throw std::invalid_argument("Unsupported protocol: " + value);
+            }
+        } else if (option == "-s") {
+            for (const auto& source : rule.sources) {
+                if (source.prefix == AddressMatch::kUnresolved) {
+                    throw std::invalid_argument("Source is not an IPv4 network: " + value);
+                }
+            }
+        } else if (option == "--mac-source") {
+            if (!rule.mac) {
+                throw std::invalid_argument("Invalid MAC address: " + value);
+            }
+        } else if (option != "--dports" && option != "-j" && option != "--to-port") {
+            throw std::invalid_argument("Unsupported rule option: " + option);
+        }
+    }
+
+    if (rule.target.empty()) {
+        throw std::invalid_argument("Rule has no target");
+    }
+    return rule;
+}
+
+// Fill an interface name and its match mask the way iptables does ("eth+" matches a prefix)
+void setInterface(const std::string& name, char* iface, unsigned char* mask) {
+    if (name.empty()) {
+        return;
+    }
+    if (name.size() >= IFNAMSIZ) {
+        throw std::invalid_argument("Interface name too long: " + name);
+    }
+    std::strncpy(iface, name.c_str(), IFNAMSIZ - 1);
+    size_t len = name.size();
+    if (name.back() == '+') {
+        std::memset(mask, 0xff, len - 1);
+    } else {
+        std::memset(mask, 0xff, len + 1);
+    }
+}
+
+void setSource(const AddressMatch& source, struct ipt_ip& ip) {
+    uint32_t mask = source.prefix == 0 ? 0 : ~uint32_t{0} << (32 - source.prefix);
+    ip.smsk.s_addr = htonl(mask);
+    ip.src.s_addr = htonl(source.network & mask);
+}
+
+// Append a match or target record (header plus payload) to an entry buffer
+template <typename Header>
+Header* appendRecord(std::vector<unsigned char>& buffer, const std::string& name, uint8_t revision,
+                     const void* data, size_t data_size) {
+    size_t size = XT_ALIGN(sizeof(Header)) + XT_ALIGN(data_size);
+    size_t offset = buffer.size();
+    buffer.resize(offset + size, 0);
+
+    auto* header = reinterpret_cast<Header*>(buffer.data() + offset);
+    std::strncpy(header->u.user.name, name.c_str(), sizeof(header->u.user.name) - 1);
+    header->u.user.revision = revision;
+    if constexpr (std::is_same_v<Header, xt_entry_match>) {
+        header->u.match_size = static_cast<uint16_t>(size);
+    } else {
+        header->u.target_size = static_cast<uint16_t>(size);
+    }
+    if (data_size > 0) {
+        std::memcpy(buffer.data() + offset + XT_ALIGN(sizeof(Header)), data, data_size);
+    }
+    return header;
+}
+
+void appendMatches(std::vector<unsigned char>& buffer, const NativeRule& rule) {
+    for (const auto& module : rule.modules) {
+        if (module == "tcp") {
+            xt_tcp tcp{};
+            tcp.spts[1] = 0xffff;
+            tcp.dpts[1] = 0xffff;
+            if (!rule.multiport && !rule.ports.empty()) {
+                tcp.dpts[0] = rule.ports.front().first;
+                tcp.dpts[1] = rule.ports.front().last;
+            }
+            appendRecord<xt_entry_match>(buffer, "tcp", 0, &tcp, sizeof(tcp));
+        } else if (module == "udp") {
+            xt_udp udp{};
+            udp.spts[1] = 0xffff;
+            udp.dpts[1] = 0xffff;
+            if (!rule.multiport && !rule.ports.empty()) {
+                udp.dpts[0] = rule.ports.front().first;
+                udp.dpts[1] = rule.ports.front().last;
+            }
+            appendRecord<xt_entry_match>(buffer, "udp", 0, &udp, sizeof(udp));
+        } else if (module == "multiport") {
+            xt_multiport_v1 multiport{};
+            multiport.flags = XT_MULTIPORT_DESTINATION;
+            for (const auto& [first, last] : rule.ports) {
+                size_t needed = (first == last) ? 1 : 2;
+                if (multiport.count + needed > XT_MULTI_PORTS) {
+                    throw std::invalid_argument("Too many ports for multiport match");
+                }
+                multiport.ports[multiport.count] = first;
+                if (first != last) {
+                    multiport.pflags[multiport.count] = 1;
+                    multiport.ports[++multiport.count] = last;
+                }
+                ++multiport.count;
+            }
+            appendRecord<xt_entry_match>(buffer, "multiport", 1, &multiport, sizeof(multiport));
+        } else if (module == "mac") {
+            if (!rule.mac) {
+                throw std::invalid_argument("mac match without --mac-source");
+            }
+            xt_mac_info mac{};
+            for (int i = 0; i < ETH_ALEN; ++i) {
+                mac.srcaddr[i] = static_cast<unsigned char>(*rule.mac >> (8 * (ETH_ALEN - 1 - i)));
+            }
+            appendRecord<xt_entry_match>(buffer, "mac", 0, &mac, sizeof(mac));
+        } else if (module == "comment") {
+            if (rule.comment.size() >= XT_MAX_COMMENT_LEN) {
+                throw std::invalid_argument("Comment too long: " + rule.comment);
+            }
+            xt_comment_info comment{};
+            std::strncpy(comment.comment, rule.comment.c_str(), XT_MAX_COMMENT_LEN - 1);
+            appendRecord<xt_entry_match>(buffer, "comment", 0, &comment, sizeof(comment));
+        }
+    }
+}
+
+void appendTarget(std::vector<unsigned char>& buffer, const NativeRule& rule) {
+    if (rule.target == "REJECT") {
+        ipt_reject_info reject{};
+        reject.with = IPT_ICMP_PORT_UNREACHABLE;
+        appendRecord<xt_entry_target>(buffer, "REJECT", 0, &reject, sizeof(reject));
+    } else if (rule.target == "REDIRECT") {
+        nf_nat_ipv4_multi_range_compat redirect{};
+        redirect.rangesize = 1;
+        if (rule.to_port != 0) {
+            redirect.range[0].flags = NF_NAT_RANGE_PROTO_SPECIFIED;
+            redirect.range[0].min.tcp.port = htons(rule.to_port);
+            redirect.range[0].max.tcp.port = htons(rule.to_port);
+        }
+        appendRecord<xt_entry_target>(buffer, "REDIRECT", 0, &redirect, sizeof(redirect));
+    } else {
+        // ACCEPT, DROP, RETURN and chain jumps are standard targets that libiptc resolves by name
+        int verdict = 0;
+        appendRecord<xt_entry_target>(buffer, rule.target, 0, &verdict, sizeof(verdict));
+    }
+}
+
+// Build the ipt_entry blobs for one compiled rule; "-s a,b" yields one entry per source
+std::vector<std::vector<unsigned char>> buildEntries(const RuleView& compiled) {
+    NativeRule rule = decodeRule(compiled);
+
+    // A rule without sources matches any address: one entry with an empty mask
+    std::vector<AddressMatch> sources = rule.sources;
+    if (sources.empty()) {
+        sources.push_back(AddressMatch{0, 0});
+    }
+
+    std::vector<std::vector<unsigned char>> entries;
+    for (const auto& source : sources) {
+        std::vector<unsigned char> buffer(XT_ALIGN(sizeof(ipt_entry)), 0);
+        {
+            auto* entry = reinterpret_cast<ipt_entry*>(buffer.data());
+            entry->ip.proto = rule.proto;
+            setInterface(rule.in_iface, entry->ip.iniface, entry->ip.iniface_mask);
+            setInterface(rule.out_iface, entry->ip.outiface, entry->ip.outiface_mask);
+            setSource(source, entry->ip);
+        }
+
+        appendMatches(buffer, rule);
+        size_t target_offset = buffer.size();
+        appendTarget(buffer, rule);
+
+        // The buffer may have been reallocated, so re-derive the entry pointer
+        auto* entry = reinterpret_cast<ipt_entry*>(buffer.data());
+        entry->target_offset = static_cast<uint16_t>(target_offset);
+        entry->next_offset = static_cast<uint16_t>(buffer.size());
+        entries.push_back(std::move(buffer));
+    }
+    return entries;
+}
+
+// Check whether a kernel entry carries a YAML comment
+bool isManagedEntry(const ipt_entry* entry) {
+    const auto* base = reinterpret_cast<const unsigned char*>(entry);
+    for (size_t offset = sizeof(ipt_entry); offset < entry->target_offset;) {
+        const auto* match = reinterpret_cast<const xt_entry_match*>(base + offset);
+        if (match->u.match_size == 0) {
+            break;
+        }
+        if (std::strcmp(match->u.user.name, "comment") == 0) {
+            const auto* info = reinterpret_cast<const xt_comment_info*>(match->data);
+            if (std::strncmp(info->comment, "YAML:", 5) == 0) {
+                return true;
+            }
+        }
+        offset += match->u.match_size;
+    }
+    return false;
+}
+
+// Owns a libiptc handle for the lifetime of one table transaction
+class TableHandle {
+public:
+    explicit TableHandle(const std::string& table) : handle_(iptc_init(table.c_str())) {}
+    ~TableHandle() {
+        if (handle_) iptc_free(handle_);
+    }
+    TableHandle(const TableHandle&) = delete;
+    TableHandle& operator=(const TableHandle&) = delete;
+
+    xtc_handle* get() const { return handle_; }
+
+private:
+    xtc_handle* handle_;
+};
+
+bool applyTable(const std::string& table, const CompiledRuleset& ruleset, bool reset, std::ostream& err) {
+    const bool is_filter = (table == "filter");
+
+    std::vector<RuleView> rules;
+    for (const auto& rule : ruleset.rules) {
+        if (rule.table() == table) {
+            rules.push_back(rule);
+        }
+    }
+    const bool required = !rules.empty() || (is_filter && (!ruleset.chains.empty() || !ruleset.policies.empty()));
+
+    TableHandle handle(table);
+    if (!handle.get()) {
+        if (!required && errno == ENOENT) {
+            // Table module not loaded: nothing of ours can live there
+            return true;
+        }
+        err << "Failed to read " << table << " table: " << iptc_strerror(errno) << std::endl;
+        return false;
+    }
+    xtc_handle* h = handle.get();
+
+    std::vector<std::string> chains;
+    for (const char* chain = iptc_first_chain(h); chain; chain = iptc_next_chain(h)) {
+        chains.emplace_back(chain);
+    }
+
+    bool changed = false;
+    auto fail = [&](const std::string& action, const std::string& chain) {
+        err << "Failed to " << action << " " << table << "/" << chain << ": "
+            << iptc_strerror(errno) << std::endl;
+        return false;
+    };
+
+    if (reset) {
+        for (const auto& chain : chains) {
+            if (!iptc_flush_entries(chain.c_str(), h)) return fail("flush", chain);
+        }
+        for (const auto& chain : chains) {
+            if (!iptc_builtin(chain.c_str(), h) && !iptc_delete_chain(chain.c_str(), h)) {
+                return fail("delete chain", chain);
+            }
+        }
+        changed = true;
+    } else {
+        std::vector<std::string> stale;
+        for (const auto& chain : chains) {
+            if (ruleset.ownsChain(table, chain)) {
+                if (!iptc_flush_entries(chain.c_str(), h)) return fail("flush", chain);
+                changed = true;
+                continue;
+            }
+            if (!iptc_builtin(chain.c_str(), h) && RulesetCompiler::isSectionChain(chain)) {
+                // Section chain of a removed section; deleted once its jump is gone
+                if (!iptc_flush_entries(chain.c_str(), h)) return fail("flush", chain);
+                stale.push_back(chain);
+                changed = true;
+                continue;
+            }
+
+            std::vector<unsigned int> managed;
+            unsigned int index = 0;
+            for (const ipt_entry* entry = iptc_first_rule(chain.c_str(), h); entry;
+                 entry = iptc_next_rule(entry, h)) {
+                if (isManagedEntry(entry)) {
+                    managed.push_back(index);
+                }
+                ++index;
+            }
+            for (auto it = managed.rbegin(); it != managed.rend(); ++it) {
+                if (!iptc_delete_num_entry(chain.c_str(), *it, h)) return fail("delete rule in", chain);
+                changed = true;
+            }
+        }
+        for (const auto& chain : stale) {
+            if (!iptc_delete_chain(chain.c_str(), h)) return fail("delete chain", chain);
+        }
+    }
+
+    if (is_filter) {
+        for (const auto& chain : ruleset.chains) {
+            if (!iptc_is_chain(chain.c_str(), h)) {
+                if (!iptc_create_chain(chain.c_str(), h)) return fail("create chain", chain);
+                changed = true;
+            }
+        }
+        for (const auto& [chain, policy] : ruleset.policies) {
+            // Setting a policy marks the table changed even when it already holds
+            xt_counters counters;
+            const char* current = iptc_get_policy(chain.c_str(), &counters, h);
+            if (current && policyToString(policy) == current) {
+                continue;
+            }
+            if (!iptc_set_policy(chain.c_str(), policyToString(policy).c_str(), nullptr, h)) {
+                return fail("set policy on", chain);
+            }
+            changed = true;
+        }
+    }
+
+    for (const auto& section_chain : ruleset.section_chains) {
+        if (section_chain.table == table && !iptc_is_chain(section_chain.name.c_str(), h)) {
+            if (!iptc_create_chain(section_chain.name.c_str(), h)) return fail("create chain", section_chain.name);
+            changed = true;
+        }
+    }
+
+    for (const auto& rule : rules) {
+        std::vector<std::vector<unsigned char>> entries;
+        try {
+            entries = buildEntries(rule);
+        } catch (const std::exception& e) {
+            err << "Cannot translate rule " << rule.comment() << ": " << e.what() << std::endl;
+            return false;
+        }
+        for (const auto& entry : entries) {
+            if (!iptc_append_entry(rule.chain().c_str(), reinterpret_cast<const ipt_entry*>(entry.data()), h)) {
+                return fail("append rule " + rule.comment() + " to", rule.chain());
+            }
+            changed = true;
+        }
+    }
+
+    if (changed && !iptc_commit(h)) {
+        err << "Failed to commit " << table << " table: " << iptc_strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool LibiptcBackend::isAvailable() {
+    return true;
+}
+
+bool LibiptcBackend::apply(const CompiledRuleset& ruleset, bool reset, std::ostream& out, std::ostream& err) {
+    std::vector<std::string> tables = {"filter", "nat", "mangle"};
+    for (const auto& table : ruleset.tables()) {
+        if (std::find(tables.begin(), tables.end(), table) == tables.end()) {
+            tables.push_back(table);
+        }
+    }
+
+    out << "Applying " << ruleset.rules.size() << " rule(s) and "
+        << ruleset.chains.size() + ruleset.section_chains.size() << " chain(s) through libiptc" << std::endl;
+
+    for (const auto& table : tables) {
+        if (!applyTable(table, ruleset, reset, err)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace iptables
+
+#else // !HAVE_LIBIPTC
+
+namespace iptables {
+
+bool LibiptcBackend::isAvailable() {
+    return false;
+}
+
+bool LibiptcBackend::apply(const CompiledRuleset&, bool, std::ostream&, std::ostream& err) {
+    err << "This build of iptables-compose-cpp does not include the libiptc backend" << std::endl;
+    return false;
+}
+
+} // namespace iptables
+
+#endif // HAVE_LIBIPTC
@@ -1,13 +1,80 @@
 #include <iostream>
 #include <string>
 #include <filesystem>
+#include <chrono>
+#include <csignal>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <sstream>
 #include "iptables_manager.hpp"
+#include "command_executor.hpp"
 #include "cli_parser.hpp"
 #include "system_utils.hpp"
-#include "config_parser.hpp"
+#include "config_loader.hpp"
 #include "rule_validator.hpp"
+#include "libiptc_backend.hpp"
+#include "simulated_netfilter.hpp"
+#include "metrics.hpp"
+#include "state_journal.hpp"
+#include "ruleset_cache.hpp"
+#include "control_socket.hpp"
 
-int main(int argc, char* argv[]) {
+namespace {
+
+// SIGINT/SIGTERM kill running iptables children instead of orphaning them;
+// the handler resets itself, so a second signal terminates immediately
+void cancelOnSignal(int) {
+    iptables::CommandExecutor::cancelAll();
+}
+
+void installCancelHandlers() {
+    struct sigaction action = {};
+    action.sa_handler = cancelOnSignal;
+    action.sa_flags = SA_RESETHAND;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+}
+
+// Installs the in-memory netfilter for --simulate; when the run ends, the
+// simulated ruleset is written back and the simulation statistics printed
+class Simulation {
+public:
+    Simulation(const std::filesystem::path& state_file, unsigned latency_ms)
+        : state_file_(state_file) {
+        iptables::RulesetSnapshot initial = iptables::SimulatedNetfilter::defaultRuleset();
+        std::ifstream in(state_file_);
+        if (in) {
+            std::ostringstream dump;
+            dump << in.rdbuf();
+            initial = iptables::RulesetSnapshot::parse(dump.str());
+        }
+        netfilter_ = std::make_unique<iptables::SimulatedNetfilter>(std::move(initial));
+        netfilter_->setLatency(std::chrono::milliseconds(latency_ms));
+        iptables::CommandExecutor::setRunner(netfilter_.get());
+    }
+    
+    ~Simulation() {
+        iptables::CommandExecutor::setRunner(nullptr);
+        std::ofstream out(state_file_);
+        out << netfilter_->ruleset().dump(true);
+        if (!out) {
+            std::cerr << "Failed to save simulated ruleset to " << state_file_.string() << std::endl;
+        }
+        std::cout << netfilter_->statistics().summary() << std::endl;
+    }
+    
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+    
+private:
+    std::filesystem::path state_file_;
+    std::unique_ptr<iptables::SimulatedNetfilter> netfilter_;
+};
+
+// Runs the requested action; metrics_file is set once the options are known
+int run(int argc, char* argv[], std::optional<std::filesystem::path>& metrics_file) {
     try {
         // Parse command line arguments using getopt_long for robust argument handling
         // This will throw std::invalid_argument for invalid options or combinations
@@ -27,13 +94,82 @@ int main(int argc, char* argv[]) {
             return 0;
         }
         
+        metrics_file = options.metrics_file;
+        
+        // Control client: one request to a running daemon, which does all the work
+        if (options.control) {
+            std::string body;
+            if (options.control->compare(0, 13, "apply-section") == 0) {
+                std::ostringstream input;
+                input << std::cin.rdbuf();
+                body = input.str();
+            }
+            auto response = iptables::ControlClient::send(options.socket.value_or(iptables::ControlServer::kDefaultPath),
+                                                          iptables::ControlClient::parse(*options.control, body));
+            if (!response) {
+                return 1;
+            }
+            std::cout << response->body << std::flush;
+            return response->success ? 0 : 1;
+        }
+        
+        // Handle payload emission (no system validation needed)
+        // Compiling a configuration into an iptables-restore payload never touches the kernel
+        if (options.emit_restore) {
+            iptables::IptablesManager manager;
+            manager.setSectionChains(options.section_chains);
+            if (!manager.emitRestore(*options.config_file, *options.emit_restore)) {
+                std::cerr << "Failed to emit iptables-restore payload for: " << options.config_file->string() << std::endl;
+                return 1;
+            }
+            return 0;
+        }
+        
+        // Bound every command, and the run as a whole if requested, so a hung
+        // iptables invocation cannot outlast the service manager's start timeout
+        iptables::CommandExecutor::setCommandTimeout(std::chrono::seconds(options.command_timeout));
+        if (options.timeout && *options.timeout > 0) {
+            iptables::CommandExecutor::setDeadline(std::chrono::steady_clock::now() +
+                                                   std::chrono::seconds(*options.timeout));
+        }
+        installCancelHandlers();
+        
+        // A simulated ruleset gets a journal of its own, next to its state file
+        if (options.state_file) {
+            iptables::StateJournal::setPath(*options.state_file);
+        } else if (options.simulate) {
+            iptables::StateJournal::setPath(options.simulate->string() + ".state");
+        }
+        if (options.cache_file) {
+            iptables::RulesetCache::setPath(*options.cache_file);
+        } else if (options.simulate) {
+            iptables::RulesetCache::setPath(options.simulate->string() + ".cache");
+        }
+        
+        // Simulation replaces every iptables program with an in-memory ruleset
+        std::unique_ptr<Simulation> simulation;
+        if (options.simulate) {
+            std::cout << "Simulating netfilter in memory, state file: " << options.simulate->string() << std::endl;
+            simulation = std::make_unique<Simulation>(*options.simulate, options.simulate_latency_ms);
+        }
+        
         // For all iptables operations, validate system requirements first
         // This prevents confusing error messages later in the process
         std::cout << "Validating system requirements..." << std::endl;
         try {
             // In debug mode, skip system validation to allow testing without root privileges
             // This enables developers to test configuration parsing and validation
-            if (!options.debug) {
+            if (options.simulate) {
+                std::cout << "Simulation: Skipping system validation." << std::endl;
+            } else if (options.from_cache && !options.debug) {
+                // At boot every process spawned counts; iptables-restore itself
+                // reports a missing binary, so only privileges are checked here
+                if (!iptables::SystemUtils::isRunningAsRoot()) {
+                    std::cerr << "Error: --from-cache must be run as root." << std::endl;
+                    throw std::runtime_error("not running as root");
+                }
+                std::cout << "System validation passed." << std::endl;
+            } else if (!options.debug) {
                 // Check for root privileges, iptables availability, and execution permissions
                 // Throws std::runtime_error with detailed error messages if validation fails
                 iptables::SystemUtils::validateSystemRequirements();
@@ -48,6 +184,18 @@ int main(int argc, char* argv[]) {
             return 1;
         }
         
+        // Handle plan preview
+        // Reads the live ruleset and prints the minimal changes without applying them
+        if (options.plan) {
+            iptables::IptablesManager manager;
+            manager.setSectionChains(options.section_chains);
+            if (!manager.planConfig(*options.config_file)) {
+                std::cerr << "Failed to plan configuration: " << options.config_file->string() << std::endl;
+                return 1;
+            }
+            return 0;
+        }
+        
         // Handle rule removal without config
         // This operation removes all rules with YAML comment signatures from iptables
         if (options.remove_rules) {
@@ -90,6 +238,21 @@ int main(int argc, char* argv[]) {
             
             // Create manager instance for configuration processing
             iptables::IptablesManager manager;
+            manager.setSectionChains(options.section_chains);
+            if (options.backend == "restore") {
+                // Apply the whole configuration, including any reset, in one iptables-restore transaction
+                manager.setBackend(iptables::IptablesManager::Backend::Restore);
+            } else if (options.backend == "libiptc") {
+                // Apply in-process with one libiptc commit per table, if this build supports it
+                if (!iptables::LibiptcBackend::isAvailable()) {
+                    std::cerr << "Error: this build does not include the libiptc backend." << std::endl;
+                    return 1;
+                }
+                manager.setBackend(iptables::IptablesManager::Backend::Libiptc);
+            } else if (options.backend == "stream") {
+                // Replace rules one by one, streamed as small batches to a single iptables-restore
+                manager.setBackend(iptables::IptablesManager::Backend::Stream);
+            }
             
             // Debug mode: validation-only workflow without applying iptables rules
             // This allows safe testing of configuration files and rule validation
@@ -99,9 +262,9 @@ int main(int argc, char* argv[]) {
                 // Load and validate configuration without applying to iptables
                 // This workflow is safe to run without root privileges
                 try {
-                    // Parse YAML configuration file into internal Config structure
+                    // Parse the YAML configuration file and its fragments into one Config structure
                     // This validates YAML syntax and converts to typed configuration objects
-                    iptables::Config config = iptables::ConfigParser::loadFromFile(config_path.string());
+                    iptables::Config config = iptables::ConfigLoader().load(config_path);
                     std::cout << "Configuration loaded successfully" << std::endl;
                     
                     // Run rule order validation to detect potential configuration issues
@@ -145,6 +308,53 @@ int main(int argc, char* argv[]) {
                 }
             }
             
+            // Hitless reload: the new ruleset is built before the old one is taken away
+            if (options.reload) {
+                std::cout << "Reloading configuration..." << std::endl;
+                if (!manager.reloadConfig(config_path)) {
+                    std::cerr << "Failed to reload configuration: " << config_path.string() << std::endl;
+                    return 1;
+                }
+                std::cout << "Configuration reloaded successfully!" << std::endl;
+                return 0;
+            }
+            
+            // Drift detection: read-only, the exit status tells monitoring what it found;
+            // only a state file named on the command line is written
+            if (options.check) {
+                std::optional<bool> in_sync = manager.checkConfig(config_path, options.state_file.has_value());
+                if (!in_sync) {
+                    std::cerr << "Failed to check configuration: " << config_path.string() << std::endl;
+                    return 1;
+                }
+                return *in_sync ? 0 : 2;
+            }
+            
+            // Drift repair: runs until SIGINT or SIGTERM
+            if (options.watch) {
+                return manager.watchConfig(config_path) ? 0 : 1;
+            }
+            
+            // Daemon: configuration edits are reapplied as well, from a resident model
+            if (options.daemon) {
+                if (options.socket) {
+                    manager.setControlSocket(*options.socket);
+                } else if (options.simulate) {
+                    manager.setControlSocket(options.simulate->string() + ".sock");
+                }
+                return manager.runDaemon(config_path) ? 0 : 1;
+            }
+            
+            // Boot fast path: the cached payload if it still matches, a full apply otherwise
+            if (options.from_cache) {
+                if (!manager.loadFromCache(config_path)) {
+                    std::cerr << "Failed to load or apply configuration: " << config_path.string() << std::endl;
+                    return 1;
+                }
+                std::cout << "Configuration applied successfully!" << std::endl;
+                return 0;
+            }
+            
             // Handle rule reset before config application
             // Reset clears all existing iptables rules to start with a clean slate
             if (options.reset) {
@@ -212,4 +422,17 @@ int main(int argc, char* argv[]) {
         std::cerr << "Please report this issue with the command you were trying to execute." << std::endl;
         return 1;
     }
-} 
\ No newline at end of file
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::optional<std::filesystem::path> metrics_file;
+    int status = run(argc, argv, metrics_file);
+    
+    // Metrics are written for failed runs too, so alerts can fire on them
+    if (metrics_file && !iptables::Metrics::writeFile(*metrics_file, status == 0)) {
+        return status == 0 ? 1 : status;
+    }
+    return status;
+}
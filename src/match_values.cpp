@@ -0,0 +1,115 @@
+#include "match_values.hpp"
+#include <cctype>
+
+namespace iptables {
+
+namespace {
+
+// Parse a decimal number of at most `digits` digits that does not exceed `max`
+bool parseDecimal(std::string_view text, size_t digits, uint32_t max, uint32_t& value) {
+    if (text.empty() || text.size() > digits) {
+        return false;
+    }
+    value = 0;
+    for (char c : text) {
+        if (!std::isdigit(static_cast<unsigned char>(c))) {
+            return false;
+        }
+        value = value * 10 + static_cast<uint32_t>(c - '0');
+    }
+    return value <= max;
+}
+
+int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+} // namespace
+
+Subnet Subnet::parse(std::string_view text) {
+    Subnet subnet;
+    subnet.text = std::string(text);
+
+    std::string_view address = text;
+    uint32_t prefix = 32;
+    size_t slash = text.find('/');
+    if (slash != std::string_view::npos) {
+        address = text.substr(0, slash);
+        if (!parseDecimal(text.substr(slash + 1), 2, 32, prefix)) {
+            return subnet;
+        }
+    }
+
+    // Dotted quad with four decimal octets
+    uint32_t network = 0;
+    for (int octet = 0; octet < 4; ++octet) {
+        size_t dot = octet < 3 ? address.find('.') : address.size();
+        uint32_t value;
+        if (dot == std::string_view::npos || !parseDecimal(address.substr(0, dot), 3, 255, value)) {
+            return subnet;
+        }
+        network = (network << 8) | value;
+        address.remove_prefix(octet < 3 ? dot + 1 : dot);
+    }
+
+    uint32_t mask = prefix == 0 ? 0 : ~0U << (32 - prefix);
+    subnet.network = network & mask;
+    subnet.prefix = static_cast<uint8_t>(prefix);
+    subnet.valid = true;
+    return subnet;
+}
+
+bool Subnet::contains(const Subnet& other) const {
+    if (!valid || !other.valid || prefix > other.prefix) {
+        return false;
+    }
+    uint32_t mask = prefix == 0 ? 0 : ~0U << (32 - prefix);
+    return (other.network & mask) == network;
+}
+
+PortRange PortRange::parse(std::string_view text) {
+    PortRange range;
+    range.text = std::string(text);
+
+    size_t dash = text.find('-');
+    uint32_t first;
+    uint32_t last;
+    if (dash == std::string_view::npos || !parseDecimal(text.substr(0, dash), 5, 65535, first) ||
+        !parseDecimal(text.substr(dash + 1), 5, 65535, last)) {
+        return range;
+    }
+    range.first = static_cast<uint16_t>(first);
+    range.last = static_cast<uint16_t>(last);
+    range.valid = first >= 1 && first < last;
+    return range;
+}
+
+std::string PortRange::toMultiport() const {
+    return std::to_string(first) + ":" + std::to_string(last);
+}
+
+MacAddress MacAddress::parse(std::string_view text) {
+    MacAddress mac;
+    mac.text = std::string(text);
+
+    if (text.size() != 17) {
+        return mac;
+    }
+    uint64_t value = 0;
+    for (size_t i = 0; i < 6; ++i) {
+        int high = hexDigit(text[3 * i]);
+        int low = hexDigit(text[3 * i + 1]);
+        if (high < 0 || low < 0 || (i < 5 && text[3 * i + 2] != ':' && text[3 * i + 2] != '-')) {
+            return mac;
+        }
+        value = (value << 8) | static_cast<uint64_t>(high << 4 | low);
+    }
+    mac.value = value;
+    mac.valid = true;
+    return mac;
+}
+
+} // namespace iptables
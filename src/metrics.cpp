@@ -0,0 +1,303 @@
+#include "metrics.hpp"
+#include "xtables_lock.hpp"
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <sstream>
+
+namespace iptables {
+
+namespace {
+
+std::mutex g_metrics_mutex;
+RunMetrics g_metrics;
+const auto g_run_started = std::chrono::steady_clock::now();
+
+std::string programName(const std::string& path) {
+    size_t slash = path.rfind('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() &&
+           text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Value of "-t TABLE" in an argument vector, or an empty string
+std::string tableArgument(const std::vector<std::string>& args) {
+    for (size_t i = 1; i + 1 < args.size(); ++i) {
+        if (args[i] == "-t" || args[i] == "--table") {
+            return args[i + 1];
+        }
+    }
+    return "";
+}
+
+bool isListing(const std::vector<std::string>& args) {
+    for (size_t i = 1; i < args.size(); ++i) {
+        if (args[i] == "-L" || args[i] == "-S" || args[i] == "--list" || args[i] == "--list-rules") {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Tables named by "*table" lines of an iptables-restore payload
+std::set<std::string> restoreTables(const std::string& input) {
+    std::set<std::string> tables;
+    size_t pos = 0;
+    while (pos < input.size()) {
+        size_t end = input.find('\n', pos);
+        if (end == std::string::npos) {
+            end = input.size();
+        }
+        if (input[pos] == '*') {
+            tables.insert(input.substr(pos + 1, end - pos - 1));
+        }
+        pos = end + 1;
+    }
+    return tables;
+}
+
+std::string jsonString(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+template <typename Value>
+void jsonMap(std::ostream& out, const std::map<std::string, Value>& values) {
+    out << "{";
+    const char* separator = "";
+    for (const auto& [name, value] : values) {
+        out << separator << jsonString(name) << ": " << value;
+        separator = ", ";
+    }
+    out << "}";
+}
+
+// One gauge with HELP and TYPE lines, optionally split by a label
+class PrometheusWriter {
+public:
+    explicit PrometheusWriter(std::ostream& out) : out_(out) {}
+
+    template <typename Value>
+    void gauge(const std::string& name, const std::string& help, Value value) {
+        header(name, help);
+        out_ << "iptables_compose_" << name << " " << value << "\n";
+    }
+
+    template <typename Value>
+    void gauge(const std::string& name, const std::string& help, const std::string& label,
+               const std::map<std::string, Value>& values) {
+        header(name, help);
+        for (const auto& [key, value] : values) {
+            out_ << "iptables_compose_" << name << "{" << label << "=\"" << key << "\"} " << value << "\n";
+        }
+    }
+
+private:
+    void header(const std::string& name, const std::string& help) {
+        out_ << "# HELP iptables_compose_" << name << " " << help << "\n"
+             << "# TYPE iptables_compose_" << name << " gauge\n";
+    }
+
+    std::ostream& out_;
+};
+
+} // namespace
+
+Metrics::PhaseTimer::PhaseTimer(std::string phase)
+    : phase_(std::move(phase)), start_(std::chrono::steady_clock::now()) {
+}
+
+void Metrics::PhaseTimer::stop() {
+    if (running_) {
+        running_ = false;
+        recordPhase(phase_, std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count());
+    }
+}
+
+void Metrics::recordPhase(const std::string& phase, double seconds) {
+    std::lock_guard<std::mutex> lock(g_metrics_mutex);
+    PhaseMetrics& metrics = g_metrics.phases[phase];
+    metrics.runs++;
+    metrics.seconds += seconds;
+}
+
+void Metrics::recordCommand(const std::vector<std::string>& args, const std::string& input,
+                            const CommandResult& result, double seconds, bool spawned) {
+    std::string program = args.empty() ? "" : programName(args[0]);
+    std::set<std::string> tables;
+    bool listing = false;
+    if (endsWith(program, "-restore")) {
+        tables = restoreTables(input);
+    } else if (endsWith(program, "-save")) {
+        listing = true;
+        std::string table = tableArgument(args);
+        if (!table.empty()) {
+            tables.insert(table);
+        }
+    } else if (program.compare(0, 8, "iptables") == 0) {
+        listing = isListing(args);
+        std::string table = tableArgument(args);
+        tables.insert(table.empty() ? "filter" : table);
+    }
+
+    std::lock_guard<std::mutex> lock(g_metrics_mutex);
+    if (spawned) {
+        g_metrics.processes++;
+        g_metrics.programs[program]++;
+        for (const auto& table : tables) {
+            g_metrics.tables[table]++;
+        }
+    }
+    if (!result.isSuccess()) {
+        g_metrics.failures++;
+    }
+    if (result.timed_out) {
+        g_metrics.timeouts++;
+    }
+    g_metrics.command_seconds += seconds;
+    g_metrics.bytes_written += input.size();
+    g_metrics.bytes_read += result.stdout_output.size() + result.stderr_output.size();
+    if (listing) {
+        g_metrics.listing_bytes += result.stdout_output.size();
+    }
+}
+
+void Metrics::recordOperations(const std::string& kind, uint64_t count) {
+    if (count == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(g_metrics_mutex);
+    g_metrics.operations[kind] += count;
+}
+
+RunMetrics Metrics::snapshot() {
+    std::lock_guard<std::mutex> lock(g_metrics_mutex);
+    return g_metrics;
+}
+
+double Metrics::elapsedSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - g_run_started).count();
+}
+
+std::string Metrics::toJson(bool success) {
+    RunMetrics metrics = snapshot();
+    LockStatistics lock = XtablesLock::statistics();
+
+    std::ostringstream out;
+    out << std::setprecision(9);
+    out << "{\n"
+        << "  \"success\": " << (success ? "true" : "false") << ",\n"
+        << "  \"timestamp\": " << std::time(nullptr) << ",\n"
+        << "  \"duration_seconds\": " << elapsedSeconds() << ",\n"
+        << "  \"phases\": {";
+    const char* separator = "";
+    for (const auto& [name, phase] : metrics.phases) {
+        out << separator << "\n    " << jsonString(name) << ": {\"runs\": " << phase.runs
+            << ", \"seconds\": " << phase.seconds << "}";
+        separator = ",";
+    }
+    out << (metrics.phases.empty() ? "" : "\n  ") << "},\n"
+        << "  \"processes\": " << metrics.processes << ",\n"
+        << "  \"programs\": ";
+    jsonMap(out, metrics.programs);
+    out << ",\n  \"tables\": ";
+    jsonMap(out, metrics.tables);
+    out << ",\n"
+        << "  \"failures\": " << metrics.failures << ",\n"
+        << "  \"timeouts\": " << metrics.timeouts << ",\n"
+        << "  \"command_seconds\": " << metrics.command_seconds << ",\n"
+        << "  \"bytes_written\": " << metrics.bytes_written << ",\n"
+        << "  \"bytes_read\": " << metrics.bytes_read << ",\n"
+        << "  \"listing_bytes\": " << metrics.listing_bytes << ",\n"
+        << "  \"operations\": ";
+    jsonMap(out, metrics.operations);
+    out << ",\n"
+        << "  \"xtables_lock\": {\"commands\": " << lock.commands << ", \"contended\": " << lock.contended
+        << ", \"retries\": " << lock.retries << ", \"wait_seconds\": " << lock.wait_seconds
+        << ", \"work_seconds\": " << lock.work_seconds << "}\n"
+        << "}\n";
+    return out.str();
+}
+
+std::string Metrics::toPrometheus(bool success) {
+    RunMetrics metrics = snapshot();
+    LockStatistics lock = XtablesLock::statistics();
+
+    std::map<std::string, double> phase_seconds;
+    std::map<std::string, uint64_t> phase_runs;
+    for (const auto& [name, phase] : metrics.phases) {
+        phase_seconds[name] = phase.seconds;
+        phase_runs[name] = phase.runs;
+    }
+
+    std::ostringstream out;
+    out << std::setprecision(9);
+    PrometheusWriter writer(out);
+    writer.gauge("last_run_success", "Whether the last run succeeded", success ? 1 : 0);
+    writer.gauge("last_run_timestamp_seconds", "Unix time the last run finished",
+                 static_cast<long long>(std::time(nullptr)));
+    writer.gauge("last_run_duration_seconds", "Wall-clock time of the last run", elapsedSeconds());
+    writer.gauge("phase_duration_seconds", "Time spent per phase, summed over workers", "phase", phase_seconds);
+    writer.gauge("phase_runs", "Times each phase was entered", "phase", phase_runs);
+    writer.gauge("processes_spawned", "Processes started", metrics.processes);
+    writer.gauge("program_invocations", "Processes started per program", "program", metrics.programs);
+    writer.gauge("table_invocations", "iptables program invocations per table", "table", metrics.tables);
+    writer.gauge("command_failures", "Commands that did not succeed", metrics.failures);
+    writer.gauge("command_timeouts", "Commands killed by a deadline or cancellation", metrics.timeouts);
+    writer.gauge("command_duration_seconds", "Time spent in commands, summed over workers",
+                 metrics.command_seconds);
+    writer.gauge("bytes_written", "Bytes written to command input", metrics.bytes_written);
+    writer.gauge("bytes_read", "Bytes read from command output", metrics.bytes_read);
+    writer.gauge("listing_bytes_read", "Bytes read from ruleset listings", metrics.listing_bytes);
+    writer.gauge("operations", "Ruleset changes made per kind", "kind", metrics.operations);
+    writer.gauge("xtables_lock_commands", "Commands run under the xtables lock", lock.commands);
+    writer.gauge("xtables_lock_contended", "Commands that waited for the xtables lock", lock.contended);
+    writer.gauge("xtables_lock_retries", "Commands re-run because the xtables lock was busy", lock.retries);
+    writer.gauge("xtables_lock_wait_seconds", "Time spent waiting for the xtables lock", lock.wait_seconds);
+    return out.str();
+}
+
+bool Metrics::writeFile(const std::filesystem::path& path, bool success) {
+    std::string content = path.extension() == ".json" ? toJson(success) : toPrometheus(success);
+
+    // node exporter may read the file at any moment; rename() replaces it atomically
+    std::filesystem::path temporary = path;
+    temporary += ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::trunc);
+        out << content;
+        if (!out.flush()) {
+            std::cerr << "Failed to write metrics to " << temporary.string() << std::endl;
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::cerr << "Failed to write metrics to " << path.string() << ": " << error.message() << std::endl;
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+} // namespace iptables
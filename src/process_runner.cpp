@@ -0,0 +1,343 @@
+#include "process_runner.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace iptables {
+
+namespace {
+
+// Read size per syscall; iptables-save output for large rulesets is several megabytes
+constexpr size_t kReadChunk = 64 * 1024;
+
+void closeFd(int& fd) {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+// Blocks SIGPIPE for the calling thread while writing to a child's stdin, so a
+// child that exits early produces EPIPE instead of terminating this process
+class SigpipeGuard {
+public:
+    SigpipeGuard() {
+        sigset_t block;
+        sigemptyset(&block);
+        sigaddset(&block, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &block, &previous_);
+    }
+
+    ~SigpipeGuard() {
+        // Discard a SIGPIPE raised by our own writes before unblocking
+        sigset_t pending;
+        sigpending(&pending);
+        if (sigismember(&pending, SIGPIPE) && !sigismember(&previous_, SIGPIPE)) {
+            sigset_t only_pipe;
+            sigemptyset(&only_pipe);
+            sigaddset(&only_pipe, SIGPIPE);
+            struct timespec zero = {0, 0};
+            sigtimedwait(&only_pipe, nullptr, &zero);
+        }
+        pthread_sigmask(SIG_SETMASK, &previous_, nullptr);
+    }
+
+private:
+    sigset_t previous_;
+};
+
+// Append whatever is readable on fd; returns false once the stream is at EOF
+bool drain(int fd, std::string& buffer) {
+    for (;;) {
+        size_t old_size = buffer.size();
+        if (buffer.capacity() - old_size < kReadChunk) {
+            buffer.reserve(buffer.capacity() * 2 + kReadChunk);
+        }
+        buffer.resize(old_size + kReadChunk);
+        ssize_t n = read(fd, &buffer[old_size], kReadChunk);
+        buffer.resize(old_size + (n > 0 ? static_cast<size_t>(n) : 0));
+        if (n > 0) {
+            if (static_cast<size_t>(n) < kReadChunk) {
+                return true;
+            }
+            continue;
+        }
+        if (n < 0 && (errno == EINTR)) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        return false;
+    }
+}
+
+// Milliseconds a poll() may block before the limits need checking again; -1 for none
+int pollTimeout(const ExecutionLimits& limits) {
+    // A cancellation flag cannot wake poll(), so it is checked at this interval
+    constexpr int kCancelCheckMs = 50;
+    int timeout = limits.cancelled ? kCancelCheckMs : -1;
+    if (limits.deadline != ExecutionLimits::Clock::time_point::max()) {
+        auto remaining = std::chrono::ceil<std::chrono::milliseconds>(limits.deadline -
+                                                                      ExecutionLimits::Clock::now()).count();
+        // Capped so the conversion to int cannot overflow; the loop simply polls again
+        int until_deadline = static_cast<int>(std::max<long long>(0, std::min<long long>(remaining, 60000)));
+        timeout = timeout < 0 ? until_deadline : std::min(timeout, until_deadline);
+    }
+    return timeout;
+}
+
+// Check whether a child has terminated without reaping it
+bool hasExited(pid_t pid) {
+    siginfo_t info = {};
+    if (waitid(P_PID, static_cast<id_t>(pid), &info, WEXITED | WNOHANG | WNOWAIT) != 0) {
+        return errno != EINTR;
+    }
+    return info.si_pid != 0;
+}
+
+} // namespace
+
+SpawnedProcess ProcessRunner::spawn(const std::vector<std::string>& argv) {
+    SpawnedProcess process;
+    if (argv.empty()) {
+        process.error = EINVAL;
+        return process;
+    }
+
+    int in_pipe[2] = {-1, -1};
+    int out_pipe[2] = {-1, -1};
+    int err_pipe[2] = {-1, -1};
+    if (pipe2(in_pipe, O_CLOEXEC) != 0 || pipe2(out_pipe, O_CLOEXEC) != 0 || pipe2(err_pipe, O_CLOEXEC) != 0) {
+        process.error = errno;
+        for (int* fds : {in_pipe, out_pipe, err_pipe}) {
+            closeFd(fds[0]);
+            closeFd(fds[1]);
+        }
+        return process;
+    }
+
+    // dup2 clears close-on-exec on the child's copies of the stream descriptors
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, in_pipe[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, out_pipe[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, err_pipe[1], STDERR_FILENO);
+
+    // Own process group, so a deadline kill also reaches anything the child started
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attributes, 0);
+
+    std::vector<char*> args;
+    args.reserve(argv.size() + 1);
+    for (const auto& arg : argv) {
+        args.push_back(const_cast<char*>(arg.c_str()));
+    }
+    args.push_back(nullptr);
+
+    pid_t pid = -1;
+    int rc = posix_spawnp(&pid, args[0], &actions, &attributes, args.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+
+    closeFd(in_pipe[0]);
+    closeFd(out_pipe[1]);
+    closeFd(err_pipe[1]);
+
+    if (rc != 0) {
+        process.error = rc;
+        closeFd(in_pipe[1]);
+        closeFd(out_pipe[0]);
+        closeFd(err_pipe[0]);
+        return process;
+    }
+
+    process.pid = pid;
+    process.stdin_fd = in_pipe[1];
+    process.stdout_fd = out_pipe[0];
+    process.stderr_fd = err_pipe[0];
+    return process;
+}
+
+int ProcessRunner::wait(pid_t pid) {
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    }
+    if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+    return -1;
+}
+
+void ProcessRunner::kill(pid_t pid) {
+    if (pid <= 0) {
+        return;
+    }
+    if (::kill(-pid, SIGKILL) != 0) {
+        ::kill(pid, SIGKILL);
+    }
+}
+
+CommandResult ProcessRunner::run(const std::vector<std::string>& argv, const std::string& input,
+                                 const ExecutionLimits& limits) {
+    SpawnedProcess process = spawn(argv);
+    if (process.pid < 0) {
+        CommandResult result;
+        result.success = false;
+        result.exit_code = 127;
+        result.stderr_output = "Failed to start " + (argv.empty() ? std::string("<empty>") : argv[0]) +
+                               ": " + std::strerror(process.error);
+        return result;
+    }
+
+    return communicate(process, input, limits);
+}
+
+bool ProcessRunner::writeAll(int fd, const std::string& data, const ExecutionLimits& limits) {
+    SigpipeGuard sigpipe_guard;
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = write(fd, data.data() + written, data.size() - written);
+        if (n > 0) {
+            written += static_cast<size_t>(n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (limits.expired()) {
+                return false;
+            }
+            struct pollfd pfd = {fd, POLLOUT, 0};
+            poll(&pfd, 1, pollTimeout(limits));
+            continue;
+        }
+        return false;
+    }
+    return true;
+}
+
+CommandResult ProcessRunner::communicate(SpawnedProcess& process, const std::string& input,
+                                        const ExecutionLimits& limits) {
+    CommandResult result;
+
+    for (int fd : {process.stdin_fd, process.stdout_fd, process.stderr_fd}) {
+        if (fd >= 0) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        }
+    }
+
+    result.stdout_output.reserve(kReadChunk);
+    result.stderr_output.reserve(kReadChunk / 16);
+
+    size_t written = 0;
+    if (input.empty()) {
+        closeFd(process.stdin_fd);
+    }
+
+    SigpipeGuard sigpipe_guard;
+    while (process.stdout_fd >= 0 || process.stderr_fd >= 0 || process.stdin_fd >= 0) {
+        if (limits.expired()) {
+            kill(process.pid);
+            result.timed_out = true;
+            break;
+        }
+
+        struct pollfd fds[3];
+        nfds_t count = 0;
+        int stdin_slot = -1, stdout_slot = -1, stderr_slot = -1;
+        if (process.stdin_fd >= 0) {
+            stdin_slot = static_cast<int>(count);
+            fds[count++] = {process.stdin_fd, POLLOUT, 0};
+        }
+        if (process.stdout_fd >= 0) {
+            stdout_slot = static_cast<int>(count);
+            fds[count++] = {process.stdout_fd, POLLIN, 0};
+        }
+        if (process.stderr_fd >= 0) {
+            stderr_slot = static_cast<int>(count);
+            fds[count++] = {process.stderr_fd, POLLIN, 0};
+        }
+
+        if (poll(fds, count, pollTimeout(limits)) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (stdin_slot >= 0 && fds[stdin_slot].revents) {
+            if (fds[stdin_slot].revents & (POLLERR | POLLHUP)) {
+                closeFd(process.stdin_fd);
+            } else {
+                ssize_t n = write(process.stdin_fd, input.data() + written, input.size() - written);
+                if (n > 0) {
+                    written += static_cast<size_t>(n);
+                } else if (n < 0 && errno != EINTR && errno != EAGAIN) {
+                    closeFd(process.stdin_fd);
+                }
+                if (written == input.size()) {
+                    closeFd(process.stdin_fd);
+                }
+            }
+        }
+        if (stdout_slot >= 0 && fds[stdout_slot].revents) {
+            if (!drain(process.stdout_fd, result.stdout_output)) {
+                closeFd(process.stdout_fd);
+            }
+        }
+        if (stderr_slot >= 0 && fds[stderr_slot].revents) {
+            if (!drain(process.stderr_fd, result.stderr_output)) {
+                closeFd(process.stderr_fd);
+            }
+        }
+    }
+
+    closeFd(process.stdin_fd);
+    closeFd(process.stdout_fd);
+    closeFd(process.stderr_fd);
+
+    // A child may close its streams and keep running; the limits still apply while reaping it
+    if (!result.timed_out && limits.bounded()) {
+        while (!hasExited(process.pid)) {
+            if (limits.expired()) {
+                kill(process.pid);
+                result.timed_out = true;
+                break;
+            }
+            struct timespec pause = {0, 5 * 1000 * 1000};
+            nanosleep(&pause, nullptr);
+        }
+    }
+
+    result.exit_code = wait(process.pid);
+    result.success = (result.exit_code == 0) && !result.timed_out;
+    if (result.timed_out) {
+        if (!result.stderr_output.empty() && result.stderr_output.back() != '\n') {
+            result.stderr_output += '\n';
+        }
+        result.stderr_output += (limits.cancelled && limits.cancelled->load())
+                                    ? "Cancelled; process group killed"
+                                    : "Deadline exceeded; process group killed";
+    }
+    process.pid = -1;
+    return result;
+}
+
+} // namespace iptables
@@ -0,0 +1,665 @@
+#include "reconciler.hpp"
+#include "match_values.hpp"
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <netinet/in.h>
+#include <set>
+#include <utility>
+
+namespace iptables {
+
+namespace {
+
+// Largest LCS table built for the part of a chain that differs; beyond it
+// the differing part is simply replaced
+constexpr size_t kMaxLcsCells = 4 * 1024 * 1024;
+
+// Map long forms of the address, interface and protocol options to the short forms
+std::string shortIpOption(const std::string& token) {
+    static const std::map<std::string, std::string> kOptions = {
+        {"-s", "-s"}, {"--source", "-s"}, {"--src", "-s"},
+        {"-d", "-d"}, {"--destination", "-d"}, {"--dst", "-d"},
+        {"-i", "-i"}, {"--in-interface", "-i"},
+        {"-o", "-o"}, {"--out-interface", "-o"},
+        {"-p", "-p"}, {"--protocol", "-p"},
+    };
+    auto it = kOptions.find(token);
+    return it == kOptions.end() ? "" : it->second;
+}
+
+std::string toLower(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+    return value;
+}
+
+std::string toUpper(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(), ::toupper);
+    return value;
+}
+
+// Matched pairs (have index, want index) of a longest common subsequence
+std::vector<std::pair<size_t, size_t>> longestCommonSubsequence(const std::vector<std::string>& have,
+                                                                const std::vector<std::string>& want) {
+    std::vector<std::pair<size_t, size_t>> matches;
+
+    // Unchanged chains, and chains changed in one place, match almost
+    // entirely at the ends; only the middle needs the quadratic table
+    size_t prefix = 0;
+    while (prefix < have.size() && prefix < want.size() && have[prefix] == want[prefix]) {
+        matches.emplace_back(prefix, prefix);
+        ++prefix;
+    }
+    size_t suffix = 0;
+    while (suffix < have.size() - prefix && suffix < want.size() - prefix &&
+           have[have.size() - 1 - suffix] == want[want.size() - 1 - suffix]) {
+        ++suffix;
+    }
+
+    size_t n = have.size() - prefix - suffix;
+    size_t m = want.size() - prefix - suffix;
+    if (n > 0 && m > 0 && (n + 1) * (m + 1) <= kMaxLcsCells) {
+        std::vector<uint32_t> table((n + 1) * (m + 1), 0);
+        auto cell = [&](size_t i, size_t j) -> uint32_t& { return table[i * (m + 1) + j]; };
+        for (size_t i = n; i-- > 0;) {
+            for (size_t j = m; j-- > 0;) {
+                cell(i, j) = have[prefix + i] == want[prefix + j]
+                    ? cell(i + 1, j + 1) + 1
+                    : std::max(cell(i + 1, j), cell(i, j + 1));
+            }
+        }
+        size_t i = 0, j = 0;
+        while (i < n && j < m) {
+            if (have[prefix + i] == want[prefix + j]) {
+                matches.emplace_back(prefix + i, prefix + j);
+                ++i;
+                ++j;
+            } else if (cell(i + 1, j) >= cell(i, j + 1)) {
+                ++i;
+            } else {
+                ++j;
+            }
+        }
+    }
+
+    for (size_t k = suffix; k > 0; --k) {
+        matches.emplace_back(have.size() - k, want.size() - k);
+    }
+    return matches;
+}
+
+// An address as iptables-save prints it: host bits cleared and a prefix always given
+std::string canonicalAddress(const std::string& value) {
+    Subnet subnet = Subnet::parse(value);
+    if (subnet.valid) {
+        return AddressMatch{subnet.network, subnet.prefix}.toCidr();
+    }
+    return value.find('/') == std::string::npos ? value + "/32" : value;
+}
+
+// The values of a rule read from its tokens, for live rules and plain specifications
+struct TextValues {
+    std::string address(const std::string&, const std::string& value) const { return canonicalAddress(value); }
+    std::string protocol(const std::string& value) const { return toLower(value); }
+    std::string mac(const std::string& value) const {
+        MacAddress mac = MacAddress::parse(value);
+        return mac.valid ? formatMac(mac.value) : toUpper(value);
+    }
+};
+
+// The values of a compiled rule read from its typed columns
+struct RowValues {
+    const RuleView& rule;
+
+    std::string address(const std::string& option, const std::string& value) const {
+        ColumnSpan<AddressMatch> sources = rule.sources();
+        if (option != "-s" || sources.empty() ||
+            std::any_of(sources.begin(), sources.end(),
+                        [](const AddressMatch& source) { return source.prefix == AddressMatch::kUnresolved; })) {
+            return TextValues{}.address(option, value);
+        }
+        std::string joined;
+        for (const auto& source : sources) {
+            joined += (joined.empty() ? "" : ",") + source.toCidr();
+        }
+        return joined;
+    }
+    std::string protocol(const std::string& value) const {
+        switch (rule.protocol()) {
+            case IPPROTO_TCP: return "tcp";
+            case IPPROTO_UDP: return "udp";
+            default: return toLower(value);
+        }
+    }
+    std::string mac(const std::string& value) const {
+        std::optional<uint64_t> mac = rule.mac();
+        return mac ? formatMac(*mac) : toUpper(value);
+    }
+};
+
+// Shared by both canonicalRule() overloads
+template <typename Spec, typename Values>
+std::string canonicalSpec(const Spec& spec, const Values& values) {
+    static const std::vector<std::string> kIpOrder = {"-s", "-d", "-i", "-o", "-p"};
+    std::map<std::string, std::string> ip_options;
+    std::vector<std::string> rest;
+    rest.reserve(spec.size() + 2);
+
+    for (size_t i = 0; i < spec.size(); ++i) {
+        bool negated = spec[i] == "!" && i + 1 < spec.size() && !shortIpOption(spec[i + 1]).empty();
+        size_t at = negated ? i + 1 : i;
+        std::string option = shortIpOption(spec[at]);
+        if (!option.empty() && at + 1 < spec.size()) {
+            std::string value = spec[at + 1];
+            if (option == "-s" || option == "-d") {
+                value = values.address(option, value);
+                if (value == "0.0.0.0/0" && !negated) {
+                    i = at + 1;
+                    continue;
+                }
+            } else if (option == "-p") {
+                value = values.protocol(value);
+            }
+            ip_options[option] = (negated ? "! " : "") + option + " " + value;
+            i = at + 1;
+            continue;
+        }
+
+        const std::string& token = spec[i];
+        if (!rest.empty() && rest.back() == "--mac-source") {
+            rest.push_back(values.mac(token));
+        } else if (token == "--to-port") {
+            rest.push_back("--to-ports");
+        } else {
+            rest.push_back(token);
+        }
+    }
+
+    // iptables-save spells out the default reject type
+    for (size_t i = 0; i + 1 < rest.size(); ++i) {
+        if (rest[i] == "-j" && rest[i + 1] == "REJECT" &&
+            std::find(rest.begin(), rest.end(), "--reject-with") == rest.end()) {
+            rest.insert(rest.begin() + static_cast<std::ptrdiff_t>(i + 2), {"--reject-with", "icmp-port-unreachable"});
+            break;
+        }
+    }
+
+    std::string canonical;
+    for (const auto& option : kIpOrder) {
+        auto it = ip_options.find(option);
+        if (it != ip_options.end()) {
+            canonical += it->second;
+            canonical += ' ';
+        }
+    }
+    for (const auto& token : rest) {
+        canonical += token;
+        canonical += ' ';
+    }
+    if (!canonical.empty()) {
+        canonical.pop_back();
+    }
+    return canonical;
+}
+
+// Sections whose live rules are known to be their compiled rules, by name and by tag section id
+struct Settled {
+    const std::set<std::string>& sections;
+    std::set<std::string> ids;
+
+    bool hasTag(const std::string& comment) const {
+        return comment.size() == RulesetCompiler::kRuleTagLength && ids.count(comment.substr(5, 8)) > 0;
+    }
+};
+
+// Append the operations that turn one live chain into its desired contents
+void reconcileChain(ReconcilePlan& plan, const std::string& table, const std::string& chain_name,
+                    const std::vector<RuleView>& wanted, const RulesetSnapshot& live, bool owned,
+                    const Settled& settled) {
+    const SnapshotChain* chain = live.chain(table, chain_name);
+    const size_t live_size = chain ? chain->rules.size() : 0;
+
+    // Rules of settled sections compare by tag, which hashes the same spec,
+    // so only changed sections pay for canonical forms
+    std::vector<std::string> want_keys;
+    want_keys.reserve(wanted.size());
+    for (const auto& rule : wanted) {
+        want_keys.push_back(settled.sections.count(rule.section()) ? rule.comment()
+                                                                   : Reconciler::canonicalRule(rule));
+    }
+
+    // Managed live rules, by position in the chain
+    std::vector<size_t> managed;
+    std::vector<std::string> have_keys;
+    for (size_t i = 0; i < live_size; ++i) {
+        const SnapshotRule& rule = chain->rules[i];
+        if (owned || Reconciler::isManaged(rule)) {
+            managed.push_back(i);
+            have_keys.push_back(settled.hasTag(rule.comment)
+                                    ? rule.comment
+                                    : Reconciler::canonicalRule(Reconciler::tokenize(rule.spec)));
+        }
+    }
+
+    auto matches = longestCommonSubsequence(have_keys, want_keys);
+    plan.unchanged += matches.size();
+
+    std::vector<bool> kept(managed.size(), false);
+    std::vector<size_t> kept_as(live_size, SIZE_MAX);  // live position -> desired index
+    for (const auto& [have, want] : matches) {
+        kept[have] = true;
+        kept_as[managed[have]] = want;
+    }
+
+    // Deletions run bottom-up so the positions of the remaining ones stay valid
+    for (size_t k = managed.size(); k-- > 0;) {
+        if (!kept[k]) {
+            PlanOperation op;
+            op.kind = PlanOperation::Kind::DeleteRule;
+            op.table = table;
+            op.chain = chain_name;
+            op.position = static_cast<uint32_t>(managed[k] + 1);
+            op.text = chain->rules[managed[k]].spec;
+            plan.operations.push_back(std::move(op));
+        }
+    }
+
+    // Index of each kept desired rule once the deletions are done
+    std::vector<size_t> kept_index(wanted.size(), SIZE_MAX);
+    size_t remaining = 0;
+    std::vector<bool> is_managed(live_size, false);
+    for (size_t index : managed) {
+        is_managed[index] = true;
+    }
+    for (size_t i = 0; i < live_size; ++i) {
+        if (!is_managed[i]) {
+            ++remaining;
+        } else if (kept_as[i] != SIZE_MAX) {
+            kept_index[kept_as[i]] = remaining++;
+        }
+    }
+    const size_t first_kept = matches.empty() ? SIZE_MAX : kept_index[matches.front().second];
+
+    // Missing rules go right after their desired predecessor; a missing first
+    // rule goes before the first kept one, or at the end of an unmanaged chain.
+    // Every insertion lands before all later kept rules, shifting them by one.
+    size_t inserted = 0;
+    size_t previous = 0;
+    for (size_t j = 0; j < wanted.size(); ++j) {
+        if (kept_index[j] != SIZE_MAX) {
+            previous = kept_index[j] + inserted;
+            continue;
+        }
+
+        size_t size = remaining + inserted;
+        size_t index;
+        if (j > 0) {
+            index = previous + 1;
+        } else if (first_kept != SIZE_MAX) {
+            index = first_kept;
+        } else {
+            index = size;
+        }
+
+        PlanOperation op;
+        op.table = table;
+        op.chain = chain_name;
+        op.rule = wanted[j].toCompiledRule();
+        if (index == size) {
+            op.kind = PlanOperation::Kind::AppendRule;
+        } else {
+            op.kind = PlanOperation::Kind::InsertRule;
+            op.position = static_cast<uint32_t>(index + 1);
+        }
+        plan.operations.push_back(std::move(op));
+
+        previous = index;
+        ++inserted;
+    }
+}
+
+} // namespace
+
+std::vector<std::string> PlanOperation::toIptablesArgs() const {
+    switch (kind) {
+        case Kind::CreateChain:
+            return {"-t", table, "-N", chain};
+        case Kind::DeleteRule:
+            return {"-t", table, "-D", chain, std::to_string(position)};
+        case Kind::InsertRule: {
+            std::vector<std::string> args = {"-t", table, "-I", chain, std::to_string(position)};
+            args.insert(args.end(), rule.spec.begin(), rule.spec.end());
+            return args;
+        }
+        case Kind::AppendRule:
+            return rule.toAppendArgs();
+        case Kind::SetPolicy:
+            return {"-t", table, "-P", chain, text};
+        case Kind::FlushChain:
+            return {"-t", table, "-F", chain};
+        case Kind::DeleteChain:
+            return {"-t", table, "-X", chain};
+    }
+    return {};
+}
+
+std::string PlanOperation::toRestoreLine() const {
+    switch (kind) {
+        case Kind::CreateChain:
+            return "-N " + chain;
+        case Kind::DeleteRule:
+            return "-D " + chain + " " + std::to_string(position);
+        case Kind::InsertRule:
+            return rule.toRestoreLine(position);
+        case Kind::AppendRule:
+            return rule.toRestoreLine();
+        case Kind::SetPolicy:
+            return "-P " + chain + " " + text;
+        case Kind::FlushChain:
+            return "-F " + chain;
+        case Kind::DeleteChain:
+            return "-X " + chain;
+    }
+    return "";
+}
+
+std::string PlanOperation::describe() const {
+    switch (kind) {
+        case Kind::CreateChain:
+        case Kind::InsertRule:
+        case Kind::AppendRule:
+            return "+ -t " + table + " " + toRestoreLine();
+        case Kind::DeleteRule:
+            return "- -t " + table + " " + toRestoreLine() + "  (" + text + ")";
+        case Kind::SetPolicy:
+            return "~ -t " + table + " " + toRestoreLine();
+        case Kind::FlushChain:
+            return "- -t " + table + " " + toRestoreLine() + "  (" + text + " rule(s))";
+        case Kind::DeleteChain:
+            return "- -t " + table + " " + toRestoreLine();
+    }
+    return "";
+}
+
+size_t ReconcilePlan::count(PlanOperation::Kind kind) const {
+    return static_cast<size_t>(std::count_if(operations.begin(), operations.end(),
+                                             [kind](const PlanOperation& op) { return op.kind == kind; }));
+}
+
+ReconcilePlan Reconciler::plan(const CompiledRuleset& desired, const RulesetSnapshot& live,
+                               const std::set<std::string>& settled_sections) {
+    ReconcilePlan plan;
+    Settled settled{settled_sections, {}};
+    for (const auto& section : settled_sections) {
+        settled.ids.insert(RulesetCompiler::sectionId(section));
+    }
+
+    for (const auto& chain : desired.chains) {
+        if (!live.hasChain("filter", chain)) {
+            PlanOperation op;
+            op.kind = PlanOperation::Kind::CreateChain;
+            op.chain = chain;
+            plan.operations.push_back(std::move(op));
+        }
+    }
+    for (const auto& section_chain : desired.section_chains) {
+        if (!live.hasChain(section_chain.table, section_chain.name)) {
+            PlanOperation op;
+            op.kind = PlanOperation::Kind::CreateChain;
+            op.table = section_chain.table;
+            op.chain = section_chain.name;
+            plan.operations.push_back(std::move(op));
+        }
+    }
+
+    // Desired rules per chain, in the order the chains are first used
+    using ChainKey = std::pair<std::string, std::string>;
+    std::vector<ChainKey> order;
+    std::map<ChainKey, std::vector<RuleView>> wanted;
+    RuleTable expanded;  // Rules with address lists, split the way iptables stores them
+    for (const auto& rule : desired.rules) {
+        ChainKey key{rule.table(), rule.chain()};
+        auto it = wanted.find(key);
+        if (it == wanted.end()) {
+            order.push_back(key);
+            it = wanted.emplace(key, std::vector<RuleView>{}).first;
+        }
+        size_t first = expanded.size();
+        size_t split = expandSources(rule, expanded);
+        if (split == 0) {
+            it->second.push_back(rule);
+        }
+        for (size_t row = first; row < first + split; ++row) {
+            it->second.push_back(expanded[row]);
+        }
+    }
+
+    // Chains still holding managed rules the configuration no longer has;
+    // section chains of removed sections go as a whole
+    std::vector<ChainKey> stale;
+    for (const auto& table : live.tables()) {
+        for (const auto& chain : live.chainNames(table)) {
+            ChainKey key{table, chain};
+            if (wanted.count(key)) {
+                continue;
+            }
+            bool is_owned = desired.ownsChain(table, chain);
+            if (!is_owned && RulesetCompiler::isSectionChain(chain)) {
+                stale.push_back(key);
+            } else if (is_owned || !live.findRulesWithPrefix(table, chain, "YAML:").empty()) {
+                order.push_back(key);
+                wanted.emplace(key, std::vector<RuleView>{});
+            }
+        }
+    }
+
+    for (const auto& key : order) {
+        reconcileChain(plan, key.first, key.second, wanted[key], live, desired.ownsChain(key.first, key.second),
+                       settled);
+    }
+
+    // Flush every stale chain before deleting any; they may jump to each other
+    for (const auto& [table, chain] : stale) {
+        size_t rules = live.chain(table, chain)->rules.size();
+        if (rules > 0) {
+            PlanOperation flush;
+            flush.kind = PlanOperation::Kind::FlushChain;
+            flush.table = table;
+            flush.chain = chain;
+            flush.text = std::to_string(rules);
+            plan.operations.push_back(std::move(flush));
+        }
+    }
+    for (const auto& [table, chain] : stale) {
+        PlanOperation remove;
+        remove.kind = PlanOperation::Kind::DeleteChain;
+        remove.table = table;
+        remove.chain = chain;
+        plan.operations.push_back(std::move(remove));
+    }
+
+    for (const auto& [chain, policy] : desired.policies) {
+        const SnapshotChain* current = live.chain("filter", chain);
+        std::string target = policyToString(policy);
+        if (current == nullptr || current->policy != target) {
+            PlanOperation op;
+            op.kind = PlanOperation::Kind::SetPolicy;
+            op.chain = chain;
+            op.text = target;
+            plan.operations.push_back(std::move(op));
+        }
+    }
+
+    return plan;
+}
+
+std::string Reconciler::canonicalRule(const std::vector<std::string>& spec) {
+    return canonicalSpec(spec, TextValues{});
+}
+
+std::string Reconciler::canonicalRule(const RuleView& rule) {
+    return canonicalSpec(rule.spec(), RowValues{rule});
+}
+
+std::vector<std::string> Reconciler::tokenize(const std::string& spec) {
+    std::vector<std::string> tokens;
+    std::string current;
+    bool in_token = false;
+    bool quoted = false;
+
+    for (size_t i = 0; i < spec.size(); ++i) {
+        char c = spec[i];
+        if (quoted) {
+            if (c == '\\' && i + 1 < spec.size()) {
+                current += spec[++i];
+            } else if (c == '"') {
+                quoted = false;
+            } else {
+                current += c;
+            }
+        } else if (c == '"') {
+            quoted = true;
+            in_token = true;
+        } else if (std::isspace(static_cast<unsigned char>(c))) {
+            if (in_token) {
+                tokens.push_back(std::move(current));
+                current.clear();
+                in_token = false;
+            }
+        } else {
+            current += c;
+            in_token = true;
+        }
+    }
+    if (in_token) {
+        tokens.push_back(std::move(current));
+    }
+    return tokens;
+}
+
+std::string Reconciler::jumpTarget(const std::vector<std::string>& spec) {
+    for (size_t i = 0; i + 1 < spec.size(); ++i) {
+        if (spec[i] == "-j" || spec[i] == "--jump" || spec[i] == "-g" || spec[i] == "--goto") {
+            return spec[i + 1];
+        }
+    }
+    return "";
+}
+
+std::string Reconciler::jumpTarget(const std::string& spec) {
+    return jumpTarget(tokenize(spec));
+}
+
+bool Reconciler::isManaged(const SnapshotRule& rule) {
+    return rule.comment.compare(0, 5, "YAML:") == 0;
+}
+
+size_t Reconciler::expandSources(const RuleView& rule, RuleTable& expanded) {
+    if (rule.sources().size() < 2) {
+        return 0;
+    }
+    CompiledRule split = rule.toCompiledRule();
+    auto option = std::find(split.spec.begin(), split.spec.end(), "-s");
+    if (option == split.spec.end() || option + 1 == split.spec.end()) {
+        return 0;
+    }
+    // The list holds one subnet as written per typed source
+    const std::string list = *(option + 1);
+    const std::vector<AddressMatch> sources = split.sources;
+    size_t start = 0;
+    for (const auto& source : sources) {
+        size_t end = std::min(list.find(',', start), list.size());
+        *(option + 1) = list.substr(start, end - start);
+        split.sources = {source};
+        expanded.append(split);
+        start = end + 1;
+    }
+    return sources.size();
+}
+
+ReconcilePlan Reconciler::teardown(const RulesetSnapshot& live) {
+    ReconcilePlan plan;
+
+    for (const auto& table : live.tables()) {
+        // Chains that go as a whole. An empty chain shows no sign of being
+        // ours, so another tool's empty chain is left alone.
+        std::set<std::string> removed;
+        for (const auto& chain : live.chainNames(table, true)) {
+            const auto& rules = live.chain(table, chain)->rules;
+            if (RulesetCompiler::isSectionChain(chain) ||
+                (table == "filter" && !rules.empty() && std::all_of(rules.begin(), rules.end(), isManaged))) {
+                removed.insert(chain);
+            }
+        }
+        // A chain a remaining rule jumps to stays, and so do the chains it jumps to
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (const auto& chain : live.chainNames(table)) {
+                if (removed.count(chain)) {
+                    continue;
+                }
+                for (const auto& rule : live.chain(table, chain)->rules) {
+                    if (!isManaged(rule) && removed.erase(jumpTarget(rule.spec)) > 0) {
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        for (const auto& chain : live.chainNames(table)) {
+            if (removed.count(chain)) {
+                continue;
+            }
+            const auto& rules = live.chain(table, chain)->rules;
+            for (size_t i = rules.size(); i-- > 0;) {
+                if (isManaged(rules[i])) {
+                    PlanOperation op;
+                    op.kind = PlanOperation::Kind::DeleteRule;
+                    op.table = table;
+                    op.chain = chain;
+                    op.position = static_cast<uint32_t>(i + 1);
+                    op.text = rules[i].spec;
+                    plan.operations.push_back(std::move(op));
+                }
+            }
+        }
+
+        // Flush every removed chain before deleting any; they may jump to each other
+        for (const auto& chain : removed) {
+            size_t rules = live.chain(table, chain)->rules.size();
+            if (rules > 0) {
+                PlanOperation flush;
+                flush.kind = PlanOperation::Kind::FlushChain;
+                flush.table = table;
+                flush.chain = chain;
+                flush.text = std::to_string(rules);
+                plan.operations.push_back(std::move(flush));
+            }
+        }
+        for (const auto& chain : removed) {
+            PlanOperation remove;
+            remove.kind = PlanOperation::Kind::DeleteChain;
+            remove.table = table;
+            remove.chain = chain;
+            plan.operations.push_back(std::move(remove));
+        }
+
+        if (table == "filter") {
+            for (const auto& chain : RulesetCompiler::builtinChains(table)) {
+                const SnapshotChain* current = live.chain(table, chain);
+                if (current != nullptr && current->policy != "ACCEPT") {
+                    PlanOperation op;
+                    op.kind = PlanOperation::Kind::SetPolicy;
+                    op.table = table;
+                    op.chain = chain;
+                    op.text = "ACCEPT";
+                    plan.operations.push_back(std::move(op));
+                }
+            }
+        }
+    }
+
+    return plan;
+}
+
+} // namespace iptables
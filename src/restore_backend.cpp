@@ -0,0 +1,217 @@
+#include "restore_backend.hpp"
+#include "command_executor.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+namespace iptables {
+
+namespace {
+
+// Tables in the order iptables-restore payloads are written
+const std::vector<std::string> kTableOrder = {"filter", "nat", "mangle", "raw"};
+
+// Append a chain declaration line
+void declareChain(std::ostringstream& out, const std::string& chain,
+                  const std::string& policy, const std::string& counters) {
+    out << ":" << chain << " " << policy << " " << counters << "\n";
+}
+
+// Policy to declare for a built-in chain, honouring the configured filter policies
+std::string builtinPolicy(const CompiledRuleset& ruleset, const std::string& table,
+                          const std::string& chain, const std::string& fallback) {
+    if (table == "filter") {
+        auto it = ruleset.policies.find(chain);
+        if (it != ruleset.policies.end()) {
+            return policyToString(it->second);
+        }
+    }
+    return fallback;
+}
+
+// Append the compiled rules that belong to a table
+void appendCompiledRules(std::ostringstream& out, const CompiledRuleset& ruleset, const std::string& table) {
+    for (const auto& rule : ruleset.rules) {
+        if (rule.table() == table) {
+            out << rule.toRestoreLine() << "\n";
+        }
+    }
+}
+
+} // namespace
+
+std::string RestoreBackend::renderPayload(const CompiledRuleset& ruleset) {
+    std::ostringstream out;
+
+    for (const auto& table : ruleset.tables()) {
+        out << "*" << table << "\n";
+        for (const auto& chain : RulesetCompiler::builtinChains(table)) {
+            declareChain(out, chain, builtinPolicy(ruleset, table, chain, "-"), "[0:0]");
+        }
+        if (table == "filter") {
+            for (const auto& chain : ruleset.chains) {
+                declareChain(out, chain, "-", "[0:0]");
+            }
+        }
+        for (const auto& section_chain : ruleset.section_chains) {
+            if (section_chain.table == table) {
+                declareChain(out, section_chain.name, "-", "[0:0]");
+            }
+        }
+        appendCompiledRules(out, ruleset, table);
+        out << "COMMIT\n";
+    }
+
+    return out.str();
+}
+
+std::string RestoreBackend::mergeWithLive(const CompiledRuleset& ruleset, const RulesetSnapshot& live, bool reset) {
+    // Tables to rewrite: those the configuration uses, those still holding
+    // managed rules from a previous apply, and everything on reset
+    std::set<std::string> wanted;
+    for (const auto& table : ruleset.tables()) {
+        wanted.insert(table);
+    }
+    for (const auto& table : live.tables()) {
+        for (const auto& chain : live.chainNames(table)) {
+            if (!live.findRulesWithPrefix(table, chain, "YAML:").empty()) {
+                wanted.insert(table);
+                break;
+            }
+        }
+    }
+    if (reset) {
+        wanted.insert({"filter", "nat", "mangle"});
+    }
+
+    std::vector<std::string> ordered;
+    for (const auto& table : kTableOrder) {
+        if (wanted.count(table)) {
+            ordered.push_back(table);
+        }
+    }
+    for (const auto& table : wanted) {
+        if (std::find(kTableOrder.begin(), kTableOrder.end(), table) == kTableOrder.end()) {
+            ordered.push_back(table);
+        }
+    }
+
+    std::ostringstream out;
+    for (const auto& table : ordered) {
+        const bool present = live.hasTable(table);
+        const bool is_filter = (table == "filter");
+        std::vector<const SnapshotChain*> chains;
+        for (const auto& name : live.chainNames(table)) {
+            chains.push_back(live.chain(table, name));
+        }
+
+        out << "*" << table << "\n";
+
+        // Built-in chains keep their live policy and counters unless configured
+        if (present) {
+            for (const auto* chain : chains) {
+                if (!chain->isUserDefined()) {
+                    declareChain(out, chain->name, builtinPolicy(ruleset, table, chain->name, chain->policy),
+                                 chain->counters);
+                }
+            }
+        } else {
+            for (const auto& chain : RulesetCompiler::builtinChains(table)) {
+                declareChain(out, chain, builtinPolicy(ruleset, table, chain, "ACCEPT"), "[0:0]");
+            }
+        }
+
+        // Foreign custom chains survive unless the whole ruleset is being reset;
+        // undeclared section chains of removed sections are dropped by the restore
+        auto foreign = [&](const SnapshotChain* chain) {
+            return !ruleset.ownsChain(table, chain->name) &&
+                   !(chain->isUserDefined() && RulesetCompiler::isSectionChain(chain->name));
+        };
+        if (!reset) {
+            for (const auto* chain : chains) {
+                if (chain->isUserDefined() && foreign(chain)) {
+                    declareChain(out, chain->name, "-", chain->counters);
+                }
+            }
+        }
+        if (is_filter) {
+            for (const auto& name : ruleset.chains) {
+                const SnapshotChain* existing = live.chain(table, name);
+                declareChain(out, name, "-", existing ? existing->counters : "[0:0]");
+            }
+        }
+        for (const auto& section_chain : ruleset.section_chains) {
+            if (section_chain.table == table) {
+                const SnapshotChain* existing = live.chain(table, section_chain.name);
+                declareChain(out, section_chain.name, "-", existing ? existing->counters : "[0:0]");
+            }
+        }
+
+        // Foreign rules keep their position ahead of the managed rules, exactly
+        // where the per-command backend would leave them after re-appending
+        if (!reset) {
+            for (const auto* chain : chains) {
+                if (!foreign(chain)) {
+                    continue;
+                }
+                for (const auto& rule : chain->rules) {
+                    if (rule.comment.compare(0, 5, "YAML:") != 0) {
+                        out << rule.toLine(chain->name, true) << "\n";
+                    }
+                }
+            }
+        }
+
+        appendCompiledRules(out, ruleset, table);
+        out << "COMMIT\n";
+    }
+
+    return out.str();
+}
+
+bool RestoreBackend::apply(const CompiledRuleset& ruleset, const RulesetSnapshot& live, bool reset,
+                           std::ostream& out, std::ostream& err) {
+    std::string payload = mergeWithLive(ruleset, live, reset);
+
+    out << "Applying " << ruleset.rules.size() << " rule(s) and "
+        << ruleset.chains.size() + ruleset.section_chains.size()
+        << " chain(s) in a single iptables-restore transaction" << std::endl;
+
+    auto result = CommandExecutor::executeRestore(payload, {"--counters"});
+    if (!result.isSuccess()) {
+        err << "Failed to apply ruleset with iptables-restore: " << result.getErrorMessage() << std::endl;
+        if (!result.stdout_output.empty()) {
+            err << result.stdout_output << std::endl;
+        }
+        return false;
+    }
+
+    return true;
+}
+
+bool RestoreBackend::writePayload(const CompiledRuleset& ruleset, const std::string& destination) {
+    std::string payload = renderPayload(ruleset);
+
+    if (destination == "-") {
+        std::cout << payload << std::flush;
+        return static_cast<bool>(std::cout);
+    }
+
+    std::ofstream file(destination, std::ios::out | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open " << destination << " for writing" << std::endl;
+        return false;
+    }
+    file << payload;
+    file.close();
+    if (!file) {
+        std::cerr << "Failed to write restore payload to " << destination << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace iptables
@@ -0,0 +1,194 @@
+#include "restore_session.hpp"
+#include "command_executor.hpp"
+#include "metrics.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace iptables {
+
+namespace {
+
+// Extract the failing input line from iptables-restore diagnostics.
+// Legacy builds print "line N failed", newer ones "Error occurred at line: N".
+size_t failedLine(const std::string& diagnostics) {
+    for (const char* marker : {"line: ", "line "}) {
+        size_t pos = 0;
+        while ((pos = diagnostics.find(marker, pos)) != std::string::npos) {
+            pos += std::strlen(marker);
+            size_t end = pos;
+            while (end < diagnostics.size() && std::isdigit(static_cast<unsigned char>(diagnostics[end]))) {
+                ++end;
+            }
+            if (end > pos) {
+                return std::stoul(diagnostics.substr(pos, end - pos));
+            }
+        }
+    }
+    return 0;
+}
+
+std::string trimmed(const std::string& text) {
+    size_t end = text.find_last_not_of("\r\n ");
+    return end == std::string::npos ? "" : text.substr(0, end + 1);
+}
+
+} // namespace
+
+RestoreSession::RestoreSession(std::string program)
+    : program_(std::move(program)) {
+}
+
+RestoreSession::~RestoreSession() {
+    if (!pending_.empty()) {
+        sync();
+    }
+    stopChild();
+}
+
+bool RestoreSession::ensureChild() {
+    if (child_alive_) {
+        return true;
+    }
+    // An installed runner cannot stream, so the child's input is collected
+    // and handed over in one piece when the session finishes it
+    child_input_.clear();
+    if (!CommandExecutor::runner()) {
+        child_ = ProcessRunner::spawn(childArgs());
+        if (child_.pid < 0) {
+            return false;
+        }
+    }
+    child_started_ = std::chrono::steady_clock::now();
+    ++spawn_count_;
+    child_alive_ = true;
+    lines_written_ = 0;
+    return true;
+}
+
+void RestoreSession::writeBatch(PendingBatch& pending) {
+    std::string text;
+    text.reserve(64 * (pending.batch.lines.size() + 2));
+    text += "*" + pending.batch.table + "\n";
+    for (const auto& line : pending.batch.lines) {
+        text += line;
+        text += '\n';
+    }
+    text += "COMMIT\n";
+
+    pending.first_line = lines_written_ + 1;
+    pending.last_line = lines_written_ + pending.batch.lines.size() + 2;
+    pending.written = true;
+    lines_written_ = pending.last_line;
+
+    child_input_ += text;
+    if (CommandExecutor::runner()) {
+        return;
+    }
+    // A failed write means the child already exited; sync() attributes the failure
+    ProcessRunner::writeAll(child_.stdin_fd, text, CommandExecutor::currentLimits());
+}
+
+std::vector<std::string> RestoreSession::childArgs() const {
+    return {program_, CommandExecutor::restoreWaitOption(), "--noflush"};
+}
+
+CommandResult RestoreSession::finishChild() {
+    child_alive_ = false;
+    CommandResult result;
+    if (CommandRunner* runner = CommandExecutor::runner()) {
+        result = runner->run(childArgs(), child_input_, CommandExecutor::currentLimits());
+    } else {
+        result = ProcessRunner::communicate(child_, "", CommandExecutor::currentLimits());
+    }
+    Metrics::recordCommand(childArgs(), child_input_, result,
+                           std::chrono::duration<double>(std::chrono::steady_clock::now() - child_started_).count());
+    child_input_.clear();
+    return result;
+}
+
+void RestoreSession::stopChild() {
+    if (child_alive_) {
+        finishChild();
+    }
+}
+
+size_t RestoreSession::submit(RestoreBatch batch) {
+    size_t id = next_id_++;
+    pending_.push_back(PendingBatch{id, std::move(batch)});
+    if (ensureChild()) {
+        writeBatch(pending_.back());
+    }
+    return id;
+}
+
+std::vector<BatchResult> RestoreSession::sync() {
+    std::vector<BatchResult> results;
+    results.reserve(pending_.size());
+
+    auto resolve = [&](const PendingBatch& pending, bool success, const std::string& error) {
+        results.push_back(BatchResult{pending.id, pending.batch.description, success, error});
+    };
+
+    while (!pending_.empty()) {
+        if (!ensureChild()) {
+            std::string error = "Failed to start " + program_ + ": " + std::strerror(child_.error);
+            for (const auto& pending : pending_) {
+                resolve(pending, false, error);
+            }
+            pending_.clear();
+            break;
+        }
+        for (auto& pending : pending_) {
+            if (!pending.written) {
+                writeBatch(pending);
+            }
+        }
+
+        // Closing stdin lets the child finish; its exit status covers every batch
+        CommandResult result = finishChild();
+
+        if (result.exit_code == 0) {
+            for (const auto& pending : pending_) {
+                resolve(pending, true, "");
+            }
+            pending_.clear();
+            break;
+        }
+
+        std::string diagnostics = trimmed(result.stderr_output.empty() ? result.stdout_output
+                                                                       : result.stderr_output);
+        size_t line = failedLine(diagnostics);
+        auto failed = std::find_if(pending_.begin(), pending_.end(), [line](const PendingBatch& pending) {
+            return pending.written && line >= pending.first_line && line <= pending.last_line;
+        });
+
+        if (failed == pending_.end()) {
+            // The failure cannot be attributed; nothing after the last commit is trustworthy
+            for (const auto& pending : pending_) {
+                resolve(pending, false, diagnostics.empty() ? "iptables-restore exited with code " +
+                                                              std::to_string(result.exit_code)
+                                                            : diagnostics);
+            }
+            pending_.clear();
+            break;
+        }
+
+        // Everything before the failing batch committed; everything after it never ran
+        for (auto it = pending_.begin(); it != failed; ++it) {
+            resolve(*it, true, "");
+        }
+        resolve(*failed, false, diagnostics);
+
+        std::vector<PendingBatch> remaining(std::make_move_iterator(failed + 1),
+                                            std::make_move_iterator(pending_.end()));
+        for (auto& pending : remaining) {
+            pending.written = false;
+        }
+        pending_ = std::move(remaining);
+    }
+
+    return results;
+}
+
+} // namespace iptables
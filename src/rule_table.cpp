@@ -0,0 +1,259 @@
+#include "rule_table.hpp"
+#include <cstdio>
+#include <functional>
+
+namespace iptables {
+
+namespace {
+
+// Quote a token for iptables-restore, which understands double quotes and backslash escapes
+std::string quoteRestoreToken(const std::string& token, bool force = false) {
+    if (!force && !token.empty() && token.find_first_of(" \t\"'\\") == std::string::npos) {
+        return token;
+    }
+    std::string quoted = "\"";
+    for (char c : token) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+        }
+        quoted += c;
+    }
+    quoted += "\"";
+    return quoted;
+}
+
+// Shared by CompiledRule and RuleView, so both render byte for byte the same
+template <typename Spec>
+std::string restoreLine(const std::string& chain, const Spec& spec, uint32_t position) {
+    std::string line = position > 0 ? "-I " + chain + " " + std::to_string(position) : "-A " + chain;
+    for (size_t i = 0; i < spec.size(); ++i) {
+        // Comments are always quoted, matching the iptables-save output format
+        line += " " + quoteRestoreToken(spec[i], i > 0 && spec[i - 1] == "--comment");
+    }
+    return line;
+}
+
+} // namespace
+
+std::string AddressMatch::toCidr() const {
+    char text[24];
+    std::snprintf(text, sizeof(text), "%u.%u.%u.%u/%u", network >> 24, (network >> 16) & 0xff,
+                  (network >> 8) & 0xff, network & 0xff, static_cast<unsigned>(prefix));
+    return text;
+}
+
+std::string formatMac(uint64_t mac) {
+    char text[18];
+    std::snprintf(text, sizeof(text), "%02X:%02X:%02X:%02X:%02X:%02X", static_cast<unsigned>((mac >> 40) & 0xff),
+                  static_cast<unsigned>((mac >> 32) & 0xff), static_cast<unsigned>((mac >> 24) & 0xff),
+                  static_cast<unsigned>((mac >> 16) & 0xff), static_cast<unsigned>((mac >> 8) & 0xff),
+                  static_cast<unsigned>(mac & 0xff));
+    return text;
+}
+
+std::vector<std::string> CompiledRule::toAppendArgs() const {
+    std::vector<std::string> args = {"-t", table, "-A", chain};
+    args.insert(args.end(), spec.begin(), spec.end());
+    return args;
+}
+
+std::string CompiledRule::toRestoreLine(uint32_t position) const {
+    return restoreLine(chain, spec, position);
+}
+
+std::string CompiledRule::toReplaceLine(uint32_t position) const {
+    std::string line = toRestoreLine(position);
+    line[1] = 'R';
+    return line;
+}
+
+uint32_t StringPool::intern(std::string_view text) {
+    if (2 * (interned_ + 1) > slots_.size()) {
+        grow();
+    }
+    uint32_t hash = static_cast<uint32_t>(std::hash<std::string_view>{}(text));
+    size_t mask = slots_.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        Slot& slot = slots_[i];
+        if (slot.id == 0) {
+            slot.id = add(std::string(text)) + 1;
+            slot.hash = hash;
+            ++interned_;
+            return slot.id - 1;
+        }
+        if (slot.hash == hash && strings_[slot.id - 1] == text) {
+            return slot.id - 1;
+        }
+    }
+}
+
+void StringPool::grow() {
+    std::vector<Slot> slots(slots_.empty() ? 64 : 2 * slots_.size());
+    size_t mask = slots.size() - 1;
+    for (const Slot& slot : slots_) {
+        if (slot.id != 0) {
+            size_t i = slot.hash & mask;
+            while (slots[i].id != 0) {
+                i = (i + 1) & mask;
+            }
+            slots[i] = slot;
+        }
+    }
+    slots_ = std::move(slots);
+}
+
+uint32_t StringPool::add(std::string text) {
+    strings_.push_back(std::move(text));
+    return static_cast<uint32_t>(strings_.size() - 1);
+}
+
+std::vector<std::string> RuleView::toAppendArgs() const {
+    std::vector<std::string> args = {"-t", table(), "-A", chain()};
+    TokenSpan tokens = spec();
+    args.insert(args.end(), tokens.begin(), tokens.end());
+    return args;
+}
+
+std::string RuleView::toRestoreLine(uint32_t position) const {
+    return restoreLine(chain(), spec(), position);
+}
+
+std::string RuleView::toReplaceLine(uint32_t position) const {
+    std::string line = toRestoreLine(position);
+    line[1] = 'R';
+    return line;
+}
+
+CompiledRule RuleView::toCompiledRule() const {
+    CompiledRule rule;
+    rule.table = table();
+    rule.chain = chain();
+    rule.spec = spec().toVector();
+    rule.comment = comment();
+    rule.description = description();
+    rule.section = section();
+    rule.protocol = protocol();
+    rule.sources.assign(sources().begin(), sources().end());
+    rule.ports.assign(ports().begin(), ports().end());
+    rule.multiport = multiport();
+    rule.mac = mac();
+    rule.to_port = toPort();
+    rule.target = target();
+    return rule;
+}
+
+void RuleTable::reserve(size_t rows, size_t tokens) {
+    for (auto* column : {&table_, &chain_, &section_, &comment_, &description_, &target_}) {
+        column->reserve(rows);
+    }
+    protocol_.reserve(rows);
+    multiport_.reserve(rows);
+    mac_.reserve(rows);
+    to_port_.reserve(rows);
+    for (auto* column : {&spec_begin_, &source_begin_, &port_begin_}) {
+        column->reserve(rows + 1);
+    }
+    tokens_.reserve(tokens);
+}
+
+void RuleTable::append(CompiledRule rule) {
+    table_.push_back(strings_.intern(rule.table));
+    chain_.push_back(strings_.intern(rule.chain));
+    section_.push_back(strings_.intern(rule.section));
+    // Tags and signatures are unique to their rule; interning them would only grow the index
+    comment_.push_back(strings_.add(std::move(rule.comment)));
+    description_.push_back(strings_.add(std::move(rule.description)));
+    const std::string& tag = strings_[comment_.back()];
+    for (size_t i = 0; i < rule.spec.size(); ++i) {
+        bool comment = i > 0 && rule.spec[i - 1] == "--comment" && rule.spec[i] == tag;
+        tokens_.push_back(comment ? comment_.back() : strings_.intern(rule.spec[i]));
+    }
+    spec_begin_.push_back(static_cast<uint32_t>(tokens_.size()));
+
+    protocol_.push_back(rule.protocol);
+    multiport_.push_back(rule.multiport ? 1 : 0);
+    mac_.push_back(rule.mac.value_or(kNoMac));
+    to_port_.push_back(rule.to_port);
+    target_.push_back(strings_.intern(rule.target));
+    sources_.insert(sources_.end(), rule.sources.begin(), rule.sources.end());
+    source_begin_.push_back(static_cast<uint32_t>(sources_.size()));
+    ports_.insert(ports_.end(), rule.ports.begin(), rule.ports.end());
+    port_begin_.push_back(static_cast<uint32_t>(ports_.size()));
+}
+
+// The typed columns of a copied row; the target is interned by the caller
+void RuleTable::appendMatches(const RuleView& rule) {
+    protocol_.push_back(rule.protocol());
+    multiport_.push_back(rule.multiport() ? 1 : 0);
+    mac_.push_back(rule.mac().value_or(kNoMac));
+    to_port_.push_back(rule.toPort());
+    // Index rather than iterate: the row may belong to this table, whose columns grow here
+    const RuleTable& from = rule.rules();
+    for (uint32_t i = from.source_begin_[rule.row()]; i < from.source_begin_[rule.row() + 1]; ++i) {
+        sources_.push_back(from.sources_[i]);
+    }
+    source_begin_.push_back(static_cast<uint32_t>(sources_.size()));
+    for (uint32_t i = from.port_begin_[rule.row()]; i < from.port_begin_[rule.row() + 1]; ++i) {
+        ports_.push_back(from.ports_[i]);
+    }
+    port_begin_.push_back(static_cast<uint32_t>(ports_.size()));
+}
+
+void RuleTable::append(const RuleView& rule) {
+    if (&rule.rules() == this) {
+        // Rows of this table share its ids; copying through a CompiledRule would
+        // also be safe, but reusing them keeps the pool from growing
+        size_t row = rule.row();
+        table_.push_back(table_[row]);
+        chain_.push_back(chain_[row]);
+        section_.push_back(section_[row]);
+        comment_.push_back(comment_[row]);
+        description_.push_back(description_[row]);
+        for (uint32_t i = spec_begin_[row]; i < spec_begin_[row + 1]; ++i) {
+            tokens_.push_back(tokens_[i]);
+        }
+        spec_begin_.push_back(static_cast<uint32_t>(tokens_.size()));
+        target_.push_back(target_[row]);
+        appendMatches(rule);
+        return;
+    }
+
+    table_.push_back(strings_.intern(rule.table()));
+    chain_.push_back(strings_.intern(rule.chain()));
+    section_.push_back(strings_.intern(rule.section()));
+    comment_.push_back(strings_.add(rule.comment()));
+    description_.push_back(strings_.add(rule.description()));
+    TokenSpan spec = rule.spec();
+    for (size_t i = 0; i < spec.size(); ++i) {
+        bool comment = spec.id(i) == rule.rules().comment_[rule.row()];
+        tokens_.push_back(comment ? comment_.back() : strings_.intern(spec[i]));
+    }
+    spec_begin_.push_back(static_cast<uint32_t>(tokens_.size()));
+    target_.push_back(strings_.intern(rule.target()));
+    appendMatches(rule);
+}
+
+void RuleTable::setChain(size_t row, std::string_view chain) {
+    chain_[row] = strings_.intern(chain);
+}
+
+void RuleTable::setTarget(size_t row, std::string_view target) {
+    uint32_t id = strings_.intern(target);
+    for (uint32_t i = spec_begin_[row]; i + 1 < spec_begin_[row + 1]; ++i) {
+        if (strings_[tokens_[i]] == "-j") {
+            tokens_[i + 1] = id;
+        }
+    }
+    target_[row] = id;
+}
+
+bool RuleTable::hasTable(std::string_view table) const {
+    for (uint32_t id : table_) {
+        if (strings_[id] == table) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace iptables
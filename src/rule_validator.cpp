@@ -2,7 +2,6 @@
 #include <iostream>
 #include <sstream>
 #include <algorithm>
-#include <arpa/inet.h>
 #include <functional>
 
 namespace iptables {
@@ -79,20 +78,37 @@ bool RuleValidator::isRuleUnreachable(const RuleSelectivity& rule_a, const RuleS
     }
     // If both have no subnet restrictions, they overlap in this dimension
     
-    // 2. Check port specificity
-    if (rule_a.port && rule_b.port) {
-        if (*rule_a.port != *rule_b.port) {
-            return false; // Different ports, no overlap
+    // 2. Check port specificity; ranges are compared by their decoded ports
+    auto covers_port = [&](uint16_t port) {
+        if (rule_a.port) {
+            return *rule_a.port == port;
         }
-    } else if (rule_b.port && !rule_a.port) {
-        // rule_a matches any port, rule_b matches specific port
-        // rule_a is more general, continue checking
-    } else if (rule_a.port && !rule_b.port) {
-        // rule_a matches specific port, rule_b matches any port
+        return std::any_of(rule_a.port_ranges->begin(), rule_a.port_ranges->end(),
+                           [&](const PortRange& range) { return range.first <= port && port <= range.last; });
+    };
+    bool a_has_ports = rule_a.port || rule_a.port_ranges;
+    bool b_has_ports = rule_b.port || rule_b.port_ranges;
+    if (a_has_ports && !b_has_ports) {
+        // rule_a matches specific ports, rule_b matches any port
         // rule_b is more general, so rule_a doesn't overshadow rule_b
         return false;
+    } else if (a_has_ports && rule_b.port) {
+        if (!covers_port(static_cast<uint16_t>(*rule_b.port))) {
+            return false; // rule_b's port is not among rule_a's ports
+        }
+    } else if (a_has_ports) {
+        // Every range of rule_b must lie within one single port or range of rule_a
+        for (const auto& range_b : *rule_b.port_ranges) {
+            bool covered = rule_a.port_ranges &&
+                           std::any_of(rule_a.port_ranges->begin(), rule_a.port_ranges->end(), [&](const PortRange& range_a) {
+                               return range_a.first <= range_b.first && range_b.last <= range_a.last;
+                           });
+            if (!covered) {
+                return false;
+            }
+        }
     }
-    // If both have no port restrictions, they overlap in this dimension
+    // If rule_a has no port restrictions, it matches every port of rule_b
     
     // 3. Check protocol
     if (rule_a.protocol != rule_b.protocol) {
@@ -142,29 +158,10 @@ bool RuleValidator::isRuleUnreachable(const RuleSelectivity& rule_a, const RuleS
     return false;
 }
 
-bool RuleValidator::subnetContains(const std::string& subnet_a, const std::string& subnet_b) {
-    try {
-        auto [net_a, prefix_a] = parseCIDR(subnet_a);
-        auto [net_b, prefix_b] = parseCIDR(subnet_b);
-        
-        // subnet_a contains subnet_b if:
-        // 1. subnet_a has smaller or equal prefix (less specific or equally specific)
-        // 2. subnet_b's network address falls within subnet_a's range
-        
-        if (prefix_a > prefix_b) {
-            return false; // subnet_a is more specific than subnet_b
-        }
-        
-        // Create mask for subnet_a
-        uint32_t mask_a = (prefix_a == 0) ? 0 : (~0U << (32 - prefix_a));
-        
-        // Check if subnet_b's network falls within subnet_a
-        return (net_a & mask_a) == (net_b & mask_a);
-        
-    } catch (const std::exception&) {
-        // If parsing fails, assume no containment
-        return false;
-    }
+bool RuleValidator::subnetContains(const Subnet& subnet_a, const Subnet& subnet_b) {
+    // subnet_a contains subnet_b if it is less or equally specific and
+    // subnet_b's network falls within subnet_a's range
+    return subnet_a.contains(subnet_b);
 }
 
 std::vector<RuleSelectivity> RuleValidator::extractRuleSelectivity(const Config& config) {
@@ -179,26 +176,33 @@ std::vector<RuleSelectivity> RuleValidator::extractRuleSelectivity(const Config&
     }
     
     // Extract from custom sections in order
-    for (const auto& [section_name, section] : config.custom_sections) {
-        size_t rule_index = 0;
-        
-        // Process port rules first
-        if (section.ports) {
-            for (size_t i = 0; i < section.ports->size(); ++i) {
-                const auto& port = (*section.ports)[i];
-                rules.push_back(extractPortSelectivity(port, section_name, rule_index++));
+    for (const auto& [template_name, template_section] : config.custom_sections) {
+        // Template sections are analysed instance by instance, as they are compiled
+        for (size_t instance = 0, instances = template_section.instanceCount(); instance < instances; ++instance) {
+            SectionConfig expanded;
+            const SectionConfig& section =
+                template_section.template_config ? (expanded = template_section.instance(instance)) : template_section;
+            std::string section_name = template_section.instanceName(template_name, instance);
+            size_t rule_index = 0;
+            
+            // Process port rules first
+            if (section.ports) {
+                for (size_t i = 0; i < section.ports->size(); ++i) {
+                    const auto& port = (*section.ports)[i];
+                    rules.push_back(extractPortSelectivity(port, section_name, rule_index++));
+                }
             }
-        }
-        
-        // Process MAC rules second
-        if (section.mac) {
-            for (size_t i = 0; i < section.mac->size(); ++i) {
-                const auto& mac = (*section.mac)[i];
-                rules.push_back(extractMacSelectivity(mac, section_name, rule_index++));
+            
+            // Process MAC rules second
+            if (section.mac) {
+                for (size_t i = 0; i < section.mac->size(); ++i) {
+                    const auto& mac = (*section.mac)[i];
+                    rules.push_back(extractMacSelectivity(mac, section_name, rule_index++));
+                }
             }
+            
+            // Interface rules would go here if implemented
         }
-        
-        // Interface rules would go here if implemented
     }
     
     return rules;
@@ -234,7 +238,7 @@ RuleSelectivity RuleValidator::extractPortSelectivity(const PortConfig& port, co
         desc << "port ranges [";
         for (size_t i = 0; i < port.range->size(); ++i) {
             if (i > 0) desc << ", ";
-            desc << (*port.range)[i];
+            desc << (*port.range)[i].text;
         }
         desc << "]";
     }
@@ -244,7 +248,7 @@ RuleSelectivity RuleValidator::extractPortSelectivity(const PortConfig& port, co
         desc << " from subnets: ";
         for (size_t i = 0; i < port.subnet->size(); ++i) {
             if (i > 0) desc << ", ";
-            desc << (*port.subnet)[i];
+            desc << (*port.subnet)[i].text;
         }
     }
     desc << " -> " << (port.allow ? "ACCEPT" : "DROP");
@@ -269,12 +273,12 @@ RuleSelectivity RuleValidator::extractMacSelectivity(const MacConfig& mac, const
     }
     
     std::ostringstream desc;
-    desc << "MAC " << mac.mac_source;
+    desc << "MAC " << mac.mac_source.text;
     if (mac.subnet) {
         desc << " from subnets: ";
         for (size_t i = 0; i < mac.subnet->size(); ++i) {
             if (i > 0) desc << ", ";
-            desc << (*mac.subnet)[i];
+            desc << (*mac.subnet)[i].text;
         }
     }
     desc << " -> " << (mac.allow ? "ACCEPT" : "DROP");
@@ -283,34 +287,6 @@ RuleSelectivity RuleValidator::extractMacSelectivity(const MacConfig& mac, const
     return selectivity;
 }
 
-std::pair<uint32_t, int> RuleValidator::parseCIDR(const std::string& cidr) {
-    size_t slash_pos = cidr.find('/');
-    std::string ip_str;
-    int prefix_len = 32; // Default to /32 if no prefix specified
-    
-    if (slash_pos != std::string::npos) {
-        ip_str = cidr.substr(0, slash_pos);
-        prefix_len = std::stoi(cidr.substr(slash_pos + 1));
-    } else {
-        ip_str = cidr;
-    }
-    
-    struct in_addr addr;
-    if (inet_aton(ip_str.c_str(), &addr) == 0) {
-        throw std::runtime_error("Invalid IP address: " + ip_str);
-    }
-    
-    uint32_t ip = ntohl(addr.s_addr);
-    
-    // Apply the network mask to get the network address
-    if (prefix_len < 32) {
-        uint32_t mask = (~0U << (32 - prefix_len));
-        ip &= mask;
-    }
-    
-    return {ip, prefix_len};
-}
-
 bool RuleValidator::isInterfaceMoreSpecific(const std::optional<std::string>& specific, 
                                           const std::optional<std::string>& general) {
     // Returns true if 'specific' is more specific than or equal to 'general'
@@ -347,77 +323,84 @@ std::vector<ValidationWarning> RuleValidator::validateChainReferences(const Conf
     }
     
     // Check chain references in sections
-    for (const auto& [section_name, section] : config.custom_sections) {
-        // Check interface config chain references
-        if (section.interface_config && section.interface_config->chain) {
-            const std::string& referenced_chain = *section.interface_config->chain;
-            if (defined_chains.find(referenced_chain) == defined_chains.end()) {
-                ValidationWarning warning;
-                warning.type = ValidationWarning::Type::InvalidChainReference;
-                warning.section_name = section_name;
-                warning.rule_index = 0;
-                warning.message = "Section '" + section_name + "' references undefined chain '" + referenced_chain + "'";
-                warnings.push_back(warning);
+    for (const auto& [template_name, template_section] : config.custom_sections) {
+        // Each instance of a template section may reference a different chain
+        for (size_t instance = 0, instances = template_section.instanceCount(); instance < instances; ++instance) {
+            SectionConfig expanded;
+            const SectionConfig& section =
+                template_section.template_config ? (expanded = template_section.instance(instance)) : template_section;
+            std::string section_name = template_section.instanceName(template_name, instance);
+            // Check interface config chain references
+            if (section.interface_config && section.interface_config->chain) {
+                const std::string& referenced_chain = *section.interface_config->chain;
+                if (defined_chains.find(referenced_chain) == defined_chains.end()) {
+                    ValidationWarning warning;
+                    warning.type = ValidationWarning::Type::InvalidChainReference;
+                    warning.section_name = section_name;
+                    warning.rule_index = 0;
+                    warning.message = "Section '" + section_name + "' references undefined chain '" + referenced_chain + "'";
+                    warnings.push_back(warning);
+                }
             }
-        }
-        
-        // Check port config direct chain references
-        if (section.ports) {
-            for (size_t i = 0; i < section.ports->size(); ++i) {
-                const auto& port = (*section.ports)[i];
-                if (port.chain) {
-                    const std::string& referenced_chain = *port.chain;
-                    if (defined_chains.find(referenced_chain) == defined_chains.end()) {
-                        ValidationWarning warning;
-                        warning.type = ValidationWarning::Type::InvalidChainReference;
-                        warning.section_name = section_name;
-                        warning.rule_index = i;
-                        warning.message = "Port rule in section '" + section_name + "' references undefined chain '" + referenced_chain + "'";
-                        warnings.push_back(warning);
+            
+            // Check port config direct chain references
+            if (section.ports) {
+                for (size_t i = 0; i < section.ports->size(); ++i) {
+                    const auto& port = (*section.ports)[i];
+                    if (port.chain) {
+                        const std::string& referenced_chain = *port.chain;
+                        if (defined_chains.find(referenced_chain) == defined_chains.end()) {
+                            ValidationWarning warning;
+                            warning.type = ValidationWarning::Type::InvalidChainReference;
+                            warning.section_name = section_name;
+                            warning.rule_index = i;
+                            warning.message = "Port rule in section '" + section_name + "' references undefined chain '" + referenced_chain + "'";
+                            warnings.push_back(warning);
+                        }
                     }
-                }
-                
-                // Also check interface chain references within port rules
-                if (port.interface && port.interface->chain) {
-                    const std::string& referenced_chain = *port.interface->chain;
-                    if (defined_chains.find(referenced_chain) == defined_chains.end()) {
-                        ValidationWarning warning;
-                        warning.type = ValidationWarning::Type::InvalidChainReference;
-                        warning.section_name = section_name;
-                        warning.rule_index = i;
-                        warning.message = "Port rule interface in section '" + section_name + "' references undefined chain '" + referenced_chain + "'";
-                        warnings.push_back(warning);
+                    
+                    // Also check interface chain references within port rules
+                    if (port.interface && port.interface->chain) {
+                        const std::string& referenced_chain = *port.interface->chain;
+                        if (defined_chains.find(referenced_chain) == defined_chains.end()) {
+                            ValidationWarning warning;
+                            warning.type = ValidationWarning::Type::InvalidChainReference;
+                            warning.section_name = section_name;
+                            warning.rule_index = i;
+                            warning.message = "Port rule interface in section '" + section_name + "' references undefined chain '" + referenced_chain + "'";
+                            warnings.push_back(warning);
+                        }
                     }
                 }
             }
-        }
-        
-        // Check MAC config direct chain references
-        if (section.mac) {
-            for (size_t i = 0; i < section.mac->size(); ++i) {
-                const auto& mac = (*section.mac)[i];
-                if (mac.chain) {
-                    const std::string& referenced_chain = *mac.chain;
-                    if (defined_chains.find(referenced_chain) == defined_chains.end()) {
-                        ValidationWarning warning;
-                        warning.type = ValidationWarning::Type::InvalidChainReference;
-                        warning.section_name = section_name;
-                        warning.rule_index = i;
-                        warning.message = "MAC rule in section '" + section_name + "' references undefined chain '" + referenced_chain + "'";
-                        warnings.push_back(warning);
+            
+            // Check MAC config direct chain references
+            if (section.mac) {
+                for (size_t i = 0; i < section.mac->size(); ++i) {
+                    const auto& mac = (*section.mac)[i];
+                    if (mac.chain) {
+                        const std::string& referenced_chain = *mac.chain;
+                        if (defined_chains.find(referenced_chain) == defined_chains.end()) {
+                            ValidationWarning warning;
+                            warning.type = ValidationWarning::Type::InvalidChainReference;
+                            warning.section_name = section_name;
+                            warning.rule_index = i;
+                            warning.message = "MAC rule in section '" + section_name + "' references undefined chain '" + referenced_chain + "'";
+                            warnings.push_back(warning);
+                        }
                     }
-                }
-                
-                // Also check interface chain references within MAC rules
-                if (mac.interface && mac.interface->chain) {
-                    const std::string& referenced_chain = *mac.interface->chain;
-                    if (defined_chains.find(referenced_chain) == defined_chains.end()) {
-                        ValidationWarning warning;
-                        warning.type = ValidationWarning::Type::InvalidChainReference;
-                        warning.section_name = section_name;
-                        warning.rule_index = i;
-                        warning.message = "MAC rule interface in section '" + section_name + "' references undefined chain '" + referenced_chain + "'";
-                        warnings.push_back(warning);
+                    
+                    // Also check interface chain references within MAC rules
+                    if (mac.interface && mac.interface->chain) {
+                        const std::string& referenced_chain = *mac.interface->chain;
+                        if (defined_chains.find(referenced_chain) == defined_chains.end()) {
+                            ValidationWarning warning;
+                            warning.type = ValidationWarning::Type::InvalidChainReference;
+                            warning.section_name = section_name;
+                            warning.rule_index = i;
+                            warning.message = "MAC rule interface in section '" + section_name + "' references undefined chain '" + referenced_chain + "'";
+                            warnings.push_back(warning);
+                        }
                     }
                 }
             }
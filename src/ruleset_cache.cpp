@@ -0,0 +1,125 @@
+#include "ruleset_cache.hpp"
+#include "config_loader.hpp"
+#include "restore_backend.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifndef IPTABLES_COMPOSE_VERSION
+#define IPTABLES_COMPOSE_VERSION "unknown"
+#endif
+
+namespace iptables {
+
+namespace {
+
+std::filesystem::path g_path = RulesetCache::kDefaultPath;
+
+// Bumped whenever the payload a configuration compiles to changes without a version change
+constexpr const char* kCacheFormat = "1";
+
+uint64_t fnv1a(uint64_t hash, const std::string& text) {
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+} // namespace
+
+void RulesetCache::setPath(const std::filesystem::path& path) {
+    g_path = path;
+}
+
+const std::filesystem::path& RulesetCache::path() {
+    return g_path;
+}
+
+std::optional<uint64_t> RulesetCache::key(const std::filesystem::path& config_path, bool section_chains) {
+    uint64_t hash = 14695981039346656037ull;
+    hash = fnv1a(hash, std::string(IPTABLES_COMPOSE_VERSION) + "/" + kCacheFormat + "\n");
+    hash = fnv1a(hash, section_chains ? "section-chains\n" : "plain\n");
+
+    // The fragments count with their names, since these decide the merge order
+    for (const auto& file : ConfigLoader::files(config_path)) {
+        std::ifstream in(file, std::ios::binary);
+        if (!in) {
+            return std::nullopt;
+        }
+        std::ostringstream contents;
+        contents << in.rdbuf();
+        if (in.bad()) {
+            return std::nullopt;
+        }
+        if (file != config_path) {
+            hash = fnv1a(hash, "\nfragment " + file.filename().string() + "\n");
+        }
+        hash = fnv1a(hash, contents.str());
+    }
+    return hash;
+}
+
+std::optional<CachedRuleset> RulesetCache::load(uint64_t key) {
+    std::ifstream in(g_path);
+    std::string key_line, tables_line;
+    if (!in || !std::getline(in, key_line) || !std::getline(in, tables_line) ||
+        key_line.compare(0, 4, "key ") != 0 || tables_line.compare(0, 7, "tables ") != 0) {
+        return std::nullopt;
+    }
+    if (std::strtoull(key_line.c_str() + 4, nullptr, 16) != key) {
+        return std::nullopt;
+    }
+
+    CachedRuleset cached;
+    std::istringstream tables(tables_line.substr(7));
+    std::string table;
+    while (std::getline(tables, table, ',')) {
+        cached.tables.push_back(table);
+    }
+    std::ostringstream payload;
+    payload << in.rdbuf();
+    cached.payload = payload.str();
+    if (cached.tables.empty() || cached.payload.empty()) {
+        return std::nullopt;
+    }
+    return cached;
+}
+
+bool RulesetCache::store(uint64_t key, const CompiledRuleset& ruleset) {
+    std::error_code error;
+    if (g_path.has_parent_path()) {
+        std::filesystem::create_directories(g_path.parent_path(), error);
+    }
+    // A boot must never restore half a payload; rename() replaces the cache atomically
+    std::filesystem::path temporary = g_path;
+    temporary += ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::trunc);
+        char key_text[17];
+        std::snprintf(key_text, sizeof(key_text), "%016llx", static_cast<unsigned long long>(key));
+        out << "key " << key_text << "\ntables ";
+        std::vector<std::string> tables = ruleset.tables();
+        for (size_t i = 0; i < tables.size(); ++i) {
+            out << (i > 0 ? "," : "") << tables[i];
+        }
+        out << "\n" << RestoreBackend::renderPayload(ruleset);
+        if (!out.flush()) {
+            std::cerr << "Warning: failed to write ruleset cache " << temporary.string() << std::endl;
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+    }
+    std::filesystem::rename(temporary, g_path, error);
+    if (error) {
+        std::cerr << "Warning: failed to write ruleset cache " << g_path.string() << ": " << error.message()
+                  << std::endl;
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+} // namespace iptables
@@ -0,0 +1,715 @@
+#include "ruleset_compiler.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <netinet/in.h>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+namespace iptables {
+
+// Helper function to convert Policy enum to string
+std::string policyToString(Policy policy) {
+    switch (policy) {
+        case Policy::Accept: return "ACCEPT";
+        case Policy::Drop: return "DROP";
+        case Policy::Reject: return "REJECT";
+        default: return "ACCEPT";
+    }
+}
+
+std::string actionToString(Action action) {
+    switch (action) {
+        case Action::Accept: return "ACCEPT";
+        case Action::Drop: return "DROP";
+        case Action::Reject: return "REJECT";
+        default: return "ACCEPT";
+    }
+}
+
+// Helper function to generate interface comment
+std::string getInterfaceComment(const std::optional<InterfaceConfig>& interface) {
+    if (interface.has_value()) {
+        std::string in_iface = interface->input.value_or("any");
+        std::string out_iface = interface->output.value_or("any");
+        return "i:" + in_iface + ":o:" + out_iface;
+    }
+    return "i:any:o:any";
+}
+
+std::string directionToChain(Direction direction) {
+    switch (direction) {
+        case Direction::Input: return "INPUT";
+        case Direction::Output: return "OUTPUT";
+        case Direction::Forward: return "FORWARD";
+    }
+    return "INPUT";
+}
+
+namespace {
+
+// Join a list of values with commas as spelled in the configuration, as
+// accepted by -s and used in rule comments
+template <typename T>
+std::string joinList(const std::vector<T>& values) {
+    std::ostringstream joined;
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (i > 0) joined << ",";
+        joined << values[i].text;
+    }
+    return joined.str();
+}
+
+// Join port ranges as iptables multiport expects them, e.g. "1000:2000,8080"
+std::string joinMultiport(const std::vector<PortRange>& ranges) {
+    std::string joined;
+    for (const auto& range : ranges) {
+        if (!joined.empty()) joined += ",";
+        joined += range.toMultiport();
+    }
+    return joined;
+}
+
+// The helpers below append a match to a rule's spec and record it in the typed fields at once
+
+// -p with the protocol's name
+void matchProtocol(CompiledRule& rule, Protocol protocol) {
+    rule.spec.insert(rule.spec.end(), {"-p", protocol == Protocol::Tcp ? "tcp" : "udp"});
+    rule.protocol = protocol == Protocol::Tcp ? IPPROTO_TCP : IPPROTO_UDP;
+}
+
+// A single destination port through the protocol's own match
+void matchPort(CompiledRule& rule, Protocol protocol, uint16_t port) {
+    rule.spec.insert(rule.spec.end(), {"-m", protocol == Protocol::Tcp ? "tcp" : "udp", "--dport", std::to_string(port)});
+    rule.ports.push_back(PortMatch{port, port});
+}
+
+void matchPortRanges(CompiledRule& rule, const std::vector<PortRange>& ranges) {
+    rule.spec.insert(rule.spec.end(), {"-m", "multiport", "--dports", joinMultiport(ranges)});
+    for (const auto& range : ranges) {
+        rule.ports.push_back(PortMatch{range.first, range.last});
+    }
+    rule.multiport = true;
+}
+
+// -s with the subnets as written; names iptables resolves itself have no network
+void matchSources(CompiledRule& rule, const std::vector<Subnet>& subnets) {
+    rule.spec.insert(rule.spec.end(), {"-s", joinList(subnets)});
+    for (const auto& subnet : subnets) {
+        rule.sources.push_back(subnet.valid ? AddressMatch{subnet.network, subnet.prefix}
+                                            : AddressMatch{0, AddressMatch::kUnresolved});
+    }
+}
+
+void matchMac(CompiledRule& rule, const MacAddress& mac) {
+    rule.spec.insert(rule.spec.end(), {"-m", "mac", "--mac-source", mac.text});
+    if (mac.valid) {
+        rule.mac = mac.value;
+    }
+}
+
+// The comment carrying the rule's signature, and the target
+void jumpTo(CompiledRule& rule, const std::string& target) {
+    rule.spec.insert(rule.spec.end(), {"-m", "comment", "--comment", rule.comment, "-j", target});
+    rule.target = target;
+}
+
+// Stable 32-bit FNV-1a hash; generated chain names must not change between builds
+uint32_t fnv1a(const std::string& text) {
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Short chain name suffix for each built-in chain
+std::string parentSuffix(const std::string& parent) {
+    if (parent == "INPUT") return "in";
+    if (parent == "OUTPUT") return "out";
+    if (parent == "FORWARD") return "fwd";
+    if (parent == "PREROUTING") return "pre";
+    if (parent == "POSTROUTING") return "post";
+    return parent;
+}
+
+bool isChainNameCharacter(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '-' || c == '.';
+}
+
+// "YAML-<base><suffix>", or a readable start of base plus a hash of all of it when
+// that is too long or invalid; the start leaves room for `reserved` suffix characters
+std::string generatedChainName(const std::string& base, const std::string& suffix, size_t reserved) {
+    std::string prefix = RulesetCompiler::kSectionChainPrefix;
+    size_t budget = RulesetCompiler::kMaxChainNameLength - prefix.size() - suffix.size();
+
+    bool valid = !base.empty() && std::all_of(base.begin(), base.end(), isChainNameCharacter);
+    if (valid && base.size() <= budget) {
+        return prefix + base + suffix;
+    }
+
+    char hash[10];
+    std::snprintf(hash, sizeof(hash), "-%08x", fnv1a(base));
+    std::string readable = base.substr(0, RulesetCompiler::kMaxChainNameLength - prefix.size() - 9 - reserved);
+    std::replace_if(readable.begin(), readable.end(), [](char c) { return !isChainNameCharacter(c); }, '_');
+    return prefix + readable + hash + suffix;
+}
+
+// Replace a rule's readable signature with its ownership tag, in the comment and in the spec
+void tagRule(CompiledRule& rule) {
+    rule.description = rule.comment;
+    rule.comment = RulesetCompiler::ruleTag(rule);
+    for (size_t i = 0; i + 1 < rule.spec.size(); ++i) {
+        if (rule.spec[i] == "--comment") {
+            rule.spec[i + 1] = rule.comment;
+        }
+    }
+}
+
+} // namespace
+
+std::vector<std::string> CompiledRuleset::tables() const {
+    std::vector<std::string> result = {"filter"};
+    for (const char* table : {"nat", "mangle"}) {
+        if (rules.hasTable(table)) {
+            result.push_back(table);
+        }
+    }
+    return result;
+}
+
+bool CompiledRuleset::ownsChain(const std::string& table, const std::string& chain) const {
+    if (table == "filter" && std::find(chains.begin(), chains.end(), chain) != chains.end()) {
+        return true;
+    }
+    return std::any_of(section_chains.begin(), section_chains.end(), [&](const SectionChain& owned) {
+        return owned.table == table && owned.name == chain;
+    });
+}
+
+CompiledRuleset RulesetCompiler::compile(const Config& config) {
+    CompiledRuleset ruleset;
+
+    // Filter section: policies first, then global MAC rules
+    if (config.filter) {
+        if (config.filter->input) {
+            ruleset.policies["INPUT"] = *config.filter->input;
+        }
+        if (config.filter->output) {
+            ruleset.policies["OUTPUT"] = *config.filter->output;
+        }
+        if (config.filter->forward) {
+            ruleset.policies["FORWARD"] = *config.filter->forward;
+        }
+        if (config.filter->mac) {
+            for (const auto& mac : *config.filter->mac) {
+                ruleset.rules.append(compileMacRule(mac, "filter"));
+            }
+        }
+    }
+
+    // Custom chains and their contents
+    auto section_to_chain = buildSectionChainMap(config);
+    for (const auto& [section_name, chain_config] : config.chain_definitions) {
+        for (const auto& chain_rule : chain_config.chain) {
+            if (std::find(ruleset.chains.begin(), ruleset.chains.end(), chain_rule.name) == ruleset.chains.end()) {
+                ruleset.chains.push_back(chain_rule.name);
+            }
+        }
+    }
+    for (const auto& [section_name, chain_config] : config.chain_definitions) {
+        for (const auto& chain_rule : chain_config.chain) {
+            auto chain_rules = compileChainRules(chain_rule.name, chain_rule.rules, section_to_chain);
+            for (const auto& rule : chain_rules) {
+                ruleset.rules.append(rule);
+            }
+        }
+    }
+
+    // Custom sections in YAML order. A template section is expanded here, one
+    // instance at a time, each compiled as a section of its own name.
+    for (const auto& [section_name, template_section] : config.custom_sections) {
+        size_t instances = template_section.instanceCount();
+        for (size_t instance = 0; instance < instances; ++instance) {
+            SectionConfig expanded;
+            const SectionConfig& section =
+                template_section.template_config ? (expanded = template_section.instance(instance)) : template_section;
+            std::string name = template_section.instanceName(section_name, instance);
+            if (section.ports) {
+                for (const auto& port : *section.ports) {
+                    ruleset.rules.append(compilePortRule(port, name));
+                }
+            }
+            if (section.mac) {
+                for (const auto& mac : *section.mac) {
+                    ruleset.rules.append(compileMacRule(mac, name));
+                }
+            }
+            if (section.interface) {
+                for (const auto& interface : *section.interface) {
+                    ruleset.rules.append(compileInterfaceRule(interface, name));
+                }
+            }
+            if (section.interface_config) {
+                if (!section.interface_config->chain) {
+                    throw std::invalid_argument("Interface configuration must specify a chain target");
+                }
+                std::string target_chain = resolveChainName(section_to_chain, *section.interface_config->chain);
+                ruleset.rules.append(compileInterfaceChainCall(*section.interface_config, name, target_chain));
+            }
+            if (section.action) {
+                ruleset.rules.append(compileActionRule(*section.action, name));
+            }
+        }
+    }
+
+    return ruleset;
+}
+
+std::map<std::string, std::string> RulesetCompiler::buildSectionChainMap(const Config& config) {
+    std::map<std::string, std::string> section_to_chain;
+    for (const auto& [section_name, chain_config] : config.chain_definitions) {
+        for (const auto& chain_rule : chain_config.chain) {
+            section_to_chain[section_name] = chain_rule.name;
+            break; // Use the first (and typically only) chain in the section
+        }
+    }
+    return section_to_chain;
+}
+
+std::string RulesetCompiler::resolveChainName(const std::map<std::string, std::string>& section_to_chain,
+                                              const std::string& name) {
+    auto it = section_to_chain.find(name);
+    if (it != section_to_chain.end()) {
+        return it->second;
+    }
+    // If not found in mapping, assume it's already an actual chain name
+    return name;
+}
+
+CompiledRule RulesetCompiler::compilePortRule(const PortConfig& port, const std::string& section_name) {
+    std::string port_description;
+    if (port.port) {
+        port_description = std::to_string(*port.port);
+    } else if (port.range) {
+        port_description = "multiport:" + joinList(*port.range);
+    } else {
+        throw std::invalid_argument("Invalid port configuration: neither port nor range specified");
+    }
+
+    if (port.forward && port.range) {
+        throw std::invalid_argument("Port forwarding is not supported with port ranges");
+    }
+
+    std::string iface_comment = getInterfaceComment(port.interface);
+    std::string mac_comment = port.mac_source ? port.mac_source->text : "any";
+
+    CompiledRule rule;
+    rule.section = section_name;
+
+    if (port.forward) {
+        // Port forwarding lives in the NAT table
+        rule.table = "nat";
+        rule.chain = "PREROUTING";
+        rule.comment = "YAML:" + section_name + ":port:" + port_description + ":forward:" + iface_comment + ":mac:" + mac_comment;
+
+        if (port.interface) {
+            if (port.interface->input) {
+                rule.spec.insert(rule.spec.end(), {"-i", *port.interface->input});
+            }
+            if (port.interface->output) {
+                rule.spec.insert(rule.spec.end(), {"-o", *port.interface->output});
+            }
+        }
+        if (port.mac_source) {
+            matchMac(rule, *port.mac_source);
+        }
+        matchProtocol(rule, port.protocol);
+        matchPort(rule, port.protocol, *port.port);
+        jumpTo(rule, "REDIRECT");
+        rule.spec.insert(rule.spec.end(), {"--to-port", std::to_string(*port.forward)});
+        rule.to_port = *port.forward;
+        tagRule(rule);
+        return rule;
+    }
+
+    // Regular rule: subnet, action and chain target make the signature unique
+    rule.comment = "YAML:" + section_name + ":port:" + port_description + ":" + iface_comment + ":mac:" + mac_comment;
+    if (port.subnet && !port.subnet->empty()) {
+        rule.comment += ":subnet:" + joinList(*port.subnet);
+    } else {
+        rule.comment += ":subnet:any";
+    }
+    rule.comment += ":";
+    rule.comment += (port.allow ? "ACCEPT" : "DROP");
+    if (port.chain) {
+        rule.comment += ":chain:" + *port.chain;
+    }
+
+    rule.chain = directionToChain(port.direction);
+
+    if (port.interface) {
+        if (port.interface->input) {
+            rule.spec.insert(rule.spec.end(), {"-i", *port.interface->input});
+        }
+        if (port.interface->output) {
+            rule.spec.insert(rule.spec.end(), {"-o", *port.interface->output});
+        }
+    }
+    if (port.mac_source) {
+        matchMac(rule, *port.mac_source);
+    }
+    if (port.subnet && !port.subnet->empty()) {
+        matchSources(rule, *port.subnet);
+    }
+
+    matchProtocol(rule, port.protocol);
+    if (port.port) {
+        matchPort(rule, port.protocol, *port.port);
+    } else {
+        matchPortRanges(rule, *port.range);
+    }
+
+    jumpTo(rule, port.chain ? *port.chain : (port.allow ? "ACCEPT" : "DROP"));
+    tagRule(rule);
+    return rule;
+}
+
+CompiledRule RulesetCompiler::compileMacRule(const MacConfig& mac, const std::string& section_name) {
+    // Only INPUT is allowed for MAC rules
+    if (mac.direction != Direction::Input) {
+        throw std::invalid_argument("MAC rules are only allowed in INPUT direction. Found direction: " +
+                                    std::to_string(static_cast<int>(mac.direction)));
+    }
+
+    CompiledRule rule;
+    rule.section = section_name;
+    rule.chain = "INPUT";
+
+    std::string iface_comment;
+    if (mac.interface) {
+        iface_comment = "i:" + mac.interface->input.value_or("any") + ":o:any";
+    } else {
+        iface_comment = "i:any:o:any";
+    }
+    rule.comment = "YAML:" + section_name + ":mac:" + mac.mac_source.text + ":" + iface_comment;
+    if (mac.chain) {
+        rule.comment += ":chain:" + *mac.chain;
+    }
+
+    if (mac.interface && mac.interface->input) {
+        rule.spec.insert(rule.spec.end(), {"-i", *mac.interface->input});
+    }
+    matchMac(rule, mac.mac_source);
+    if (mac.subnet && !mac.subnet->empty()) {
+        matchSources(rule, *mac.subnet);
+    }
+    jumpTo(rule, mac.chain ? *mac.chain : (mac.allow ? "ACCEPT" : "DROP"));
+    tagRule(rule);
+    return rule;
+}
+
+CompiledRule RulesetCompiler::compileInterfaceRule(const InterfaceRuleConfig& interface, const std::string& section_name) {
+    CompiledRule rule;
+    rule.section = section_name;
+    rule.chain = directionToChain(interface.direction);
+
+    std::string iface_comment = "i:" + interface.input.value_or("any") + ":o:" + interface.output.value_or("any");
+    rule.comment = "YAML:" + section_name + ":interface:" + iface_comment;
+
+    if (interface.input) {
+        rule.spec.insert(rule.spec.end(), {"-i", *interface.input});
+    }
+    if (interface.output) {
+        rule.spec.insert(rule.spec.end(), {"-o", *interface.output});
+    }
+    jumpTo(rule, interface.allow ? "ACCEPT" : "DROP");
+    tagRule(rule);
+    return rule;
+}
+
+CompiledRule RulesetCompiler::compileActionRule(const Action& action, const std::string& section_name) {
+    CompiledRule rule;
+    rule.section = section_name;
+    rule.chain = "INPUT";
+    rule.comment = "YAML:" + section_name + ":action:" + actionToString(action) + ":i:any:o:any:mac:any";
+    jumpTo(rule, actionToString(action));
+    tagRule(rule);
+    return rule;
+}
+
+CompiledRule RulesetCompiler::compileInterfaceChainCall(const InterfaceConfig& interface,
+                                                        const std::string& section_name,
+                                                        const std::string& target_chain) {
+    if (!interface.chain) {
+        throw std::invalid_argument("Interface configuration must specify a chain target");
+    }
+
+    CompiledRule rule;
+    rule.section = section_name;
+
+    std::string iface_comment = "i:" + interface.input.value_or("any") + ":o:" + interface.output.value_or("any");
+    rule.comment = "YAML:" + section_name + ":chain_call:" + target_chain + ":" + iface_comment;
+
+    // Default to INPUT; output-only goes to OUTPUT, both interfaces means routed traffic
+    rule.chain = "INPUT";
+    if (interface.output && !interface.input) {
+        rule.chain = "OUTPUT";
+    } else if (interface.input && interface.output) {
+        rule.chain = "FORWARD";
+    }
+
+    if (interface.input) {
+        rule.spec.insert(rule.spec.end(), {"-i", *interface.input});
+    }
+    if (interface.output) {
+        rule.spec.insert(rule.spec.end(), {"-o", *interface.output});
+    }
+    jumpTo(rule, target_chain);
+    tagRule(rule);
+    return rule;
+}
+
+std::vector<CompiledRule> RulesetCompiler::compileChainRules(
+    const std::string& chain_name,
+    const std::vector<std::pair<std::string, SectionConfig>>& rules,
+    const std::map<std::string, std::string>& section_to_chain) {
+    std::vector<CompiledRule> compiled;
+
+    for (const auto& [rule_group_name, rule_group] : rules) {
+        // Rule groups may be templates too; their instances all belong to the chain
+        for (size_t instance = 0, instances = rule_group.instanceCount(); instance < instances; ++instance) {
+            SectionConfig expanded;
+            const SectionConfig& section_config =
+                rule_group.template_config ? (expanded = rule_group.instance(instance)) : rule_group;
+            if (section_config.ports) {
+                for (const auto& port : *section_config.ports) {
+                    CompiledRule rule;
+                    rule.section = chain_name;
+                    rule.chain = chain_name;
+
+                    rule.comment = "YAML:chain:" + chain_name + ":port:" + std::to_string(port.port.value_or(0));
+                    if (port.range) {
+                        rule.comment = "YAML:chain:" + chain_name + ":port:" + joinList(*port.range);
+                    }
+                    rule.comment += ":" + getInterfaceComment(port.interface);
+                    if (port.subnet && !port.subnet->empty()) {
+                        rule.comment += ":subnet:" + joinList(*port.subnet);
+                    } else {
+                        rule.comment += ":subnet:any";
+                    }
+                    rule.comment += ":";
+                    rule.comment += (port.allow ? "ACCEPT" : "DROP");
+
+                    matchProtocol(rule, port.protocol);
+                    if (port.port) {
+                        matchPort(rule, port.protocol, *port.port);
+                    } else if (port.range && !port.range->empty()) {
+                        matchPortRanges(rule, *port.range);
+                    }
+                    if (port.subnet && !port.subnet->empty()) {
+                        matchSources(rule, *port.subnet);
+                    }
+                    if (port.interface) {
+                        if (port.interface->input) {
+                            rule.spec.insert(rule.spec.end(), {"-i", *port.interface->input});
+                        }
+                        if (port.interface->output) {
+                            rule.spec.insert(rule.spec.end(), {"-o", *port.interface->output});
+                        }
+                    }
+                    if (port.mac_source) {
+                        matchMac(rule, *port.mac_source);
+                    }
+                    jumpTo(rule, port.allow ? "ACCEPT" : "DROP");
+                    tagRule(rule);
+                    compiled.push_back(std::move(rule));
+                }
+            }
+
+            if (section_config.mac) {
+                for (const auto& mac : *section_config.mac) {
+                    CompiledRule rule;
+                    rule.section = chain_name;
+                    rule.chain = chain_name;
+                    rule.comment = "YAML:chain:" + chain_name + ":mac:" + mac.mac_source.text + ":" + getInterfaceComment(mac.interface);
+
+                    matchMac(rule, mac.mac_source);
+                    if (mac.subnet && !mac.subnet->empty()) {
+                        matchSources(rule, *mac.subnet);
+                    }
+                    // Input interface only for MAC rules
+                    if (mac.interface && mac.interface->input) {
+                        rule.spec.insert(rule.spec.end(), {"-i", *mac.interface->input});
+                    }
+                    jumpTo(rule, mac.allow ? "ACCEPT" : "DROP");
+                    tagRule(rule);
+                    compiled.push_back(std::move(rule));
+                }
+            }
+
+            if (section_config.interface_config && section_config.interface_config->chain) {
+                const auto& interface = *section_config.interface_config;
+                std::string target_chain = resolveChainName(section_to_chain, *interface.chain);
+
+                CompiledRule rule;
+                rule.section = chain_name;
+                rule.chain = chain_name;
+                rule.comment = "YAML:chain:" + chain_name + ":chain_call:" + target_chain + ":" + getInterfaceComment(interface);
+                if (interface.input) {
+                    rule.spec.insert(rule.spec.end(), {"-i", *interface.input});
+                }
+                if (interface.output) {
+                    rule.spec.insert(rule.spec.end(), {"-o", *interface.output});
+                }
+                jumpTo(rule, target_chain);
+                tagRule(rule);
+                compiled.push_back(std::move(rule));
+            }
+        }
+    }
+
+    return compiled;
+}
+
+void RulesetCompiler::useSectionChains(CompiledRuleset& ruleset, const std::string& generation) {
+    for (const auto& chain : ruleset.chains) {
+        if (isSectionChain(chain)) {
+            throw std::invalid_argument("Chain name " + chain + " uses the prefix reserved for section chains: " +
+                                        kSectionChainPrefix);
+        }
+    }
+
+    // A generation owns every chain it uses, so custom chains are renamed into it too
+    std::map<std::string, std::string> renamed;
+    if (!generation.empty()) {
+        std::string suffix = "." + generation;
+        for (const auto& chain : ruleset.chains) {
+            std::string name = generatedChainName(chain, suffix, suffix.size());
+            renamed[chain] = name;
+            ruleset.section_chains.push_back(SectionChain{"filter", name, "", chain});
+        }
+        ruleset.chains.clear();
+    }
+
+    RuleTable rules;
+    rules.reserve(ruleset.rules.size() + 8, ruleset.rules.tokenCount() + 48);
+    std::set<std::string> created;  // "table chain" of section chains already jumped to
+    for (const auto& rule : ruleset.rules) {
+        std::string chain = rule.chain();
+        if (!renamed.empty()) {
+            auto renamed_chain = renamed.find(chain);
+            if (renamed_chain != renamed.end()) {
+                chain = renamed_chain->second;
+            }
+        }
+        if (isBuiltinChain(chain)) {
+            std::string name = sectionChainName(rule.section(), chain, generation);
+            if (created.insert(rule.table() + " " + name).second) {
+                // The jump takes the place of the section's first rule in the built-in chain
+                CompiledRule jump;
+                jump.table = rule.table();
+                jump.chain = chain;
+                jump.section = rule.section();
+                jump.comment = "YAML:" + rule.section() + ":jump:" + name;
+                jumpTo(jump, name);
+                tagRule(jump);
+                rules.append(std::move(jump));
+                ruleset.section_chains.push_back(SectionChain{rule.table(), name, chain, rule.section()});
+            }
+            chain = name;
+        }
+
+        rules.append(rule);
+        size_t row = rules.size() - 1;
+        if (chain != rule.chain()) {
+            rules.setChain(row, chain);
+        }
+        if (!renamed.empty()) {
+            auto target = renamed.find(rule.target());
+            if (target != renamed.end()) {
+                rules.setTarget(row, target->second);
+            }
+        }
+    }
+    ruleset.rules = std::move(rules);
+}
+
+std::string RulesetCompiler::ruleTag(const CompiledRule& rule) {
+    // Only what the rule does identifies it; the comment is left out. Every
+    // token is hashed with its terminating NUL so neighbours cannot run together.
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const std::string& token) {
+        for (size_t i = 0; i <= token.size(); ++i) {
+            hash ^= static_cast<unsigned char>(token.c_str()[i]);
+            hash *= 1099511628211ull;
+        }
+    };
+    mix(rule.table);
+    mix(rule.chain);
+    for (size_t i = 0; i < rule.spec.size(); ++i) {
+        if (i == 0 || rule.spec[i - 1] != "--comment") {
+            mix(rule.spec[i]);
+        }
+    }
+
+    char tag[kRuleTagLength + 1];
+    std::snprintf(tag, sizeof(tag), "%s%s:%016llx", kRuleTagPrefix, sectionId(rule.section).c_str(),
+                  static_cast<unsigned long long>(hash));
+    return tag;
+}
+
+std::string RulesetCompiler::sectionId(const std::string& section) {
+    char id[9];
+    std::snprintf(id, sizeof(id), "%08x", fnv1a(section));
+    return id;
+}
+
+std::map<std::string, uint64_t> RulesetCompiler::sectionDigests(const CompiledRuleset& ruleset) {
+    // Tags already hash each rule's table, chain and spec; a section's digest chains them in order
+    std::map<std::string, uint64_t> digests;
+    for (const auto& rule : ruleset.rules) {
+        auto it = digests.emplace(rule.section(), 14695981039346656037ull).first;
+        for (unsigned char c : rule.comment()) {
+            it->second ^= c;
+            it->second *= 1099511628211ull;
+        }
+    }
+    return digests;
+}
+
+std::string RulesetCompiler::sectionChainName(const std::string& section, const std::string& parent,
+                                              const std::string& generation) {
+    std::string generation_suffix = generation.empty() ? "" : "." + generation;
+    // Hashed names keep a start sized for the longest suffix so all chains of a section match
+    return generatedChainName(section, "-" + parentSuffix(parent) + generation_suffix,
+                              std::strlen("-post") + generation_suffix.size());
+}
+
+bool RulesetCompiler::isSectionChain(const std::string& chain) {
+    return chain.compare(0, std::char_traits<char>::length(kSectionChainPrefix), kSectionChainPrefix) == 0;
+}
+
+const std::vector<std::string>& RulesetCompiler::builtinChains(const std::string& table) {
+    static const std::vector<std::string> filter = {"INPUT", "FORWARD", "OUTPUT"};
+    static const std::vector<std::string> nat = {"PREROUTING", "INPUT", "OUTPUT", "POSTROUTING"};
+    static const std::vector<std::string> mangle = {"PREROUTING", "INPUT", "FORWARD", "OUTPUT", "POSTROUTING"};
+    static const std::vector<std::string> raw = {"PREROUTING", "OUTPUT"};
+    static const std::vector<std::string> none;
+
+    if (table == "filter") return filter;
+    if (table == "nat") return nat;
+    if (table == "mangle") return mangle;
+    if (table == "raw") return raw;
+    return none;
+}
+
+bool RulesetCompiler::isBuiltinChain(const std::string& chain) {
+    return chain == "INPUT" || chain == "OUTPUT" || chain == "FORWARD" ||
+           chain == "PREROUTING" || chain == "POSTROUTING";
+}
+
+} // namespace iptables
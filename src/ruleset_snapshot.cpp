@@ -0,0 +1,373 @@
+#include "ruleset_snapshot.hpp"
+#include "command_executor.hpp"
+#include <iostream>
+#include <sstream>
+
+namespace iptables {
+
+namespace {
+
+const std::vector<SnapshotRule> kNoRules;
+
+// Split "[packets:bytes] rest" into its counter prefix and the rest
+void splitCounters(const std::string& line, std::string& counters, std::string& rest) {
+    if (!line.empty() && line[0] == '[') {
+        size_t end = line.find(']');
+        if (end != std::string::npos) {
+            counters = line.substr(0, end + 1);
+            size_t start = line.find_first_not_of(' ', end + 1);
+            rest = start == std::string::npos ? "" : line.substr(start);
+            return;
+        }
+    }
+    counters.clear();
+    rest = line;
+}
+
+} // namespace
+
+std::string SnapshotRule::toLine(const std::string& chain, bool with_counters) const {
+    std::string line;
+    line.reserve(counters.size() + chain.size() + spec.size() + 5);
+    if (with_counters && !counters.empty()) {
+        line += counters;
+        line += ' ';
+    }
+    line += "-A ";
+    line += chain;
+    if (!spec.empty()) {
+        line += ' ';
+        line += spec;
+    }
+    return line;
+}
+
+RulesetSnapshot RulesetSnapshot::parse(const std::string& dump) {
+    RulesetSnapshot snapshot;
+    Table* current = nullptr;
+
+    std::istringstream iss(dump);
+    std::string line;
+    while (std::getline(iss, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        if (line[0] == '*') {
+            current = &snapshot.ensureTable(line.substr(1));
+            continue;
+        }
+        if (current == nullptr || line == "COMMIT") {
+            continue;
+        }
+        if (line[0] == ':') {
+            // ":CHAIN POLICY [packets:bytes]"
+            std::istringstream decl(line.substr(1));
+            SnapshotChain chain;
+            std::string counters;
+            decl >> chain.name >> chain.policy >> counters;
+            if (!counters.empty()) {
+                chain.counters = counters;
+            }
+            auto it = current->by_name.find(chain.name);
+            if (it == current->by_name.end()) {
+                current->by_name[chain.name] = current->chains.size();
+                current->chains.push_back(std::move(chain));
+            } else {
+                current->chains[it->second].policy = chain.policy;
+                current->chains[it->second].counters = chain.counters;
+            }
+            continue;
+        }
+
+        std::string counters, rule;
+        splitCounters(line, counters, rule);
+        snapshot.addRule(*current, counters, rule);
+    }
+
+    return snapshot;
+}
+
+std::optional<RulesetSnapshot> RulesetSnapshot::capture() {
+    auto saved = CommandExecutor::saveRuleset();
+    if (!saved.isSuccess()) {
+        std::cerr << "Failed to read current ruleset: " << saved.getErrorMessage() << std::endl;
+        return std::nullopt;
+    }
+    return parse(saved.stdout_output);
+}
+
+std::string RulesetSnapshot::extractComment(const std::string& spec) {
+    size_t pos = spec.find("--comment ");
+    if (pos == std::string::npos) {
+        return "";
+    }
+    pos += 10;
+    std::string comment;
+    if (pos < spec.size() && spec[pos] == '"') {
+        for (++pos; pos < spec.size() && spec[pos] != '"'; ++pos) {
+            if (spec[pos] == '\\' && pos + 1 < spec.size()) {
+                ++pos;
+            }
+            comment += spec[pos];
+        }
+    } else {
+        comment = spec.substr(pos, spec.find(' ', pos) - pos);
+    }
+    return comment;
+}
+
+bool RulesetSnapshot::hasTable(const std::string& table) const {
+    return tables_.count(table) > 0;
+}
+
+bool RulesetSnapshot::hasChain(const std::string& table, const std::string& chain) const {
+    return findChain(table, chain) != nullptr;
+}
+
+const SnapshotChain* RulesetSnapshot::chain(const std::string& table, const std::string& chain) const {
+    return findChain(table, chain);
+}
+
+std::vector<std::string> RulesetSnapshot::chainNames(const std::string& table, bool user_defined_only) const {
+    std::vector<std::string> names;
+    auto it = tables_.find(table);
+    if (it == tables_.end()) {
+        return names;
+    }
+    for (const auto& chain : it->second.chains) {
+        if (!user_defined_only || chain.isUserDefined()) {
+            names.push_back(chain.name);
+        }
+    }
+    return names;
+}
+
+std::vector<uint32_t> RulesetSnapshot::findRules(const std::string& table, const std::string& chain,
+                                                 const std::string& comment) const {
+    std::vector<uint32_t> positions;
+    auto table_it = tables_.find(table);
+    if (table_it == tables_.end()) {
+        return positions;
+    }
+    auto chain_it = table_it->second.by_comment.find(chain);
+    if (chain_it == table_it->second.by_comment.end()) {
+        return positions;
+    }
+    auto comment_it = chain_it->second.find(comment);
+    if (comment_it == chain_it->second.end()) {
+        return positions;
+    }
+    positions.reserve(comment_it->second.size());
+    for (size_t index : comment_it->second) {
+        positions.push_back(static_cast<uint32_t>(index + 1));
+    }
+    return positions;
+}
+
+std::vector<uint32_t> RulesetSnapshot::findRulesWithPrefix(const std::string& table, const std::string& chain,
+                                                           const std::string& prefix) const {
+    std::vector<uint32_t> positions;
+    const SnapshotChain* found = findChain(table, chain);
+    if (found == nullptr) {
+        return positions;
+    }
+    for (size_t i = 0; i < found->rules.size(); ++i) {
+        if (found->rules[i].comment.compare(0, prefix.size(), prefix) == 0) {
+            positions.push_back(static_cast<uint32_t>(i + 1));
+        }
+    }
+    return positions;
+}
+
+std::string RulesetSnapshot::dump(bool with_counters) const {
+    std::string out;
+    for (const auto& name : table_order_) {
+        const Table& table = tables_.at(name);
+        out += "*" + name + "\n";
+        for (const auto& chain : table.chains) {
+            out += ":" + chain.name + " " + chain.policy + " " + (with_counters ? chain.counters : "[0:0]") + "\n";
+        }
+        for (const auto& chain : table.chains) {
+            for (const auto& rule : chain.rules) {
+                out += rule.toLine(chain.name, with_counters);
+                out += '\n';
+            }
+        }
+        out += "COMMIT\n";
+    }
+    return out;
+}
+
+bool RulesetSnapshot::createChain(const std::string& table, const std::string& chain) {
+    Table& contents = ensureTable(table);
+    if (contents.by_name.count(chain)) {
+        return false;
+    }
+    contents.by_name[chain] = contents.chains.size();
+    contents.chains.push_back(SnapshotChain{chain});
+    return true;
+}
+
+bool RulesetSnapshot::deleteChain(const std::string& table, const std::string& chain) {
+    auto table_it = tables_.find(table);
+    if (table_it == tables_.end()) {
+        return false;
+    }
+    Table& contents = table_it->second;
+    auto name_it = contents.by_name.find(chain);
+    if (name_it == contents.by_name.end()) {
+        return false;
+    }
+
+    contents.chains.erase(contents.chains.begin() + static_cast<std::ptrdiff_t>(name_it->second));
+    contents.by_comment.erase(chain);
+    contents.by_name.clear();
+    for (size_t i = 0; i < contents.chains.size(); ++i) {
+        contents.by_name[contents.chains[i].name] = i;
+    }
+    return true;
+}
+
+bool RulesetSnapshot::flushChain(const std::string& table, const std::string& chain) {
+    SnapshotChain* found = findChain(table, chain);
+    if (found == nullptr) {
+        return false;
+    }
+    found->rules.clear();
+    tables_.at(table).by_comment.erase(chain);
+    return true;
+}
+
+bool RulesetSnapshot::setPolicy(const std::string& table, const std::string& chain, const std::string& policy) {
+    SnapshotChain* found = findChain(table, chain);
+    if (found == nullptr || found->isUserDefined()) {
+        return false;
+    }
+    found->policy = policy;
+    return true;
+}
+
+bool RulesetSnapshot::appendRule(const std::string& table, const std::string& rule_line) {
+    auto it = tables_.find(table);
+    if (it == tables_.end()) {
+        return false;
+    }
+    return addRule(it->second, "[0:0]", rule_line);
+}
+
+bool RulesetSnapshot::insertRule(const std::string& table, const std::string& chain, uint32_t position,
+                                 const std::string& spec) {
+    SnapshotChain* found = findChain(table, chain);
+    if (found == nullptr || position == 0 || position > found->rules.size() + 1) {
+        return false;
+    }
+    SnapshotRule rule;
+    rule.counters = "[0:0]";
+    rule.spec = spec;
+    rule.comment = extractComment(spec);
+    if (position == found->rules.size() + 1) {
+        // Appending moves nothing, so the index only gains one entry
+        if (!rule.comment.empty()) {
+            tables_.at(table).by_comment[chain][rule.comment].push_back(found->rules.size());
+        }
+        found->rules.push_back(std::move(rule));
+        return true;
+    }
+    found->rules.insert(found->rules.begin() + (position - 1), std::move(rule));
+    // Every later rule moved down by one; rebuild this chain's index
+    reindexChain(tables_.at(table), *found);
+    return true;
+}
+
+bool RulesetSnapshot::deleteRule(const std::string& table, const std::string& chain, uint32_t position) {
+    SnapshotChain* found = findChain(table, chain);
+    if (found == nullptr || position == 0 || position > found->rules.size()) {
+        return false;
+    }
+    if (position == found->rules.size()) {
+        // Removing the last rule moves nothing; its index entry is the last of its comment
+        const std::string& comment = found->rules.back().comment;
+        if (!comment.empty()) {
+            auto& by_comment = tables_.at(table).by_comment[chain];
+            auto it = by_comment.find(comment);
+            if (it != by_comment.end()) {
+                it->second.pop_back();
+                if (it->second.empty()) {
+                    by_comment.erase(it);
+                }
+            }
+        }
+        found->rules.pop_back();
+        return true;
+    }
+    found->rules.erase(found->rules.begin() + (position - 1));
+    // Every later rule moved up by one; rebuild this chain's index
+    reindexChain(tables_.at(table), *found);
+    return true;
+}
+
+SnapshotChain* RulesetSnapshot::findChain(const std::string& table, const std::string& chain) {
+    auto table_it = tables_.find(table);
+    if (table_it == tables_.end()) {
+        return nullptr;
+    }
+    auto name_it = table_it->second.by_name.find(chain);
+    return name_it == table_it->second.by_name.end() ? nullptr : &table_it->second.chains[name_it->second];
+}
+
+const SnapshotChain* RulesetSnapshot::findChain(const std::string& table, const std::string& chain) const {
+    auto table_it = tables_.find(table);
+    if (table_it == tables_.end()) {
+        return nullptr;
+    }
+    auto name_it = table_it->second.by_name.find(chain);
+    return name_it == table_it->second.by_name.end() ? nullptr : &table_it->second.chains[name_it->second];
+}
+
+RulesetSnapshot::Table& RulesetSnapshot::ensureTable(const std::string& table) {
+    auto it = tables_.find(table);
+    if (it == tables_.end()) {
+        table_order_.push_back(table);
+        it = tables_.emplace(table, Table{}).first;
+    }
+    return it->second;
+}
+
+void RulesetSnapshot::reindexChain(Table& table, const SnapshotChain& chain) {
+    auto& index = table.by_comment[chain.name];
+    index.clear();
+    for (size_t i = 0; i < chain.rules.size(); ++i) {
+        if (!chain.rules[i].comment.empty()) {
+            index[chain.rules[i].comment].push_back(i);
+        }
+    }
+}
+
+bool RulesetSnapshot::addRule(Table& table, const std::string& counters, const std::string& line) {
+    // "-A CHAIN spec"
+    if (line.compare(0, 3, "-A ") != 0) {
+        return false;
+    }
+    size_t chain_end = line.find(' ', 3);
+    std::string chain_name = line.substr(3, chain_end == std::string::npos ? std::string::npos : chain_end - 3);
+    auto name_it = table.by_name.find(chain_name);
+    if (name_it == table.by_name.end()) {
+        return false;
+    }
+
+    SnapshotChain& chain = table.chains[name_it->second];
+    SnapshotRule rule;
+    rule.counters = counters;
+    rule.spec = chain_end == std::string::npos ? "" : line.substr(chain_end + 1);
+    rule.comment = extractComment(rule.spec);
+    if (!rule.comment.empty()) {
+        table.by_comment[chain_name][rule.comment].push_back(chain.rules.size());
+    }
+    chain.rules.push_back(std::move(rule));
+    return true;
+}
+
+} // namespace iptables
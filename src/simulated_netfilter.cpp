@@ -0,0 +1,659 @@
+#include "simulated_netfilter.hpp"
+#include "reconciler.hpp"
+#include <algorithm>
+#include <cctype>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <thread>
+
+namespace iptables {
+
+namespace {
+
+const std::set<std::string> kBuiltinTargets = {
+    "ACCEPT", "DROP", "REJECT", "RETURN", "LOG", "DNAT", "SNAT", "MASQUERADE", "REDIRECT",
+    "QUEUE", "NFQUEUE", "MARK", "CONNMARK", "TCPMSS", "NOTRACK", "CT", "TPROXY", "NFLOG"};
+
+const char* const kDefaultRuleset =
+    "*mangle\n"
+    ":PREROUTING ACCEPT [0:0]\n:INPUT ACCEPT [0:0]\n:FORWARD ACCEPT [0:0]\n"
+    ":OUTPUT ACCEPT [0:0]\n:POSTROUTING ACCEPT [0:0]\n"
+    "COMMIT\n"
+    "*nat\n"
+    ":PREROUTING ACCEPT [0:0]\n:INPUT ACCEPT [0:0]\n:OUTPUT ACCEPT [0:0]\n:POSTROUTING ACCEPT [0:0]\n"
+    "COMMIT\n"
+    "*filter\n"
+    ":INPUT ACCEPT [0:0]\n:FORWARD ACCEPT [0:0]\n:OUTPUT ACCEPT [0:0]\n"
+    "COMMIT\n";
+
+std::string baseName(const std::string& program) {
+    size_t slash = program.rfind('/');
+    return slash == std::string::npos ? program : program.substr(slash + 1);
+}
+
+bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool isNumber(const std::string& text) {
+    return !text.empty() && std::all_of(text.begin(), text.end(), [](unsigned char c) { return std::isdigit(c); });
+}
+
+CommandResult exitWith(int code, std::string out, std::string err) {
+    CommandResult result;
+    result.exit_code = code;
+    result.success = (code == 0);
+    result.stdout_output = std::move(out);
+    result.stderr_output = std::move(err);
+    return result;
+}
+
+// Drop the lock wait options, which have no meaning without a real lock
+std::vector<std::string> withoutWaitOptions(const std::vector<std::string>& args) {
+    std::vector<std::string> kept;
+    kept.reserve(args.size());
+    for (size_t i = 0; i < args.size(); ++i) {
+        const std::string& arg = args[i];
+        if (arg == "-w" || arg == "--wait" || arg == "-W" || arg == "--wait-interval") {
+            if (i + 1 < args.size() && isNumber(args[i + 1])) {
+                ++i;
+            }
+            continue;
+        }
+        if (arg.compare(0, 7, "--wait=") == 0 || arg.compare(0, 16, "--wait-interval=") == 0) {
+            continue;
+        }
+        kept.push_back(arg);
+    }
+    return kept;
+}
+
+// Quote a token the way iptables-save does when it contains blanks or quotes
+std::string quoteToken(const std::string& token) {
+    if (!token.empty() && token.find_first_of(" \t\"'") == std::string::npos) {
+        return token;
+    }
+    std::string quoted = "\"";
+    for (char c : token) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+        }
+        quoted += c;
+    }
+    quoted += '"';
+    return quoted;
+}
+
+std::string joinSpec(const std::vector<std::string>& tokens) {
+    std::string spec;
+    for (const auto& token : tokens) {
+        if (!spec.empty()) {
+            spec += ' ';
+        }
+        spec += quoteToken(token);
+    }
+    return spec;
+}
+
+// iptables turns "-s a,b" into one rule per address (and likewise for -d)
+std::vector<std::vector<std::string>> expandAddresses(const std::vector<std::string>& spec) {
+    std::vector<std::vector<std::string>> rules = {spec};
+    for (size_t i = 0; i + 1 < spec.size(); ++i) {
+        bool address = spec[i] == "-s" || spec[i] == "--source" || spec[i] == "-d" || spec[i] == "--destination";
+        if (!address || spec[i + 1].find(',') == std::string::npos) {
+            continue;
+        }
+        std::vector<std::string> values;
+        std::istringstream list(spec[i + 1]);
+        std::string value;
+        while (std::getline(list, value, ',')) {
+            values.push_back(value);
+        }
+        std::vector<std::vector<std::string>> expanded;
+        for (const auto& rule : rules) {
+            for (const auto& value : values) {
+                expanded.push_back(rule);
+                expanded.back()[i + 1] = value;
+            }
+        }
+        rules = std::move(expanded);
+    }
+    return rules;
+}
+
+std::string optionValue(const std::vector<std::string>& spec, std::initializer_list<const char*> names,
+                        const std::string& fallback) {
+    for (size_t i = 0; i + 1 < spec.size(); ++i) {
+        for (const char* name : names) {
+            if (spec[i] == name) {
+                return spec[i + 1];
+            }
+        }
+    }
+    return fallback;
+}
+
+// Chains of a table that some rule jumps to
+size_t countReferences(const RulesetSnapshot& state, const std::string& table, const std::string& target) {
+    size_t references = 0;
+    for (const auto& name : state.chainNames(table)) {
+        for (const auto& rule : state.chain(table, name)->rules) {
+            if (Reconciler::jumpTarget(rule.spec) == target) {
+                ++references;
+            }
+        }
+    }
+    return references;
+}
+
+// One rule in "iptables -L -n -v --line-numbers" layout
+std::string listLine(size_t number, const SnapshotRule& rule) {
+    std::vector<std::string> spec = Reconciler::tokenize(rule.spec);
+    std::ostringstream line;
+    line << std::left << std::setw(4) << number << std::right << std::setw(8) << 0 << std::setw(6) << 0 << ' '
+         << std::left << std::setw(10) << Reconciler::jumpTarget(spec) << ' '
+         << std::setw(4) << optionValue(spec, {"-p", "--protocol"}, "all") << " --  "
+         << std::setw(6) << optionValue(spec, {"-i", "--in-interface"}, "*") << ' '
+         << std::setw(6) << optionValue(spec, {"-o", "--out-interface"}, "*") << ' '
+         << std::setw(20) << optionValue(spec, {"-s", "--source"}, "0.0.0.0/0") << ' '
+         << std::setw(20) << optionValue(spec, {"-d", "--destination"}, "0.0.0.0/0");
+    if (!rule.comment.empty()) {
+        line << " /* " << rule.comment << " */";
+    }
+    return line.str();
+}
+
+} // namespace
+
+std::string SimulationStatistics::summary() const {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1)
+        << "Simulated netfilter: " << processes << " process(es)";
+    if (!programs.empty()) {
+        out << " (";
+        bool first = true;
+        for (const auto& [program, count] : programs) {
+            out << (first ? "" : ", ") << program << " " << count;
+            first = false;
+        }
+        out << ")";
+    }
+    out << ", " << operations << " operation(s), " << failures << " failed, "
+        << latency_seconds * 1000.0 << " ms simulated latency";
+    return out.str();
+}
+
+SimulatedNetfilter::SimulatedNetfilter(RulesetSnapshot initial)
+    : state_(std::move(initial)) {
+}
+
+RulesetSnapshot SimulatedNetfilter::defaultRuleset() {
+    return RulesetSnapshot::parse(kDefaultRuleset);
+}
+
+RulesetSnapshot SimulatedNetfilter::ruleset() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return state_;
+}
+
+SimulationStatistics SimulatedNetfilter::statistics() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return statistics_;
+}
+
+CommandResult SimulatedNetfilter::run(const std::vector<std::string>& argv, const std::string& input,
+                                      const ExecutionLimits& limits) {
+    if (argv.empty()) {
+        return exitWith(127, "", "No command specified");
+    }
+
+    // Start-up latency is spent outside the lock, like a process that has not reached it yet
+    if (latency_.count() > 0) {
+        auto wake = std::chrono::steady_clock::now() + latency_;
+        std::this_thread::sleep_until(std::min(wake, limits.deadline));
+    }
+    if (limits.expired()) {
+        CommandResult result = exitWith(137, "", "Deadline exceeded; process group killed");
+        result.timed_out = true;
+        return result;
+    }
+
+    std::string program = baseName(argv[0]);
+    std::vector<std::string> args = withoutWaitOptions({argv.begin() + 1, argv.end()});
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    CommandResult result;
+    if (endsWith(program, "-restore")) {
+        result = runRestore(args, input);
+    } else if (endsWith(program, "-save")) {
+        result = runSave(args);
+    } else if (program.compare(0, 8, "iptables") == 0) {
+        result = runIptables(args);
+    } else {
+        result = exitWith(127, "", "Failed to start " + argv[0] + ": not simulated");
+    }
+
+    statistics_.processes++;
+    statistics_.programs[program]++;
+    statistics_.latency_seconds += std::chrono::duration<double>(latency_).count();
+    if (!result.success) {
+        statistics_.failures++;
+    }
+    return result;
+}
+
+CommandResult SimulatedNetfilter::runIptables(const std::vector<std::string>& args) {
+    if (!args.empty() && (args[0] == "--version" || args[0] == "-V")) {
+        return exitWith(0, "iptables v1.8.9 (simulated)", "");
+    }
+
+    // "-t TABLE" may appear anywhere before or after the command
+    std::string table = "filter";
+    std::vector<std::string> command;
+    for (size_t i = 0; i < args.size(); ++i) {
+        if ((args[i] == "-t" || args[i] == "--table") && i + 1 < args.size()) {
+            table = args[++i];
+        } else {
+            command.push_back(args[i]);
+        }
+    }
+    if (command.empty()) {
+        return exitWith(2, "", "iptables v1.8.9 (simulated): no command specified");
+    }
+
+    std::string output;
+    uint64_t operations = 0;
+    std::string error = apply(state_, table, command, output, operations);
+    if (!error.empty()) {
+        return exitWith(1, "", "iptables: " + error);
+    }
+    statistics_.operations += operations;
+    return exitWith(0, output, "");
+}
+
+CommandResult SimulatedNetfilter::runSave(const std::vector<std::string>& args) const {
+    bool counters = false;
+    std::string only_table;
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] == "-c" || args[i] == "--counters") {
+            counters = true;
+        } else if ((args[i] == "-t" || args[i] == "--table") && i + 1 < args.size()) {
+            only_table = args[++i];
+        }
+    }
+
+    std::string tables = state_.dump(counters);
+    if (!only_table.empty()) {
+        size_t start = tables.find("*" + only_table + "\n");
+        if (start == std::string::npos) {
+            return exitWith(1, "", "iptables-save: table '" + only_table + "' does not exist");
+        }
+        tables = tables.substr(start, tables.find("COMMIT\n", start) + 7 - start);
+    }
+    return exitWith(0, "# Generated by iptables-save v1.8.9 (simulated)\n" + tables, "");
+}
+
+CommandResult SimulatedNetfilter::runRestore(const std::vector<std::string>& args, const std::string& input) {
+    bool noflush = false;
+    bool test_only = false;
+    for (const auto& arg : args) {
+        if (arg == "-n" || arg == "--noflush") {
+            noflush = true;
+        } else if (arg == "-t" || arg == "--test") {
+            test_only = true;
+        }
+    }
+
+    // Every table commits atomically: work on a copy and keep it only at COMMIT
+    RulesetSnapshot committed = state_;
+    RulesetSnapshot work = committed;
+    uint64_t committed_operations = 0;
+    uint64_t pending_operations = 0;
+    std::string table;
+    size_t line_number = 0;
+
+    auto fail = [&](size_t line) {
+        if (!test_only) {
+            state_ = std::move(committed);
+        }
+        statistics_.operations += committed_operations;
+        return exitWith(1, "", "iptables-restore: line " + std::to_string(line) + " failed");
+    };
+
+    std::istringstream lines(input);
+    std::string line;
+    while (std::getline(lines, line)) {
+        ++line_number;
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#') {
+            continue;
+        }
+        line = line.substr(start);
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) {
+            line.pop_back();
+        }
+
+        if (line[0] == '*') {
+            if (!table.empty()) {
+                return fail(line_number);
+            }
+            table = line.substr(1);
+            if (!work.hasTable(table)) {
+                return fail(line_number);
+            }
+            if (!noflush) {
+                for (const auto& chain : work.chainNames(table)) {
+                    work.flushChain(table, chain);
+                }
+                for (const auto& chain : work.chainNames(table, true)) {
+                    work.deleteChain(table, chain);
+                }
+            }
+            continue;
+        }
+        if (table.empty()) {
+            return fail(line_number);
+        }
+        if (line == "COMMIT") {
+            committed = work;
+            committed_operations += pending_operations;
+            pending_operations = 0;
+            table.clear();
+            continue;
+        }
+        if (line[0] == ':') {
+            // ":CHAIN POLICY [packets:bytes]"
+            std::istringstream declaration(line.substr(1));
+            std::string chain, policy;
+            declaration >> chain >> policy;
+            const SnapshotChain* existing = work.chain(table, chain);
+            if (existing && !existing->isUserDefined()) {
+                if (policy != "-" && !work.setPolicy(table, chain, policy)) {
+                    return fail(line_number);
+                }
+            } else if (existing) {
+                // Declaring an existing user chain under --noflush empties it
+                work.flushChain(table, chain);
+            } else {
+                work.createChain(table, chain);
+            }
+            ++pending_operations;
+            continue;
+        }
+        if (line[0] == '[') {
+            // "[packets:bytes] -A ..." with --counters
+            size_t end = line.find("] ");
+            line = end == std::string::npos ? line : line.substr(end + 2);
+        }
+
+        std::string output;
+        if (!apply(work, table, Reconciler::tokenize(line), output, pending_operations).empty()) {
+            return fail(line_number);
+        }
+    }
+
+    if (!table.empty()) {
+        // Input ended inside a table block
+        return fail(line_number);
+    }
+    if (!test_only) {
+        state_ = std::move(committed);
+    }
+    statistics_.operations += committed_operations;
+    return exitWith(0, "", "");
+}
+
+std::optional<uint64_t> SimulatedNetfilter::rulesetFingerprint(const std::vector<std::string>& tables) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // FNV-1a over each table's contents as iptables-save prints them without counters
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&hash](const std::string& text) {
+        for (unsigned char c : text) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+    };
+    for (const auto& table : tables) {
+        add("*" + table + "\n");
+        for (const auto& name : state_.chainNames(table)) {
+            const SnapshotChain* chain = state_.chain(table, name);
+            add(":" + name + " " + chain->policy + "\n");
+            for (const auto& rule : chain->rules) {
+                add(rule.toLine(name, false) + "\n");
+            }
+        }
+    }
+    return hash;
+}
+
+std::optional<bool> SimulatedNetfilter::rulesetEmpty(const std::vector<std::string>& tables) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& table : tables) {
+        for (const auto& name : state_.chainNames(table)) {
+            const SnapshotChain* chain = state_.chain(table, name);
+            if (chain->isUserDefined() || !chain->rules.empty()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+std::string SimulatedNetfilter::apply(RulesetSnapshot& state, const std::string& table,
+                                      const std::vector<std::string>& args, std::string& output,
+                                      uint64_t& operations) {
+    if (args.empty()) {
+        return "no command specified";
+    }
+    if (!state.hasTable(table)) {
+        return "can't initialize iptables table `" + table + "': Table does not exist";
+    }
+    const std::string& command = args[0];
+    std::string chain = args.size() > 1 ? args[1] : "";
+    const SnapshotChain* existing = chain.empty() ? nullptr : state.chain(table, chain);
+    static const std::string kNoChain = "No chain/target/match by that name.";
+
+    auto checkTarget = [&](const std::vector<std::string>& spec) -> std::string {
+        std::string target = Reconciler::jumpTarget(spec);
+        if (target.empty() || kBuiltinTargets.count(target) || state.hasChain(table, target)) {
+            return "";
+        }
+        return "Couldn't load target `" + target + "':No such file or directory";
+    };
+
+    if (command == "-A" || command == "--append" || command == "-I" || command == "--insert") {
+        if (!existing) {
+            return kNoChain;
+        }
+        bool insert = (command == "-I" || command == "--insert");
+        size_t first = 2;
+        uint32_t position = static_cast<uint32_t>(existing->rules.size()) + 1;
+        if (insert) {
+            position = 1;
+            if (args.size() > 2 && isNumber(args[2])) {
+                position = static_cast<uint32_t>(std::stoul(args[2]));
+                first = 3;
+            }
+            if (position == 0 || position > existing->rules.size() + 1) {
+                return "Index of insertion too big.";
+            }
+        }
+        std::vector<std::string> spec(args.begin() + static_cast<std::ptrdiff_t>(first), args.end());
+        std::string error = checkTarget(spec);
+        if (!error.empty()) {
+            return error;
+        }
+        for (const auto& rule : expandAddresses(spec)) {
+            state.insertRule(table, chain, position++, joinSpec(rule));
+            operations++;
+        }
+        return "";
+    }
+
+    if (command == "-R" || command == "--replace") {
+        if (!existing) {
+            return kNoChain;
+        }
+        if (args.size() < 3 || !isNumber(args[2])) {
+            return "option \"-R\" requires a rule number";
+        }
+        auto position = static_cast<uint32_t>(std::stoul(args[2]));
+        if (position == 0 || position > existing->rules.size()) {
+            return "Index of replacement too big.";
+        }
+        std::vector<std::string> spec(args.begin() + 3, args.end());
+        std::string error = checkTarget(spec);
+        if (!error.empty()) {
+            return error;
+        }
+        auto rules = expandAddresses(spec);
+        if (rules.size() != 1) {
+            return "multiple source or destination IP addresses not allowed";
+        }
+        state.deleteRule(table, chain, position);
+        state.insertRule(table, chain, position, joinSpec(rules.front()));
+        operations++;
+        return "";
+    }
+
+    if (command == "-D" || command == "--delete" || command == "-C" || command == "--check") {
+        if (!existing) {
+            return kNoChain;
+        }
+        bool check = (command == "-C" || command == "--check");
+        if (!check && args.size() == 3 && isNumber(args[2])) {
+            if (!state.deleteRule(table, chain, static_cast<uint32_t>(std::stoul(args[2])))) {
+                return "Index of deletion too big.";
+            }
+            operations++;
+            return "";
+        }
+        std::vector<std::string> spec(args.begin() + 2, args.end());
+        for (const auto& rule : expandAddresses(spec)) {
+            std::string wanted = Reconciler::canonicalRule(rule);
+            const auto& rules = state.chain(table, chain)->rules;
+            auto found = std::find_if(rules.begin(), rules.end(), [&](const SnapshotRule& candidate) {
+                return Reconciler::canonicalRule(Reconciler::tokenize(candidate.spec)) == wanted;
+            });
+            if (found == rules.end()) {
+                return "Bad rule (does a matching rule exist in that chain?).";
+            }
+            if (!check) {
+                state.deleteRule(table, chain, static_cast<uint32_t>(found - rules.begin()) + 1);
+                operations++;
+            }
+        }
+        return "";
+    }
+
+    if (command == "-N" || command == "--new-chain") {
+        if (chain.empty()) {
+            return "option \"-N\" requires an argument";
+        }
+        if (existing) {
+            return "Chain already exists.";
+        }
+        state.createChain(table, chain);
+        operations++;
+        return "";
+    }
+
+    if (command == "-X" || command == "--delete-chain") {
+        std::vector<std::string> chains = chain.empty() ? state.chainNames(table, true)
+                                                        : std::vector<std::string>{chain};
+        for (const auto& name : chains) {
+            const SnapshotChain* target = state.chain(table, name);
+            if (!target) {
+                return kNoChain;
+            }
+            if (!target->isUserDefined()) {
+                return "Can't delete built-in chain " + name;
+            }
+            if (!target->rules.empty()) {
+                return "Directory not empty.";
+            }
+            if (countReferences(state, table, name) > 0) {
+                return "Too many links.";
+            }
+        }
+        for (const auto& name : chains) {
+            state.deleteChain(table, name);
+            operations++;
+        }
+        return "";
+    }
+
+    if (command == "-F" || command == "--flush") {
+        if (!chain.empty() && !existing) {
+            return kNoChain;
+        }
+        std::vector<std::string> chains = chain.empty() ? state.chainNames(table)
+                                                        : std::vector<std::string>{chain};
+        for (const auto& name : chains) {
+            state.flushChain(table, name);
+            operations++;
+        }
+        return "";
+    }
+
+    if (command == "-P" || command == "--policy") {
+        if (args.size() < 3) {
+            return "-P requires a chain and a policy";
+        }
+        if (!existing) {
+            return "Bad built-in chain name.";
+        }
+        if (args[2] != "ACCEPT" && args[2] != "DROP") {
+            return "Bad policy name.";
+        }
+        if (!state.setPolicy(table, chain, args[2])) {
+            return "Bad built-in chain name.";
+        }
+        operations++;
+        return "";
+    }
+
+    if (command == "-L" || command == "--list" || command == "-S" || command == "--list-rules") {
+        bool rules_format = (command == "-S" || command == "--list-rules");
+        if (!chain.empty() && chain[0] == '-') {
+            chain.clear();
+        }
+        if (!chain.empty() && !state.hasChain(table, chain)) {
+            return kNoChain;
+        }
+        std::vector<std::string> chains = chain.empty() ? state.chainNames(table)
+                                                        : std::vector<std::string>{chain};
+        std::ostringstream out;
+        for (const auto& name : chains) {
+            const SnapshotChain* listed = state.chain(table, name);
+            if (rules_format) {
+                out << (listed->isUserDefined() ? "-N " + name : "-P " + name + " " + listed->policy) << '\n';
+                for (const auto& rule : listed->rules) {
+                    out << rule.toLine(name, false) << '\n';
+                }
+                continue;
+            }
+            if (listed->isUserDefined()) {
+                out << "Chain " << name << " (" << countReferences(state, table, name) << " references)\n";
+            } else {
+                out << "Chain " << name << " (policy " << listed->policy << " 0 packets, 0 bytes)\n";
+            }
+            out << "num   pkts bytes target     prot opt in     out     source               destination\n";
+            for (size_t i = 0; i < listed->rules.size(); ++i) {
+                out << listLine(i + 1, listed->rules[i]) << '\n';
+            }
+            out << '\n';
+        }
+        output = out.str();
+        return "";
+    }
+
+    if (command == "-Z" || command == "--zero") {
+        return "";
+    }
+
+    return "unknown command " + command;
+}
+
+} // namespace iptables
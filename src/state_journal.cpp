@@ -0,0 +1,269 @@
+#include "state_journal.hpp"
+#include "command_executor.hpp"
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/netfilter_ipv4/ip_tables.h>
+
+namespace iptables {
+
+namespace {
+
+std::filesystem::path g_path = StateJournal::kDefaultPath;
+
+constexpr uint64_t kFnvOffset = 14695981039346656037ull;
+
+uint64_t fnv1a(uint64_t hash, const void* data, size_t size) {
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// The nf_tables variant keeps its rules where the legacy socket options cannot see them
+bool usesLegacyIptables() {
+    const char* path = std::getenv("PATH");
+    std::istringstream dirs(path ? path : "/usr/sbin:/usr/bin:/sbin:/bin");
+    std::string dir;
+    while (std::getline(dirs, dir, ':')) {
+        std::filesystem::path candidate = std::filesystem::path(dir.empty() ? "." : dir) / "iptables";
+        if (access(candidate.c_str(), X_OK) != 0) {
+            continue;
+        }
+        std::error_code error;
+        std::string target = std::filesystem::canonical(candidate, error).filename().string();
+        return !error && target.find("nft") == std::string::npos;
+    }
+    return false;
+}
+
+// Hash one table's rule blob as the kernel holds it, skipping the counters of every entry
+bool fingerprintTable(int fd, const std::string& table, uint64_t& hash) {
+    ipt_getinfo info{};
+    std::strncpy(info.name, table.c_str(), sizeof(info.name) - 1);
+    socklen_t length = sizeof(info);
+    if (getsockopt(fd, IPPROTO_IP, IPT_SO_GET_INFO, &info, &length) != 0) {
+        return false;
+    }
+
+    std::vector<char> buffer(sizeof(ipt_get_entries) + info.size);
+    auto* entries = reinterpret_cast<ipt_get_entries*>(buffer.data());
+    std::strncpy(entries->name, table.c_str(), sizeof(entries->name) - 1);
+    entries->size = info.size;
+    length = static_cast<socklen_t>(buffer.size());
+    if (getsockopt(fd, IPPROTO_IP, IPT_SO_GET_ENTRIES, entries, &length) != 0) {
+        return false;
+    }
+
+    hash = fnv1a(hash, table.data(), table.size());
+    hash = fnv1a(hash, info.hook_entry, sizeof(info.hook_entry));
+    hash = fnv1a(hash, info.underflow, sizeof(info.underflow));
+    const char* blob = reinterpret_cast<const char*>(entries->entrytable);
+    for (size_t offset = 0; offset + sizeof(ipt_entry) <= info.size;) {
+        const auto* entry = reinterpret_cast<const ipt_entry*>(blob + offset);
+        if (entry->next_offset < sizeof(ipt_entry) || offset + entry->next_offset > info.size) {
+            return false;
+        }
+        size_t counters = offsetof(ipt_entry, counters);
+        size_t after_counters = counters + sizeof(entry->counters);
+        hash = fnv1a(hash, entry, counters);
+        hash = fnv1a(hash, blob + offset + after_counters, entry->next_offset - after_counters);
+        offset += entry->next_offset;
+    }
+    return true;
+}
+
+} // namespace
+
+void StateJournal::setPath(const std::filesystem::path& path) {
+    g_path = path;
+}
+
+const std::filesystem::path& StateJournal::path() {
+    return g_path;
+}
+
+std::optional<uint64_t> StateJournal::fingerprint(const std::vector<std::string>& tables) {
+    if (CommandRunner* runner = CommandExecutor::runner()) {
+        return runner->rulesetFingerprint(tables);
+    }
+    if (!usesLegacyIptables()) {
+        return std::nullopt;
+    }
+
+    int fd = socket(AF_INET, SOCK_RAW, IPPROTO_RAW);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+    uint64_t hash = kFnvOffset;
+    bool complete = true;
+    for (const auto& table : tables) {
+        if (!fingerprintTable(fd, table, hash)) {
+            complete = false;
+            break;
+        }
+    }
+    close(fd);
+    return complete ? std::optional<uint64_t>(hash) : std::nullopt;
+}
+
+std::optional<bool> StateJournal::isEmpty(const std::vector<std::string>& tables) {
+    if (CommandRunner* runner = CommandExecutor::runner()) {
+        return runner->rulesetEmpty(tables);
+    }
+    if (!usesLegacyIptables()) {
+        // iptables-nft has no such socket option; one listing answers instead
+        std::optional<RulesetSnapshot> live = RulesetSnapshot::capture();
+        if (!live) {
+            return std::nullopt;
+        }
+        for (const auto& table : tables) {
+            for (const auto& name : live->chainNames(table)) {
+                const SnapshotChain* chain = live->chain(table, name);
+                if (chain->isUserDefined() || !chain->rules.empty()) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    int fd = socket(AF_INET, SOCK_RAW, IPPROTO_RAW);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+    std::optional<bool> empty = true;
+    for (const auto& table : tables) {
+        ipt_getinfo info{};
+        std::strncpy(info.name, table.c_str(), sizeof(info.name) - 1);
+        socklen_t length = sizeof(info);
+        if (getsockopt(fd, IPPROTO_IP, IPT_SO_GET_INFO, &info, &length) != 0) {
+            // A table nobody has used yet is not even loaded
+            if (errno != ENOENT) {
+                empty = std::nullopt;
+                break;
+            }
+            continue;
+        }
+        // An empty table has one policy entry per hook plus the terminating error entry
+        unsigned int builtin = static_cast<unsigned int>(__builtin_popcount(info.valid_hooks)) + 1;
+        if (info.num_entries != builtin) {
+            empty = false;
+            break;
+        }
+    }
+    close(fd);
+    return empty;
+}
+
+std::optional<RulesetSnapshot> StateJournal::recall() {
+    std::ifstream in(g_path);
+    std::string line;
+    if (!in || !std::getline(in, line) || line.compare(0, 12, "fingerprint ") != 0) {
+        return std::nullopt;
+    }
+    uint64_t recorded = std::strtoull(line.c_str() + 12, nullptr, 16);
+    std::ostringstream dump;
+    dump << in.rdbuf();
+
+    RulesetSnapshot snapshot = RulesetSnapshot::parse(dump.str());
+    std::optional<uint64_t> current = fingerprint(snapshot.tables());
+    if (!current || *current != recorded) {
+        return std::nullopt;
+    }
+    return snapshot;
+}
+
+bool StateJournal::record(const RulesetSnapshot& snapshot, const JournalIndex& index, std::optional<uint64_t> before) {
+    std::optional<uint64_t> current = fingerprint(snapshot.tables());
+    if (!current) {
+        discard();
+        return true;
+    }
+    if (before && *before != *current) {
+        discard();
+        return false;
+    }
+
+    std::error_code error;
+    if (g_path.has_parent_path()) {
+        std::filesystem::create_directories(g_path.parent_path(), error);
+    }
+    // A reader must never see half a journal; rename() replaces it atomically
+    std::filesystem::path temporary = g_path;
+    temporary += ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::trunc);
+        char fingerprint_text[17];
+        std::snprintf(fingerprint_text, sizeof(fingerprint_text), "%016llx",
+                      static_cast<unsigned long long>(*current));
+        out << "fingerprint " << fingerprint_text << "\n";
+        for (const auto& [tag, description] : index.descriptions) {
+            if (description.find('\n') == std::string::npos) {
+                out << "# tag " << tag << " " << description << "\n";
+            }
+        }
+        for (const auto& [section, digest] : index.sections) {
+            if (section.find('\n') == std::string::npos) {
+                char digest_text[17];
+                std::snprintf(digest_text, sizeof(digest_text), "%016llx", static_cast<unsigned long long>(digest));
+                out << "# section " << digest_text << " " << section << "\n";
+            }
+        }
+        out << snapshot.dump(false);
+        if (!out.flush()) {
+            std::cerr << "Warning: failed to write state journal " << temporary.string() << std::endl;
+            std::filesystem::remove(temporary, error);
+            discard();
+            return false;
+        }
+    }
+    std::filesystem::rename(temporary, g_path, error);
+    if (error) {
+        std::cerr << "Warning: failed to write state journal " << g_path.string() << ": " << error.message()
+                  << std::endl;
+        std::filesystem::remove(temporary, error);
+        discard();
+        return false;
+    }
+    return true;
+}
+
+JournalIndex StateJournal::index() {
+    JournalIndex result;
+    std::ifstream in(g_path);
+    std::string line;
+    // The index sits between the fingerprint and the ruleset
+    while (std::getline(in, line) && (line.compare(0, 2, "# ") == 0 || line.compare(0, 12, "fingerprint ") == 0)) {
+        size_t key = line.find(' ', 2);
+        size_t value = key == std::string::npos ? key : line.find(' ', key + 1);
+        if (value == std::string::npos) {
+            continue;
+        }
+        std::string kind = line.substr(2, key - 2);
+        std::string first = line.substr(key + 1, value - key - 1);
+        if (kind == "tag") {
+            result.descriptions[first] = line.substr(value + 1);
+        } else if (kind == "section") {
+            result.sections[line.substr(value + 1)] = std::strtoull(first.c_str(), nullptr, 16);
+        }
+    }
+    return result;
+}
+
+void StateJournal::discard() {
+    std::error_code error;
+    std::filesystem::remove(g_path, error);
+}
+
+} // namespace iptables
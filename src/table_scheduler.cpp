@@ -0,0 +1,70 @@
+#include "table_scheduler.hpp"
+#include <exception>
+#include <sstream>
+#include <thread>
+
+namespace iptables {
+
+namespace {
+
+struct WorkerOutput {
+    std::ostringstream out;
+    std::ostringstream err;
+    bool success = true;
+};
+
+void runTasks(const std::string& table, const std::vector<TableScheduler::Task>& tasks, WorkerOutput& output) {
+    for (const auto& task : tasks) {
+        try {
+            if (!task(output.out, output.err)) {
+                output.success = false;
+            }
+        } catch (const std::exception& e) {
+            output.err << "Error while changing table " << table << ": " << e.what() << std::endl;
+            output.success = false;
+        }
+    }
+}
+
+} // namespace
+
+void TableScheduler::add(const std::string& table, Task task) {
+    for (auto& workload : workloads_) {
+        if (workload.table == table) {
+            workload.tasks.push_back(std::move(task));
+            return;
+        }
+    }
+    workloads_.push_back(Workload{table, {std::move(task)}});
+}
+
+bool TableScheduler::run(std::ostream& out, std::ostream& err) {
+    std::vector<WorkerOutput> outputs(workloads_.size());
+
+    if (workloads_.size() == 1) {
+        runTasks(workloads_[0].table, workloads_[0].tasks, outputs[0]);
+    } else {
+        std::vector<std::thread> workers;
+        workers.reserve(workloads_.size());
+        for (size_t i = 0; i < workloads_.size(); ++i) {
+            workers.emplace_back(runTasks, std::cref(workloads_[i].table),
+                                 std::cref(workloads_[i].tasks), std::ref(outputs[i]));
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    bool success = true;
+    for (const auto& output : outputs) {
+        out << output.out.str();
+        err << output.err.str();
+        success = success && output.success;
+    }
+    out << std::flush;
+
+    workloads_.clear();
+    return success;
+}
+
+} // namespace iptables
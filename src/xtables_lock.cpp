@@ -0,0 +1,97 @@
+#include "xtables_lock.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <sys/file.h>
+#include <thread>
+#include <unistd.h>
+
+namespace iptables {
+
+namespace {
+
+std::mutex g_statistics_mutex;
+LockStatistics g_statistics;
+
+// Interval between non-blocking probes while the lock is held
+constexpr auto kProbeInterval = std::chrono::milliseconds(1);
+
+} // namespace
+
+std::string LockStatistics::summary() const {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1)
+        << "xtables lock: " << commands << " command(s), "
+        << wait_seconds * 1000.0 << " ms waiting (" << contended << " contended, "
+        << retries << " retr" << (retries == 1 ? "y" : "ies") << "), "
+        << work_seconds * 1000.0 << " ms working";
+    return out.str();
+}
+
+LockStatistics LockStatistics::since(const LockStatistics& earlier) const {
+    LockStatistics delta;
+    delta.commands = commands - earlier.commands;
+    delta.contended = contended - earlier.contended;
+    delta.retries = retries - earlier.retries;
+    delta.wait_seconds = wait_seconds - earlier.wait_seconds;
+    delta.work_seconds = work_seconds - earlier.work_seconds;
+    return delta;
+}
+
+std::string XtablesLock::lockPath() {
+    const char* path = std::getenv("XTABLES_LOCKFILE");
+    return (path && *path) ? path : "/run/xtables.lock";
+}
+
+double XtablesLock::waitUntilFree(const ExecutionLimits& limits) {
+    int fd = open(lockPath().c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        // No lock file means no iptables process has ever taken the lock
+        return 0.0;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::seconds(kWaitSeconds);
+    bool contended = false;
+    // Poll rather than block so a stuck holder cannot hang us beyond --wait
+    while (flock(fd, LOCK_SH | LOCK_NB) != 0) {
+        contended = true;
+        if (std::chrono::steady_clock::now() >= deadline || limits.expired()) {
+            break;
+        }
+        std::this_thread::sleep_for(kProbeInterval);
+    }
+    flock(fd, LOCK_UN);
+    close(fd);
+
+    if (!contended) {
+        return 0.0;
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void XtablesLock::record(double wait_seconds, double work_seconds, uint64_t retries) {
+    std::lock_guard<std::mutex> lock(g_statistics_mutex);
+    g_statistics.commands++;
+    if (wait_seconds > 0.0) {
+        g_statistics.contended++;
+    }
+    g_statistics.retries += retries;
+    g_statistics.wait_seconds += wait_seconds;
+    g_statistics.work_seconds += work_seconds;
+}
+
+LockStatistics XtablesLock::statistics() {
+    std::lock_guard<std::mutex> lock(g_statistics_mutex);
+    return g_statistics;
+}
+
+void XtablesLock::reset() {
+    std::lock_guard<std::mutex> lock(g_statistics_mutex);
+    g_statistics = LockStatistics{};
+}
+
+} // namespace iptables
@@ -0,0 +1,198 @@
+/**
+ * @file config_reader_test.cpp
+ * @brief Differential test of ConfigReader against YAML::Load and convert
+ * @author iptables-compose-cpp Development Team
+ * @date 2024
+ *
+ * ConfigReader promises the Config, and the error, that decoding a node
+ * tree with YAML::convert<Config> gives. Every document here is decoded
+ * both ways and the outcomes compared: the configuration re-encoded as
+ * YAML, or the exception text with its line and column.
+ */
+
+#include "config_reader.hpp"
+#include "test_support.hpp"
+#include <yaml-cpp/yaml.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using iptables::Config;
+using iptables::ConfigReader;
+
+namespace fs = std::filesystem;
+
+// Everything a decoded Config holds, as text
+std::string describe(const Config& config) {
+    // encode() leaves out chain definitions, which decode() moves aside
+    YAML::Node node = YAML::convert<Config>::encode(config);
+    for (const auto& [name, chain] : config.chain_definitions) {
+        node["chain definitions"][name] = chain;
+    }
+    return YAML::Dump(node);
+}
+
+// Outcome of one decode: the configuration, or the error it stopped at
+struct Outcome {
+    bool ok = false;
+    std::string text;
+};
+
+Outcome viaReader(const std::string& yaml) {
+    Outcome outcome;
+    try {
+        std::istringstream input(yaml);
+        outcome.text = describe(ConfigReader::read(input));
+        outcome.ok = true;
+    } catch (const YAML::Exception& e) {
+        outcome.text = e.what();
+    }
+    return outcome;
+}
+
+Outcome viaNodes(const std::string& yaml) {
+    Outcome outcome;
+    try {
+        outcome.text = describe(YAML::Load(yaml).as<Config>());
+        outcome.ok = true;
+    } catch (const YAML::Exception& e) {
+        outcome.text = e.what();
+    }
+    return outcome;
+}
+
+/**
+ * @brief Decode a document both ways and compare
+ * @param name Shown when the outcomes differ
+ * @param yaml Document text
+ * @return The reader's outcome, for further checks
+ */
+Outcome compare(const std::string& name, const std::string& yaml) {
+    Outcome reader = viaReader(yaml);
+    Outcome nodes = viaNodes(yaml);
+    if (reader.ok != nodes.ok || reader.text != nodes.text) {
+        std::cerr << name << ":\n  reader: " << reader.text << "\n  nodes:  " << nodes.text << std::endl;
+    }
+    EXPECT(reader.ok == nodes.ok);
+    EXPECT(reader.text == nodes.text);
+    return reader;
+}
+
+std::string slurp(const fs::path& path) {
+    std::ifstream file(path);
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+void testShippedConfigs() {
+    fs::path root = IPTABLES_COMPOSE_SOURCE_DIR;
+    std::vector<fs::path> files = {root / "example.yaml", root / "example_mac.yaml"};
+    for (const auto& entry : fs::directory_iterator(root / "test-configs")) {
+        if (entry.path().extension() == ".yaml") {
+            files.push_back(entry.path());
+        }
+    }
+    EXPECT(files.size() > 2);
+    for (const auto& file : files) {
+        compare(file.filename().string(), slurp(file));
+    }
+}
+
+void testNulls() {
+    // A null where a string goes converts to "null"; elsewhere it is a conversion error
+    EXPECT(compare("null chain name", "jump:\n  interface:\n    input: eth0\n    chain: ~\n").ok);
+    EXPECT(compare("null interface", "web:\n  ports:\n    - port: 80\n      interface:\n        input:\n").ok);
+    EXPECT(!compare("null section", "web:\n").ok);
+    EXPECT(!compare("null port", "web:\n  ports:\n    - port: ~\n").ok);
+    EXPECT(!compare("null policy", "filter:\n  input: null\n").ok);
+    EXPECT(!compare("null document", "~\n").ok);
+}
+
+void testAliases() {
+    // An anchored node decodes the same wherever it is referenced
+    EXPECT(compare("aliased rule", R"(web:
+  ports:
+    - &http
+      port: 80
+      protocol: tcp
+    - *http
+api:
+  ports:
+    - *http
+)").ok);
+    EXPECT(compare("aliased list", R"(lan:
+  ports:
+    - port: 22
+      subnet: &lan ["10.0.0.0/8", "192.168.0.0/16"]
+    - port: 443
+      subnet: *lan
+)").ok);
+    EXPECT(compare("aliased section", "web: &web\n  ports:\n    - port: 80\ncopy: *web\n").ok);
+    // An alias to a node that cannot convert fails where it is used
+    EXPECT(!compare("aliased bad port", "a:\n  ports:\n    - port: &p 70000\nb:\n  ports:\n    - port: *p\n").ok);
+}
+
+void testDuplicateKeys() {
+    // The first of repeated fields wins; repeated sections are kept in order
+    EXPECT(compare("duplicate field", "web:\n  ports:\n    - port: 80\n      port: 81\n").ok);
+    EXPECT(compare("duplicate policy", "filter:\n  input: drop\n  input: accept\n").ok);
+    EXPECT(compare("duplicate section",
+                   "web:\n  ports:\n    - port: 80\nweb:\n  ports:\n    - port: 81\n").ok);
+    // A bad value under a repeated key is never converted
+    EXPECT(compare("bad duplicate", "web:\n  ports:\n    - port: 80\n      port: nope\n").ok);
+}
+
+void testTemplates() {
+    // Variables keep their YAML order; scalars and lists stay apart
+    EXPECT(compare("template", R"(web:
+  vars:
+    lan: ["10.0.0.0/8", "192.168.0.0/16"]
+    zone: office
+  for_each:
+    iface: [eth0, eth1]
+    port: ["80", "443"]
+  ports:
+    - range: ["${port}"]
+      subnet: ["${lan}"]
+      interface:
+        input: "${iface}"
+)").ok);
+    EXPECT(!compare("template map value", "web:\n  vars:\n    lan: {a: b}\n").ok);
+}
+
+void testErrors() {
+    // Conversion errors carry the position of the node that failed
+    Outcome bad_port = compare("bad port", "web:\n  ports:\n    - port: 70000\n");
+    EXPECT(!bad_port.ok);
+    EXPECT(bad_port.text == "yaml-cpp: error at line 3, column 13: bad conversion" != std::string::npos);
+    EXPECT(!compare("bad protocol", "web:\n  ports:\n    - port: 80\n      protocol: sctp\n").ok);
+    EXPECT(!compare("nested range", "web:\n  ports:\n    - range: [[1000]]\n").ok);
+    EXPECT(!compare("port and range", "web:\n  ports:\n    - port: 80\n      range: [\"1-2\"]\n").ok);
+    EXPECT(!compare("bad interface", "web:\n  interface:\n    - input: [eth0]\n").ok);
+    // With several faults, the one the node decoder reaches first is reported
+    EXPECT(!compare("two faults",
+                    "a:\n  ports:\n    - port: 80\n      protocol: sctp\n      direction: sideways\n").ok);
+
+    // Syntax errors win over conversion errors earlier in the document
+    Outcome syntax = compare("syntax error", "web:\n  ports:\n    - port: 70000\n  mac: [unterminated\n");
+    EXPECT(!syntax.ok);
+    EXPECT(syntax.text.find("line") != std::string::npos);
+    EXPECT(!compare("bad indentation", "web:\n  ports:\n - port: 80\n   allow: true\n").ok);
+}
+
+} // namespace
+
+int main() {
+    testShippedConfigs();
+    testNulls();
+    testAliases();
+    testDuplicateKeys();
+    testTemplates();
+    testErrors();
+    return iptables::test::report("config reader");
+}
@@ -0,0 +1,202 @@
+/**
+ * @file control_socket_test.cpp
+ * @brief Round trips between ControlClient and ControlServer
+ * @author iptables-compose-cpp Development Team
+ * @date 2024
+ *
+ * A ControlServer listens on a socket in a temporary directory and is
+ * served from the test thread, the way the daemon's event loop does,
+ * while a second thread plays the client: either ControlClient::send or
+ * a raw socket that breaks the framing on purpose.
+ */
+
+#include "control_socket.hpp"
+#include "test_support.hpp"
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace {
+
+using iptables::ControlClient;
+using iptables::ControlRequest;
+using iptables::ControlResponse;
+using iptables::ControlServer;
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief A listening ControlServer in a private temporary directory
+ */
+class SocketFixture {
+public:
+    SocketFixture()
+        : root_(fs::temp_directory_path() / ("iptables-compose-socket-tests-" + std::to_string(getpid()))),
+          server_(root_ / "control.sock") {
+        fs::remove_all(root_);
+        fs::create_directories(root_);
+        listening_ = server_.listen();
+    }
+
+    ~SocketFixture() {
+        std::error_code error;
+        fs::remove_all(root_, error);
+    }
+
+    bool listening() const { return listening_; }
+    fs::path path() const { return root_ / "control.sock"; }
+
+    /**
+     * @brief Run client on its own thread and serve until it is done
+     * @return Number of requests the server answered
+     */
+    size_t exchange(const ControlServer::Handler& handler, const std::function<void()>& client) {
+        std::thread thread(client);
+        size_t served = 0;
+        pollfd descriptor{server_.descriptor(), POLLIN, 0};
+        if (poll(&descriptor, 1, 5000) > 0) {
+            served = server_.serve(handler);
+        }
+        thread.join();
+        return served;
+    }
+
+private:
+    fs::path root_;
+    ControlServer server_;
+    bool listening_ = false;
+};
+
+// Connect without ControlClient, to send whatever bytes a test needs
+int connectRaw(const fs::path& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// True once the server hung up without writing a byte
+bool closedUnanswered(int fd) {
+    char byte;
+    return recv(fd, &byte, 1, 0) == 0;
+}
+
+ControlResponse echo(const ControlRequest& request) {
+    ControlResponse response;
+    response.success = request.command != "fail";
+    response.body = request.command;
+    for (const auto& argument : request.arguments) {
+        response.body += "|" + argument;
+    }
+    response.body += "\n" + request.body;
+    return response;
+}
+
+void testRoundTrip() {
+    SocketFixture fixture;
+    EXPECT(fixture.listening());
+
+    // The request line is split into words; the body crosses unchanged, newlines included
+    std::optional<ControlResponse> response;
+    size_t served = fixture.exchange(echo, [&] {
+        response = ControlClient::send(fixture.path(), {"apply", {"web", "db"}, "ssh:\n  ports: []\n"});
+    });
+    EXPECT(served == 1);
+    EXPECT(response && response->success);
+    EXPECT(response && response->body == "apply|web|db\nssh:\n  ports: []\n");
+
+    // A failed request comes back with the error status and its body
+    response.reset();
+    served = fixture.exchange(echo, [&] { response = ControlClient::send(fixture.path(), {"fail", {}, "why"}); });
+    EXPECT(served == 1);
+    EXPECT(response && !response->success);
+    EXPECT(response && response->body == "fail\nwhy");
+
+    // Frames are length-prefixed, so a large body arrives whole
+    std::string large(4u << 20, 'x');
+    response.reset();
+    served = fixture.exchange(echo, [&] { response = ControlClient::send(fixture.path(), {"status", {}, large}); });
+    EXPECT(served == 1);
+    EXPECT(response && response->body == "status\n" + large);
+}
+
+void testOversizedFrame() {
+    SocketFixture fixture;
+    bool handled = false;
+    auto handler = [&](const ControlRequest& request) {
+        handled = true;
+        return echo(request);
+    };
+
+    // A header announcing more than kMaxFrame is dropped without reading the payload
+    bool closed = false;
+    size_t served = fixture.exchange(handler, [&] {
+        int fd = connectRaw(fixture.path());
+        uint32_t size = ControlServer::kMaxFrame + 1;
+        unsigned char header[4] = {static_cast<unsigned char>(size >> 24), static_cast<unsigned char>(size >> 16),
+                                   static_cast<unsigned char>(size >> 8), static_cast<unsigned char>(size)};
+        ::send(fd, header, sizeof(header), MSG_NOSIGNAL);
+        closed = closedUnanswered(fd);
+        close(fd);
+    });
+    EXPECT(served == 0);
+    EXPECT(!handled);
+    EXPECT(closed);
+
+    // The client refuses to send such a frame in the first place
+    std::optional<ControlResponse> response;
+    std::string oversized(ControlServer::kMaxFrame + 1, 'x');
+    served = fixture.exchange(handler, [&] {
+        response = ControlClient::send(fixture.path(), {"apply", {}, oversized});
+    });
+    EXPECT(!response);
+    EXPECT(served == 0);
+    EXPECT(!handled);
+}
+
+void testTricklingClient() {
+    SocketFixture fixture;
+
+    // One byte every 400 ms keeps each recv() under a second, but not the frame
+    bool closed = false;
+    auto started = std::chrono::steady_clock::now();
+    size_t served = fixture.exchange(echo, [&] {
+        int fd = connectRaw(fixture.path());
+        const unsigned char frame[] = {0, 0, 0, 6, 's', 't', 'a', 't', 'u', 's'};
+        for (unsigned char byte : frame) {
+            if (::send(fd, &byte, 1, MSG_NOSIGNAL) != 1) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(400));
+        }
+        closed = closedUnanswered(fd);
+        close(fd);
+    });
+    auto held = std::chrono::steady_clock::now() - started;
+    EXPECT(served == 0);
+    EXPECT(closed);
+    // serve() returned at the deadline, not when the client gave up
+    EXPECT(held < std::chrono::seconds(3));
+}
+
+} // namespace
+
+int main() {
+    testRoundTrip();
+    testOversizedFrame();
+    testTricklingClient();
+    return iptables::test::report("control socket");
+}
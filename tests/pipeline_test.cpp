@@ -0,0 +1,496 @@
+/**
+ * @file pipeline_test.cpp
+ * @brief End-to-end tests of the apply, plan, reload, check and remove pipelines
+ *        and of section templates and conf.d fragments
+ * @author iptables-compose-cpp Development Team
+ * @date 2024
+ *
+ * Each test drives IptablesManager the way the command line does, with a
+ * SimulatedNetfilter installed as the command runner, and asserts on the
+ * ruleset the simulation holds afterwards. Nothing touches the kernel, so
+ * the tests run unprivileged.
+ */
+
+#include "iptables_manager.hpp"
+#include "command_executor.hpp"
+#include "config_loader.hpp"
+#include "ruleset_cache.hpp"
+#include "simulated_netfilter.hpp"
+#include "state_journal.hpp"
+#include "test_support.hpp"
+#include <unistd.h>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using iptables::IptablesManager;
+using iptables::RulesetSnapshot;
+using iptables::SimulatedNetfilter;
+
+const char* const kConfig = R"(filter:
+  input: drop
+  output: accept
+  forward: drop
+
+ssh:
+  ports:
+    - port: 22
+      allow: true
+
+vscode:
+  ports:
+    - range:
+        - "1000-2000"
+        - "3000-4000"
+      allow: true
+)";
+
+// Same sections, with ssh moved to another port
+const char* const kEditedConfig = R"(filter:
+  input: drop
+  output: accept
+  forward: drop
+
+ssh:
+  ports:
+    - port: 2222
+      allow: true
+
+vscode:
+  ports:
+    - range:
+        - "1000-2000"
+        - "3000-4000"
+      allow: true
+)";
+
+// Two interfaces times two port ranges: four instances of three rules, one per subnet
+const char* const kTemplateConfig = R"(web:
+  vars:
+    office: 172.16.0.0/12
+    trusted: ["10.0.0.0/8", "192.168.0.0/16"]
+    web_ports: ["8000-8100", "9000-9100"]
+  for_each:
+    iface: [eth0, eth1]
+    ports: web_ports
+  ports:
+    - range: ["${ports}"]
+      interface:
+        input: "${iface}"
+      subnet: ["${trusted}", "${office}"]
+)";
+
+// A subnet with host bits set, a MAC address in lower case and two sources
+const char* const kSpellingConfig = R"(lan:
+  ports:
+    - port: 8080
+      subnet: ["10.1.2.3/8"]
+      mac-source: "aa:bb:cc:dd:ee:ff"
+    - port: 9090
+      subnet: ["192.168.1.7/24", "172.16.0.1"]
+)";
+
+// A fresh simulated netfilter with journal and cache files of its own
+class Sandbox {
+public:
+    Sandbox()
+        : directory_(std::filesystem::temp_directory_path() /
+                     ("iptables-compose-tests-" + std::to_string(getpid()))) {
+        std::filesystem::remove_all(directory_);
+        std::filesystem::create_directories(directory_);
+        iptables::StateJournal::setPath(directory_ / "state");
+        iptables::RulesetCache::setPath(directory_ / "cache");
+        iptables::CommandExecutor::setRunner(&netfilter_);
+    }
+
+    ~Sandbox() {
+        iptables::CommandExecutor::setRunner(nullptr);
+        std::filesystem::remove_all(directory_);
+    }
+
+    Sandbox(const Sandbox&) = delete;
+    Sandbox& operator=(const Sandbox&) = delete;
+
+    std::filesystem::path write(const std::string& name, const std::string& contents) const {
+        std::filesystem::path path = directory_ / name;
+        std::ofstream(path) << contents;
+        return path;
+    }
+
+    // Run an iptables command as another tool would
+    bool foreign(const std::vector<std::string>& args) {
+        return iptables::CommandExecutor::executeIptables(args).isSuccess();
+    }
+
+    RulesetSnapshot ruleset() const { return netfilter_.ruleset(); }
+    uint64_t operations() const { return netfilter_.statistics().operations; }
+
+private:
+    std::filesystem::path directory_;
+    SimulatedNetfilter netfilter_;
+};
+
+// Every rule of a table, as "CHAIN spec"
+std::vector<std::string> rules(const RulesetSnapshot& ruleset, const std::string& table = "filter") {
+    std::vector<std::string> lines;
+    for (const auto& name : ruleset.chainNames(table)) {
+        for (const auto& rule : ruleset.chain(table, name)->rules) {
+            lines.push_back(name + " " + rule.spec);
+        }
+    }
+    return lines;
+}
+
+size_t countContaining(const std::vector<std::string>& lines, const std::string& text) {
+    size_t count = 0;
+    for (const auto& line : lines) {
+        if (line.find(text) != std::string::npos) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+std::string policy(const RulesetSnapshot& ruleset, const std::string& chain) {
+    const iptables::SnapshotChain* found = ruleset.chain("filter", chain);
+    return found ? found->policy : "";
+}
+
+// What a call printed on a stream
+std::string printedOn(std::ostream& stream, const std::function<void()>& call) {
+    std::ostringstream captured;
+    std::streambuf* previous = stream.rdbuf(captured.rdbuf());
+    call();
+    stream.rdbuf(previous);
+    return captured.str();
+}
+
+std::string stdoutOf(const std::function<void()>& call) {
+    return printedOn(std::cout, call);
+}
+
+std::string stderrOf(const std::function<void()>& call) {
+    return printedOn(std::cerr, call);
+}
+
+void testApply(IptablesManager::Backend backend) {
+    Sandbox sandbox;
+    std::filesystem::path config = sandbox.write("config.yaml", kConfig);
+
+    IptablesManager manager;
+    manager.setBackend(backend);
+    EXPECT(manager.loadConfig(config));
+
+    RulesetSnapshot live = sandbox.ruleset();
+    std::vector<std::string> filter = rules(live);
+    EXPECT(policy(live, "INPUT") == "DROP");
+    EXPECT(policy(live, "FORWARD") == "DROP");
+    EXPECT(countContaining(filter, "--dport 22 ") == 1);
+    EXPECT(countContaining(filter, "--dports 1000:2000,3000:4000 ") == 1);
+    EXPECT(countContaining(filter, "YAML:") == 2);
+
+    // Applying the same configuration again changes nothing
+    uint64_t before = sandbox.operations();
+    IptablesManager again;
+    again.setBackend(backend);
+    EXPECT(again.loadConfig(config));
+    EXPECT(sandbox.operations() == before);
+    EXPECT(rules(sandbox.ruleset()) == filter);
+}
+
+void testPlan() {
+    Sandbox sandbox;
+    std::filesystem::path config = sandbox.write("config.yaml", kConfig);
+    std::filesystem::path edited = sandbox.write("edited.yaml", kEditedConfig);
+
+    IptablesManager manager;
+    std::string output;
+    output = stdoutOf([&] { EXPECT(manager.planConfig(config)); });
+    EXPECT(output.find("Plan: 2 to add, 0 to delete") != std::string::npos);
+    EXPECT(rules(sandbox.ruleset()).empty());
+
+    EXPECT(manager.loadConfig(config));
+    output = stdoutOf([&] { EXPECT(manager.planConfig(config)); });
+    EXPECT(output.find("Plan: 0 to add, 0 to delete") != std::string::npos);
+
+    output = stdoutOf([&] { EXPECT(manager.planConfig(edited)); });
+    EXPECT(output.find("Plan: 1 to add, 1 to delete") != std::string::npos);
+}
+
+void testReload() {
+    Sandbox sandbox;
+    std::filesystem::path config = sandbox.write("config.yaml", kConfig);
+    std::filesystem::path edited = sandbox.write("edited.yaml", kEditedConfig);
+
+    IptablesManager manager;
+    EXPECT(manager.loadConfig(config));
+    EXPECT(manager.reloadConfig(edited));
+
+    // The rules now live in generation chains the built-in chains jump to
+    std::vector<std::string> filter = rules(sandbox.ruleset());
+    EXPECT(countContaining(filter, "--dport 2222 ") == 1);
+    EXPECT(countContaining(filter, "--dport 22 ") == 0);
+    EXPECT(countContaining(filter, "--dports 1000:2000,3000:4000 ") == 1);
+
+    // Reloading the same file again swaps generations without losing a rule
+    EXPECT(manager.reloadConfig(edited));
+    EXPECT(countContaining(rules(sandbox.ruleset()), "--dport 2222 ") == 1);
+}
+
+void testCheck() {
+    Sandbox sandbox;
+    std::filesystem::path config = sandbox.write("config.yaml", kConfig);
+
+    IptablesManager manager;
+    EXPECT(manager.loadConfig(config));
+    EXPECT(manager.checkConfig(config, false) == std::optional<bool>(true));
+
+    // Another tool's rules in a built-in chain are not drift
+    EXPECT(sandbox.foreign({"-A", "INPUT", "-s", "192.0.2.1", "-j", "DROP"}));
+    EXPECT(manager.checkConfig(config, false) == std::optional<bool>(true));
+
+    // A check without a state file writes nothing
+    std::filesystem::remove(iptables::StateJournal::path());
+    EXPECT(manager.checkConfig(config, false) == std::optional<bool>(true));
+    EXPECT(!std::filesystem::exists(iptables::StateJournal::path()));
+    EXPECT(manager.checkConfig(config, true) == std::optional<bool>(true));
+    EXPECT(std::filesystem::exists(iptables::StateJournal::path()));
+
+    // Removing a managed rule is drift
+    std::vector<std::string> filter = rules(sandbox.ruleset());
+    for (size_t i = 0; i < filter.size(); ++i) {
+        if (filter[i].find("--dport 22 ") != std::string::npos) {
+            EXPECT(sandbox.foreign({"-D", "INPUT", std::to_string(i + 1)}));
+            break;
+        }
+    }
+    EXPECT(manager.checkConfig(config, false) == std::optional<bool>(false));
+}
+
+// Rules spelled the way iptables-save prints them are the rules the configuration asks for
+void testCanonicalSpelling() {
+    Sandbox sandbox;
+    std::filesystem::path config = sandbox.write("config.yaml", kSpellingConfig);
+
+    IptablesManager manager;
+    EXPECT(manager.loadConfig(config));
+    std::vector<std::string> filter = rules(sandbox.ruleset());
+    EXPECT(countContaining(filter, "--dport 9090 ") == 2);
+
+    // Replace what was applied with the kernel's spelling of the same rules
+    std::filesystem::remove(iptables::StateJournal::path());
+    for (size_t i = filter.size(); i > 0; --i) {
+        EXPECT(sandbox.foreign({"-D", "INPUT", std::to_string(i)}));
+    }
+    for (std::string line : filter) {
+        line = line.substr(line.find(' ') + 1);
+        for (const auto& [written, saved] : std::vector<std::pair<std::string, std::string>>{
+                 {"10.1.2.3/8", "10.0.0.0/8"},
+                 {"192.168.1.7/24", "192.168.1.0/24"},
+                 {"172.16.0.1 ", "172.16.0.1/32 "},
+                 {"aa:bb:cc:dd:ee:ff", "AA:BB:CC:DD:EE:FF"}}) {
+            size_t at = line.find(written);
+            if (at != std::string::npos) {
+                line.replace(at, written.size(), saved);
+            }
+        }
+        std::vector<std::string> args{"-A", "INPUT"};
+        std::istringstream words(line);
+        for (std::string word; words >> word;) {
+            args.push_back(word);
+        }
+        EXPECT(sandbox.foreign(args));
+    }
+
+    std::string output = stdoutOf([&] { EXPECT(manager.planConfig(config)); });
+    EXPECT(output.find("Plan: 0 to add, 0 to delete") != std::string::npos);
+    EXPECT(manager.checkConfig(config, false) == std::optional<bool>(true));
+}
+
+void testRemoveRules() {
+    Sandbox sandbox;
+    std::filesystem::path config = sandbox.write("config.yaml", kConfig);
+
+    IptablesManager manager;
+    manager.setSectionChains(true);
+    EXPECT(manager.loadConfig(config));
+    EXPECT(sandbox.foreign({"-A", "INPUT", "-s", "192.0.2.1", "-j", "DROP"}));
+    EXPECT(sandbox.foreign({"-N", "DOCKER-USER"}));
+
+    IptablesManager remover;
+    EXPECT(remover.removeYamlRules());
+
+    RulesetSnapshot live = sandbox.ruleset();
+    std::vector<std::string> filter = rules(live);
+    EXPECT(countContaining(filter, "YAML:") == 0);
+    EXPECT(countContaining(filter, "192.0.2.1") == 1);
+    EXPECT(live.hasChain("filter", "DOCKER-USER"));
+    EXPECT(live.chainNames("filter", true) == std::vector<std::string>{"DOCKER-USER"});
+    EXPECT(policy(live, "INPUT") == "ACCEPT");
+    EXPECT(policy(live, "FORWARD") == "ACCEPT");
+}
+
+void testTemplates() {
+    Sandbox sandbox;
+    std::filesystem::path config = sandbox.write("template.yaml", kTemplateConfig);
+
+    // Each instance is planned under its own name
+    IptablesManager manager;
+    std::string output = stdoutOf([&] { EXPECT(manager.planConfig(config)); });
+    EXPECT(output.find("Plan: 12 to add, 0 to delete") != std::string::npos);
+    for (const char* instance : {"web[eth0,8000-8100]", "web[eth0,9000-9100]", "web[eth1,8000-8100]",
+                                 "web[eth1,9000-9100]"}) {
+        EXPECT(output.find(std::string("# YAML:") + instance + ":") != std::string::npos);
+    }
+
+    EXPECT(manager.loadConfig(config));
+    std::vector<std::string> filter = rules(sandbox.ruleset());
+    EXPECT(filter.size() == 12);
+    EXPECT(countContaining(filter, "-i eth0 ") == 6);
+    EXPECT(countContaining(filter, "--dports 9000:9100 ") == 6);
+    // Scalar variables, and list variables as whole elements, fill the subnet list
+    EXPECT(countContaining(filter, "-s 10.0.0.0/8 ") == 4);
+    EXPECT(countContaining(filter, "-s 172.16.0.0/12 ") == 4);
+    EXPECT(countContaining(filter, "-i eth1 -s 192.168.0.0/16 -p tcp -m multiport --dports 8000:8100 ") == 1);
+
+    // A new for_each value only adds the new instances; the others keep their rules
+    std::string grown = kTemplateConfig;
+    grown.replace(grown.find("[eth0, eth1]"), 12, "[eth0, eth1, eth2]");
+    std::filesystem::path edited = sandbox.write("grown.yaml", grown);
+    output = stdoutOf([&] { EXPECT(manager.planConfig(edited)); });
+    EXPECT(output.find("Plan: 6 to add, 0 to delete") != std::string::npos);
+    EXPECT(output.find("web[eth2,") != std::string::npos);
+    EXPECT(output.find("web[eth0,") == std::string::npos);
+}
+
+void testTemplateErrors() {
+    Sandbox sandbox;
+    IptablesManager manager;
+    std::string errors;
+
+    // Undefined variables fail the load naming the section and the variable
+    std::filesystem::path undefined = sandbox.write("undefined.yaml", R"(web:
+  for_each:
+    iface: [eth0]
+  ports:
+    - port: 80
+      interface:
+        input: "${interface}"
+)");
+    errors = stderrOf([&] { EXPECT(!manager.loadConfig(undefined)); });
+    EXPECT(errors.find("Section 'web'") != std::string::npos);
+    EXPECT(errors.find("Undefined variable 'interface'") != std::string::npos);
+
+    // A list variable cannot be spliced into a longer string
+    std::filesystem::path spliced = sandbox.write("spliced.yaml", R"(web:
+  vars:
+    lan: ["10.0.0.0/8", "192.168.0.0/16"]
+  ports:
+    - port: 80
+      subnet: ["${lan}/extra"]
+)");
+    errors = stderrOf([&] { EXPECT(!manager.loadConfig(spliced)); });
+    EXPECT(errors.find("List variable 'lan'") != std::string::npos);
+
+    // Numbers and enumerations take no variables: the value fails to convert where it is written
+    std::filesystem::path number = sandbox.write("number.yaml", R"(web:
+  for_each:
+    port: ["80", "443"]
+  ports:
+    - port: "${port}"
+)");
+    errors = stderrOf([&] { EXPECT(!manager.loadConfig(number)); });
+    EXPECT(errors.find("line 5, column 13: bad conversion") != std::string::npos);
+
+    std::filesystem::path enumeration = sandbox.write("enumeration.yaml", R"(web:
+  for_each:
+    proto: [tcp, udp]
+  ports:
+    - port: 53
+      protocol: "${proto}"
+)");
+    errors = stderrOf([&] { EXPECT(!manager.loadConfig(enumeration)); });
+    EXPECT(errors.find("line 6, column 17: bad conversion") != std::string::npos);
+
+    EXPECT(rules(sandbox.ruleset()).empty());
+}
+
+void testFragments() {
+    Sandbox sandbox;
+    std::filesystem::path config = sandbox.write("config.yaml", kConfig);
+    std::filesystem::create_directories(iptables::ConfigLoader::fragmentDirectory(config));
+    std::filesystem::path web = sandbox.write("config.d/50-web.yaml", "web:\n  ports:\n    - port: 443\n");
+    std::filesystem::path base = sandbox.write("config.d/10-base.yaml", "base:\n  ports:\n    - port: 53\n      protocol: udp\n");
+    sandbox.write("config.d/.hidden.yaml", "hidden:\n  ports:\n    - port: 1\n");
+    sandbox.write("config.d/notes.txt", "not a fragment");
+
+    // The main file, then the fragments in byte order of their names
+    EXPECT(iptables::ConfigLoader::files(config) == (std::vector<std::filesystem::path>{config, base, web}));
+    iptables::ConfigLoader loader;
+    iptables::Config merged = loader.load(config);
+    EXPECT(loader.fragmentCount() == 2);
+    std::vector<std::string> sections;
+    for (const auto& [name, section] : merged.custom_sections) {
+        sections.push_back(name);
+    }
+    EXPECT(sections == (std::vector<std::string>{"ssh", "vscode", "base", "web"}));
+
+    // The merged rules are applied in that order
+    IptablesManager manager;
+    EXPECT(manager.loadFromCache(config));
+    std::vector<std::string> filter = rules(sandbox.ruleset());
+    EXPECT(filter.size() == 4);
+    EXPECT(filter.size() == 4 && filter[0].find("--dport 22 ") != std::string::npos);
+    EXPECT(filter.size() == 4 && filter[2].find("-p udp -m udp --dport 53 ") != std::string::npos);
+    EXPECT(filter.size() == 4 && filter[3].find("--dport 443 ") != std::string::npos);
+
+    // Changing a fragment changes the cache key, so the stored payload is not reused
+    std::optional<uint64_t> key = iptables::RulesetCache::key(config, false);
+    EXPECT(key && iptables::RulesetCache::load(*key));
+    sandbox.write("config.d/50-web.yaml", "web:\n  ports:\n    - port: 8443\n");
+    std::optional<uint64_t> edited = iptables::RulesetCache::key(config, false);
+    EXPECT(edited && *edited != *key);
+    EXPECT(edited && !iptables::RulesetCache::load(*edited));
+    // So does adding one, since fragment names decide the merge order
+    sandbox.write("config.d/70-extra.yaml", "extra:\n  ports:\n    - port: 25\n");
+    std::optional<uint64_t> added = iptables::RulesetCache::key(config, false);
+    EXPECT(added && *added != *edited);
+
+    // A section defined again in a fragment fails the load naming both files
+    std::filesystem::path duplicate = sandbox.write("config.d/60-ssh.yaml", "ssh:\n  ports:\n    - port: 2222\n");
+    std::string error;
+    try {
+        iptables::ConfigLoader().load(config);
+    } catch (const std::runtime_error& e) {
+        error = e.what();
+    }
+    EXPECT(error.find("'ssh'") != std::string::npos);
+    EXPECT(error.find(config.string()) != std::string::npos);
+    EXPECT(error.find(duplicate.string()) != std::string::npos);
+    std::string errors = stderrOf([&] { EXPECT(!IptablesManager().loadConfig(config)); });
+    EXPECT(errors.find(duplicate.string()) != std::string::npos);
+}
+
+} // namespace
+
+int main() {
+    testApply(IptablesManager::Backend::Iptables);
+    testApply(IptablesManager::Backend::Stream);
+    testApply(IptablesManager::Backend::Restore);
+    testPlan();
+    testReload();
+    testCheck();
+    testCanonicalSpelling();
+    testRemoveRules();
+    testTemplates();
+    testTemplateErrors();
+    testFragments();
+
+    return iptables::test::report("pipeline");
+}
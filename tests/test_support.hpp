@@ -0,0 +1,46 @@
+/**
+ * @file test_support.hpp
+ * @brief Expectation macro and failure report shared by the test programs
+ * @author iptables-compose-cpp Development Team
+ * @date 2024
+ *
+ * The tests are plain executables run by ctest: EXPECT records a failed
+ * condition and carries on, and main() returns report() so every failure
+ * of a run is listed, not just the first.
+ */
+
+#pragma once
+
+#include <iostream>
+
+namespace iptables::test {
+
+/// Number of expectations that failed so far in this program
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+/**
+ * @brief Print the outcome of the run
+ * @param suite Name used in the success line
+ * @return Exit code for main(): 0 if every expectation held
+ */
+inline int report(const char* suite) {
+    if (failures() > 0) {
+        std::cerr << failures() << " expectation(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All " << suite << " tests passed" << std::endl;
+    return 0;
+}
+
+} // namespace iptables::test
+
+#define EXPECT(condition)                                                                   \
+    do {                                                                                    \
+        if (!(condition)) {                                                                 \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": expected " #condition << std::endl; \
+            ++iptables::test::failures();                                                   \
+        }                                                                                   \
+    } while (0)